@@ -22,11 +22,15 @@
 
 #undef BUFSIZE
 #define BUFSIZE 1024*8
+/* Buffer size with -threads, large enough to give every thread some work */
+#define THREADS_BUFSIZE (16*1024*1024)
 
-int do_fp(BIO *out, unsigned char *buf, BIO *bp, int sep, int binout,
+int do_fp(BIO *out, unsigned char *buf, int bufsize, BIO *bp, int sep,
+          int binout,
           EVP_PKEY *key, unsigned char *sigin, int siglen,
           const char *sig_name, const char *md_name,
           const char *file);
+static void set_threads(BIO *bmd, int threads);
 
 typedef enum OPTION_choice {
     OPT_ERR = -1, OPT_EOF = 0, OPT_HELP,
@@ -34,7 +38,7 @@ typedef enum OPTION_choice {
     OPT_PRVERIFY, OPT_SIGNATURE, OPT_KEYFORM, OPT_ENGINE, OPT_ENGINE_IMPL,
     OPT_HEX, OPT_BINARY, OPT_DEBUG, OPT_FIPS_FINGERPRINT,
     OPT_HMAC, OPT_MAC, OPT_SIGOPT, OPT_MACOPT,
-    OPT_DIGEST,
+    OPT_DIGEST, OPT_THREADS,
     OPT_R_ENUM
 } OPTION_CHOICE;
 
@@ -65,6 +69,8 @@ const OPTIONS dgst_options[] = {
     {"sigopt", OPT_SIGOPT, 's', "Signature parameter in n:v form"},
     {"macopt", OPT_MACOPT, 's', "MAC algorithm parameters in n:v form or key"},
     {"", OPT_DIGEST, '-', "Any supported digest"},
+    {"threads", OPT_THREADS, 'p',
+     "Spread the hashing of large inputs over this many threads"},
     OPT_R_OPTIONS,
 #ifndef OPENSSL_NO_ENGINE
     {"engine", OPT_ENGINE, 's', "Use engine e, possibly a hardware device"},
@@ -91,10 +97,9 @@ int dgst_main(int argc, char **argv)
     int separator = 0, debug = 0, keyform = FORMAT_PEM, siglen = 0;
     int i, ret = 1, out_bin = -1, want_pub = 0, do_verify = 0;
     unsigned char *buf = NULL, *sigbuf = NULL;
-    int engine_impl = 0;
+    int engine_impl = 0, threads = 1, bufsize = BUFSIZE;
 
     prog = opt_progname(argv[0]);
-    buf = app_malloc(BUFSIZE, "I/O buffer");
     md = EVP_get_digestbyname(prog);
 
     prog = opt_init(argc, argv, dgst_options);
@@ -184,6 +189,10 @@ int dgst_main(int argc, char **argv)
                 goto opthelp;
             md = m;
             break;
+        case OPT_THREADS:
+            if (!opt_int(opt_arg(), &threads))
+                goto opthelp;
+            break;
         }
     }
     argc = opt_num_rest();
@@ -359,6 +368,13 @@ int dgst_main(int argc, char **argv)
             goto end;
         }
     }
+    if (threads > 1) {
+        if (!setup_thread_pool(threads))
+            goto end;
+        bufsize = THREADS_BUFSIZE;
+    }
+    buf = app_malloc(bufsize, "I/O buffer");
+
     inp = BIO_push(bmd, in);
 
     if (md == NULL) {
@@ -371,8 +387,9 @@ int dgst_main(int argc, char **argv)
 
     if (argc == 0) {
         BIO_set_fp(in, stdin, BIO_NOCLOSE);
-        ret = do_fp(out, buf, inp, separator, out_bin, sigkey, sigbuf,
-                    siglen, NULL, md_name, "stdin");
+        set_threads(bmd, threads);
+        ret = do_fp(out, buf, bufsize, inp, separator, out_bin, sigkey,
+                    sigbuf, siglen, NULL, md_name, "stdin");
     } else {
         const char *sig_name = NULL;
         if (!out_bin) {
@@ -392,8 +409,9 @@ int dgst_main(int argc, char **argv)
                 ret++;
                 continue;
             } else {
-                r = do_fp(out, buf, inp, separator, out_bin, sigkey, sigbuf,
-                          siglen, sig_name, md_name, argv[i]);
+                set_threads(bmd, threads);
+                r = do_fp(out, buf, bufsize, inp, separator, out_bin, sigkey,
+                          sigbuf, siglen, sig_name, md_name, argv[i]);
             }
             if (r)
                 ret = r;
@@ -401,7 +419,7 @@ int dgst_main(int argc, char **argv)
         }
     }
  end:
-    OPENSSL_clear_free(buf, BUFSIZE);
+    OPENSSL_clear_free(buf, bufsize);
     BIO_free(in);
     OPENSSL_free(passin);
     BIO_free_all(out);
@@ -453,8 +471,24 @@ static const char *newline_escape_filename(const char *file, int * backslash)
 }
 
 
-int do_fp(BIO *out, unsigned char *buf, BIO *bp, int sep, int binout,
-          EVP_PKEY *key, unsigned char *sigin, int siglen,
+/*
+ * Let the digest spread its work over |threads| threads.  It has to be done
+ * again after every reset of the context.  Digests that can't do this simply
+ * ignore it.
+ */
+static void set_threads(BIO *bmd, int threads)
+{
+    EVP_MD_CTX *mctx = NULL;
+
+    if (threads <= 1 || !BIO_get_md_ctx(bmd, &mctx))
+        return;
+    ERR_set_mark();
+    EVP_MD_CTX_ctrl(mctx, EVP_MD_CTRL_SET_THREADS, threads, NULL);
+    ERR_pop_to_mark();
+}
+
+int do_fp(BIO *out, unsigned char *buf, int bufsize, BIO *bp, int sep,
+          int binout, EVP_PKEY *key, unsigned char *sigin, int siglen,
           const char *sig_name, const char *md_name,
           const char *file)
 {
@@ -462,7 +496,7 @@ int do_fp(BIO *out, unsigned char *buf, BIO *bp, int sep, int binout,
     int i, backslash = 0;
 
     while (BIO_pending(bp) || !BIO_eof(bp)) {
-        i = BIO_read(bp, (char *)buf, BUFSIZE);
+        i = BIO_read(bp, (char *)buf, bufsize);
         if (i < 0) {
             BIO_printf(bio_err, "Read Error in %s\n", file);
             ERR_print_errors(bio_err);
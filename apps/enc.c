@@ -29,6 +29,8 @@
 #undef BSIZE
 #define SIZE    (512)
 #define BSIZE   (8*1024)
+/* Default buffer size with -threads, to give every thread something to do */
+#define THREADS_BSIZE   (1024*1024)
 
 static int set_hex(const char *in, unsigned char *out, int size);
 static void show_ciphers(const OBJ_NAME *name, void *bio_);
@@ -45,7 +47,7 @@ typedef enum OPTION_choice {
     OPT_NOPAD, OPT_SALT, OPT_NOSALT, OPT_DEBUG, OPT_UPPER_P, OPT_UPPER_A,
     OPT_A, OPT_Z, OPT_BUFSIZE, OPT_K, OPT_KFILE, OPT_UPPER_K, OPT_NONE,
     OPT_UPPER_S, OPT_IV, OPT_MD, OPT_ITER, OPT_PBKDF2, OPT_CIPHER,
-    OPT_R_ENUM
+    OPT_THREADS, OPT_R_ENUM
 } OPTION_CHOICE;
 
 const OPTIONS enc_options[] = {
@@ -68,6 +70,8 @@ const OPTIONS enc_options[] = {
     {"A", OPT_UPPER_A, '-',
      "Used with -[base64|a] to specify base64 buffer as a single line"},
     {"bufsize", OPT_BUFSIZE, 's', "Buffer size"},
+    {"threads", OPT_THREADS, 'p',
+     "Spread the work for each buffer over this many threads"},
     {"k", OPT_K, 's', "Passphrase"},
     {"kfile", OPT_KFILE, '<', "Read passphrase from file"},
     {"K", OPT_UPPER_K, 's', "Raw key, in hex"},
@@ -103,14 +107,15 @@ int enc_main(int argc, char **argv)
     char *str = NULL, *passarg = NULL, *pass = NULL, *strbuf = NULL;
     char mbuf[sizeof(magic) - 1];
     OPTION_CHOICE o;
-    int bsize = BSIZE, verbose = 0, debug = 0, olb64 = 0, nosalt = 0;
+    int bsize = 0, verbose = 0, debug = 0, olb64 = 0, nosalt = 0;
     int enc = 1, printkey = 0, i, k;
     int base64 = 0, informat = FORMAT_BINARY, outformat = FORMAT_BINARY;
     int ret = 1, inl, nopad = 0;
     unsigned char key[EVP_MAX_KEY_LENGTH], iv[EVP_MAX_IV_LENGTH];
-    unsigned char *buff = NULL, salt[PKCS5_SALT_LEN];
+    unsigned char *buff = NULL, *obuff = NULL, salt[PKCS5_SALT_LEN];
     int pbkdf2 = 0;
     int iter = 0;
+    int threads = 1, outl;
     long n;
     struct doall_enc_ciphers dec;
 #ifdef ZLIB
@@ -272,6 +277,10 @@ int enc_main(int argc, char **argv)
         case OPT_NONE:
             cipher = NULL;
             break;
+        case OPT_THREADS:
+            if (!opt_int(opt_arg(), &threads))
+                goto opthelp;
+            break;
         case OPT_R_CASES:
             if (!opt_rand(o))
                 goto end;
@@ -299,6 +308,8 @@ int enc_main(int argc, char **argv)
     if (iter == 0)
         iter = 1;
 
+    if (bsize == 0)
+        bsize = threads > 1 ? THREADS_BSIZE : BSIZE;
     /* It must be large enough for a base64 encoded line */
     if (base64 && bsize < 80)
         bsize = 80;
@@ -317,6 +328,11 @@ int enc_main(int argc, char **argv)
 
     strbuf = app_malloc(SIZE, "strbuf");
     buff = app_malloc(EVP_ENCODE_LENGTH(bsize), "evp buffer");
+    if (threads > 1) {
+        if (!setup_thread_pool(threads))
+            goto end;
+        obuff = app_malloc(bsize + EVP_MAX_BLOCK_LENGTH, "output buffer");
+    }
 
     if (infile == NULL) {
         in = dup_bio_in(informat);
@@ -551,6 +567,13 @@ int enc_main(int argc, char **argv)
             goto end;
         }
 
+        /* Ciphers that can't spread their work over threads ignore this */
+        if (threads > 1) {
+            ERR_set_mark();
+            EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_SET_THREADS, threads, NULL);
+            ERR_pop_to_mark();
+        }
+
         if (debug) {
             BIO_set_callback(benc, BIO_debug_callback);
             BIO_set_callback_arg(benc, (char *)bio_err);
@@ -582,19 +605,44 @@ int enc_main(int argc, char **argv)
         }
     }
 
-    /* Only encrypt/decrypt as we write the file */
-    if (benc != NULL)
+    /*
+     * Only encrypt/decrypt as we write the file.  The cipher BIO works on
+     * small pieces of data, so with several threads whole buffers are passed
+     * to the cipher here instead.
+     */
+    if (benc != NULL && obuff == NULL)
         wbio = BIO_push(benc, wbio);
 
     while (BIO_pending(rbio) || !BIO_eof(rbio)) {
         inl = BIO_read(rbio, (char *)buff, bsize);
         if (inl <= 0)
             break;
+        if (benc != NULL && obuff != NULL) {
+            if (!EVP_CipherUpdate(ctx, obuff, &outl, buff, inl)) {
+                BIO_printf(bio_err, "bad decrypt\n");
+                goto end;
+            }
+            if (BIO_write(wbio, (char *)obuff, outl) != outl) {
+                BIO_printf(bio_err, "error writing output file\n");
+                goto end;
+            }
+            continue;
+        }
         if (BIO_write(wbio, (char *)buff, inl) != inl) {
             BIO_printf(bio_err, "error writing output file\n");
             goto end;
         }
     }
+    if (benc != NULL && obuff != NULL) {
+        if (!EVP_CipherFinal_ex(ctx, obuff, &outl)) {
+            BIO_printf(bio_err, "bad decrypt\n");
+            goto end;
+        }
+        if (BIO_write(wbio, (char *)obuff, outl) != outl) {
+            BIO_printf(bio_err, "error writing output file\n");
+            goto end;
+        }
+    }
     if (!BIO_flush(wbio)) {
         BIO_printf(bio_err, "bad decrypt\n");
         goto end;
@@ -609,6 +657,7 @@ int enc_main(int argc, char **argv)
     ERR_print_errors(bio_err);
     OPENSSL_free(strbuf);
     OPENSSL_free(buff);
+    OPENSSL_free(obuff);
     BIO_free(in);
     BIO_free_all(out);
     BIO_free(benc);
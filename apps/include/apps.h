@@ -145,6 +145,7 @@ __owur int ctx_set_ctlog_list_file(SSL_CTX *ctx, const char *path);
 
 ENGINE *setup_engine(const char *engine, int debug);
 void release_engine(ENGINE *e);
+int setup_thread_pool(int threads);
 
 # ifndef OPENSSL_NO_OCSP
 OCSP_RESPONSE *process_responder(OCSP_REQUEST *req,
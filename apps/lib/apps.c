@@ -1171,6 +1171,27 @@ void release_engine(ENGINE *e)
 #endif
 }
 
+/*
+ * Start the library's thread pool with enough workers for |threads| threads
+ * in all, counting the calling one.  Returns 1 on success and 0 on error.
+ */
+int setup_thread_pool(int threads)
+{
+    OPENSSL_INIT_SETTINGS *settings;
+    int ret;
+
+    if (threads <= 1)
+        return 1;
+    if ((settings = OPENSSL_INIT_new()) == NULL)
+        return 0;
+    OPENSSL_INIT_set_thread_pool_size(settings, threads - 1);
+    ret = OPENSSL_init_crypto(OPENSSL_INIT_THREAD_POOL, settings);
+    OPENSSL_INIT_free(settings);
+    if (!ret)
+        BIO_printf(bio_err, "Error starting %d threads\n", threads);
+    return ret;
+}
+
 static unsigned long index_serial_hash(const OPENSSL_CSTRING *a)
 {
     const char *n;
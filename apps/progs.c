@@ -137,6 +137,15 @@ FUNCTION functions[] = {
 #ifndef OPENSSL_NO_BLAKE2
     {FT_md, "blake2s256", dgst_main},
 #endif
+#ifndef OPENSSL_NO_BLAKE2
+    {FT_md, "blake2bp512", dgst_main},
+#endif
+#ifndef OPENSSL_NO_BLAKE2
+    {FT_md, "blake2sp256", dgst_main},
+#endif
+#ifndef OPENSSL_NO_BLAKE3
+    {FT_md, "blake3", dgst_main},
+#endif
 #ifndef OPENSSL_NO_SM3
     {FT_md, "sm3", dgst_main},
 #endif
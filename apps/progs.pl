@@ -120,6 +120,8 @@ EOF
     my %md_disabler = (
         blake2b512 => "blake2",
         blake2s256 => "blake2",
+        blake2bp512 => "blake2",
+        blake2sp256 => "blake2",
     );
     foreach my $cmd (
         "md2", "md4", "md5",
@@ -129,7 +131,7 @@ EOF
         "sha3-224", "sha3-256", "sha3-384", "sha3-512",
         "shake128", "shake256",
         "mdc2", "rmd160", "blake2b512", "blake2s256",
-        "sm3"
+        "blake2bp512", "blake2sp256", "blake3", "sm3"
     ) {
         my $str = "    {FT_md, \"$cmd\", dgst_main},\n";
         if (grep { $cmd eq $_ } @disablables) {
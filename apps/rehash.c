@@ -101,6 +101,7 @@ static int evpmdsize;
 static const EVP_MD *evpmd;
 static int remove_links = 1;
 static int verbose = 0;
+static STACK_OF(X509) *compiled = NULL;
 static BUCKET *hash_table[257];
 
 static const char *suffixes[] = { "", "r" };
@@ -445,9 +446,203 @@ static int do_dir(const char *dirname, enum Hash h)
     return errs;
 }
 
+/*
+ * Add the certificates in a file to |compiled|; return number of errors.
+ */
+static int compile_file(const char *fullpath)
+{
+    STACK_OF(X509_INFO) *inf;
+    X509_INFO *x;
+    BIO *b;
+    int i, errs = 0;
+
+    if ((b = BIO_new_file(fullpath, "r")) == NULL) {
+        BIO_printf(bio_err, "%s: error: skipping %s, cannot open file\n",
+                   opt_getprog(), fullpath);
+        return 1;
+    }
+    inf = PEM_X509_INFO_read_bio(b, NULL, NULL, NULL);
+    BIO_free(b);
+    if (inf == NULL) {
+        BIO_printf(bio_err, "%s: error: cannot read certificates from %s\n",
+                   opt_getprog(), fullpath);
+        ERR_print_errors(bio_err);
+        return 1;
+    }
+
+    /* Duplicates are dropped all at once by write_compiled() */
+    for (i = 0; i < sk_X509_INFO_num(inf); i++) {
+        x = sk_X509_INFO_value(inf, i);
+        if (x->x509 == NULL)
+            continue;
+        if (!sk_X509_push(compiled, x->x509)) {
+            BIO_printf(bio_err, "%s: error: out of memory\n", opt_getprog());
+            errs++;
+            break;
+        }
+        x->x509 = NULL;
+    }
+    if (verbose)
+        BIO_printf(bio_out, "read %s\n", fullpath);
+    sk_X509_INFO_pop_free(inf, X509_INFO_free);
+    return errs;
+}
+
+/*
+ * Add the certificates in a file, or in the files with a recognized
+ * extension in a directory, to |compiled|; return number of errors.
+ */
+static int compile_path(const char *path)
+{
+    OPENSSL_DIR_CTX *d = NULL;
+    struct stat st;
+    const char *filename, *pathsep, *ext;
+    char *buf, *copy;
+    STACK_OF(OPENSSL_STRING) *files;
+    int n, buflen, errs = 0;
+    size_t i;
+
+    if (stat(path, &st) < 0) {
+        BIO_printf(bio_err, "%s: error: skipping %s, %s\n",
+                   opt_getprog(), path, strerror(errno));
+        return 1;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return compile_file(path);
+
+    if (verbose)
+        BIO_printf(bio_out, "Doing %s\n", path);
+    buflen = strlen(path);
+    pathsep = (buflen && !ends_with_dirsep(path)) ? "/": "";
+    buflen += NAME_MAX + 1 + 1;
+    buf = app_malloc(buflen, "filename buffer");
+
+    if ((files = sk_OPENSSL_STRING_new_null()) == NULL) {
+        BIO_printf(bio_err, "Skipping %s, out of memory\n", path);
+        OPENSSL_free(buf);
+        return 1;
+    }
+    while ((filename = OPENSSL_DIR_read(&d, path)) != NULL) {
+        if ((copy = OPENSSL_strdup(filename)) == NULL
+                || sk_OPENSSL_STRING_push(files, copy) == 0) {
+            OPENSSL_free(copy);
+            OPENSSL_DIR_end(&d);
+            BIO_puts(bio_err, "out of memory\n");
+            errs = 1;
+            goto err;
+        }
+    }
+    OPENSSL_DIR_end(&d);
+    sk_OPENSSL_STRING_sort(files);
+
+    /* Hash links have no recognized extension, so they are skipped */
+    for (n = 0; n < sk_OPENSSL_STRING_num(files); n++) {
+        filename = sk_OPENSSL_STRING_value(files, n);
+        if ((ext = strrchr(filename, '.')) == NULL)
+            continue;
+        for (i = 0; i < OSSL_NELEM(extensions); i++) {
+            if (strcasecmp(extensions[i], ext + 1) == 0)
+                break;
+        }
+        if (i >= OSSL_NELEM(extensions))
+            continue;
+        if (BIO_snprintf(buf, buflen, "%s%s%s",
+                         path, pathsep, filename) >= buflen)
+            continue;
+        errs += compile_file(buf);
+    }
+
+ err:
+    sk_OPENSSL_STRING_pop_free(files, str_free);
+    OPENSSL_free(buf);
+    return errs;
+}
+
+static int compiled_cmp(const X509 *const *a, const X509 *const *b)
+{
+    return X509_cmp(*a, *b);
+}
+
+/*
+ * Drop the certificates that are in |compiled| more than once. Sorting
+ * brings duplicates next to each other, which scales to large bundles
+ * where comparing every certificate with all earlier ones doesn't.
+ */
+static int dedup_compiled(void)
+{
+    STACK_OF(X509) *uniq;
+    X509 *x, *prev = NULL;
+    int i;
+
+    if ((uniq = sk_X509_new(compiled_cmp)) == NULL
+            || !sk_X509_reserve(uniq, sk_X509_num(compiled))) {
+        sk_X509_free(uniq);
+        BIO_printf(bio_err, "%s: error: out of memory\n", opt_getprog());
+        return 0;
+    }
+    sk_X509_sort(compiled);
+    for (i = 0; i < sk_X509_num(compiled); i++) {
+        x = sk_X509_value(compiled, i);
+        if (prev != NULL && X509_cmp(prev, x) == 0) {
+            X509_free(x);
+            continue;
+        }
+        sk_X509_push(uniq, x);
+        prev = x;
+    }
+    sk_X509_free(compiled);
+    compiled = uniq;
+    return 1;
+}
+
+/*
+ * Write |compiled| to a new file that replaces |outfile|, so that processes
+ * which have the old one mapped aren't disturbed; return number of errors.
+ */
+static int write_compiled(const char *outfile)
+{
+    size_t len = strlen(outfile) + 5;
+    char *tmp;
+    BIO *out;
+    int ok;
+
+    if (!dedup_compiled())
+        return 1;
+    tmp = app_malloc(len, "temporary filename");
+    BIO_snprintf(tmp, len, "%s.tmp", outfile);
+    if ((out = BIO_new_file(tmp, "wb")) == NULL) {
+        BIO_printf(bio_err, "%s: Can't create %s\n", opt_getprog(), tmp);
+        ERR_print_errors(bio_err);
+        OPENSSL_free(tmp);
+        return 1;
+    }
+    ok = X509_LOOKUP_mmap_write(out, compiled);
+    BIO_free(out);
+    if (ok && rename(tmp, outfile) < 0) {
+        BIO_printf(bio_err, "%s: Can't rename %s to %s, %s\n",
+                   opt_getprog(), tmp, outfile, strerror(errno));
+        ok = 0;
+    } else if (!ok) {
+        BIO_printf(bio_err, "%s: Can't write %s\n", opt_getprog(), tmp);
+        ERR_print_errors(bio_err);
+    }
+    if (!ok)
+        unlink(tmp);
+    else if (verbose)
+        BIO_printf(bio_out, "wrote %d certificates to %s\n",
+                   sk_X509_num(compiled), outfile);
+    OPENSSL_free(tmp);
+    return !ok;
+}
+
+static int do_arg(const char *arg, enum Hash h)
+{
+    return compiled != NULL ? compile_path(arg) : do_dir(arg, h);
+}
+
 typedef enum OPTION_choice {
     OPT_ERR = -1, OPT_EOF = 0, OPT_HELP,
-    OPT_COMPAT, OPT_OLD, OPT_N, OPT_VERBOSE
+    OPT_COMPAT, OPT_OLD, OPT_N, OPT_VERBOSE, OPT_COMPILE
 } OPTION_CHOICE;
 
 const OPTIONS rehash_options[] = {
@@ -459,13 +654,15 @@ const OPTIONS rehash_options[] = {
     {"old", OPT_OLD, '-', "Use old-style hash to generate links"},
     {"n", OPT_N, '-', "Do not remove existing links"},
     {"v", OPT_VERBOSE, '-', "Verbose output"},
+    {"compile", OPT_COMPILE, '>',
+     "Write the certificates found to a precompiled trust store"},
     {NULL}
 };
 
 
 int rehash_main(int argc, char **argv)
 {
-    const char *env, *prog;
+    const char *env, *prog, *outfile = NULL;
     char *e, *m;
     int errs = 0;
     OPTION_CHOICE o;
@@ -493,6 +690,9 @@ int rehash_main(int argc, char **argv)
         case OPT_VERBOSE:
             verbose = 1;
             break;
+        case OPT_COMPILE:
+            outfile = opt_arg();
+            break;
         }
     }
     argc = opt_num_rest();
@@ -501,20 +701,30 @@ int rehash_main(int argc, char **argv)
     evpmd = EVP_sha1();
     evpmdsize = EVP_MD_size(evpmd);
 
+    if (outfile != NULL && (compiled = sk_X509_new(compiled_cmp)) == NULL) {
+        BIO_printf(bio_err, "%s: out of memory\n", prog);
+        errs = 1;
+        goto end;
+    }
+
     if (*argv != NULL) {
         while (*argv != NULL)
-            errs += do_dir(*argv++, h);
+            errs += do_arg(*argv++, h);
     } else if ((env = getenv(X509_get_default_cert_dir_env())) != NULL) {
         char lsc[2] = { LIST_SEPARATOR_CHAR, '\0' };
         m = OPENSSL_strdup(env);
         for (e = strtok(m, lsc); e != NULL; e = strtok(NULL, lsc))
-            errs += do_dir(e, h);
+            errs += do_arg(e, h);
         OPENSSL_free(m);
     } else {
-        errs += do_dir(X509_get_default_cert_dir(), h);
+        errs += do_arg(X509_get_default_cert_dir(), h);
     }
 
+    if (compiled != NULL && errs == 0)
+        errs += write_compiled(outfile);
+
  end:
+    sk_X509_pop_free(compiled, X509_free);
     return errs;
 }
 
@@ -152,7 +152,7 @@ static long sock_ctrl(BIO *b, int cmd, long num, void *ptr)
     long ret = 1;
     int *ip;
 # ifndef OPENSSL_NO_KTLS
-    struct tls12_crypto_info_aes_gcm_128 *crypto_info;
+    union tls_crypto_info_all *crypto_info;
 # endif
 
     switch (cmd) {
@@ -183,8 +183,9 @@ static long sock_ctrl(BIO *b, int cmd, long num, void *ptr)
         break;
 # ifndef OPENSSL_NO_KTLS
     case BIO_CTRL_SET_KTLS:
-        crypto_info = (struct tls12_crypto_info_aes_gcm_128 *)ptr;
-        ret = ktls_start(b->num, crypto_info, sizeof(*crypto_info), num);
+        crypto_info = (union tls_crypto_info_all *)ptr;
+        ret = ktls_start(b->num, crypto_info,
+                         ktls_crypto_info_len(crypto_info), num);
         if (ret)
             BIO_set_ktls_flag(b, num);
         break;
@@ -0,0 +1,520 @@
+#! /usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+#
+# Lane-interleaved BLAKE2bp and BLAKE2sp compression for x86_64.
+#
+# BLAKE2bp and BLAKE2sp leaves are independent BLAKE2b and BLAKE2s
+# instances fed with every 4th or 8th block, so that one full stride of
+# input advances all leaves by one block. Here leaf i is lane i of a
+# ymm register, 4x64-bit for BLAKE2bp and 8x32-bit for BLAKE2sp, the
+# 16 state words live in %ymm0-15, and the message is transposed to
+# stack and used as memory operands. Leaf chaining values are kept in
+# same interleaved layout in memory, h[8][lanes].
+#
+#	int blake2bp_compress_avx2(u64 h[8][4], u64 t[2],
+#				const unsigned char *inp, size_t n);
+#	int blake2sp_compress_avx2(u32 h[8][8], u32 t[2],
+#				const unsigned char *inp, size_t n);
+#
+# Process |n| strides, 512 bytes each, none of which may hold a last
+# block of a leaf, and advance the common counter |t|. Return 1, or 0
+# if processor lacks AVX2. AVX512VL processors use vprord/vprorq in
+# rotations instead of shifts and shuffles, which also frees register
+# otherwise spilled for temporary value.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$avx = ($1>=2.19) + ($1>=2.22) + ($1>=2.25);
+}
+
+if (!$avx && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	   `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)(?:\.([0-9]+))?/) {
+	$avx = ($1>=2.09) + ($1>=2.10) + ($1>=2.12);
+	$avx += 1 if ($1==2.11 && $2>=8);
+}
+
+if (!$avx && $win64 && ($flavour =~ /masm/ || $ENV{ASM} =~ /ml64/) &&
+	   `ml64 2>&1` =~ /Version ([0-9]+)\./) {
+	$avx = ($1>=10) + ($1>=11);
+}
+
+if (!$avx && `$ENV{CC} -v 2>&1` =~ /((?:^clang|LLVM) version|.*based on LLVM) ([3-9]\.[0-9]+)/) {
+	$avx = ($2>=3.0) + ($2>3.0);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+my ($h,$t,$inp,$n)=("%rdi","%rsi","%rdx","%rcx");
+my @v=map("%ymm$_",(0..15));
+my $spill=0x200;	# %ymm8 spill slot, message words are at 0x00-0x1ff
+my $xframe = $win64 ? 0xa8 : 8;
+
+my @sigma = (
+	[  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 ],
+	[ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 ],
+	[ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 ],
+	[  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 ],
+	[  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 ],
+	[  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 ],
+	[ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 ],
+	[ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 ],
+	[  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 ],
+	[ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 ] );
+
+# Rotate right 4 registers at once. Rotations by multiple of 8 are byte
+# shuffles, others need temporary register, %ymm8, which is always one
+# of "c" words and is not referred to at the time "b" words are rotated.
+sub ROR {
+my ($w,$rot,$vl,@r)=@_;
+my $code="";
+
+    if ($vl) {
+	$code.="\tvpror$w\t\$$rot,$_,$_\n"			for (@r);
+    } elsif ($w eq "q" && $rot==32) {
+	$code.="\tvpshufd\t\$0xb1,$_,$_\n"			for (@r);
+    } elsif ($rot%8==0) {
+	$code.="\tvpshufb\t.Lror$rot$w(%rip),$_,$_\n"		for (@r);
+    } else {
+	my $bits = $w eq "q" ? 64 : 32;
+	$code.="\tvmovdqa\t%ymm8,$spill(%rsp)\n";
+	foreach (@r) {
+	    $code.="\tvpsrl$w\t\$$rot,$_,%ymm8\n";
+	    if ($bits-$rot == 1) {
+		$code.="\tvpadd$w\t$_,$_,$_\n";
+	    } else {
+		$code.="\tvpsll$w\t\$".($bits-$rot).",$_,$_\n";
+	    }
+	    $code.="\tvpor\t%ymm8,$_,$_\n";
+	}
+	$code.="\tvmovdqa\t$spill(%rsp),%ymm8\n";
+    }
+    $code;
+}
+
+# Four G functions, i.e. half a round, executed in parallel.
+sub G4 {
+my ($w,$vl,$rots,$a,$b,$c,$d,$x,$y)=@_;
+my $code="";
+
+    for (0..3) { $code.="\tvpadd$w\t".($$x[$_]*32)."(%rsp),$v[$$a[$_]],$v[$$a[$_]]\n"; }
+    for (0..3) { $code.="\tvpadd$w\t$v[$$b[$_]],$v[$$a[$_]],$v[$$a[$_]]\n"; }
+    for (0..3) { $code.="\tvpxor\t$v[$$a[$_]],$v[$$d[$_]],$v[$$d[$_]]\n"; }
+    $code.=ROR($w,$$rots[0],$vl,map($v[$_],@$d));
+    for (0..3) { $code.="\tvpadd$w\t$v[$$d[$_]],$v[$$c[$_]],$v[$$c[$_]]\n"; }
+    for (0..3) { $code.="\tvpxor\t$v[$$c[$_]],$v[$$b[$_]],$v[$$b[$_]]\n"; }
+    $code.=ROR($w,$$rots[1],$vl,map($v[$_],@$b));
+    for (0..3) { $code.="\tvpadd$w\t".($$y[$_]*32)."(%rsp),$v[$$a[$_]],$v[$$a[$_]]\n"; }
+    for (0..3) { $code.="\tvpadd$w\t$v[$$b[$_]],$v[$$a[$_]],$v[$$a[$_]]\n"; }
+    for (0..3) { $code.="\tvpxor\t$v[$$a[$_]],$v[$$d[$_]],$v[$$d[$_]]\n"; }
+    $code.=ROR($w,$$rots[2],$vl,map($v[$_],@$d));
+    for (0..3) { $code.="\tvpadd$w\t$v[$$d[$_]],$v[$$c[$_]],$v[$$c[$_]]\n"; }
+    for (0..3) { $code.="\tvpxor\t$v[$$c[$_]],$v[$$b[$_]],$v[$$b[$_]]\n"; }
+    $code.=ROR($w,$$rots[3],$vl,map($v[$_],@$b));
+    $code;
+}
+
+sub ROUND {
+my ($w,$vl,$rots,$s)=@_;
+
+    G4($w,$vl,$rots,[0,1,2,3],[4,5,6,7],[8,9,10,11],[12,13,14,15],
+		[@$s[0,2,4,6]],[@$s[1,3,5,7]]).
+    G4($w,$vl,$rots,[0,1,2,3],[5,6,7,4],[10,11,8,9],[15,12,13,14],
+		[@$s[8,10,12,14]],[@$s[9,11,13,15]]);
+}
+
+# Transpose 8x8 matrix of 32-bit words held in @r, rows being lanes,
+# into @o, rows being words. Both are 8 registers.
+sub TRANSPOSE_8x8 {
+my ($r,$o)=@_;
+my $code="";
+
+    for (0,2,4,6) {
+	$code.="\tvpunpckldq\t$$r[$_+1],$$r[$_],$$o[$_]\n";
+	$code.="\tvpunpckhdq\t$$r[$_+1],$$r[$_],$$o[$_+1]\n";
+    }
+    for (0,4) {
+	$code.="\tvpunpcklqdq\t$$o[$_+2],$$o[$_],$$r[$_]\n";
+	$code.="\tvpunpckhqdq\t$$o[$_+2],$$o[$_],$$r[$_+1]\n";
+	$code.="\tvpunpcklqdq\t$$o[$_+3],$$o[$_+1],$$r[$_+2]\n";
+	$code.="\tvpunpckhqdq\t$$o[$_+3],$$o[$_+1],$$r[$_+3]\n";
+    }
+    for (0..3) {
+	$code.="\tvperm2i128\t\$0x20,$$r[$_+4],$$r[$_],$$o[$_]\n";
+	$code.="\tvperm2i128\t\$0x31,$$r[$_+4],$$r[$_],$$o[$_+4]\n";
+    }
+    $code;
+}
+
+# Transpose 4x4 matrix of 64-bit words held in @r in place, @o being
+# temporary registers.
+sub TRANSPOSE_4x4 {
+my ($r,$o)=@_;
+
+    "\tvpunpcklqdq\t$$r[1],$$r[0],$$o[0]\n".
+    "\tvpunpckhqdq\t$$r[1],$$r[0],$$o[1]\n".
+    "\tvpunpcklqdq\t$$r[3],$$r[2],$$o[2]\n".
+    "\tvpunpckhqdq\t$$r[3],$$r[2],$$o[3]\n".
+    "\tvperm2i128\t\$0x20,$$o[2],$$o[0],$$r[0]\n".
+    "\tvperm2i128\t\$0x20,$$o[3],$$o[1],$$r[1]\n".
+    "\tvperm2i128\t\$0x31,$$o[2],$$o[0],$$r[2]\n".
+    "\tvperm2i128\t\$0x31,$$o[3],$$o[1],$$r[3]\n";
+}
+
+$code.=<<___;
+.text
+
+.extern OPENSSL_ia32cap_P
+___
+
+if ($avx>1) {
+$code.=<<___;
+.align	64
+.Lblake2b_IV:
+.quad	0x6a09e667f3bcc908,0xbb67ae8584caa73b,0x3c6ef372fe94f82b,0xa54ff53a5f1d36f1
+.quad	0x510e527fade682d1,0x9b05688c2b3e6c1f,0x1f83d9abfb41bd6b,0x5be0cd19137e2179
+.Lblake2s_IV:
+.long	0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a
+.long	0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+.Lror16d:
+.byte	0x2,0x3,0x0,0x1, 0x6,0x7,0x4,0x5, 0xa,0xb,0x8,0x9, 0xe,0xf,0xc,0xd
+.byte	0x2,0x3,0x0,0x1, 0x6,0x7,0x4,0x5, 0xa,0xb,0x8,0x9, 0xe,0xf,0xc,0xd
+.Lror8d:
+.byte	0x1,0x2,0x3,0x0, 0x5,0x6,0x7,0x4, 0x9,0xa,0xb,0x8, 0xd,0xe,0xf,0xc
+.byte	0x1,0x2,0x3,0x0, 0x5,0x6,0x7,0x4, 0x9,0xa,0xb,0x8, 0xd,0xe,0xf,0xc
+.Lror24q:
+.byte	0x3,0x4,0x5,0x6,0x7,0x0,0x1,0x2, 0xb,0xc,0xd,0xe,0xf,0x8,0x9,0xa
+.byte	0x3,0x4,0x5,0x6,0x7,0x0,0x1,0x2, 0xb,0xc,0xd,0xe,0xf,0x8,0x9,0xa
+.Lror16q:
+.byte	0x2,0x3,0x4,0x5,0x6,0x7,0x0,0x1, 0xa,0xb,0xc,0xd,0xe,0xf,0x8,0x9
+.byte	0x2,0x3,0x4,0x5,0x6,0x7,0x0,0x1, 0xa,0xb,0xc,0xd,0xe,0xf,0x8,0x9
+___
+
+foreach my $alg ("b","s") {
+my $func = "blake2${alg}p_compress_avx2";
+my ($w,$wb,$rounds,$blk,$stride,$rots) = $alg eq "b"
+	? ("q",8,12,128,512,[32,24,16,63])
+	: ("d",4,10,64,512,[16,12,8,7]);
+
+$code.=<<___;
+.globl	$func
+.type	$func,\@function,4
+.align	32
+$func:
+.cfi_startproc
+	xor		%eax,%eax
+	mov		OPENSSL_ia32cap_P+8(%rip),%r10d
+	test		\$`1<<5`,%r10d		# check for AVX2
+	jz		.L${alg}p_abort
+
+	mov		%rsp,%r9		# frame register
+.cfi_def_cfa_register	%r9
+	sub		\$0x220+$xframe,%rsp
+	and		\$-32,%rsp
+___
+$code.=<<___	if ($win64);
+	movaps		%xmm6,-0xa8(%r9)
+	movaps		%xmm7,-0x98(%r9)
+	movaps		%xmm8,-0x88(%r9)
+	movaps		%xmm9,-0x78(%r9)
+	movaps		%xmm10,-0x68(%r9)
+	movaps		%xmm11,-0x58(%r9)
+	movaps		%xmm12,-0x48(%r9)
+	movaps		%xmm13,-0x38(%r9)
+	movaps		%xmm14,-0x28(%r9)
+	movaps		%xmm15,-0x18(%r9)
+___
+$code.=<<___;
+.L${alg}p_body:
+	vzeroupper
+___
+$code.=<<___	if ($alg eq "b");
+	mov		0($t),%r8		# load counter
+	mov		8($t),%r11
+___
+$code.=<<___	if ($alg eq "s");
+	mov		0($t),%r8d		# load counter as 64-bit value
+	mov		4($t),%r11d
+	shl		\$32,%r11
+	or		%r11,%r8
+___
+
+foreach my $vl (0,1) {
+my $sfx = $vl ? "_vl" : "";
+
+$code.=<<___	if (!$vl);
+	test		\$`1<<31`,%r10d		# check for AVX512VL
+	jnz		.Loop_${alg}p_vl
+___
+$code.=<<___;
+.align	32
+.Loop_${alg}p$sfx:
+___
+    # transpose message to stack
+    if ($alg eq "s") {
+	foreach my $half (0,1) {
+	    for (0..7) {
+		$code.="\tvmovdqu\t".($_*$blk+$half*32)."($inp),$v[$_]\n";
+	    }
+	    $code.=TRANSPOSE_8x8([@v[0..7]],[@v[8..15]]);
+	    for (0..7) {
+		$code.="\tvmovdqa\t$v[8+$_],".(($half*8+$_)*32)."(%rsp)\n";
+	    }
+	}
+    } else {
+	foreach my $quarter (0..3) {
+	    for (0..3) {
+		$code.="\tvmovdqu\t".($_*$blk+$quarter*32)."($inp),$v[$_]\n";
+	    }
+	    $code.=TRANSPOSE_4x4([@v[0..3]],[@v[4..7]]);
+	    for (0..3) {
+		$code.="\tvmovdqa\t$v[$_],".(($quarter*4+$_)*32)."(%rsp)\n";
+	    }
+	}
+    }
+
+$code.=<<___	if ($alg eq "b");
+	add		\$$blk,%r8		# advance counter
+	adc		\$0,%r11
+	mov		.Lblake2b_IV+32(%rip),%rax
+	xor		%r8,%rax
+	vmovq		%rax,%xmm12
+	mov		.Lblake2b_IV+40(%rip),%rax
+	xor		%r11,%rax
+	vmovq		%rax,%xmm13
+	vpbroadcastq	%xmm12,%ymm12
+	vpbroadcastq	%xmm13,%ymm13
+	vpbroadcastq	.Lblake2b_IV+0(%rip),%ymm8
+	vpbroadcastq	.Lblake2b_IV+8(%rip),%ymm9
+	vpbroadcastq	.Lblake2b_IV+16(%rip),%ymm10
+	vpbroadcastq	.Lblake2b_IV+24(%rip),%ymm11
+	vpbroadcastq	.Lblake2b_IV+48(%rip),%ymm14
+	vpbroadcastq	.Lblake2b_IV+56(%rip),%ymm15
+___
+$code.=<<___	if ($alg eq "s");
+	add		\$$blk,%r8		# advance counter
+	mov		%r8,%rax
+	shr		\$32,%rax
+	xor		.Lblake2s_IV+20(%rip),%eax
+	vmovd		%eax,%xmm13
+	mov		.Lblake2s_IV+16(%rip),%eax
+	xor		%r8d,%eax
+	vmovd		%eax,%xmm12
+	vpbroadcastd	%xmm12,%ymm12
+	vpbroadcastd	%xmm13,%ymm13
+	vpbroadcastd	.Lblake2s_IV+0(%rip),%ymm8
+	vpbroadcastd	.Lblake2s_IV+4(%rip),%ymm9
+	vpbroadcastd	.Lblake2s_IV+8(%rip),%ymm10
+	vpbroadcastd	.Lblake2s_IV+12(%rip),%ymm11
+	vpbroadcastd	.Lblake2s_IV+24(%rip),%ymm14
+	vpbroadcastd	.Lblake2s_IV+28(%rip),%ymm15
+___
+    for (0..7) {
+	$code.="\tvmovdqu\t".($_*32)."($h),$v[$_]\n";
+    }
+    for (0..$rounds-1) {
+	$code.=ROUND($w,$vl,$rots,$sigma[$_%10]);
+    }
+    for (0..7) {
+	$code.="\tvpxor\t$v[$_+8],$v[$_],$v[$_]\n";
+	$code.="\tvpxor\t".($_*32)."($h),$v[$_],$v[$_]\n";
+	$code.="\tvmovdqu\t$v[$_],".($_*32)."($h)\n";
+    }
+
+$code.=<<___;
+	lea		$stride($inp),$inp
+	dec		$n
+	jnz		.Loop_${alg}p$sfx
+	jmp		.L${alg}p_done
+___
+}
+
+$code.=<<___	if ($alg eq "b");
+
+.L${alg}p_done:
+	mov		%r8,0($t)		# store counter
+	mov		%r11,8($t)
+___
+$code.=<<___	if ($alg eq "s");
+
+.L${alg}p_done:
+	mov		%r8d,0($t)		# store counter
+	shr		\$32,%r8
+	mov		%r8d,4($t)
+___
+$code.=<<___;
+	vzeroall
+___
+$code.=<<___	if ($win64);
+	movaps		-0xa8(%r9),%xmm6
+	movaps		-0x98(%r9),%xmm7
+	movaps		-0x88(%r9),%xmm8
+	movaps		-0x78(%r9),%xmm9
+	movaps		-0x68(%r9),%xmm10
+	movaps		-0x58(%r9),%xmm11
+	movaps		-0x48(%r9),%xmm12
+	movaps		-0x38(%r9),%xmm13
+	movaps		-0x28(%r9),%xmm14
+	movaps		-0x18(%r9),%xmm15
+___
+$code.=<<___;
+	lea		(%r9),%rsp
+.cfi_def_cfa_register	%rsp
+	mov		\$1,%eax
+.L${alg}p_epilogue:
+.L${alg}p_abort:
+	ret
+.cfi_endproc
+.size	$func,.-$func
+___
+}
+} else {
+# Assembler is too old for AVX2, let C fall back to generic code.
+$code.=<<___;
+.globl	blake2bp_compress_avx2
+.type	blake2bp_compress_avx2,\@abi-omnipotent
+blake2bp_compress_avx2:
+.globl	blake2sp_compress_avx2
+.type	blake2sp_compress_avx2,\@abi-omnipotent
+blake2sp_compress_avx2:
+	xor	%eax,%eax
+	ret
+.size	blake2bp_compress_avx2,.-blake2bp_compress_avx2
+___
+}
+
+# EXCEPTION_DISPOSITION handler (EXCEPTION_RECORD *rec,ULONG64 frame,
+#		CONTEXT *context,DISPATCHER_CONTEXT *disp)
+if ($win64 && $avx>1) {
+$rec="%rcx";
+$frame="%rdx";
+$context="%r8";
+$disp="%r9";
+
+$code.=<<___;
+.extern	__imp_RtlVirtualUnwind
+.type	simd_handler,\@abi-omnipotent
+.align	16
+simd_handler:
+	push	%rsi
+	push	%rdi
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	pushfq
+	sub	\$64,%rsp
+
+	mov	120($context),%rax	# pull context->Rax
+	mov	248($context),%rbx	# pull context->Rip
+
+	mov	8($disp),%rsi		# disp->ImageBase
+	mov	56($disp),%r11		# disp->HandlerData
+
+	mov	0(%r11),%r10d		# HandlerData[0]
+	lea	(%rsi,%r10),%r10	# prologue label
+	cmp	%r10,%rbx		# context->Rip<prologue label
+	jb	.Lcommon_seh_tail
+
+	mov	192($context),%rax	# pull context->R9
+
+	mov	4(%r11),%r10d		# HandlerData[1]
+	lea	(%rsi,%r10),%r10	# epilogue label
+	cmp	%r10,%rbx		# context->Rip>=epilogue label
+	jae	.Lcommon_seh_tail
+
+	lea	-0xa8(%rax),%rsi
+	lea	512($context),%rdi	# &context.Xmm6
+	mov	\$20,%ecx
+	.long	0xa548f3fc		# cld; rep movsq
+
+.Lcommon_seh_tail:
+	mov	8(%rax),%rdi
+	mov	16(%rax),%rsi
+	mov	%rax,152($context)	# restore context->Rsp
+	mov	%rsi,168($context)	# restore context->Rsi
+	mov	%rdi,176($context)	# restore context->Rdi
+
+	mov	40($disp),%rdi		# disp->ContextRecord
+	mov	$context,%rsi		# context
+	mov	\$154,%ecx		# sizeof(CONTEXT)
+	.long	0xa548f3fc		# cld; rep movsq
+
+	mov	$disp,%rsi
+	xor	%rcx,%rcx		# arg1, UNW_FLAG_NHANDLER
+	mov	8(%rsi),%rdx		# arg2, disp->ImageBase
+	mov	0(%rsi),%r8		# arg3, disp->ControlPc
+	mov	16(%rsi),%r9		# arg4, disp->FunctionEntry
+	mov	40(%rsi),%r10		# disp->ContextRecord
+	lea	56(%rsi),%r11		# &disp->HandlerData
+	lea	24(%rsi),%r12		# &disp->EstablisherFrame
+	mov	%r10,32(%rsp)		# arg5
+	mov	%r11,40(%rsp)		# arg6
+	mov	%r12,48(%rsp)		# arg7
+	mov	%rcx,56(%rsp)		# arg8, (NULL)
+	call	*__imp_RtlVirtualUnwind(%rip)
+
+	mov	\$1,%eax		# ExceptionContinueSearch
+	add	\$64,%rsp
+	popfq
+	pop	%r15
+	pop	%r14
+	pop	%r13
+	pop	%r12
+	pop	%rbp
+	pop	%rbx
+	pop	%rdi
+	pop	%rsi
+	ret
+.size	simd_handler,.-simd_handler
+
+.section	.pdata
+.align	4
+	.rva	.LSEH_begin_blake2bp_compress_avx2
+	.rva	.LSEH_end_blake2bp_compress_avx2
+	.rva	.LSEH_info_blake2bp_compress_avx2
+
+	.rva	.LSEH_begin_blake2sp_compress_avx2
+	.rva	.LSEH_end_blake2sp_compress_avx2
+	.rva	.LSEH_info_blake2sp_compress_avx2
+
+.section	.xdata
+.align	8
+.LSEH_info_blake2bp_compress_avx2:
+	.byte	9,0,0,0
+	.rva	simd_handler
+	.rva	.Lbp_body,.Lbp_epilogue		# HandlerData[]
+
+.LSEH_info_blake2sp_compress_avx2:
+	.byte	9,0,0,0
+	.rva	simd_handler
+	.rva	.Lsp_body,.Lsp_epilogue		# HandlerData[]
+___
+}
+
+foreach (split("\n",$code)) {
+	s/\`([^\`]*)\`/eval $1/ge;
+
+	print $_,"\n";
+}
+
+close STDOUT or die "error closing STDOUT: $!";
@@ -0,0 +1,444 @@
+#! /usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+#
+# Eight BLAKE3 chunks hashed in parallel for x86_64.
+#
+# BLAKE3 chunks are independent of each other up to the point their
+# chaining values are combined in a tree, so that eight consecutive
+# chunks can be hashed at once with chunk i in lane i of a ymm register.
+# The 16 state words live in %ymm0-15, message is transposed to stack
+# and used as memory operands, and chaining values are kept on stack
+# between blocks.
+#
+#	int blake3_hash_chunks_avx2(const unsigned char *inp,
+#				u64 counter, u32 cvs[8][8]);
+#
+# Hash 8 whole 1KB chunks starting with chunk number |counter| and store
+# their chaining values to |cvs|. Chunk numbers are assumed to differ in
+# low 32-bit word only, which is the case for lanes caller is interested
+# in, those up to next multiple of 8. Return 1, or 0 if processor lacks
+# AVX2. AVX512VL processors use vprord in rotations instead of shifts and
+# shuffles.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$avx = ($1>=2.19) + ($1>=2.22) + ($1>=2.25);
+}
+
+if (!$avx && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	   `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)(?:\.([0-9]+))?/) {
+	$avx = ($1>=2.09) + ($1>=2.10) + ($1>=2.12);
+	$avx += 1 if ($1==2.11 && $2>=8);
+}
+
+if (!$avx && $win64 && ($flavour =~ /masm/ || $ENV{ASM} =~ /ml64/) &&
+	   `ml64 2>&1` =~ /Version ([0-9]+)\./) {
+	$avx = ($1>=10) + ($1>=11);
+}
+
+if (!$avx && `$ENV{CC} -v 2>&1` =~ /((?:^clang|LLVM) version|.*based on LLVM) ([3-9]\.[0-9]+)/) {
+	$avx = ($2>=3.0) + ($2>3.0);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+my ($inp,$ctr,$out)=("%rdi","%rsi","%rdx");
+my @v=map("%ymm$_",(0..15));
+# message words are at 0x00-0x1ff
+my $spill=0x200;	# %ymm8 spill slot
+my $cv=0x220;		# chaining values, 0x220-0x31f
+my $ctrlo=0x320;	# low and high counter words
+my $ctrhi=0x340;
+my $framesz=0x360;
+my $xframe = $win64 ? 0xa8 : 8;
+
+my @sigma = (
+	[  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 ],
+	[  2,  6,  3, 10,  7,  0,  4, 13,  1, 11, 12,  5,  9, 14, 15,  8 ],
+	[  3,  4, 10, 12, 13,  2,  7, 14,  6,  5,  9,  0, 11, 15,  8,  1 ],
+	[ 10,  7, 12,  9, 14,  3, 13, 15,  4,  0, 11,  2,  5,  8,  1,  6 ],
+	[ 12, 13,  9, 11, 15, 10, 14,  8,  7,  2,  5,  3,  0,  1,  6,  4 ],
+	[  9, 14, 11,  5,  8, 12, 15,  1, 13,  3,  0, 10,  2,  6,  4,  7 ],
+	[ 11, 15,  5,  0,  1,  9,  8,  6, 14, 10,  2, 12,  3,  4,  7, 13 ] );
+
+# Rotate right 4 registers at once. Rotations by 8 and 16 are byte
+# shuffles, others need temporary register, %ymm8, which is always one
+# of "c" words and is not referred to at the time "b" words are rotated.
+sub ROR {
+my ($rot,$vl,@r)=@_;
+my $code="";
+
+    if ($vl) {
+	$code.="\tvprord\t\$$rot,$_,$_\n"			for (@r);
+    } elsif ($rot%8==0) {
+	$code.="\tvpshufb\t.Lror$rot(%rip),$_,$_\n"		for (@r);
+    } else {
+	$code.="\tvmovdqa\t%ymm8,$spill(%rsp)\n";
+	foreach (@r) {
+	    $code.="\tvpsrld\t\$$rot,$_,%ymm8\n";
+	    $code.="\tvpslld\t\$".(32-$rot).",$_,$_\n";
+	    $code.="\tvpor\t%ymm8,$_,$_\n";
+	}
+	$code.="\tvmovdqa\t$spill(%rsp),%ymm8\n";
+    }
+    $code;
+}
+
+# Four G functions, i.e. half a round, executed in parallel.
+sub G4 {
+my ($vl,$a,$b,$c,$d,$x,$y)=@_;
+my $code="";
+
+    for (0..3) { $code.="\tvpaddd\t".($$x[$_]*32)."(%rsp),$v[$$a[$_]],$v[$$a[$_]]\n"; }
+    for (0..3) { $code.="\tvpaddd\t$v[$$b[$_]],$v[$$a[$_]],$v[$$a[$_]]\n"; }
+    for (0..3) { $code.="\tvpxor\t$v[$$a[$_]],$v[$$d[$_]],$v[$$d[$_]]\n"; }
+    $code.=ROR(16,$vl,map($v[$_],@$d));
+    for (0..3) { $code.="\tvpaddd\t$v[$$d[$_]],$v[$$c[$_]],$v[$$c[$_]]\n"; }
+    for (0..3) { $code.="\tvpxor\t$v[$$c[$_]],$v[$$b[$_]],$v[$$b[$_]]\n"; }
+    $code.=ROR(12,$vl,map($v[$_],@$b));
+    for (0..3) { $code.="\tvpaddd\t".($$y[$_]*32)."(%rsp),$v[$$a[$_]],$v[$$a[$_]]\n"; }
+    for (0..3) { $code.="\tvpaddd\t$v[$$b[$_]],$v[$$a[$_]],$v[$$a[$_]]\n"; }
+    for (0..3) { $code.="\tvpxor\t$v[$$a[$_]],$v[$$d[$_]],$v[$$d[$_]]\n"; }
+    $code.=ROR(8,$vl,map($v[$_],@$d));
+    for (0..3) { $code.="\tvpaddd\t$v[$$d[$_]],$v[$$c[$_]],$v[$$c[$_]]\n"; }
+    for (0..3) { $code.="\tvpxor\t$v[$$c[$_]],$v[$$b[$_]],$v[$$b[$_]]\n"; }
+    $code.=ROR(7,$vl,map($v[$_],@$b));
+    $code;
+}
+
+sub ROUND {
+my ($vl,$s)=@_;
+
+    G4($vl,[0,1,2,3],[4,5,6,7],[8,9,10,11],[12,13,14,15],
+		[@$s[0,2,4,6]],[@$s[1,3,5,7]]).
+    G4($vl,[0,1,2,3],[5,6,7,4],[10,11,8,9],[15,12,13,14],
+		[@$s[8,10,12,14]],[@$s[9,11,13,15]]);
+}
+
+# Transpose 8x8 matrix of 32-bit words held in @r into @o, @r being
+# clobbered. Both are 8 registers.
+sub TRANSPOSE_8x8 {
+my ($r,$o)=@_;
+my $code="";
+
+    for (0,2,4,6) {
+	$code.="\tvpunpckldq\t$$r[$_+1],$$r[$_],$$o[$_]\n";
+	$code.="\tvpunpckhdq\t$$r[$_+1],$$r[$_],$$o[$_+1]\n";
+    }
+    for (0,4) {
+	$code.="\tvpunpcklqdq\t$$o[$_+2],$$o[$_],$$r[$_]\n";
+	$code.="\tvpunpckhqdq\t$$o[$_+2],$$o[$_],$$r[$_+1]\n";
+	$code.="\tvpunpcklqdq\t$$o[$_+3],$$o[$_+1],$$r[$_+2]\n";
+	$code.="\tvpunpckhqdq\t$$o[$_+3],$$o[$_+1],$$r[$_+3]\n";
+    }
+    for (0..3) {
+	$code.="\tvperm2i128\t\$0x20,$$r[$_+4],$$r[$_],$$o[$_]\n";
+	$code.="\tvperm2i128\t\$0x31,$$r[$_+4],$$r[$_],$$o[$_+4]\n";
+    }
+    $code;
+}
+
+$code.=<<___;
+.text
+
+.extern OPENSSL_ia32cap_P
+___
+
+if ($avx>1) {
+my $func = "blake3_hash_chunks_avx2";
+
+$code.=<<___;
+.align	64
+.Lblake3_IV:
+.long	0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a
+.long	0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+.Lincd:
+.long	0,1,2,3,4,5,6,7
+.Lror16:
+.byte	0x2,0x3,0x0,0x1, 0x6,0x7,0x4,0x5, 0xa,0xb,0x8,0x9, 0xe,0xf,0xc,0xd
+.byte	0x2,0x3,0x0,0x1, 0x6,0x7,0x4,0x5, 0xa,0xb,0x8,0x9, 0xe,0xf,0xc,0xd
+.Lror8:
+.byte	0x1,0x2,0x3,0x0, 0x5,0x6,0x7,0x4, 0x9,0xa,0xb,0x8, 0xd,0xe,0xf,0xc
+.byte	0x1,0x2,0x3,0x0, 0x5,0x6,0x7,0x4, 0x9,0xa,0xb,0x8, 0xd,0xe,0xf,0xc
+.Lblocklen:
+.long	64
+
+.globl	$func
+.type	$func,\@function,3
+.align	32
+$func:
+.cfi_startproc
+	xor		%eax,%eax
+	mov		OPENSSL_ia32cap_P+8(%rip),%r10d
+	test		\$`1<<5`,%r10d		# check for AVX2
+	jz		.Lchunks_abort
+
+	mov		%rsp,%r9		# frame register
+.cfi_def_cfa_register	%r9
+	sub		\$$framesz+$xframe,%rsp
+	and		\$-32,%rsp
+___
+$code.=<<___	if ($win64);
+	movaps		%xmm6,-0xa8(%r9)
+	movaps		%xmm7,-0x98(%r9)
+	movaps		%xmm8,-0x88(%r9)
+	movaps		%xmm9,-0x78(%r9)
+	movaps		%xmm10,-0x68(%r9)
+	movaps		%xmm11,-0x58(%r9)
+	movaps		%xmm12,-0x48(%r9)
+	movaps		%xmm13,-0x38(%r9)
+	movaps		%xmm14,-0x28(%r9)
+	movaps		%xmm15,-0x18(%r9)
+___
+$code.=<<___;
+.Lchunks_body:
+	vzeroupper
+	vmovd		%esi,%xmm12		# chunk counters
+	shr		\$32,$ctr
+	vmovd		%esi,%xmm13
+	vpbroadcastd	%xmm12,%ymm12
+	vpbroadcastd	%xmm13,%ymm13
+	vpaddd		.Lincd(%rip),%ymm12,%ymm12
+	vmovdqa		%ymm12,$ctrlo(%rsp)
+	vmovdqa		%ymm13,$ctrhi(%rsp)
+___
+    for (0..7) {
+	$code.="\tvpbroadcastd\t.Lblake3_IV+".($_*4)."(%rip),$v[$_]\n";
+	$code.="\tvmovdqa\t$v[$_],".($cv+$_*32)."(%rsp)\n";
+    }
+$code.=<<___;
+	mov		\$1,%r8d		# CHUNK_START
+	mov		\$16,%ecx		# blocks per chunk
+___
+
+foreach my $vl (0,1) {
+my $sfx = $vl ? "_vl" : "";
+
+$code.=<<___	if (!$vl);
+	test		\$`1<<31`,%r10d		# check for AVX512VL
+	jnz		.Loop_chunks_vl
+___
+$code.=<<___;
+.align	32
+.Loop_chunks$sfx:
+___
+    # transpose message to stack
+    foreach my $half (0,1) {
+	for (0..7) {
+	    $code.="\tvmovdqu\t".($_*1024+$half*32)."($inp),$v[$_]\n";
+	}
+	$code.=TRANSPOSE_8x8([@v[0..7]],[@v[8..15]]);
+	for (0..7) {
+	    $code.="\tvmovdqa\t$v[8+$_],".(($half*8+$_)*32)."(%rsp)\n";
+	}
+    }
+
+$code.=<<___;
+	lea		2(%r8),%eax		# CHUNK_END
+	cmp		\$1,%ecx
+	cmove		%eax,%r8d
+	vmovd		%r8d,%xmm15
+	vpbroadcastd	%xmm15,%ymm15
+	vpbroadcastd	.Lblake3_IV+0(%rip),%ymm8
+	vpbroadcastd	.Lblake3_IV+4(%rip),%ymm9
+	vpbroadcastd	.Lblake3_IV+8(%rip),%ymm10
+	vpbroadcastd	.Lblake3_IV+12(%rip),%ymm11
+	vmovdqa		$ctrlo(%rsp),%ymm12
+	vmovdqa		$ctrhi(%rsp),%ymm13
+	vpbroadcastd	.Lblocklen(%rip),%ymm14
+___
+    for (0..7) {
+	$code.="\tvmovdqa\t".($cv+$_*32)."(%rsp),$v[$_]\n";
+    }
+    for (0..6) {
+	$code.=ROUND($vl,$sigma[$_]);
+    }
+    for (0..7) {
+	$code.="\tvpxor\t$v[$_+8],$v[$_],$v[$_]\n";
+	$code.="\tvmovdqa\t$v[$_],".($cv+$_*32)."(%rsp)\n";
+    }
+
+$code.=<<___;
+	lea		64($inp),$inp
+	xor		%r8d,%r8d
+	dec		%ecx
+	jnz		.Loop_chunks$sfx
+___
+$code.=<<___	if (!$vl);
+	jmp		.Lchunks_done
+___
+}
+
+$code.=<<___;
+
+.Lchunks_done:
+___
+    # chaining values are in %ymm0-7 with rows being words
+    $code.=TRANSPOSE_8x8([@v[0..7]],[@v[8..15]]);
+    for (0..7) {
+	$code.="\tvmovdqu\t$v[8+$_],".($_*32)."($out)\n";
+    }
+$code.=<<___;
+	vzeroall
+___
+$code.=<<___	if ($win64);
+	movaps		-0xa8(%r9),%xmm6
+	movaps		-0x98(%r9),%xmm7
+	movaps		-0x88(%r9),%xmm8
+	movaps		-0x78(%r9),%xmm9
+	movaps		-0x68(%r9),%xmm10
+	movaps		-0x58(%r9),%xmm11
+	movaps		-0x48(%r9),%xmm12
+	movaps		-0x38(%r9),%xmm13
+	movaps		-0x28(%r9),%xmm14
+	movaps		-0x18(%r9),%xmm15
+___
+$code.=<<___;
+	lea		(%r9),%rsp
+.cfi_def_cfa_register	%rsp
+	mov		\$1,%eax
+.Lchunks_epilogue:
+.Lchunks_abort:
+	ret
+.cfi_endproc
+.size	$func,.-$func
+___
+} else {
+# Assembler is too old for AVX2, let C fall back to generic code.
+$code.=<<___;
+.globl	blake3_hash_chunks_avx2
+.type	blake3_hash_chunks_avx2,\@abi-omnipotent
+blake3_hash_chunks_avx2:
+	xor	%eax,%eax
+	ret
+.size	blake3_hash_chunks_avx2,.-blake3_hash_chunks_avx2
+___
+}
+
+# EXCEPTION_DISPOSITION handler (EXCEPTION_RECORD *rec,ULONG64 frame,
+#		CONTEXT *context,DISPATCHER_CONTEXT *disp)
+if ($win64 && $avx>1) {
+$rec="%rcx";
+$frame="%rdx";
+$context="%r8";
+$disp="%r9";
+
+$code.=<<___;
+.extern	__imp_RtlVirtualUnwind
+.type	simd_handler,\@abi-omnipotent
+.align	16
+simd_handler:
+	push	%rsi
+	push	%rdi
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	pushfq
+	sub	\$64,%rsp
+
+	mov	120($context),%rax	# pull context->Rax
+	mov	248($context),%rbx	# pull context->Rip
+
+	mov	8($disp),%rsi		# disp->ImageBase
+	mov	56($disp),%r11		# disp->HandlerData
+
+	mov	0(%r11),%r10d		# HandlerData[0]
+	lea	(%rsi,%r10),%r10	# prologue label
+	cmp	%r10,%rbx		# context->Rip<prologue label
+	jb	.Lcommon_seh_tail
+
+	mov	192($context),%rax	# pull context->R9
+
+	mov	4(%r11),%r10d		# HandlerData[1]
+	lea	(%rsi,%r10),%r10	# epilogue label
+	cmp	%r10,%rbx		# context->Rip>=epilogue label
+	jae	.Lcommon_seh_tail
+
+	lea	-0xa8(%rax),%rsi
+	lea	512($context),%rdi	# &context.Xmm6
+	mov	\$20,%ecx
+	.long	0xa548f3fc		# cld; rep movsq
+
+.Lcommon_seh_tail:
+	mov	8(%rax),%rdi
+	mov	16(%rax),%rsi
+	mov	%rax,152($context)	# restore context->Rsp
+	mov	%rsi,168($context)	# restore context->Rsi
+	mov	%rdi,176($context)	# restore context->Rdi
+
+	mov	40($disp),%rdi		# disp->ContextRecord
+	mov	$context,%rsi		# context
+	mov	\$154,%ecx		# sizeof(CONTEXT)
+	.long	0xa548f3fc		# cld; rep movsq
+
+	mov	$disp,%rsi
+	xor	%rcx,%rcx		# arg1, UNW_FLAG_NHANDLER
+	mov	8(%rsi),%rdx		# arg2, disp->ImageBase
+	mov	0(%rsi),%r8		# arg3, disp->ControlPc
+	mov	16(%rsi),%r9		# arg4, disp->FunctionEntry
+	mov	40(%rsi),%r10		# disp->ContextRecord
+	lea	56(%rsi),%r11		# &disp->HandlerData
+	lea	24(%rsi),%r12		# &disp->EstablisherFrame
+	mov	%r10,32(%rsp)		# arg5
+	mov	%r11,40(%rsp)		# arg6
+	mov	%r12,48(%rsp)		# arg7
+	mov	%rcx,56(%rsp)		# arg8, (NULL)
+	call	*__imp_RtlVirtualUnwind(%rip)
+
+	mov	\$1,%eax		# ExceptionContinueSearch
+	add	\$64,%rsp
+	popfq
+	pop	%r15
+	pop	%r14
+	pop	%r13
+	pop	%r12
+	pop	%rbp
+	pop	%rbx
+	pop	%rdi
+	pop	%rsi
+	ret
+.size	simd_handler,.-simd_handler
+
+.section	.pdata
+.align	4
+	.rva	.LSEH_begin_blake3_hash_chunks_avx2
+	.rva	.LSEH_end_blake3_hash_chunks_avx2
+	.rva	.LSEH_info_blake3_hash_chunks_avx2
+
+.section	.xdata
+.align	8
+.LSEH_info_blake3_hash_chunks_avx2:
+	.byte	9,0,0,0
+	.rva	simd_handler
+	.rva	.Lchunks_body,.Lchunks_epilogue	# HandlerData[]
+___
+}
+
+foreach (split("\n",$code)) {
+	s/\`([^\`]*)\`/eval $1/ge;
+
+	print $_,"\n";
+}
+
+close STDOUT or die "error closing STDOUT: $!";
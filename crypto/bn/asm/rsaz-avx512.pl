@@ -0,0 +1,855 @@
+#! /usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+#
+# Almost Montgomery Multiplication in radix 2^52 for processors with
+# AVX512 IFMA extension.
+#
+# Operands are kept as little-endian arrays of 52-bit digits padded with
+# zeros to a multiple of 4 digits, i.e. 20 digits for 1024-bit, 32 for
+# 1536-bit and 40 for 2048-bit moduli, so that each of them occupies
+# whole %ymm registers. Both vpmadd52luq and vpmadd52huq accumulate into
+# 64-bit lanes, which leaves 12 bits of headroom, enough to postpone
+# carry propagation until the very end of the multiplication.
+#
+# Single multiplications use only 256-bit vectors, because on current
+# processors 512-bit ones drop the clock frequency for longer than an
+# RSA private key operation takes. Pairs of independent multiplications,
+# as the two CRT halves of RSA private key operation are, are done in
+# the two halves of 512-bit vectors instead, where twice the work per
+# instruction pays for it. Only %ymm16-%ymm31/%zmm16-%zmm31 are used,
+# so that no vector registers have to be preserved on Win64. As
+# vzeroupper doesn't touch them, they are cleared explicitly on return,
+# otherwise subsequent SSE code is penalized.
+#
+# References:
+# [1] S. Gueron, "Efficient Software Implementations of Modular
+#     Exponentiation", Journal of Cryptographic Engineering 2:31-43 (2012).
+# [2] N. Drucker, S. Gueron, "Fast modular squaring with AVX512IFMA",
+#     IACR ePrint 2018/335.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$ifma = ($1>=2.26);
+}
+
+if (!$ifma && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	   `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)/) {
+	$ifma = ($1>=2.13);
+}
+
+if (!$ifma && `$ENV{CC} -v 2>&1` =~ /((?:^clang|LLVM) version|.*based on LLVM) ([0-9]+)\.([0-9]+)/) {
+	$ifma = ($2>=7);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+if ($ifma) {{{
+$code.=<<___;
+.text
+
+.extern	OPENSSL_ia32cap_P
+.globl	rsaz_avx512ifma_eligible
+.type	rsaz_avx512ifma_eligible,\@abi-omnipotent
+.align	32
+rsaz_avx512ifma_eligible:
+	mov	OPENSSL_ia32cap_P+8(%rip),%ecx
+	xor	%eax,%eax
+	and	\$`1<<31|1<<21|1<<16`,%ecx	# AVX512VL, AVX512IFMA, AVX512F
+	cmp	\$`1<<31|1<<21|1<<16`,%ecx
+	sete	%al
+	ret
+.size	rsaz_avx512ifma_eligible,.-rsaz_avx512ifma_eligible
+___
+
+###############################################################################
+# void rsaz_amm52xN_x1_256(BN_ULONG *res, const BN_ULONG *a,
+#                          const BN_ULONG *b, const BN_ULONG *m,
+#                          BN_ULONG k0);
+#
+# res = a * b * 2^(-52*N) mod m, with res < 2*m provided that a, b < 2*m
+# and 4*m < 2^(52*N). Digits of res are normalized to 52 bits. res may
+# alias a or b.
+#
+# The lowest digit of the accumulator is tracked in a general purpose
+# register, which also computes low half of m[1]*y[i] on its own. This
+# way y[i+1] only depends on vector lanes finished in the previous
+# iteration and can be computed while the products with y[i] are still
+# being accumulated. Products with b[i] don't depend on y[i] at all and
+# are summed up in a temporary register before being added to the
+# accumulator, which keeps the loop-carried vector dependency short.
+# The vector lanes of the two lowest digits are left to accumulate
+# garbage, which is shifted out every time.
+#
+my ($rp,$ap,$bp,$np,$k0)=("%rdi","%rsi","%r11","%rcx","%r8");
+my ($acc,$t2,$lo,$hi,$d1,$mask,$cnt)=
+   ("%r9","%r10","%rax","%rbx","%r12","%r13","%r14d");
+my ($zero,$Bi,$Bn,$Yi,$T,$X)=map("%ymm$_",(16..21));
+(my $Xx=$X) =~ s/ymm/xmm/;
+
+sub amm52x1_iter {
+my ($last,@R)=@_;
+
+$code.=<<___;
+	vpbroadcastq	($bp),$Bi		# b[i]
+	mov	($ap),%rdx
+	mulx	($bp),$lo,$t2		# a[0]*b[i]
+	valignq	\$1,$R[0],$R[0],$X
+	add	$lo,$acc
+	adc	\$0,$t2
+	mov	$k0,%rdx
+	imul	$acc,%rdx
+	and	$mask,%rdx		# y[i] = (res[0]+a[0]*b[i])*k0 mod 2^52
+	vpbroadcastq	%rdx,$Yi
+	vmovq	$Xx,$d1			# res[1]
+	mulx	($np),$lo,$hi		# m[0]*y[i]
+	add	$lo,$acc
+	adc	$hi,$t2
+	mulx	8($np),$lo,$hi		# m[1]*y[i]
+	shrd	\$52,$t2,$acc		# (res[0]+a[0]*b[i]+m[0]*y[i])>>52
+	and	$mask,$lo
+	add	$d1,$acc
+	add	$lo,$acc		# res[0] for the next iteration
+	lea	8($bp),$bp
+
+	# res += lo52(m*y[i]), lo52(a*b[i]) is already there
+___
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___;
+	vpmadd52luq	`32*$i`($np),$Yi,$R[$i]
+___
+}
+$code.=<<___;
+
+	# res >>= 52
+___
+for (my $i=0; $i<$#R; $i++) {
+$code.=<<___;
+	valignq	\$1,$R[$i],$R[$i+1],$R[$i]
+___
+}
+$code.=<<___;
+	valignq	\$1,$R[-1],$zero,$R[-1]
+
+	# res += hi52(a*b[i]) + lo52(a*b[i+1]) + hi52(m*y[i])
+___
+$code.=<<___	if (!$last);
+	vpbroadcastq	($bp),$Bn		# b[i+1]
+___
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___	if (!$last);
+	vpxord	$T,$T,$T
+	vpmadd52huq	`32*$i`($ap),$Bi,$T
+	vpmadd52luq	`32*$i`($ap),$Bn,$T
+	vpaddq	$T,$R[$i],$R[$i]
+___
+$code.=<<___	if ($last);
+	vpmadd52huq	`32*$i`($ap),$Bi,$R[$i]
+___
+}
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___;
+	vpmadd52huq	`32*$i`($np),$Yi,$R[$i]
+___
+}
+}
+
+sub amm52x1 {
+my ($digits,$padded)=@_;
+my @R=map("%ymm$_",(22..(22+$padded/4-1)));
+
+$code.=<<___;
+.globl	rsaz_amm52x${digits}_x1_256
+.type	rsaz_amm52x${digits}_x1_256,\@function,5
+.align	32
+rsaz_amm52x${digits}_x1_256:
+.cfi_startproc
+	push	%rbp
+.cfi_push	%rbp
+	push	%rbx
+.cfi_push	%rbx
+	push	%r12
+.cfi_push	%r12
+	push	%r13
+.cfi_push	%r13
+	push	%r14
+.cfi_push	%r14
+	push	%r15
+.cfi_push	%r15
+.Lamm52x${digits}_body:
+	mov	%rdx,$bp		# b
+	mov	\$0xfffffffffffff,$mask
+	xor	$acc,$acc		# res[0]
+	vpxord	$zero,$zero,$zero
+	vpbroadcastq	($bp),$Bi
+___
+foreach (@R) {
+$code.=<<___;
+	vpxord	$_,$_,$_
+___
+}
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___;
+	vpmadd52luq	`32*$i`($ap),$Bi,$R[$i]
+___
+}
+$code.=<<___;
+	mov	\$`$digits-1`,$cnt
+
+.align	32
+.Loop_amm52x${digits}:
+___
+amm52x1_iter(0,@R);
+$code.=<<___;
+
+	dec	$cnt
+	jnz	.Loop_amm52x${digits}
+
+___
+amm52x1_iter(1,@R);
+$code.=<<___;
+
+___
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___;
+	vmovdqu64	$R[$i],`32*$i`($rp)
+___
+}
+foreach ($Bi,$Bn,$Yi,$T,$X,@R) {
+$code.=<<___;
+	vpxord	$_,$_,$_
+___
+}
+$code.=<<___;
+	vzeroupper
+
+	# normalize digits to 52 bits, the final carry is zero since
+	# res < 2*m < 2^(52*N)
+	mov	$acc,($rp)
+	xor	$acc,$acc
+	mov	\$$digits,$cnt
+.Lnorm_amm52x${digits}:
+	mov	($rp),$lo
+	add	$acc,$lo
+	mov	$lo,$acc
+	shr	\$52,$acc
+	and	$mask,$lo
+	mov	$lo,($rp)
+	lea	8($rp),$rp
+	dec	$cnt
+	jnz	.Lnorm_amm52x${digits}
+
+	mov	0(%rsp),%r15
+.cfi_restore	%r15
+	mov	8(%rsp),%r14
+.cfi_restore	%r14
+	mov	16(%rsp),%r13
+.cfi_restore	%r13
+	mov	24(%rsp),%r12
+.cfi_restore	%r12
+	mov	32(%rsp),%rbx
+.cfi_restore	%rbx
+	mov	40(%rsp),%rbp
+.cfi_restore	%rbp
+	lea	48(%rsp),%rsp
+.cfi_adjust_cfa_offset	-48
+.Lamm52x${digits}_epilogue:
+	ret
+.cfi_endproc
+.size	rsaz_amm52x${digits}_x1_256,.-rsaz_amm52x${digits}_x1_256
+___
+}
+
+###############################################################################
+# void rsaz_amm52xN_x2_512(BN_ULONG *res, const BN_ULONG *a,
+#                          const BN_ULONG *b, const BN_ULONG *m,
+#                          const BN_ULONG k0[2]);
+#
+# Two independent multiplications as above in the two halves of %zmm
+# registers. Operands are pairs of N-digit numbers, N is a multiple of
+# 4, interleaved in blocks of 4 digits, i.e. digits 4*j..4*j+3 of the
+# first number are followed by the same digits of the second one. This
+# way each %zmm register holds the same block of both accumulators and
+# every vector instruction works on both multiplications at once. The
+# loop is unrolled 4 times to walk b block by block.
+#
+my $acc2="%r15";
+my $d2="%rbp";
+
+sub amm52x2_iter {
+my ($last,$boff,$bnext,$Perm,@R)=@_;
+(my $Xx=$X) =~ s/zmm/xmm/;
+(my $Tx=$T) =~ s/zmm/xmm/;
+
+$code.=<<___;
+	vpbroadcastq	$boff($bp),$Bi		# b[i]
+	vpbroadcastq	`$boff+32`($bp),$Bi\{%k2\}
+	mov	($ap),%rdx
+	mulx	$boff($bp),$lo,$t2	# a[0]*b[i]
+	valignq	\$1,$R[0],$R[0],$X
+	add	$lo,$acc
+	adc	\$0,$t2
+	mov	($k0),%rdx
+	imul	$acc,%rdx
+	and	$mask,%rdx		# y[i] = (res[0]+a[0]*b[i])*k0 mod 2^52
+	vpbroadcastq	%rdx,$Yi
+	vmovq	$Xx,$d1			# res[1]
+	mulx	($np),$lo,$hi		# m[0]*y[i]
+	add	$lo,$acc
+	adc	$hi,$t2
+	mulx	8($np),$lo,$hi		# m[1]*y[i]
+	shrd	\$52,$t2,$acc		# (res[0]+a[0]*b[i]+m[0]*y[i])>>52
+	and	$mask,$lo
+	add	$d1,$acc
+	add	$lo,$acc		# res[0] for the next iteration
+
+	mov	32($ap),%rdx		# same for the second number
+	mulx	`$boff+32`($bp),$lo,$t2
+	vextracti32x4	\$2,$X,$Tx
+	add	$lo,$acc2
+	adc	\$0,$t2
+	mov	8($k0),%rdx
+	imul	$acc2,%rdx
+	and	$mask,%rdx
+	vpbroadcastq	%rdx,$Yi\{%k2\}
+	vmovq	$Tx,$d2
+	mulx	32($np),$lo,$hi
+	add	$lo,$acc2
+	adc	$hi,$t2
+	mulx	40($np),$lo,$hi
+	shrd	\$52,$t2,$acc2
+	and	$mask,$lo
+	add	$d2,$acc2
+	add	$lo,$acc2
+
+	# res += lo52(m*y[i]), lo52(a*b[i]) is already there
+___
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___;
+	vpmadd52luq	`64*$i`($np),$Yi,$R[$i]
+___
+}
+$code.=<<___;
+
+	# res >>= 52, independently in each half
+___
+for (my $i=0; $i<$#R; $i++) {
+$code.=<<___;
+	vpermt2q	$R[$i+1],$Perm,$R[$i]
+___
+}
+$code.=<<___;
+	vpermt2q	$zero,$Perm,$R[-1]
+
+	# res += hi52(a*b[i]) + lo52(a*b[i+1]) + hi52(m*y[i])
+___
+$code.=<<___	if (!$last);
+	vpbroadcastq	$bnext($bp),$Bn		# b[i+1]
+	vpbroadcastq	`$bnext+32`($bp),$Bn\{%k2\}
+___
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___	if (!$last);
+	vpxord	$T,$T,$T
+	vpmadd52huq	`64*$i`($ap),$Bi,$T
+	vpmadd52luq	`64*$i`($ap),$Bn,$T
+	vpaddq	$T,$R[$i],$R[$i]
+___
+$code.=<<___	if ($last);
+	vpmadd52huq	`64*$i`($ap),$Bi,$R[$i]
+___
+}
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___;
+	vpmadd52huq	`64*$i`($np),$Yi,$R[$i]
+___
+}
+}
+
+sub amm52x2 {
+my $digits=shift;
+my $Perm="%zmm22";
+my @R=map("%zmm$_",(23..(23+$digits/4-1)));
+($zero,$Bi,$Bn,$Yi,$T,$X)=map("%zmm$_",(16..21));
+
+$code.=<<___;
+.globl	rsaz_amm52x${digits}_x2_512
+.type	rsaz_amm52x${digits}_x2_512,\@function,5
+.align	32
+rsaz_amm52x${digits}_x2_512:
+.cfi_startproc
+	push	%rbp
+.cfi_push	%rbp
+	push	%rbx
+.cfi_push	%rbx
+	push	%r12
+.cfi_push	%r12
+	push	%r13
+.cfi_push	%r13
+	push	%r14
+.cfi_push	%r14
+	push	%r15
+.cfi_push	%r15
+.Lamm52x${digits}_x2_body:
+	mov	%rdx,$bp		# b
+	mov	\$0xfffffffffffff,$mask
+	mov	\$0xf0,%eax
+	kmovw	%eax,%k2		# upper half
+	xor	$acc,$acc		# res[0]
+	xor	$acc2,$acc2
+	vpxord	$zero,$zero,$zero
+	vmovdqu64	.Lshift_x2(%rip),$Perm
+	vpbroadcastq	($bp),$Bi
+	vpbroadcastq	32($bp),$Bi\{%k2\}
+___
+foreach (@R) {
+$code.=<<___;
+	vpxord	$_,$_,$_
+___
+}
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___;
+	vpmadd52luq	`64*$i`($ap),$Bi,$R[$i]
+___
+}
+$code.=<<___;
+	mov	\$`$digits/4-1`,$cnt
+
+.align	32
+.Loop_amm52x${digits}_x2:
+___
+amm52x2_iter(0,0,8,$Perm,@R);
+amm52x2_iter(0,8,16,$Perm,@R);
+amm52x2_iter(0,16,24,$Perm,@R);
+amm52x2_iter(0,24,64,$Perm,@R);
+$code.=<<___;
+	lea	64($bp),$bp
+
+	dec	$cnt
+	jnz	.Loop_amm52x${digits}_x2
+
+___
+amm52x2_iter(0,0,8,$Perm,@R);
+amm52x2_iter(0,8,16,$Perm,@R);
+amm52x2_iter(0,16,24,$Perm,@R);
+amm52x2_iter(1,24,64,$Perm,@R);
+$code.=<<___;
+
+___
+for (my $i=0; $i<=$#R; $i++) {
+$code.=<<___;
+	vmovdqu64	$R[$i],`64*$i`($rp)
+___
+}
+foreach ($Bi,$Bn,$Yi,$T,$X,$Perm,@R) {
+$code.=<<___;
+	vpxord	$_,$_,$_
+___
+}
+$code.=<<___;
+	vzeroupper
+
+	# normalize digits of both numbers to 52 bits
+	mov	$acc,($rp)
+	mov	$acc2,32($rp)
+	mov	%rdi,$t2
+	xor	$acc,$acc
+	xor	$acc2,$acc2
+	mov	\$`$digits/4`,$cnt
+.Lnorm_amm52x${digits}_x2:
+___
+for (my $i=0; $i<4; $i++) {
+$code.=<<___;
+	mov	`8*$i`($t2),$lo
+	mov	`32+8*$i`($t2),$hi
+	add	$acc,$lo
+	add	$acc2,$hi
+	mov	$lo,$acc
+	mov	$hi,$acc2
+	shr	\$52,$acc
+	shr	\$52,$acc2
+	and	$mask,$lo
+	and	$mask,$hi
+	mov	$lo,`8*$i`($t2)
+	mov	$hi,`32+8*$i`($t2)
+___
+}
+$code.=<<___;
+	lea	64($t2),$t2
+	dec	$cnt
+	jnz	.Lnorm_amm52x${digits}_x2
+
+	mov	0(%rsp),%r15
+.cfi_restore	%r15
+	mov	8(%rsp),%r14
+.cfi_restore	%r14
+	mov	16(%rsp),%r13
+.cfi_restore	%r13
+	mov	24(%rsp),%r12
+.cfi_restore	%r12
+	mov	32(%rsp),%rbx
+.cfi_restore	%rbx
+	mov	40(%rsp),%rbp
+.cfi_restore	%rbp
+	lea	48(%rsp),%rsp
+.cfi_adjust_cfa_offset	-48
+.Lamm52x${digits}_x2_epilogue:
+	ret
+.cfi_endproc
+.size	rsaz_amm52x${digits}_x2_512,.-rsaz_amm52x${digits}_x2_512
+___
+}
+
+###############################################################################
+# void rsaz_gather52xN_win5(BN_ULONG *out, const BN_ULONG *table, int idx);
+#
+# Constant-time out = table[idx], the table holds 32 entries of N digits
+# padded to a multiple of 4. Every entry is read and blended in under a
+# mask, so that the memory access pattern doesn't depend on idx.
+#
+sub gather52 {
+my ($digits,$padded)=@_;
+my ($out,$tbl,$idx)=("%rdi","%rsi","%rdx");
+my ($Idx,$Cur,$One,$T)=map("%ymm$_",(16..19));
+my @A=map("%ymm$_",(20..(20+$padded/4-1)));
+
+$code.=<<___;
+.globl	rsaz_gather52x${digits}_win5
+.type	rsaz_gather52x${digits}_win5,\@function,3
+.align	32
+rsaz_gather52x${digits}_win5:
+.cfi_startproc
+	mov	%edx,%edx
+	vpbroadcastq	$idx,$Idx
+	mov	\$1,%eax
+	vpbroadcastq	%rax,$One
+	vpxord	$Cur,$Cur,$Cur
+___
+foreach (@A) {
+$code.=<<___;
+	vpxord	$_,$_,$_
+___
+}
+$code.=<<___;
+	mov	\$32,%ecx
+
+.align	32
+.Loop_gather52x${digits}:
+	vpcmpeqq	$Cur,$Idx,%k1
+___
+for (my $i=0; $i<=$#A; $i++) {
+my $dst="$A[$i]"."{%k1}";
+$code.=<<___;
+	vmovdqu64	`32*$i`($tbl),$T
+	vpblendmq	$T,$A[$i],$dst
+___
+}
+$code.=<<___;
+	vpaddq	$One,$Cur,$Cur
+	lea	`8*$padded`($tbl),$tbl
+	dec	%ecx
+	jnz	.Loop_gather52x${digits}
+
+___
+for (my $i=0; $i<=$#A; $i++) {
+$code.=<<___;
+	vmovdqu64	$A[$i],`32*$i`($out)
+___
+}
+foreach ($Idx,$Cur,$One,$T,@A) {
+$code.=<<___;
+	vpxord	$_,$_,$_
+___
+}
+$code.=<<___;
+	vzeroupper
+	ret
+.cfi_endproc
+.size	rsaz_gather52x${digits}_win5,.-rsaz_gather52x${digits}_win5
+___
+}
+
+###############################################################################
+# void rsaz_gather52xN_x2_win5(BN_ULONG *out, const BN_ULONG *table,
+#                              int idx1, int idx2);
+#
+# Same as above for tables of pairs of numbers in the layout used by
+# rsaz_amm52xN_x2_512, the first number is taken from entry idx1 and the
+# second one from entry idx2.
+#
+sub gather52x2 {
+my $digits=shift;
+my ($out,$tbl,$idx1,$idx2)=("%rdi","%rsi","%rdx","%rcx");
+my ($Idx,$Cur,$One,$T)=map("%zmm$_",(16..19));
+my @A=map("%zmm$_",(20..(20+$digits/4-1)));
+
+$code.=<<___;
+.globl	rsaz_gather52x${digits}_x2_win5
+.type	rsaz_gather52x${digits}_x2_win5,\@function,4
+.align	32
+rsaz_gather52x${digits}_x2_win5:
+.cfi_startproc
+	mov	%edx,%edx
+	mov	%ecx,%ecx
+	mov	\$0xf0,%eax
+	kmovw	%eax,%k2
+	vpbroadcastq	$idx1,$Idx
+	vpbroadcastq	$idx2,$Idx\{%k2\}
+	mov	\$1,%eax
+	vpbroadcastq	%rax,$One
+	vpxord	$Cur,$Cur,$Cur
+___
+foreach (@A) {
+$code.=<<___;
+	vpxord	$_,$_,$_
+___
+}
+$code.=<<___;
+	mov	\$32,%ecx
+
+.align	32
+.Loop_gather52x${digits}_x2:
+	vpcmpeqq	$Cur,$Idx,%k1
+___
+for (my $i=0; $i<=$#A; $i++) {
+my $dst="$A[$i]"."{%k1}";
+$code.=<<___;
+	vmovdqu64	`64*$i`($tbl),$T
+	vpblendmq	$T,$A[$i],$dst
+___
+}
+$code.=<<___;
+	vpaddq	$One,$Cur,$Cur
+	lea	`16*$digits`($tbl),$tbl
+	dec	%ecx
+	jnz	.Loop_gather52x${digits}_x2
+
+___
+for (my $i=0; $i<=$#A; $i++) {
+$code.=<<___;
+	vmovdqu64	$A[$i],`64*$i`($out)
+___
+}
+foreach ($Idx,$Cur,$One,$T,@A) {
+$code.=<<___;
+	vpxord	$_,$_,$_
+___
+}
+$code.=<<___;
+	vzeroupper
+	ret
+.cfi_endproc
+.size	rsaz_gather52x${digits}_x2_win5,.-rsaz_gather52x${digits}_x2_win5
+___
+}
+
+$code.=<<___;
+.align	64
+.Lshift_x2:
+	.quad	1,2,3,8,5,6,7,12
+___
+
+amm52x1(20,20);		# 1024-bit moduli
+amm52x1(30,32);		# 1536-bit moduli
+amm52x1(40,40);		# 2048-bit moduli
+gather52(20,20);
+gather52(30,32);
+gather52(40,40);
+amm52x2(20);		# 1024-bit moduli
+amm52x2(32);		# 1536-bit moduli
+gather52x2(20);
+gather52x2(32);
+
+# EXCEPTION_DISPOSITION handler (EXCEPTION_RECORD *rec,ULONG64 frame,
+#		CONTEXT *context,DISPATCHER_CONTEXT *disp)
+if ($win64) {
+$rec="%rcx";
+$frame="%rdx";
+$context="%r8";
+$disp="%r9";
+
+$code.=<<___;
+.extern	__imp_RtlVirtualUnwind
+.type	rsaz_se_handler,\@abi-omnipotent
+.align	16
+rsaz_se_handler:
+	push	%rsi
+	push	%rdi
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	pushfq
+	sub	\$64,%rsp
+
+	mov	120($context),%rax	# pull context->Rax
+	mov	248($context),%rbx	# pull context->Rip
+
+	mov	8($disp),%rsi		# disp->ImageBase
+	mov	56($disp),%r11		# disp->HandlerData
+
+	mov	0(%r11),%r10d		# HandlerData[0]
+	lea	(%rsi,%r10),%r10	# end of prologue label
+	cmp	%r10,%rbx		# context->Rip<end of prologue label
+	jb	.Lcommon_seh_tail
+
+	mov	152($context),%rax	# pull context->Rsp
+
+	mov	4(%r11),%r10d		# HandlerData[1]
+	lea	(%rsi,%r10),%r10	# epilogue label
+	cmp	%r10,%rbx		# context->Rip>=epilogue label
+	jae	.Lcommon_seh_tail
+
+	lea	48(%rax),%rax
+
+	mov	-8(%rax),%rbp
+	mov	-16(%rax),%rbx
+	mov	-24(%rax),%r12
+	mov	-32(%rax),%r13
+	mov	-40(%rax),%r14
+	mov	-48(%rax),%r15
+	mov	%rbx,144($context)	# restore context->Rbx
+	mov	%rbp,160($context)	# restore context->Rbp
+	mov	%r12,216($context)	# restore context->R12
+	mov	%r13,224($context)	# restore context->R13
+	mov	%r14,232($context)	# restore context->R14
+	mov	%r15,240($context)	# restore context->R15
+
+.Lcommon_seh_tail:
+	mov	8(%rax),%rdi
+	mov	16(%rax),%rsi
+	mov	%rax,152($context)	# restore context->Rsp
+	mov	%rsi,168($context)	# restore context->Rsi
+	mov	%rdi,176($context)	# restore context->Rdi
+
+	mov	40($disp),%rdi		# disp->ContextRecord
+	mov	$context,%rsi		# context
+	mov	\$154,%ecx		# sizeof(CONTEXT)
+	.long	0xa548f3fc		# cld; rep movsq
+
+	mov	$disp,%rsi
+	xor	%rcx,%rcx		# arg1, UNW_FLAG_NHANDLER
+	mov	8(%rsi),%rdx		# arg2, disp->ImageBase
+	mov	0(%rsi),%r8		# arg3, disp->ControlPc
+	mov	16(%rsi),%r9		# arg4, disp->FunctionEntry
+	mov	40(%rsi),%r10		# disp->ContextRecord
+	lea	56(%rsi),%r11		# &disp->HandlerData
+	lea	24(%rsi),%r12		# &disp->EstablisherFrame
+	mov	%r10,32(%rsp)		# arg5
+	mov	%r11,40(%rsp)		# arg6
+	mov	%r12,48(%rsp)		# arg7
+	mov	%rcx,56(%rsp)		# arg8, (NULL)
+	call	*__imp_RtlVirtualUnwind(%rip)
+
+	mov	\$1,%eax		# ExceptionContinueSearch
+	add	\$64,%rsp
+	popfq
+	pop	%r15
+	pop	%r14
+	pop	%r13
+	pop	%r12
+	pop	%rbp
+	pop	%rbx
+	pop	%rdi
+	pop	%rsi
+	ret
+.size	rsaz_se_handler,.-rsaz_se_handler
+
+.section	.pdata
+.align	4
+___
+foreach (20,30,40) {
+$code.=<<___;
+	.rva	.LSEH_begin_rsaz_amm52x${_}_x1_256
+	.rva	.LSEH_end_rsaz_amm52x${_}_x1_256
+	.rva	.LSEH_info_rsaz_amm52x${_}_x1_256
+
+___
+}
+foreach (20,32) {
+$code.=<<___;
+	.rva	.LSEH_begin_rsaz_amm52x${_}_x2_512
+	.rva	.LSEH_end_rsaz_amm52x${_}_x2_512
+	.rva	.LSEH_info_rsaz_amm52x${_}_x2_512
+
+___
+}
+$code.=<<___;
+.section	.xdata
+.align	8
+___
+foreach (20,30,40) {
+$code.=<<___;
+.LSEH_info_rsaz_amm52x${_}_x1_256:
+	.byte	9,0,0,0
+	.rva	rsaz_se_handler
+	.rva	.Lamm52x${_}_body,.Lamm52x${_}_epilogue	# HandlerData[]
+___
+}
+foreach (20,32) {
+$code.=<<___;
+.LSEH_info_rsaz_amm52x${_}_x2_512:
+	.byte	9,0,0,0
+	.rva	rsaz_se_handler
+	.rva	.Lamm52x${_}_x2_body,.Lamm52x${_}_x2_epilogue	# HandlerData[]
+___
+}
+}
+}}} else {{{
+$code.=<<___;	# assembler is too old
+.text
+
+.globl	rsaz_avx512ifma_eligible
+.type	rsaz_avx512ifma_eligible,\@abi-omnipotent
+rsaz_avx512ifma_eligible:
+	xor	%eax,%eax
+	ret
+.size	rsaz_avx512ifma_eligible,.-rsaz_avx512ifma_eligible
+
+.globl	rsaz_amm52x20_x1_256
+.globl	rsaz_amm52x30_x1_256
+.globl	rsaz_amm52x40_x1_256
+.globl	rsaz_amm52x20_x2_512
+.globl	rsaz_amm52x32_x2_512
+.globl	rsaz_gather52x20_x2_win5
+.globl	rsaz_gather52x32_x2_win5
+.globl	rsaz_gather52x20_win5
+.globl	rsaz_gather52x30_win5
+.globl	rsaz_gather52x40_win5
+.type	rsaz_amm52x20_x1_256,\@abi-omnipotent
+rsaz_amm52x20_x1_256:
+rsaz_amm52x30_x1_256:
+rsaz_amm52x40_x1_256:
+rsaz_amm52x20_x2_512:
+rsaz_amm52x32_x2_512:
+rsaz_gather52x20_x2_win5:
+rsaz_gather52x32_x2_win5:
+rsaz_gather52x20_win5:
+rsaz_gather52x30_win5:
+rsaz_gather52x40_win5:
+	.byte	0x0f,0x0b	# ud2
+	ret
+.size	rsaz_amm52x20_x1_256,.-rsaz_amm52x20_x1_256
+___
+}}}
+
+$code =~ s/\`([^\`]*)\`/eval $1/gem;
+print $code;
+close STDOUT;
@@ -663,7 +663,31 @@ int BN_mod_exp_mont_consttime(BIGNUM *rr, const BIGNUM *a, const BIGNUM *p,
      * RSAZ exponentiation. For further information see
      * crypto/bn/rsaz_exp.c and accompanying assembly modules.
      */
-    if ((16 == a->top) && (16 == p->top) && (BN_num_bits(m) == 1024)
+    if ((p->top <= top) && rsaz_avx512ifma_eligible()
+        && (BN_num_bits(m) == 1024 || BN_num_bits(m) == 1536
+            || BN_num_bits(m) == 2048)) {
+        BN_ULONG base_w[32], exp_w[32], rr_w[32];
+        int copied;
+
+        /* Operands that don't fit are left to the generic code below */
+        copied = bn_copy_words(base_w, a, top)
+                 && bn_copy_words(exp_w, p, top)
+                 && bn_copy_words(rr_w, &mont->RR, top);
+        if (copied)
+            ret = bn_wexpand(rr, top) != NULL
+                  && RSAZ_mod_exp_avx512(rr->d, base_w, exp_w, m->d, rr_w,
+                                         mont->n0[0], BN_num_bits(m));
+        OPENSSL_cleanse(base_w, sizeof(base_w));
+        OPENSSL_cleanse(exp_w, sizeof(exp_w));
+        if (copied) {
+            if (ret) {
+                rr->top = top;
+                rr->neg = 0;
+                bn_correct_top(rr);
+            }
+            goto err;
+        }
+    } else if ((16 == a->top) && (16 == p->top) && (BN_num_bits(m) == 1024)
         && rsaz_avx2_eligible()) {
         if (NULL == bn_wexpand(rr, 16))
             goto err;
@@ -1126,6 +1150,90 @@ int BN_mod_exp_mont_consttime(BIGNUM *rr, const BIGNUM *a, const BIGNUM *p,
     return ret;
 }
 
+/*
+ * Two independent constant-time exponentiations, rr1 = a1^p1 mod m1 and
+ * rr2 = a2^p2 mod m2. Where the platform can do both in the same pass, e.g.
+ * the CRT halves of an RSA private key, this is faster than two calls to
+ * BN_mod_exp_mont_consttime(), otherwise it is exactly that.
+ */
+int BN_mod_exp_mont_consttime_x2(BIGNUM *rr1, const BIGNUM *a1,
+                                 const BIGNUM *p1, const BIGNUM *m1,
+                                 BN_MONT_CTX *in_mont1,
+                                 BIGNUM *rr2, const BIGNUM *a2,
+                                 const BIGNUM *p2, const BIGNUM *m2,
+                                 BN_MONT_CTX *in_mont2, BN_CTX *ctx)
+{
+#ifdef RSAZ_ENABLED
+    int modbits = BN_num_bits(m1), top = m1->top;
+
+    /*
+     * Only fully reduced non-negative bases are taken, anything else is
+     * rare enough to go the long way.
+     */
+    if (rsaz_avx512ifma_eligible()
+        && (modbits == 1024 || modbits == 1536)
+        && BN_num_bits(m2) == modbits
+        && BN_is_odd(m1) && BN_is_odd(m2)
+        && p1->top <= top && p2->top <= top
+        && !BN_is_zero(p1) && !BN_is_zero(p2)
+        && !a1->neg && !a2->neg
+        && BN_ucmp(a1, m1) < 0 && BN_ucmp(a2, m2) < 0) {
+        BN_MONT_CTX *mont1 = in_mont1, *mont2 = in_mont2;
+        BN_ULONG base1_w[24], exp1_w[24], rr1_w[24];
+        BN_ULONG base2_w[24], exp2_w[24], rr2_w[24];
+        int ret = 0, fallback = 0;
+
+        if (mont1 == NULL) {
+            if ((mont1 = BN_MONT_CTX_new()) == NULL
+                || !BN_MONT_CTX_set(mont1, m1, ctx))
+                goto err;
+        }
+        if (mont2 == NULL) {
+            if ((mont2 = BN_MONT_CTX_new()) == NULL
+                || !BN_MONT_CTX_set(mont2, m2, ctx))
+                goto err;
+        }
+
+        /* Operands that don't fit are left to the generic code below */
+        fallback = !bn_copy_words(base1_w, a1, top)
+                   || !bn_copy_words(exp1_w, p1, top)
+                   || !bn_copy_words(rr1_w, &mont1->RR, top)
+                   || !bn_copy_words(base2_w, a2, top)
+                   || !bn_copy_words(exp2_w, p2, top)
+                   || !bn_copy_words(rr2_w, &mont2->RR, top);
+        if (!fallback)
+            ret = bn_wexpand(rr1, top) != NULL
+                  && bn_wexpand(rr2, top) != NULL
+                  && RSAZ_mod_exp_avx512_x2(rr1->d, base1_w, exp1_w, m1->d,
+                                            rr1_w, mont1->n0[0],
+                                            rr2->d, base2_w, exp2_w, m2->d,
+                                            rr2_w, mont2->n0[0], modbits);
+        OPENSSL_cleanse(base1_w, sizeof(base1_w));
+        OPENSSL_cleanse(exp1_w, sizeof(exp1_w));
+        OPENSSL_cleanse(base2_w, sizeof(base2_w));
+        OPENSSL_cleanse(exp2_w, sizeof(exp2_w));
+        if (ret) {
+            rr1->top = top;
+            rr1->neg = 0;
+            bn_correct_top(rr1);
+            rr2->top = top;
+            rr2->neg = 0;
+            bn_correct_top(rr2);
+        }
+ err:
+        if (in_mont1 == NULL)
+            BN_MONT_CTX_free(mont1);
+        if (in_mont2 == NULL)
+            BN_MONT_CTX_free(mont2);
+        if (!fallback)
+            return ret;
+    }
+#endif
+
+    return BN_mod_exp_mont_consttime(rr1, a1, p1, m1, ctx, in_mont1)
+           && BN_mod_exp_mont_consttime(rr2, a2, p2, m2, ctx, in_mont2);
+}
+
 int BN_mod_exp_mont_word(BIGNUM *rr, BN_ULONG a, const BIGNUM *p,
                          const BIGNUM *m, BN_CTX *ctx, BN_MONT_CTX *in_mont)
 {
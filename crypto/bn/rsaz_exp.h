@@ -35,6 +35,17 @@ void RSAZ_512_mod_exp(BN_ULONG result[8],
                       const BN_ULONG m_norm[8], BN_ULONG k0,
                       const BN_ULONG RR[8]);
 
+int RSAZ_mod_exp_avx512(BN_ULONG *res, const BN_ULONG *base,
+                        const BN_ULONG *exp, const BN_ULONG *m,
+                        const BN_ULONG *RR, BN_ULONG k0, int modbits);
+int RSAZ_mod_exp_avx512_x2(BN_ULONG *res1, const BN_ULONG *base1,
+                           const BN_ULONG *exp1, const BN_ULONG *m1,
+                           const BN_ULONG *RR1, BN_ULONG k0_1,
+                           BN_ULONG *res2, const BN_ULONG *base2,
+                           const BN_ULONG *exp2, const BN_ULONG *m2,
+                           const BN_ULONG *RR2, BN_ULONG k0_2, int modbits);
+int rsaz_avx512ifma_eligible(void);
+
 # endif
 
 #endif
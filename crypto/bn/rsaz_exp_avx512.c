@@ -0,0 +1,351 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <openssl/opensslconf.h>
+#include <openssl/crypto.h>
+#include "rsaz_exp.h"
+
+#ifndef RSAZ_ENABLED
+NON_EMPTY_TRANSLATION_UNIT
+#else
+# include "internal/constant_time_locl.h"
+# include "bn_lcl.h"
+
+/*
+ * See crypto/bn/asm/rsaz-avx512.pl for further details.
+ */
+void rsaz_amm52x20_x1_256(BN_ULONG *res, const BN_ULONG *a,
+                          const BN_ULONG *b, const BN_ULONG *m, BN_ULONG k0);
+void rsaz_amm52x30_x1_256(BN_ULONG *res, const BN_ULONG *a,
+                          const BN_ULONG *b, const BN_ULONG *m, BN_ULONG k0);
+void rsaz_amm52x40_x1_256(BN_ULONG *res, const BN_ULONG *a,
+                          const BN_ULONG *b, const BN_ULONG *m, BN_ULONG k0);
+
+void rsaz_amm52x20_x2_512(BN_ULONG *res, const BN_ULONG *a,
+                          const BN_ULONG *b, const BN_ULONG *m,
+                          const BN_ULONG k0[2]);
+void rsaz_amm52x32_x2_512(BN_ULONG *res, const BN_ULONG *a,
+                          const BN_ULONG *b, const BN_ULONG *m,
+                          const BN_ULONG k0[2]);
+
+void rsaz_gather52x20_win5(BN_ULONG *out, const BN_ULONG *table, int idx);
+void rsaz_gather52x30_win5(BN_ULONG *out, const BN_ULONG *table, int idx);
+void rsaz_gather52x40_win5(BN_ULONG *out, const BN_ULONG *table, int idx);
+void rsaz_gather52x20_x2_win5(BN_ULONG *out, const BN_ULONG *table,
+                              int idx1, int idx2);
+void rsaz_gather52x32_x2_win5(BN_ULONG *out, const BN_ULONG *table,
+                              int idx1, int idx2);
+
+typedef void (*AMM52)(BN_ULONG *res, const BN_ULONG *a, const BN_ULONG *b,
+                      const BN_ULONG *m, BN_ULONG k0);
+typedef void (*AMM52X2)(BN_ULONG *res, const BN_ULONG *a, const BN_ULONG *b,
+                        const BN_ULONG *m, const BN_ULONG k0[2]);
+typedef void (*GATHER52)(BN_ULONG *out, const BN_ULONG *table, int idx);
+typedef void (*GATHER52X2)(BN_ULONG *out, const BN_ULONG *table,
+                           int idx1, int idx2);
+
+# define DIGIT_SIZE             52
+# define DIGIT_MASK             ((BN_ULONG)0xFFFFFFFFFFFFF)
+# define MAX_DIGITS             40      /* 2048-bit modulus, multiple of 4 */
+# define EXP_WIN_SIZE           5
+# define EXP_WIN_MASK           ((1 << EXP_WIN_SIZE) - 1)
+# define MAX_DIGITS_X2          32      /* 1536-bit modulus, multiple of 4 */
+
+/* Digit |i| of the |j|-th number of a pair in rsaz_amm52xN_x2_512 layout */
+# define X2_DIGIT(i, j)         (((i) / 4) * 8 + (j) * 4 + (i) % 4)
+
+/*
+ * Convert |in_len| 64-bit words to |out_len| 52-bit digits, |out| is zero
+ * padded.
+ */
+static void to_words52(BN_ULONG *out, int out_len,
+                       const BN_ULONG *in, int in_len)
+{
+    int i, w, sh;
+    BN_ULONG v;
+
+    for (i = 0; i < out_len; i++) {
+        w = (DIGIT_SIZE * i) / BN_BITS2;
+        sh = (DIGIT_SIZE * i) % BN_BITS2;
+        v = 0;
+        if (w < in_len)
+            v = in[w] >> sh;
+        if (sh > BN_BITS2 - DIGIT_SIZE && w + 1 < in_len)
+            v |= in[w + 1] << (BN_BITS2 - sh);
+        out[i] = v & DIGIT_MASK;
+    }
+}
+
+/* Convert |in_len| normalized 52-bit digits to |out_len| 64-bit words. */
+static void from_words52(BN_ULONG *out, int out_len,
+                         const BN_ULONG *in, int in_len)
+{
+    int i, w, sh;
+
+    for (i = 0; i < out_len; i++)
+        out[i] = 0;
+    for (i = 0; i < in_len; i++) {
+        w = (DIGIT_SIZE * i) / BN_BITS2;
+        sh = (DIGIT_SIZE * i) % BN_BITS2;
+        if (w < out_len)
+            out[w] |= in[i] << sh;
+        if (sh > BN_BITS2 - DIGIT_SIZE && w + 1 < out_len)
+            out[w + 1] |= in[i] >> (BN_BITS2 - sh);
+    }
+}
+
+/* Bits [|pos|, |pos| + EXP_WIN_SIZE) of the |len|-word exponent |exp|. */
+static int exp_window(const BN_ULONG *exp, int len, int pos)
+{
+    int w = pos / BN_BITS2, sh = pos % BN_BITS2;
+    BN_ULONG v = exp[w] >> sh;
+
+    if (sh > BN_BITS2 - EXP_WIN_SIZE && w + 1 < len)
+        v |= exp[w + 1] << (BN_BITS2 - sh);
+    return (int)(v & EXP_WIN_MASK);
+}
+
+/*
+ * Constant-time modular exponentiation for 1024, 1536 and 2048-bit moduli
+ * using AVX512 IFMA Almost Montgomery Multiplication in radix 2^52.
+ *
+ * |base|, |exp|, |m| and |RR| are |modbits|/64 words long, |base| < |m|,
+ * |RR| is R^2 mod |m| for R = 2^modbits as computed by BN_MONT_CTX_set()
+ * and |k0| is the matching Montgomery constant. Returns 0 if |modbits| is
+ * not supported.
+ */
+int RSAZ_mod_exp_avx512(BN_ULONG *res, const BN_ULONG *base,
+                        const BN_ULONG *exp, const BN_ULONG *m,
+                        const BN_ULONG *RR, BN_ULONG k0, int modbits)
+{
+    /* Buffers are 64-byte aligned and MAX_DIGITS long */
+    BN_ULONG storage[(4 + (1 << EXP_WIN_SIZE)) * MAX_DIGITS + 8];
+    BN_ULONG *m52, *RR52, *acc, *tmp, *table;
+    BN_ULONG tmp64[MAX_DIGITS], borrow, mask;
+    AMM52 amm;
+    GATHER52 gather;
+    int digits, padded, words, pos, i;
+
+    switch (modbits) {
+    case 1024:
+        amm = rsaz_amm52x20_x1_256;
+        gather = rsaz_gather52x20_win5;
+        digits = 20;
+        padded = 20;
+        break;
+    case 1536:
+        amm = rsaz_amm52x30_x1_256;
+        gather = rsaz_gather52x30_win5;
+        digits = 30;
+        padded = 32;
+        break;
+    case 2048:
+        amm = rsaz_amm52x40_x1_256;
+        gather = rsaz_gather52x40_win5;
+        digits = 40;
+        padded = 40;
+        break;
+    default:
+        return 0;
+    }
+    words = modbits / BN_BITS2;
+
+    m52 = storage + ((64 - ((size_t)storage % 64)) % 64) / sizeof(BN_ULONG);
+    RR52 = m52 + MAX_DIGITS;
+    acc = RR52 + MAX_DIGITS;
+    tmp = acc + MAX_DIGITS;
+    table = tmp + MAX_DIGITS;
+
+    to_words52(m52, padded, m, words);
+
+    /*
+     * Derive R'^2 mod m for R' = 2^(52*digits) from R^2 mod m:
+     * AMM(AMM(RR, RR), 2^k) = R^4 * 2^k / R'^2 = R'^2 mod m for
+     * k = 4 * (52 * digits - modbits).
+     */
+    to_words52(tmp, padded, RR, words);
+    amm(RR52, tmp, tmp, m52, k0);
+    pos = 4 * (DIGIT_SIZE * digits - modbits);
+    for (i = 0; i < padded; i++)
+        tmp[i] = 0;
+    tmp[pos / DIGIT_SIZE] = (BN_ULONG)1 << (pos % DIGIT_SIZE);
+    amm(RR52, RR52, tmp, m52, k0);
+
+    /* table[0] = R' mod m, table[i] = base^i * R' mod m */
+    for (i = 0; i < padded; i++)
+        tmp[i] = 0;
+    tmp[0] = 1;
+    amm(table, RR52, tmp, m52, k0);
+    to_words52(tmp, padded, base, words);
+    amm(table + padded, tmp, RR52, m52, k0);
+    for (i = 2; i < (1 << EXP_WIN_SIZE); i++)
+        amm(table + i * padded, table + (i - 1) * padded, table + padded,
+            m52, k0);
+
+    /* Fixed window exponentiation from the top */
+    pos = ((modbits - 1) / EXP_WIN_SIZE) * EXP_WIN_SIZE;
+    gather(acc, table, exp_window(exp, words, pos));
+    while (pos > 0) {
+        pos -= EXP_WIN_SIZE;
+        for (i = 0; i < EXP_WIN_SIZE; i++)
+            amm(acc, acc, acc, m52, k0);
+        gather(tmp, table, exp_window(exp, words, pos));
+        amm(acc, acc, tmp, m52, k0);
+    }
+
+    /* Out of Montgomery domain, the result is in [0, m] */
+    for (i = 0; i < padded; i++)
+        tmp[i] = 0;
+    tmp[0] = 1;
+    amm(acc, acc, tmp, m52, k0);
+    from_words52(res, words, acc, digits);
+
+    /* Subtract m in constant time if res == m */
+    borrow = bn_sub_words(tmp64, res, m, words);
+    mask = borrow - 1;
+    for (i = 0; i < words; i++)
+        res[i] = constant_time_select_64(mask, tmp64[i], res[i]);
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    OPENSSL_cleanse(tmp64, sizeof(tmp64));
+    return 1;
+}
+
+/*
+ * Convert two |in_len|-word numbers to a pair of |digits|-digit ones in the
+ * interleaved layout. |scratch| is 2*|digits| long.
+ */
+static void to_words52_x2(BN_ULONG *out, BN_ULONG *scratch, int digits,
+                          const BN_ULONG *in1, const BN_ULONG *in2,
+                          int in_len)
+{
+    int i;
+
+    to_words52(scratch, digits, in1, in_len);
+    to_words52(scratch + digits, digits, in2, in_len);
+    for (i = 0; i < digits; i++) {
+        out[X2_DIGIT(i, 0)] = scratch[i];
+        out[X2_DIGIT(i, 1)] = scratch[digits + i];
+    }
+}
+
+/* Set both numbers of a pair to 2^|pos| */
+static void set_bit_x2(BN_ULONG *out, int digits, int pos)
+{
+    int i;
+
+    for (i = 0; i < 2 * digits; i++)
+        out[i] = 0;
+    out[X2_DIGIT(pos / DIGIT_SIZE, 0)] = (BN_ULONG)1 << (pos % DIGIT_SIZE);
+    out[X2_DIGIT(pos / DIGIT_SIZE, 1)] = (BN_ULONG)1 << (pos % DIGIT_SIZE);
+}
+
+/*
+ * Two independent exponentiations as above, |res1| = |base1|^|exp1| mod |m1|
+ * and |res2| = |base2|^|exp2| mod |m2|, done in lockstep for moduli of the
+ * same size. Only 1024 and 1536-bit moduli are supported, i.e. CRT halves of
+ * 2048 and 3072-bit RSA keys, otherwise 0 is returned.
+ */
+int RSAZ_mod_exp_avx512_x2(BN_ULONG *res1, const BN_ULONG *base1,
+                           const BN_ULONG *exp1, const BN_ULONG *m1,
+                           const BN_ULONG *RR1, BN_ULONG k0_1,
+                           BN_ULONG *res2, const BN_ULONG *base2,
+                           const BN_ULONG *exp2, const BN_ULONG *m2,
+                           const BN_ULONG *RR2, BN_ULONG k0_2, int modbits)
+{
+    /* Buffers are 64-byte aligned and hold pairs of MAX_DIGITS_X2 digits */
+    BN_ULONG storage[(5 + (1 << EXP_WIN_SIZE)) * 2 * MAX_DIGITS_X2 + 8];
+    BN_ULONG *m52, *RR52, *acc, *tmp, *scratch, *table;
+    BN_ULONG tmp64[MAX_DIGITS_X2], k0[2], borrow, mask;
+    BN_ULONG *res[2];
+    const BN_ULONG *m[2];
+    AMM52X2 amm;
+    GATHER52X2 gather;
+    int digits, words, pos, i, j;
+
+    switch (modbits) {
+    case 1024:
+        amm = rsaz_amm52x20_x2_512;
+        gather = rsaz_gather52x20_x2_win5;
+        digits = 20;
+        break;
+    case 1536:
+        amm = rsaz_amm52x32_x2_512;
+        gather = rsaz_gather52x32_x2_win5;
+        digits = 32;
+        break;
+    default:
+        return 0;
+    }
+    words = modbits / BN_BITS2;
+    k0[0] = k0_1;
+    k0[1] = k0_2;
+    res[0] = res1;
+    res[1] = res2;
+    m[0] = m1;
+    m[1] = m2;
+
+    m52 = storage + ((64 - ((size_t)storage % 64)) % 64) / sizeof(BN_ULONG);
+    RR52 = m52 + 2 * MAX_DIGITS_X2;
+    acc = RR52 + 2 * MAX_DIGITS_X2;
+    tmp = acc + 2 * MAX_DIGITS_X2;
+    scratch = tmp + 2 * MAX_DIGITS_X2;
+    table = scratch + 2 * MAX_DIGITS_X2;
+
+    to_words52_x2(m52, scratch, digits, m1, m2, words);
+
+    /* R'^2 mod m, see RSAZ_mod_exp_avx512() */
+    to_words52_x2(tmp, scratch, digits, RR1, RR2, words);
+    amm(RR52, tmp, tmp, m52, k0);
+    set_bit_x2(tmp, digits, 4 * (DIGIT_SIZE * digits - modbits));
+    amm(RR52, RR52, tmp, m52, k0);
+
+    /* table[0] = R' mod m, table[i] = base^i * R' mod m */
+    set_bit_x2(tmp, digits, 0);
+    amm(table, RR52, tmp, m52, k0);
+    to_words52_x2(tmp, scratch, digits, base1, base2, words);
+    amm(table + 2 * digits, tmp, RR52, m52, k0);
+    for (i = 2; i < (1 << EXP_WIN_SIZE); i++)
+        amm(table + i * 2 * digits, table + (i - 1) * 2 * digits,
+            table + 2 * digits, m52, k0);
+
+    /* Fixed window exponentiation from the top */
+    pos = ((modbits - 1) / EXP_WIN_SIZE) * EXP_WIN_SIZE;
+    gather(acc, table, exp_window(exp1, words, pos),
+           exp_window(exp2, words, pos));
+    while (pos > 0) {
+        pos -= EXP_WIN_SIZE;
+        for (i = 0; i < EXP_WIN_SIZE; i++)
+            amm(acc, acc, acc, m52, k0);
+        gather(tmp, table, exp_window(exp1, words, pos),
+               exp_window(exp2, words, pos));
+        amm(acc, acc, tmp, m52, k0);
+    }
+
+    /* Out of Montgomery domain, the results are in [0, m] */
+    set_bit_x2(tmp, digits, 0);
+    amm(acc, acc, tmp, m52, k0);
+
+    for (j = 0; j < 2; j++) {
+        for (i = 0; i < digits; i++)
+            scratch[i] = acc[X2_DIGIT(i, j)];
+        from_words52(res[j], words, scratch, digits);
+
+        /* Subtract m in constant time if res == m */
+        borrow = bn_sub_words(tmp64, res[j], m[j], words);
+        mask = borrow - 1;
+        for (i = 0; i < words; i++)
+            res[j][i] = constant_time_select_64(mask, tmp64[i], res[j][i]);
+    }
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    OPENSSL_cleanse(tmp64, sizeof(tmp64));
+    return 1;
+}
+#endif
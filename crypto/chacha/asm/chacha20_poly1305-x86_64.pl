@@ -0,0 +1,836 @@
+#! /usr/bin/env perl
+# Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+#
+# ChaCha20-Poly1305 "stitched" AEAD kernel for x86_64.
+#
+# chacha20_poly1305_tls_cipher normally processes a record in two
+# passes, ChaCha20 over the payload and then Poly1305 over the
+# ciphertext. Vector ChaCha20 code leaves integer units idle, while
+# radix 2^64 Poly1305 is a chain of mulq/adc that touches no vector
+# registers, so the two are interleaved instruction by instruction
+# here: Poly1305 hashes 512 bytes of ciphertext while 8xAVX2 ChaCha20
+# computes next 512 bytes of key stream. In addition ciphertext is
+# hashed while it's still in L1.
+#
+#	size_t chacha20_poly1305_encrypt(unsigned char *out,
+#				const unsigned char *inp, size_t len,
+#				const unsigned int key[8],
+#				const unsigned int counter[4],
+#				u64 poly[5]);
+#
+# and same for chacha20_poly1305_decrypt. |poly| is radix 2^64 hash
+# value h[3] followed by clamped key r[2], i.e. same layout as one used
+# by scalar poly1305_blocks, and ciphertext is hashed with pad bit set.
+# Only multiple of 512 bytes is processed, amount of processed data is
+# returned, and it's 0 if processor lacks AVX2. |counter| is not
+# updated.
+#
+# Stitched code is bound by latency of scalar Poly1305, one dependent
+# chain of multiplications per 16-byte block. This is why there is no
+# AVX512 counterpart: 16xAVX512F ChaCha20 widens the vector half only,
+# while AVX512 Poly1305 running back-to-back with it is not bound by
+# that chain. Caller is expected to use this module only on processors
+# with AVX2 but without AVX512F/VL.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$avx = ($1>=2.19) + ($1>=2.22) + ($1>=2.25);
+}
+
+if (!$avx && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	   `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)(?:\.([0-9]+))?/) {
+	$avx = ($1>=2.09) + ($1>=2.10) + ($1>=2.12);
+	$avx += 1 if ($1==2.11 && $2>=8);
+}
+
+if (!$avx && $win64 && ($flavour =~ /masm/ || $ENV{ASM} =~ /ml64/) &&
+	   `ml64 2>&1` =~ /Version ([0-9]+)\./) {
+	$avx = ($1>=10) + ($1>=11);
+}
+
+if (!$avx && `$ENV{CC} -v 2>&1` =~ /((?:^clang|LLVM) version|.*based on LLVM) ([3-9]\.[0-9]+)/) {
+	$avx = ($2>=3.0) + ($2>3.0);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+# input parameter block
+my ($out,$inp,$len,$key,$counter,$poly)=
+   ("%rdi","%rsi","%rdx","%rcx","%r8","%r9");
+# Poly1305 state, %rax and %rdx are multiplication scratch
+my ($h0,$h1,$h2,$r0,$r1,$s1,$d1,$d2,$d3,$hp)=
+   ("%r14","%rbx","%rbp","%r11","%r12","%r13","%r8","%r9","%r10","%r15");
+
+my $frame=0x2a0;	# see stack layout below
+
+$code.=<<___;
+.text
+
+.extern OPENSSL_ia32cap_P
+___
+
+if ($avx>1) {
+$code.=<<___;
+.align	64
+.Lincy:
+.long	0,2,4,6,1,3,5,7
+.Leight:
+.long	8,8,8,8,8,8,8,8
+.Lrot16:
+.byte	0x2,0x3,0x0,0x1, 0x6,0x7,0x4,0x5, 0xa,0xb,0x8,0x9, 0xe,0xf,0xc,0xd
+.Lrot24:
+.byte	0x3,0x0,0x1,0x2, 0x7,0x4,0x5,0x6, 0xb,0x8,0x9,0xa, 0xf,0xc,0xd,0xe
+.Lsigma:
+.asciz	"expand 32-byte k"
+___
+
+sub poly1305_block {	# ($hp) += 16, h = (h + m + 2^128) * r % p
+    grep(/\S/,split("\n",<<___));
+	 add	0($hp),$h0		# accumulate input
+	 adc	8($hp),$h1
+	 lea	16($hp),$hp
+	 adc	\$1,$h2
+	 mov	$r1,%rax
+	 mulq	$h0			# h0*r1
+	 mov	%rax,$d2
+	 mov	$r0,%rax
+	 mov	%rdx,$d3
+	 mulq	$h0			# h0*r0
+	 mov	%rax,$h0
+	 mov	$r0,%rax
+	 mov	%rdx,$d1
+	 mulq	$h1			# h1*r0
+	 add	%rax,$d2
+	 mov	$s1,%rax
+	 adc	%rdx,$d3
+	 mulq	$h1			# h1*s1
+	 mov	$h2,$h1
+	 add	%rax,$h0
+	 adc	%rdx,$d1
+	 imulq	$s1,$h1			# h2*s1
+	 add	$h1,$d2
+	 mov	$d1,$h1
+	 adc	\$0,$d3
+	 imulq	$r0,$h2			# h2*r0
+	 add	$d2,$h1
+	 mov	\$-4,%rax
+	 adc	$h2,$d3
+	 and	$d3,%rax		# last reduction step
+	 mov	$d3,$h2
+	 shr	\$2,$d3
+	 and	\$3,$h2
+	 add	$d3,%rax
+	 add	%rax,$h0
+	 adc	\$0,$h1
+	 adc	\$0,$h2
+___
+}
+
+sub poly1305_nblocks {
+my $n=shift;
+    map(&poly1305_block(),(1..$n));
+}
+
+# Spread integer instructions evenly among vector ones. Flags are
+# produced and consumed by integer instructions only, so that
+# everything but the relative order within each stream is free.
+sub interleave {
+my ($vec,$int)=@_;
+my ($n,$m,$j,$ret)=(scalar(@$vec),scalar(@$int),0,"");
+
+    for (my $i=0; $i<$n; $i++) {
+	$ret.="$$vec[$i]\n";
+	$ret.="$$int[$j++]\n" while ($j<$m && $j*$n<($i+1)*$m);
+    }
+    $ret.="$$int[$j++]\n" while ($j<$m);
+
+    $ret;
+}
+
+########################################################################
+# 8xAVX2, 512 bytes per iteration, 32 Poly1305 blocks, 3 per double
+# round and 2 during transposition.
+#
+################ stack layout
+# +0x00		SIMD equivalent of @x[8-12]
+# ...
+# +0x80		constant copy of key[0-2] smashed by lanes
+# ...
+# +0x200	SIMD counters (with nonce smashed by lanes)
+# ...
+# +0x280	original %rsp
+# +0x288	poly
+# +0x290	remaining length
+# +0x298	return value
+{
+my ($xb0,$xb1,$xb2,$xb3, $xd0,$xd1,$xd2,$xd3,
+    $xa0,$xa1,$xa2,$xa3, $xt0,$xt1,$xt2,$xt3)=map("%ymm$_",(0..15));
+my @xx=($xa0,$xa1,$xa2,$xa3, $xb0,$xb1,$xb2,$xb3,
+	"%nox","%nox","%nox","%nox", $xd0,$xd1,$xd2,$xd3);
+
+sub AVX2_lane_ROUND {
+my ($a0,$b0,$c0,$d0)=@_;
+my ($a1,$b1,$c1,$d1)=map(($_&~3)+(($_+1)&3),($a0,$b0,$c0,$d0));
+my ($a2,$b2,$c2,$d2)=map(($_&~3)+(($_+1)&3),($a1,$b1,$c1,$d1));
+my ($a3,$b3,$c3,$d3)=map(($_&~3)+(($_+1)&3),($a2,$b2,$c2,$d2));
+my ($xc,$xc_,$t0,$t1)=($xt0,$xt1,$xt2,$xt3);
+my @x=@xx;
+
+	# 'a', 'b' and 'd's are permanently allocated in registers,
+	# while 'c's are maintained in memory, see chacha-x86_64.pl
+	# for details.
+
+    grep(/\S/,split("\n",<<___));
+	vpaddd		$x[$b0],$x[$a0],$x[$a0]	# Q1
+	vpxor		$x[$d0],$x[$a0],$x[$d0]
+	vpshufb		$t1,$x[$d0],$x[$d0]
+	vpaddd		$x[$b1],$x[$a1],$x[$a1]	# Q2
+	vpxor		$x[$d1],$x[$a1],$x[$d1]
+	vpshufb		$t1,$x[$d1],$x[$d1]
+
+	vpaddd		$x[$d0],$xc,$xc
+	vpxor		$x[$b0],$xc,$x[$b0]
+	vpslld		\$12,$x[$b0],$t0
+	vpsrld		\$20,$x[$b0],$x[$b0]
+	vpor		$x[$b0],$t0,$x[$b0]
+	vbroadcasti128	.Lrot24(%rip),$t0
+	vpaddd		$x[$d1],$xc_,$xc_
+	vpxor		$x[$b1],$xc_,$x[$b1]
+	vpslld		\$12,$x[$b1],$t1
+	vpsrld		\$20,$x[$b1],$x[$b1]
+	vpor		$x[$b1],$t1,$x[$b1]
+
+	vpaddd		$x[$b0],$x[$a0],$x[$a0]
+	vpxor		$x[$d0],$x[$a0],$x[$d0]
+	vpshufb		$t0,$x[$d0],$x[$d0]
+	vpaddd		$x[$b1],$x[$a1],$x[$a1]
+	vpxor		$x[$d1],$x[$a1],$x[$d1]
+	vpshufb		$t0,$x[$d1],$x[$d1]
+
+	vpaddd		$x[$d0],$xc,$xc
+	vpxor		$x[$b0],$xc,$x[$b0]
+	vpslld		\$7,$x[$b0],$t1
+	vpsrld		\$25,$x[$b0],$x[$b0]
+	vpor		$x[$b0],$t1,$x[$b0]
+	vbroadcasti128	.Lrot16(%rip),$t1
+	vpaddd		$x[$d1],$xc_,$xc_
+	vpxor		$x[$b1],$xc_,$x[$b1]
+	vpslld		\$7,$x[$b1],$t0
+	vpsrld		\$25,$x[$b1],$x[$b1]
+	vpor		$x[$b1],$t0,$x[$b1]
+
+	vmovdqa		$xc,`32*($c0-8)`(%rsp)	# reload pair of 'c's
+	vmovdqa		$xc_,`32*($c1-8)`(%rsp)
+	vmovdqa		`32*($c2-8)`(%rsp),$xc
+	vmovdqa		`32*($c3-8)`(%rsp),$xc_
+
+	vpaddd		$x[$b2],$x[$a2],$x[$a2]	# Q3
+	vpxor		$x[$d2],$x[$a2],$x[$d2]
+	vpshufb		$t1,$x[$d2],$x[$d2]
+	vpaddd		$x[$b3],$x[$a3],$x[$a3]	# Q4
+	vpxor		$x[$d3],$x[$a3],$x[$d3]
+	vpshufb		$t1,$x[$d3],$x[$d3]
+
+	vpaddd		$x[$d2],$xc,$xc
+	vpxor		$x[$b2],$xc,$x[$b2]
+	vpslld		\$12,$x[$b2],$t0
+	vpsrld		\$20,$x[$b2],$x[$b2]
+	vpor		$x[$b2],$t0,$x[$b2]
+	vbroadcasti128	.Lrot24(%rip),$t0
+	vpaddd		$x[$d3],$xc_,$xc_
+	vpxor		$x[$b3],$xc_,$x[$b3]
+	vpslld		\$12,$x[$b3],$t1
+	vpsrld		\$20,$x[$b3],$x[$b3]
+	vpor		$x[$b3],$t1,$x[$b3]
+
+	vpaddd		$x[$b2],$x[$a2],$x[$a2]
+	vpxor		$x[$d2],$x[$a2],$x[$d2]
+	vpshufb		$t0,$x[$d2],$x[$d2]
+	vpaddd		$x[$b3],$x[$a3],$x[$a3]
+	vpxor		$x[$d3],$x[$a3],$x[$d3]
+	vpshufb		$t0,$x[$d3],$x[$d3]
+
+	vpaddd		$x[$d2],$xc,$xc
+	vpxor		$x[$b2],$xc,$x[$b2]
+	vpslld		\$7,$x[$b2],$t1
+	vpsrld		\$25,$x[$b2],$x[$b2]
+	vpor		$x[$b2],$t1,$x[$b2]
+	vbroadcasti128	.Lrot16(%rip),$t1
+	vpaddd		$x[$d3],$xc_,$xc_
+	vpxor		$x[$b3],$xc_,$x[$b3]
+	vpslld		\$7,$x[$b3],$t0
+	vpsrld		\$25,$x[$b3],$x[$b3]
+	vpor		$x[$b3],$t0,$x[$b3]
+___
+}
+
+sub AVX2_setup {
+    <<___;
+	vbroadcasti128	.Lsigma(%rip),$xa3	# key[0]
+	vbroadcasti128	($key),$xb3		# key[1]
+	vbroadcasti128	16($key),$xt3		# key[2]
+	vbroadcasti128	($counter),$xd3		# key[3]
+
+	vpshufd		\$0x00,$xa3,$xa0	# smash key by lanes...
+	vpshufd		\$0x55,$xa3,$xa1
+	vmovdqa		$xa0,0x80(%rsp)		# ... and offload
+	vpshufd		\$0xaa,$xa3,$xa2
+	vmovdqa		$xa1,0xa0(%rsp)
+	vpshufd		\$0xff,$xa3,$xa3
+	vmovdqa		$xa2,0xc0(%rsp)
+	vmovdqa		$xa3,0xe0(%rsp)
+
+	vpshufd		\$0x00,$xb3,$xb0
+	vpshufd		\$0x55,$xb3,$xb1
+	vmovdqa		$xb0,0x100(%rsp)
+	vpshufd		\$0xaa,$xb3,$xb2
+	vmovdqa		$xb1,0x120(%rsp)
+	vpshufd		\$0xff,$xb3,$xb3
+	vmovdqa		$xb2,0x140(%rsp)
+	vmovdqa		$xb3,0x160(%rsp)
+
+	vpshufd		\$0x00,$xt3,$xt0	# "xc0"
+	vpshufd		\$0x55,$xt3,$xt1	# "xc1"
+	vmovdqa		$xt0,0x180(%rsp)
+	vpshufd		\$0xaa,$xt3,$xt2	# "xc2"
+	vmovdqa		$xt1,0x1a0(%rsp)
+	vpshufd		\$0xff,$xt3,$xt3	# "xc3"
+	vmovdqa		$xt2,0x1c0(%rsp)
+	vmovdqa		$xt3,0x1e0(%rsp)
+
+	vpshufd		\$0x00,$xd3,$xd0
+	vpshufd		\$0x55,$xd3,$xd1
+	vpaddd		.Lincy(%rip),$xd0,$xd0
+	vpshufd		\$0xaa,$xd3,$xd2
+	vpsubd		.Leight(%rip),$xd0,$xd0	# pre-bias for 1st iteration
+	vmovdqa		$xd1,0x220(%rsp)
+	vpshufd		\$0xff,$xd3,$xd3
+	vmovdqa		$xd2,0x240(%rsp)
+	vmovdqa		$xd3,0x260(%rsp)
+	vmovdqa		$xd0,0x200(%rsp)
+___
+}
+
+sub AVX2_iteration {
+my ($label,$stitch)=@_;
+my ($xa0,$xa1,$xa2,$xa3,$xb0,$xb1,$xb2,$xb3,
+    $xd0,$xd1,$xd2,$xd3,$xt0,$xt1,$xt2,$xt3)=
+   ($xa0,$xa1,$xa2,$xa3,$xb0,$xb1,$xb2,$xb3,
+    $xd0,$xd1,$xd2,$xd3,$xt0,$xt1,$xt2,$xt3);
+my ($xc0,$xc1,$xc2,$xc3);
+my $ret=<<___;
+	vmovdqa		0x80(%rsp),$xa0		# load smashed key
+	vmovdqa		0xa0(%rsp),$xa1
+	vmovdqa		0xc0(%rsp),$xa2
+	vmovdqa		0xe0(%rsp),$xa3
+	vmovdqa		0x100(%rsp),$xb0
+	vmovdqa		0x120(%rsp),$xb1
+	vmovdqa		0x140(%rsp),$xb2
+	vmovdqa		0x160(%rsp),$xb3
+	vmovdqa		0x180(%rsp),$xt0	# "xc0"
+	vmovdqa		0x1a0(%rsp),$xt1	# "xc1"
+	vmovdqa		0x1c0(%rsp),$xt2	# "xc2"
+	vmovdqa		0x1e0(%rsp),$xt3	# "xc3"
+	vmovdqa		0x200(%rsp),$xd0
+	vmovdqa		0x220(%rsp),$xd1
+	vmovdqa		0x240(%rsp),$xd2
+	vmovdqa		0x260(%rsp),$xd3
+	vpaddd		.Leight(%rip),$xd0,$xd0	# next SIMD counters
+	vmovdqa		$xt2,0x40(%rsp)		# SIMD equivalent of "@x[10]"
+	vmovdqa		$xt3,0x60(%rsp)		# SIMD equivalent of "@x[11]"
+	vbroadcasti128	.Lrot16(%rip),$xt3
+	vmovdqa		$xd0,0x200(%rsp)	# save SIMD counters
+	mov		\$10,%ecx
+	jmp		.Loop_$label
+
+.align	32
+.Loop_$label:
+___
+	$ret.=&interleave([&AVX2_lane_ROUND(0, 4, 8,12),
+			   &AVX2_lane_ROUND(0, 5,10,15)],
+			  [$stitch ? &poly1305_nblocks(3) : ()]);
+	$ret.=<<___;
+	dec		%ecx
+	jnz		.Loop_$label
+
+___
+	my $pre=<<___;
+	vpaddd		0x80(%rsp),$xa0,$xa0	# accumulate key
+	vpaddd		0xa0(%rsp),$xa1,$xa1
+	vpaddd		0xc0(%rsp),$xa2,$xa2
+	vpaddd		0xe0(%rsp),$xa3,$xa3
+
+	vpunpckldq	$xa1,$xa0,$xt2		# "de-interlace" data
+	vpunpckldq	$xa3,$xa2,$xt3
+	vpunpckhdq	$xa1,$xa0,$xa0
+	vpunpckhdq	$xa3,$xa2,$xa2
+	vpunpcklqdq	$xt3,$xt2,$xa1		# "a0"
+	vpunpckhqdq	$xt3,$xt2,$xt2		# "a1"
+	vpunpcklqdq	$xa2,$xa0,$xa3		# "a2"
+	vpunpckhqdq	$xa2,$xa0,$xa0		# "a3"
+___
+	($xa0,$xa1,$xa2,$xa3,$xt2)=($xa1,$xt2,$xa3,$xa0,$xa2);
+	$pre.=<<___;
+	vpaddd		0x100(%rsp),$xb0,$xb0
+	vpaddd		0x120(%rsp),$xb1,$xb1
+	vpaddd		0x140(%rsp),$xb2,$xb2
+	vpaddd		0x160(%rsp),$xb3,$xb3
+
+	vpunpckldq	$xb1,$xb0,$xt2
+	vpunpckldq	$xb3,$xb2,$xt3
+	vpunpckhdq	$xb1,$xb0,$xb0
+	vpunpckhdq	$xb3,$xb2,$xb2
+	vpunpcklqdq	$xt3,$xt2,$xb1		# "b0"
+	vpunpckhqdq	$xt3,$xt2,$xt2		# "b1"
+	vpunpcklqdq	$xb2,$xb0,$xb3		# "b2"
+	vpunpckhqdq	$xb2,$xb0,$xb0		# "b3"
+___
+	($xb0,$xb1,$xb2,$xb3,$xt2)=($xb1,$xt2,$xb3,$xb0,$xb2);
+	$pre.=<<___;
+	vperm2i128	\$0x20,$xb0,$xa0,$xt3	# "de-interlace" further
+	vperm2i128	\$0x31,$xb0,$xa0,$xb0
+	vperm2i128	\$0x20,$xb1,$xa1,$xa0
+	vperm2i128	\$0x31,$xb1,$xa1,$xb1
+	vperm2i128	\$0x20,$xb2,$xa2,$xa1
+	vperm2i128	\$0x31,$xb2,$xa2,$xb2
+	vperm2i128	\$0x20,$xb3,$xa3,$xa2
+	vperm2i128	\$0x31,$xb3,$xa3,$xb3
+___
+	($xa0,$xa1,$xa2,$xa3,$xt3)=($xt3,$xa0,$xa1,$xa2,$xa3);
+	($xc0,$xc1,$xc2,$xc3)=($xt0,$xt1,$xa0,$xa1);
+	$pre.=<<___;
+	vmovdqa		$xa0,0x00(%rsp)		# offload $xaN
+	vmovdqa		$xa1,0x20(%rsp)
+	vmovdqa		0x40(%rsp),$xc2		# $xa0
+	vmovdqa		0x60(%rsp),$xc3		# $xa1
+
+	vpaddd		0x180(%rsp),$xc0,$xc0
+	vpaddd		0x1a0(%rsp),$xc1,$xc1
+	vpaddd		0x1c0(%rsp),$xc2,$xc2
+	vpaddd		0x1e0(%rsp),$xc3,$xc3
+
+	vpunpckldq	$xc1,$xc0,$xt2
+	vpunpckldq	$xc3,$xc2,$xt3
+	vpunpckhdq	$xc1,$xc0,$xc0
+	vpunpckhdq	$xc3,$xc2,$xc2
+	vpunpcklqdq	$xt3,$xt2,$xc1		# "c0"
+	vpunpckhqdq	$xt3,$xt2,$xt2		# "c1"
+	vpunpcklqdq	$xc2,$xc0,$xc3		# "c2"
+	vpunpckhqdq	$xc2,$xc0,$xc0		# "c3"
+___
+	($xc0,$xc1,$xc2,$xc3,$xt2)=($xc1,$xt2,$xc3,$xc0,$xc2);
+	$pre.=<<___;
+	vpaddd		0x200(%rsp),$xd0,$xd0
+	vpaddd		0x220(%rsp),$xd1,$xd1
+	vpaddd		0x240(%rsp),$xd2,$xd2
+	vpaddd		0x260(%rsp),$xd3,$xd3
+
+	vpunpckldq	$xd1,$xd0,$xt2
+	vpunpckldq	$xd3,$xd2,$xt3
+	vpunpckhdq	$xd1,$xd0,$xd0
+	vpunpckhdq	$xd3,$xd2,$xd2
+	vpunpcklqdq	$xt3,$xt2,$xd1		# "d0"
+	vpunpckhqdq	$xt3,$xt2,$xt2		# "d1"
+	vpunpcklqdq	$xd2,$xd0,$xd3		# "d2"
+	vpunpckhqdq	$xd2,$xd0,$xd0		# "d3"
+___
+	($xd0,$xd1,$xd2,$xd3,$xt2)=($xd1,$xt2,$xd3,$xd0,$xd2);
+	$pre.=<<___;
+	vperm2i128	\$0x20,$xd0,$xc0,$xt3	# "de-interlace" further
+	vperm2i128	\$0x31,$xd0,$xc0,$xd0
+	vperm2i128	\$0x20,$xd1,$xc1,$xc0
+	vperm2i128	\$0x31,$xd1,$xc1,$xd1
+	vperm2i128	\$0x20,$xd2,$xc2,$xc1
+	vperm2i128	\$0x31,$xd2,$xc2,$xd2
+	vperm2i128	\$0x20,$xd3,$xc3,$xc2
+	vperm2i128	\$0x31,$xd3,$xc3,$xd3
+___
+	($xc0,$xc1,$xc2,$xc3,$xt3)=($xt3,$xc0,$xc1,$xc2,$xc3);
+	($xb0,$xb1,$xb2,$xb3,$xc0,$xc1,$xc2,$xc3)=
+	($xc0,$xc1,$xc2,$xc3,$xb0,$xb1,$xb2,$xb3);
+	($xa0,$xa1)=($xt2,$xt3);
+	$pre.=<<___;
+	vmovdqa		0x00(%rsp),$xa0		# $xaN was offloaded, remember?
+	vmovdqa		0x20(%rsp),$xa1
+___
+	# all Poly1305 input is loaded before first store, which is
+	# essential for in-place decryption
+	$ret.=&interleave([grep(/\S/,split("\n",$pre))],
+			  [$stitch ? &poly1305_nblocks(2) : ()]);
+	$ret.=<<___;
+
+	vpxor		0x00($inp),$xa0,$xa0	# xor with input
+	vpxor		0x20($inp),$xb0,$xb0
+	vpxor		0x40($inp),$xc0,$xc0
+	vpxor		0x60($inp),$xd0,$xd0
+	vmovdqu		$xa0,0x00($out)
+	vmovdqu		$xb0,0x20($out)
+	vmovdqu		$xc0,0x40($out)
+	vmovdqu		$xd0,0x60($out)
+
+	vpxor		0x80($inp),$xa1,$xa1
+	vpxor		0xa0($inp),$xb1,$xb1
+	vpxor		0xc0($inp),$xc1,$xc1
+	vpxor		0xe0($inp),$xd1,$xd1
+	vmovdqu		$xa1,0x80($out)
+	vmovdqu		$xb1,0xa0($out)
+	vmovdqu		$xc1,0xc0($out)
+	vmovdqu		$xd1,0xe0($out)
+
+	vpxor		0x100($inp),$xa2,$xa2
+	vpxor		0x120($inp),$xb2,$xb2
+	vpxor		0x140($inp),$xc2,$xc2
+	vpxor		0x160($inp),$xd2,$xd2
+	vmovdqu		$xa2,0x100($out)
+	vmovdqu		$xb2,0x120($out)
+	vmovdqu		$xc2,0x140($out)
+	vmovdqu		$xd2,0x160($out)
+
+	vpxor		0x180($inp),$xa3,$xa3
+	vpxor		0x1a0($inp),$xb3,$xb3
+	vpxor		0x1c0($inp),$xc3,$xc3
+	vpxor		0x1e0($inp),$xd3,$xd3
+	lea		0x200($inp),$inp
+	vmovdqu		$xa3,0x180($out)
+	vmovdqu		$xb3,0x1a0($out)
+	vmovdqu		$xc3,0x1c0($out)
+	vmovdqu		$xd3,0x1e0($out)
+	lea		0x200($out),$out
+___
+	$ret;
+}
+}
+
+########################################################################
+# Encryption hashes ciphertext one iteration behind, as it's produced
+# at the very end of iteration, and final chunk is hashed separately.
+# Decryption hashes input of current iteration.
+foreach my $dir ("enc","dec") {
+my $func = $dir eq "enc" ? "chacha20_poly1305_encrypt"
+			 : "chacha20_poly1305_decrypt";
+
+$code.=<<___;
+.globl	$func
+.type	$func,\@function,6
+.align	32
+$func:
+.cfi_startproc
+	xor		%eax,%eax
+	mov		OPENSSL_ia32cap_P+8(%rip),%r10d
+	and		\$-512,$len		# whole iterations only
+	jz		.L${dir}_abort
+	test		\$`1<<5`,%r10d		# check for AVX2
+	jz		.L${dir}_abort
+
+	mov		%rsp,%rax
+.cfi_def_cfa_register	%rax
+	push		%rbx
+.cfi_push	%rbx
+	push		%rbp
+.cfi_push	%rbp
+	push		%r12
+.cfi_push	%r12
+	push		%r13
+.cfi_push	%r13
+	push		%r14
+.cfi_push	%r14
+	push		%r15
+.cfi_push	%r15
+___
+$code.=<<___	if ($win64);
+	lea		-0xa8(%rsp),%rsp
+	movaps		%xmm6,0x00(%rsp)
+	movaps		%xmm7,0x10(%rsp)
+	movaps		%xmm8,0x20(%rsp)
+	movaps		%xmm9,0x30(%rsp)
+	movaps		%xmm10,0x40(%rsp)
+	movaps		%xmm11,0x50(%rsp)
+	movaps		%xmm12,0x60(%rsp)
+	movaps		%xmm13,0x70(%rsp)
+	movaps		%xmm14,0x80(%rsp)
+	movaps		%xmm15,0x90(%rsp)
+___
+$code.=<<___;
+	sub		\$$frame,%rsp
+	and		\$-64,%rsp
+	mov		%rax,0x280(%rsp)
+.cfi_cfa_expression	%rsp+0x280,deref,+8
+.L${dir}_body:
+	mov		$poly,0x288(%rsp)
+	mov		$len,0x290(%rsp)
+	mov		$len,0x298(%rsp)
+	vzeroupper
+___
+$code.=&AVX2_setup();
+$code.=<<___;
+	mov		24($poly),$r0		# load r
+	mov		32($poly),$s1
+	mov		0($poly),$h0		# load hash value
+	mov		8($poly),$h1
+	mov		16($poly),$h2
+	mov		$s1,$r1
+	shr		\$2,$s1
+	add		$r1,$s1			# s1 = r1 + (r1 >> 2)
+___
+if ($dir eq "enc") {
+$code.=<<___;
+	mov		$out,$hp
+___
+$code.=&AVX2_iteration("enc8x_first",0);
+$code.=<<___;
+	subq		\$512,0x290(%rsp)
+	jz		.Lenc8x_last
+
+.align	32
+.Loop_outer_enc8x:
+___
+$code.=&AVX2_iteration("enc8x",1);
+$code.=<<___;
+	subq		\$512,0x290(%rsp)
+	jnz		.Loop_outer_enc8x
+
+.Lenc8x_last:
+	mov		\$32,%ecx
+	jmp		.Loop_enc_tail
+___
+} else {
+$code.=<<___;
+	mov		$inp,$hp
+	jmp		.Loop_outer_dec8x
+
+.align	32
+.Loop_outer_dec8x:
+___
+$code.=&AVX2_iteration("dec8x",1);
+$code.=<<___;
+	subq		\$512,0x290(%rsp)
+	jnz		.Loop_outer_dec8x
+	jmp		.L${dir}_done
+___
+}
+
+if ($dir eq "enc") {
+$code.=<<___;
+
+.align	32
+.Loop_enc_tail:				# hash last iteration's output
+___
+$code.=join("\n",&poly1305_block())."\n";
+$code.=<<___;
+	dec		%ecx
+	jnz		.Loop_enc_tail
+___
+}
+
+$code.=<<___;
+
+.L${dir}_done:
+	mov		0x288(%rsp),$poly
+	mov		0x280(%rsp),%rsi
+.cfi_def_cfa	%rsi,8
+	mov		$h0,0($poly)		# store hash value
+	mov		$h1,8($poly)
+	mov		$h2,16($poly)
+	mov		0x298(%rsp),%rax
+	vzeroupper
+___
+$code.=<<___	if ($win64);
+	movaps		-0xd8(%rsi),%xmm6
+	movaps		-0xc8(%rsi),%xmm7
+	movaps		-0xb8(%rsi),%xmm8
+	movaps		-0xa8(%rsi),%xmm9
+	movaps		-0x98(%rsi),%xmm10
+	movaps		-0x88(%rsi),%xmm11
+	movaps		-0x78(%rsi),%xmm12
+	movaps		-0x68(%rsi),%xmm13
+	movaps		-0x58(%rsi),%xmm14
+	movaps		-0x48(%rsi),%xmm15
+___
+$code.=<<___;
+	mov		-48(%rsi),%r15
+.cfi_restore	%r15
+	mov		-40(%rsi),%r14
+.cfi_restore	%r14
+	mov		-32(%rsi),%r13
+.cfi_restore	%r13
+	mov		-24(%rsi),%r12
+.cfi_restore	%r12
+	mov		-16(%rsi),%rbp
+.cfi_restore	%rbp
+	mov		-8(%rsi),%rbx
+.cfi_restore	%rbx
+	lea		(%rsi),%rsp
+.cfi_def_cfa_register	%rsp
+.L${dir}_epilogue:
+.L${dir}_abort:
+	ret
+.cfi_endproc
+.size	$func,.-$func
+___
+}
+} else {
+# Assembler is too old for AVX2, let C fall back to two-pass code.
+$code.=<<___;
+.globl	chacha20_poly1305_encrypt
+.type	chacha20_poly1305_encrypt,\@abi-omnipotent
+chacha20_poly1305_encrypt:
+.globl	chacha20_poly1305_decrypt
+.type	chacha20_poly1305_decrypt,\@abi-omnipotent
+chacha20_poly1305_decrypt:
+	xor	%eax,%eax
+	ret
+.size	chacha20_poly1305_encrypt,.-chacha20_poly1305_encrypt
+___
+}
+
+# EXCEPTION_DISPOSITION handler (EXCEPTION_RECORD *rec,ULONG64 frame,
+#		CONTEXT *context,DISPATCHER_CONTEXT *disp)
+if ($win64 && $avx>1) {
+$rec="%rcx";
+$frame="%rdx";
+$context="%r8";
+$disp="%r9";
+
+$code.=<<___;
+.extern	__imp_RtlVirtualUnwind
+.type	se_handler,\@abi-omnipotent
+.align	16
+se_handler:
+	push	%rsi
+	push	%rdi
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	pushfq
+	sub	\$64,%rsp
+
+	mov	120($context),%rax	# pull context->Rax
+	mov	248($context),%rbx	# pull context->Rip
+
+	mov	8($disp),%rsi		# disp->ImageBase
+	mov	56($disp),%r11		# disp->HandlerData
+
+	mov	0(%r11),%r10d		# HandlerData[0]
+	lea	(%rsi,%r10),%r10	# prologue label
+	cmp	%r10,%rbx		# context->Rip<prologue label
+	jb	.Lcommon_seh_tail
+
+	mov	152($context),%rax	# pull context->Rsp
+
+	mov	4(%r11),%r10d		# HandlerData[1]
+	lea	(%rsi,%r10),%r10	# epilogue label
+	cmp	%r10,%rbx		# context->Rip>=epilogue label
+	jae	.Lcommon_seh_tail
+
+	mov	0x280(%rax),%rax	# pull saved stack pointer
+
+	mov	-8(%rax),%rbx
+	mov	-16(%rax),%rbp
+	mov	-24(%rax),%r12
+	mov	-32(%rax),%r13
+	mov	-40(%rax),%r14
+	mov	-48(%rax),%r15
+	mov	%rbx,144($context)	# restore context->Rbx
+	mov	%rbp,160($context)	# restore context->Rbp
+	mov	%r12,216($context)	# restore context->R12
+	mov	%r13,224($context)	# restore context->R13
+	mov	%r14,232($context)	# restore context->R14
+	mov	%r15,240($context)	# restore context->R15
+
+	lea	-0xd8(%rax),%rsi
+	lea	512($context),%rdi	# &context.Xmm6
+	mov	\$20,%ecx
+	.long	0xa548f3fc		# cld; rep movsq
+
+.Lcommon_seh_tail:
+	mov	8(%rax),%rdi
+	mov	16(%rax),%rsi
+	mov	%rax,152($context)	# restore context->Rsp
+	mov	%rsi,168($context)	# restore context->Rsi
+	mov	%rdi,176($context)	# restore context->Rdi
+
+	mov	40($disp),%rdi		# disp->ContextRecord
+	mov	$context,%rsi		# context
+	mov	\$154,%ecx		# sizeof(CONTEXT)
+	.long	0xa548f3fc		# cld; rep movsq
+
+	mov	$disp,%rsi
+	xor	%rcx,%rcx		# arg1, UNW_FLAG_NHANDLER
+	mov	8(%rsi),%rdx		# arg2, disp->ImageBase
+	mov	0(%rsi),%r8		# arg3, disp->ControlPc
+	mov	16(%rsi),%r9		# arg4, disp->FunctionEntry
+	mov	40(%rsi),%r10		# disp->ContextRecord
+	lea	56(%rsi),%r11		# &disp->HandlerData
+	lea	24(%rsi),%r12		# &disp->EstablisherFrame
+	mov	%r10,32(%rsp)		# arg5
+	mov	%r11,40(%rsp)		# arg6
+	mov	%r12,48(%rsp)		# arg7
+	mov	%rcx,56(%rsp)		# arg8, (NULL)
+	call	*__imp_RtlVirtualUnwind(%rip)
+
+	mov	\$1,%eax		# ExceptionContinueSearch
+	add	\$64,%rsp
+	popfq
+	pop	%r15
+	pop	%r14
+	pop	%r13
+	pop	%r12
+	pop	%rbp
+	pop	%rbx
+	pop	%rdi
+	pop	%rsi
+	ret
+.size	se_handler,.-se_handler
+
+.section	.pdata
+.align	4
+	.rva	.LSEH_begin_chacha20_poly1305_encrypt
+	.rva	.LSEH_end_chacha20_poly1305_encrypt
+	.rva	.LSEH_info_chacha20_poly1305_encrypt
+
+	.rva	.LSEH_begin_chacha20_poly1305_decrypt
+	.rva	.LSEH_end_chacha20_poly1305_decrypt
+	.rva	.LSEH_info_chacha20_poly1305_decrypt
+
+.section	.xdata
+.align	8
+.LSEH_info_chacha20_poly1305_encrypt:
+	.byte	9,0,0,0
+	.rva	se_handler
+	.rva	.Lenc_body,.Lenc_epilogue		# HandlerData[]
+
+.LSEH_info_chacha20_poly1305_decrypt:
+	.byte	9,0,0,0
+	.rva	se_handler
+	.rva	.Ldec_body,.Ldec_epilogue		# HandlerData[]
+___
+}
+
+foreach (split("\n",$code)) {
+	s/\`([^\`]*)\`/eval $1/ge;
+
+	print $_,"\n";
+}
+
+close STDOUT or die "error closing STDOUT: $!";
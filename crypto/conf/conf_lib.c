@@ -408,6 +408,12 @@ int OPENSSL_INIT_set_config_appname(OPENSSL_INIT_SETTINGS *settings,
 }
 #endif
 
+void OPENSSL_INIT_set_thread_pool_size(OPENSSL_INIT_SETTINGS *settings,
+                                       unsigned int threads)
+{
+    settings->pool_threads = threads;
+}
+
 void OPENSSL_INIT_free(OPENSSL_INIT_SETTINGS *settings)
 {
     free(settings->filename);
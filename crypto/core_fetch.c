@@ -100,3 +100,30 @@ void *ossl_method_construct(OPENSSL_CTX *libctx, int operation_id,
  fin:
     return method;
 }
+
+/*
+ * Without atomics there is nothing that makes use of the generation, so it
+ * simply never changes.
+ */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+static unsigned int method_generation = 0;
+
+unsigned int ossl_method_generation(void)
+{
+    return __atomic_load_n(&method_generation, __ATOMIC_ACQUIRE);
+}
+
+void ossl_method_generation_bump(void)
+{
+    __atomic_add_fetch(&method_generation, 1, __ATOMIC_RELEASE);
+}
+#else
+unsigned int ossl_method_generation(void)
+{
+    return 0;
+}
+
+void ossl_method_generation_bump(void)
+{
+}
+#endif
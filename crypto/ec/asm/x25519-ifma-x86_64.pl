@@ -0,0 +1,534 @@
+#!/usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+#
+# X25519 Montgomery ladder for eight independent scalar multiplications
+# at once, for processors with AVX512 IFMA extension.
+#
+# Field elements are kept in radix 2^51, and each of the five limbs of
+# eight unrelated elements occupies one %zmm register, i.e. one ladder
+# per 64-bit lane. vpmadd52luq and vpmadd52huq return the lower and the
+# upper 52 bits of 52x52-bit products, the latter therefore have to be
+# doubled to land on 2^51 boundary. Limbs are kept below 2^52, which is
+# what IFMA instructions take, by single carry propagation pass after
+# every operation. Squaring computes each cross product once and doubles
+# the sum, which trades ten multiplications for additions that are
+# executed on another port.
+#
+# The ladder does not invert the result, but returns projective X:Z
+# pair for every lane, so that the caller can share the inversion among
+# all of them.
+#
+# Only %zmm0-%zmm5 and %zmm16-%zmm31 are used, so that no vector
+# registers have to be preserved on Win64.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$ifma = ($1>=2.26);
+}
+
+if (!$ifma && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	   `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)/) {
+	$ifma = ($1>=2.13);
+}
+
+if (!$ifma && `$ENV{CC} -v 2>&1` =~ /((?:^clang|LLVM) version|.*based on LLVM) ([0-9]+)\.([0-9]+)/) {
+	$ifma = ($2>=7);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+if ($ifma) {{{
+# Stack frame: seven field elements, 5 limbs by 8 lanes each.
+my $FE=5*64;
+my ($X1,$X2,$Z2,$X3,$Z3,$T0,$T1)=map($_*$FE,(0..6));
+my $FRAME=7*$FE;
+
+my ($rp,$bits,$up,$pos)=("%rdi","%rsi","%rdx","%rax");
+my @L=map("%zmm$_",(16..24));		# lower halves of products
+my @H=(map("%zmm$_",(25..31)),"%zmm0","%zmm1");	# upper halves
+my ($A,$A1)=("%zmm2","%zmm3");
+my @T=("%zmm4","%zmm5",@H[0..2]);
+
+# Limbs of @R modulo 2^51, carries to next limb, the top one times 19 to
+# the bottom. Input limbs must be below 2^62, output ones are below 2^52.
+sub carry {
+my @R=@_;
+
+    for (my $i=0; $i<5; $i++) {
+$code.=<<___;
+	vpsrlq		\$51,$R[$i],$T[$i]
+	vpandq		.Lmask51(%rip),$R[$i],$R[$i]
+___
+    }
+    for (my $i=0; $i<4; $i++) {
+$code.=<<___;
+	vpaddq		$T[$i],$R[$i+1],$R[$i+1]
+___
+    }
+$code.=<<___;
+	vpmadd52luq	.L19(%rip),$T[4],$R[0]
+___
+}
+
+sub store {
+my ($dst,@R)=@_;
+
+    for (my $i=0; $i<5; $i++) {
+$code.=<<___;
+	vmovdqa64	$R[$i],$dst+64*$i(%rsp)
+___
+    }
+}
+
+sub fe_add {
+my ($dst,$a,$b)=@_;
+my @R=@L[0..4];
+
+    for (my $i=0; $i<5; $i++) {
+$code.=<<___;
+	vmovdqa64	$a+64*$i(%rsp),$R[$i]
+	vpaddq		$b+64*$i(%rsp),$R[$i],$R[$i]
+___
+    }
+    &carry(@R);
+    &store($dst,@R);
+}
+
+# a - b + 4*p, limbs of 4*p are no smaller than 2^52 > b
+sub fe_sub {
+my ($dst,$a,$b)=@_;
+my @R=@L[0..4];
+
+    for (my $i=0; $i<5; $i++) {
+$code.=<<___;
+	vmovdqa64	$a+64*$i(%rsp),$R[$i]
+	vpaddq		.L4p`$i?"":"0"`(%rip),$R[$i],$R[$i]
+	vpsubq		$b+64*$i(%rsp),$R[$i],$R[$i]
+___
+    }
+    &carry(@R);
+    &store($dst,@R);
+}
+
+# Column k of the product is @L[k] + 2*@H[k-1]. Columns 5..9 are
+# multiplied by 19, since 2^255 = 19 mod p, and added to columns 0..4.
+# Each column is below 15*2^52, so that the sum is below 2^61.
+sub reduce {
+    for (my $k=1; $k<9; $k++) {
+$code.=<<___;
+	vpaddq		$H[$k-1],$L[$k],$L[$k]
+	vpaddq		$H[$k-1],$L[$k],$L[$k]
+___
+    }
+$code.=<<___;
+	vpaddq		$H[8],$H[8],$H[8]
+___
+    my @C=(@L[5..8],$H[8]);
+    for (my $k=0; $k<5; $k++) {
+$code.=<<___;
+	vpsllq		\$4,$C[$k],$T[0]
+	vpaddq		$C[$k],$C[$k],$T[1]
+	vpaddq		$C[$k],$L[$k],$L[$k]
+	vpaddq		$T[0],$L[$k],$L[$k]
+	vpaddq		$T[1],$L[$k],$L[$k]
+___
+    }
+}
+
+sub fe_mul {
+my ($dst,$a,$b)=@_;
+
+    foreach (@L,@H) {
+$code.=<<___;
+	vpxord		$_,$_,$_
+___
+    }
+    for (my $i=0; $i<5; $i++) {
+	my $Ai = $i&1 ? $A1 : $A;
+$code.=<<___;
+	vmovdqa64	$a+64*$i(%rsp),$Ai
+___
+	for (my $j=0; $j<5; $j++) {
+$code.=<<___;
+	vpmadd52luq	$b+64*$j(%rsp),$Ai,$L[$i+$j]
+	vpmadd52huq	$b+64*$j(%rsp),$Ai,$H[$i+$j]
+___
+	}
+    }
+    &reduce();
+    &carry(@L[0..4]);
+    &store($dst,@L[0..4]);
+}
+
+sub fe_sqr {
+my ($dst,$a)=@_;
+
+    foreach (@L,@H) {
+$code.=<<___;
+	vpxord		$_,$_,$_
+___
+    }
+    # cross products a[i]*a[j], i<j
+    for (my $i=0; $i<4; $i++) {
+	my $Ai = $i&1 ? $A1 : $A;
+$code.=<<___;
+	vmovdqa64	$a+64*$i(%rsp),$Ai
+___
+	for (my $j=$i+1; $j<5; $j++) {
+$code.=<<___;
+	vpmadd52luq	$a+64*$j(%rsp),$Ai,$L[$i+$j]
+	vpmadd52huq	$a+64*$j(%rsp),$Ai,$H[$i+$j]
+___
+	}
+    }
+    for (my $k=1; $k<8; $k++) {
+$code.=<<___;
+	vpaddq		$L[$k],$L[$k],$L[$k]
+	vpaddq		$H[$k],$H[$k],$H[$k]
+___
+    }
+    # squares a[i]*a[i]
+    for (my $i=0; $i<5; $i++) {
+	my $Ai = $i&1 ? $A1 : $A;
+$code.=<<___;
+	vmovdqa64	$a+64*$i(%rsp),$Ai
+	vpmadd52luq	$Ai,$Ai,$L[2*$i]
+	vpmadd52huq	$Ai,$Ai,$H[2*$i]
+___
+    }
+    &reduce();
+    &carry(@L[0..4]);
+    &store($dst,@L[0..4]);
+}
+
+sub fe_mul121666 {
+my ($dst,$a)=@_;
+
+    foreach (@L[0..4],@H[0..4]) {
+$code.=<<___;
+	vpxord		$_,$_,$_
+___
+    }
+    for (my $i=0; $i<5; $i++) {
+$code.=<<___;
+	vmovdqa64	$a+64*$i(%rsp),$A
+	vpmadd52luq	.L121666(%rip),$A,$L[$i]
+	vpmadd52huq	.L121666(%rip),$A,$H[$i]
+___
+    }
+    for (my $k=1; $k<5; $k++) {
+$code.=<<___;
+	vpaddq		$H[$k-1],$L[$k],$L[$k]
+	vpaddq		$H[$k-1],$L[$k],$L[$k]
+___
+    }
+$code.=<<___;
+	vpaddq		$H[4],$H[4],$H[4]
+	vpmadd52luq	.L19(%rip),$H[4],$L[0]
+___
+    &carry(@L[0..4]);
+    &store($dst,@L[0..4]);
+}
+
+# Conditional swap of lanes selected by %k3
+sub fe_cswap {
+my ($a,$b)=@_;
+
+    for (my $i=0; $i<5; $i++) {
+$code.=<<___;
+	vmovdqa64	$a+64*$i(%rsp),$L[$i]
+	vmovdqa64	$b+64*$i(%rsp),$H[$i]
+	vmovdqa64	$H[$i],$a+64*$i(%rsp){%k3}
+	vmovdqa64	$L[$i],$b+64*$i(%rsp){%k3}
+___
+    }
+}
+
+$code.=<<___;
+.text
+
+.extern	OPENSSL_ia32cap_P
+.globl	x25519_ifma_eligible
+.type	x25519_ifma_eligible,\@abi-omnipotent
+.align	32
+x25519_ifma_eligible:
+	mov	OPENSSL_ia32cap_P+8(%rip),%ecx
+	xor	%eax,%eax
+	and	\$`1<<21|1<<16`,%ecx	# AVX512IFMA, AVX512F
+	cmp	\$`1<<21|1<<16`,%ecx
+	sete	%al
+	ret
+.size	x25519_ifma_eligible,.-x25519_ifma_eligible
+
+###############################################################################
+# void x25519_scalar_mulx8_ifma(uint64_t xz[2][5][8],
+#                               const uint8_t bits[255],
+#                               const uint64_t u[5][8]);
+#
+# Eight X25519 ladders, lane j starting from point with u-coordinate
+# u[0..4][j] in radix 2^51. bits[i] holds bit i of the eight clamped
+# scalars, bit j of the byte for lane j. Projective result for lane j
+# is returned in xz[0][0..4][j] and xz[1][0..4][j], limbs are below 2^52.
+#
+.globl	x25519_scalar_mulx8_ifma
+.type	x25519_scalar_mulx8_ifma,\@function,3
+.align	32
+x25519_scalar_mulx8_ifma:
+.cfi_startproc
+	push	%rbp
+.cfi_push	%rbp
+	mov	%rsp,%rbp
+.cfi_def_cfa_register	%rbp
+	sub	\$$FRAME,%rsp
+	and	\$-64,%rsp
+.Lmulx8_body:
+	vpxord		$L[1],$L[1],$L[1]
+	vmovdqa64	.Lone(%rip),$L[0]
+___
+for (my $i=0; $i<5; $i++) {
+my $one = $i ? $L[1] : $L[0];
+$code.=<<___;
+	vmovdqu64	64*$i($up),$A
+	vmovdqa64	$A,$X1+64*$i(%rsp)
+	vmovdqa64	$A,$X3+64*$i(%rsp)
+	vmovdqa64	$one,$X2+64*$i(%rsp)
+	vmovdqa64	$one,$Z3+64*$i(%rsp)
+	vmovdqa64	$L[1],$Z2+64*$i(%rsp)
+___
+}
+$code.=<<___;
+	kxorw	%k2,%k2,%k2		# swap
+	mov	\$254,$pos
+	jmp	.Lmulx8_loop
+
+.align	32
+.Lmulx8_loop:
+	movzb	($bits,$pos),%ecx
+	kmovw	%ecx,%k1
+	kxorw	%k1,%k2,%k3
+	kmovw	%k1,%k2
+___
+	&fe_cswap($X2,$X3);
+	&fe_cswap($Z2,$Z3);
+	&fe_sub($T0,$X3,$Z3);
+	&fe_sub($T1,$X2,$Z2);
+	&fe_add($X2,$X2,$Z2);
+	&fe_add($Z2,$X3,$Z3);
+	&fe_mul($Z3,$T0,$X2);
+	&fe_mul($Z2,$Z2,$T1);
+	&fe_sqr($T0,$T1);
+	&fe_sqr($T1,$X2);
+	&fe_add($X3,$Z3,$Z2);
+	&fe_sub($Z2,$Z3,$Z2);
+	&fe_mul($X2,$T1,$T0);
+	&fe_sub($T1,$T1,$T0);
+	&fe_sqr($Z2,$Z2);
+	&fe_mul121666($Z3,$T1);
+	&fe_sqr($X3,$X3);
+	&fe_add($T0,$T0,$Z3);
+	&fe_mul($Z3,$X1,$Z2);
+	&fe_mul($Z2,$T1,$T0);
+$code.=<<___;
+	sub	\$1,$pos
+	jnc	.Lmulx8_loop
+
+___
+for (my $i=0; $i<5; $i++) {
+$code.=<<___;
+	vmovdqa64	$X2+64*$i(%rsp),$A
+	vmovdqa64	$Z2+64*$i(%rsp),$A1
+	vmovdqu64	$A,64*$i($rp)
+	vmovdqu64	$A1,$FE+64*$i($rp)
+___
+}
+# Wipe the stack frame, it holds intermediate results of secret scalars
+$code.=<<___;
+	vpxord		$A,$A,$A
+	mov	\$`$FRAME/64`,%ecx
+	mov	%rsp,%rax
+.Lmulx8_wipe:
+	vmovdqa64	$A,(%rax)
+	lea	64(%rax),%rax
+	dec	%ecx
+	jnz	.Lmulx8_wipe
+___
+foreach (@L,@H,$A1) {
+$code.=<<___;
+	vpxord		$_,$_,$_
+___
+}
+$code.=<<___;
+	kxorw	%k1,%k1,%k1
+	kxorw	%k2,%k2,%k2
+	kxorw	%k3,%k3,%k3
+	vzeroupper
+
+	mov	%rbp,%rsp
+.cfi_def_cfa_register	%rsp
+	pop	%rbp
+.cfi_pop	%rbp
+.Lmulx8_epilogue:
+	ret
+.cfi_endproc
+.size	x25519_scalar_mulx8_ifma,.-x25519_scalar_mulx8_ifma
+
+.align	64
+.Lmask51:
+	.quad	0x7ffffffffffff,0x7ffffffffffff,0x7ffffffffffff,0x7ffffffffffff
+	.quad	0x7ffffffffffff,0x7ffffffffffff,0x7ffffffffffff,0x7ffffffffffff
+.L4p0:
+	.quad	0x1fffffffffffb4,0x1fffffffffffb4,0x1fffffffffffb4,0x1fffffffffffb4
+	.quad	0x1fffffffffffb4,0x1fffffffffffb4,0x1fffffffffffb4,0x1fffffffffffb4
+.L4p:
+	.quad	0x1ffffffffffffc,0x1ffffffffffffc,0x1ffffffffffffc,0x1ffffffffffffc
+	.quad	0x1ffffffffffffc,0x1ffffffffffffc,0x1ffffffffffffc,0x1ffffffffffffc
+.L19:
+	.quad	19,19,19,19,19,19,19,19
+.L121666:
+	.quad	121666,121666,121666,121666,121666,121666,121666,121666
+.Lone:
+	.quad	1,1,1,1,1,1,1,1
+.asciz	"X25519 8-way ladder for AVX512 IFMA"
+___
+
+# EXCEPTION_DISPOSITION handler (EXCEPTION_RECORD *rec,ULONG64 frame,
+#		CONTEXT *context,DISPATCHER_CONTEXT *disp)
+if ($win64) {
+$rec="%rcx";
+$frame="%rdx";
+$context="%r8";
+$disp="%r9";
+
+$code.=<<___;
+.extern	__imp_RtlVirtualUnwind
+.type	mulx8_se_handler,\@abi-omnipotent
+.align	16
+mulx8_se_handler:
+	push	%rsi
+	push	%rdi
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	pushfq
+	sub	\$64,%rsp
+
+	mov	120($context),%rax	# pull context->Rax
+	mov	248($context),%rbx	# pull context->Rip
+
+	mov	8($disp),%rsi		# disp->ImageBase
+	mov	56($disp),%r11		# disp->HandlerData
+
+	mov	0(%r11),%r10d		# HandlerData[0]
+	lea	(%rsi,%r10),%r10	# end of prologue label
+	cmp	%r10,%rbx		# context->Rip<end of prologue label
+	jb	.Lcommon_seh_tail
+
+	mov	152($context),%rax	# pull context->Rsp
+
+	mov	4(%r11),%r10d		# HandlerData[1]
+	lea	(%rsi,%r10),%r10	# epilogue label
+	cmp	%r10,%rbx		# context->Rip>=epilogue label
+	jae	.Lcommon_seh_tail
+
+	mov	160($context),%rax	# pull context->Rbp
+	mov	(%rax),%rbp
+	lea	8(%rax),%rax
+	mov	%rbp,160($context)	# restore context->Rbp
+
+.Lcommon_seh_tail:
+	mov	8(%rax),%rdi
+	mov	16(%rax),%rsi
+	mov	%rax,152($context)	# restore context->Rsp
+	mov	%rsi,168($context)	# restore context->Rsi
+	mov	%rdi,176($context)	# restore context->Rdi
+
+	mov	40($disp),%rdi		# disp->ContextRecord
+	mov	$context,%rsi		# context
+	mov	\$154,%ecx		# sizeof(CONTEXT)
+	.long	0xa548f3fc		# cld; rep movsq
+
+	mov	$disp,%rsi
+	xor	%rcx,%rcx		# arg1, UNW_FLAG_NHANDLER
+	mov	8(%rsi),%rdx		# arg2, disp->ImageBase
+	mov	0(%rsi),%r8		# arg3, disp->ControlPc
+	mov	16(%rsi),%r9		# arg4, disp->FunctionEntry
+	mov	40(%rsi),%r10		# disp->ContextRecord
+	lea	56(%rsi),%r11		# &disp->HandlerData
+	lea	24(%rsi),%r12		# &disp->EstablisherFrame
+	mov	%r10,32(%rsp)		# arg5
+	mov	%r11,40(%rsp)		# arg6
+	mov	%r12,48(%rsp)		# arg7
+	mov	%rcx,56(%rsp)		# arg8, (NULL)
+	call	*__imp_RtlVirtualUnwind(%rip)
+
+	mov	\$1,%eax		# ExceptionContinueSearch
+	add	\$64,%rsp
+	popfq
+	pop	%r15
+	pop	%r14
+	pop	%r13
+	pop	%r12
+	pop	%rbp
+	pop	%rbx
+	pop	%rdi
+	pop	%rsi
+	ret
+.size	mulx8_se_handler,.-mulx8_se_handler
+
+.section	.pdata
+.align	4
+	.rva	.LSEH_begin_x25519_scalar_mulx8_ifma
+	.rva	.LSEH_end_x25519_scalar_mulx8_ifma
+	.rva	.LSEH_info_x25519_scalar_mulx8_ifma
+
+.section	.xdata
+.align	8
+.LSEH_info_x25519_scalar_mulx8_ifma:
+	.byte	9,0,0,0
+	.rva	mulx8_se_handler
+	.rva	.Lmulx8_body,.Lmulx8_epilogue		# HandlerData[]
+___
+}
+}}} else {{{
+$code.=<<___;	# assembler is too old
+.text
+
+.globl	x25519_ifma_eligible
+.type	x25519_ifma_eligible,\@abi-omnipotent
+x25519_ifma_eligible:
+	xor	%eax,%eax
+	ret
+.size	x25519_ifma_eligible,.-x25519_ifma_eligible
+
+.globl	x25519_scalar_mulx8_ifma
+.type	x25519_scalar_mulx8_ifma,\@abi-omnipotent
+x25519_scalar_mulx8_ifma:
+	.byte	0x0f,0x0b	# ud2
+	ret
+.size	x25519_scalar_mulx8_ifma,.-x25519_scalar_mulx8_ifma
+___
+}}}
+
+$code =~ s/\`([^\`]*)\`/eval $1/gem;
+print $code;
+close STDOUT;
@@ -10,6 +10,7 @@
 #include <string.h>
 #include "ec_lcl.h"
 #include <openssl/sha.h>
+#include <openssl/rand.h>
 
 #if defined(X25519_ASM) && (defined(__x86_64) || defined(__x86_64__) || \
                             defined(_M_AMD64) || defined(_M_X64))
@@ -196,12 +197,12 @@ static void fe64_invert(fe64 out, const fe64 z)
 
 /*
  * Duplicate of original x25519_scalar_mult_generic, but using
- * fe64_* subroutines.
+ * fe64_* subroutines. The result is left in projective x2:z2 form.
  */
-static void x25519_scalar_mulx(uint8_t out[32], const uint8_t scalar[32],
-                               const uint8_t point[32])
+static void x25519_ladder64(fe64 x2, fe64 z2, const uint8_t scalar[32],
+                            const uint8_t point[32])
 {
-    fe64 x1, x2, z2, x3, z3, tmp0, tmp1;
+    fe64 x1, x3, z3, tmp0, tmp1;
     uint8_t e[32];
     unsigned swap = 0;
     int pos;
@@ -243,12 +244,29 @@ static void x25519_scalar_mulx(uint8_t out[32], const uint8_t scalar[32],
         fe64_mul(z2, tmp1, tmp0);
     }
 
+    OPENSSL_cleanse(e, sizeof(e));
+}
+
+static void x25519_scalar_mulx(uint8_t out[32], const uint8_t scalar[32],
+                               const uint8_t point[32])
+{
+    fe64 x2, z2;
+
+    x25519_ladder64(x2, z2, scalar, point);
     fe64_invert(z2, z2);
     fe64_mul(x2, x2, z2);
     fe64_tobytes(out, x2);
-
-    OPENSSL_cleanse(e, sizeof(e));
 }
+
+int x25519_ifma_eligible(void);
+
+/*
+ * Eight ladders at once, lane j with scalar whose clamped bit i is bit j
+ * of bits[i]. Projective results are returned in radix 2^51, limb i of
+ * lane j being xz[0][i][j] and xz[1][i][j].
+ */
+void x25519_scalar_mulx8_ifma(uint64_t xz[2][5][8], const uint8_t bits[255],
+                              const uint64_t u[5][8]);
 #endif
 
 #if defined(X25519_ASM) \
@@ -681,23 +699,16 @@ static void fe51_invert(fe51 out, const fe51 z)
 
 /*
  * Duplicate of original x25519_scalar_mult_generic, but using
- * fe51_* subroutines.
+ * fe51_* subroutines. The result is left in projective x2:z2 form.
  */
-static void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
-                               const uint8_t point[32])
+static void x25519_ladder51(fe51 x2, fe51 z2, const uint8_t scalar[32],
+                            const uint8_t point[32])
 {
-    fe51 x1, x2, z2, x3, z3, tmp0, tmp1;
+    fe51 x1, x3, z3, tmp0, tmp1;
     uint8_t e[32];
     unsigned swap = 0;
     int pos;
 
-# ifdef BASE_2_64_IMPLEMENTED
-    if (x25519_fe64_eligible()) {
-        x25519_scalar_mulx(out, scalar, point);
-        return;
-    }
-# endif
-
     memcpy(e, scalar, 32);
     e[0]  &= 0xf8;
     e[31] &= 0x7f;
@@ -735,11 +746,152 @@ static void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
         fe51_mul(z2, tmp1, tmp0);
     }
 
+    OPENSSL_cleanse(e, sizeof(e));
+}
+
+static void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
+                               const uint8_t point[32])
+{
+    fe51 x2, z2;
+
+# ifdef BASE_2_64_IMPLEMENTED
+    if (x25519_fe64_eligible()) {
+        x25519_scalar_mulx(out, scalar, point);
+        return;
+    }
+# endif
+
+    x25519_ladder51(x2, z2, scalar, point);
     fe51_invert(z2, z2);
     fe51_mul(x2, x2, z2);
     fe51_tobytes(out, x2);
+}
+
+# define X25519_BATCH 32
+
+# ifdef BASE_2_64_IMPLEMENTED
+/*
+ * Runs eight ladders with x25519_scalar_mulx8_ifma. Lanes beyond |n|
+ * repeat the first one.
+ */
+static void x25519_ladder51_x8(fe51 x2[], fe51 z2[],
+                               const uint8_t *const scalar[],
+                               const uint8_t *const point[], size_t n)
+{
+    uint64_t xz[2][5][8], u[5][8];
+    uint8_t bits[255], e[32];
+    fe51 x1;
+    size_t i, j, k;
+    int pos;
+
+    memset(bits, 0, sizeof(bits));
+    for (j = 0; j < 8; j++) {
+        k = j < n ? j : 0;
+        memcpy(e, scalar[k], 32);
+        e[0]  &= 0xf8;
+        e[31] &= 0x7f;
+        e[31] |= 0x40;
+        for (pos = 0; pos < 255; pos++)
+            bits[pos] |= ((e[pos / 8] >> (pos & 7)) & 1) << j;
+        fe51_frombytes(x1, point[k]);
+        for (i = 0; i < 5; i++)
+            u[i][j] = x1[i];
+    }
+
+    x25519_scalar_mulx8_ifma(xz, bits, (const uint64_t (*)[8])u);
+
+    for (j = 0; j < n; j++) {
+        for (i = 0; i < 5; i++) {
+            x2[j][i] = xz[0][i][j];
+            z2[j][i] = xz[1][i][j];
+        }
+    }
 
+    OPENSSL_cleanse(bits, sizeof(bits));
     OPENSSL_cleanse(e, sizeof(e));
+    OPENSSL_cleanse(xz, sizeof(xz));
+}
+# endif
+
+/*
+ * Up to X25519_BATCH independent scalar multiplications, which share the
+ * final inversion: z[0]..z[n-1] are inverted all at once with Montgomery's
+ * trick at the cost of three multiplications per element. A z that is zero,
+ * i.e. the result for a point of small order, is replaced with one and the
+ * corresponding x with zero, so that the others are not affected and the
+ * output is all-zero just as with x25519_scalar_mult.
+ */
+static void x25519_scalar_mult_batch(uint8_t *const out[],
+                                     const uint8_t *const scalar[],
+                                     const uint8_t *const point[], size_t n)
+{
+    fe51 x2[X25519_BATCH], z2[X25519_BATCH], acc[X25519_BATCH], t, inv;
+    uint8_t s[32];
+    size_t i = 0, j;
+
+    if (n == 1) {
+        x25519_scalar_mult(out[0], scalar[0], point[0]);
+        return;
+    }
+
+# ifdef BASE_2_64_IMPLEMENTED
+    if (n >= 3 && x25519_ifma_eligible()) {
+        /* Eight lanes cost about as much as three single ladders */
+        for (; i + 3 <= n; i += 8)
+            x25519_ladder51_x8(x2 + i, z2 + i, scalar + i, point + i,
+                               n - i < 8 ? n - i : 8);
+        if (i > n)
+            i = n;
+    }
+    if (x25519_fe64_eligible()) {
+        fe64 x, z;
+
+        for (; i < n; i++) {
+            x25519_ladder64(x, z, scalar[i], point[i]);
+            fe64_tobytes(s, x);
+            fe51_frombytes(x2[i], s);
+            fe64_tobytes(s, z);
+            fe51_frombytes(z2[i], s);
+        }
+        OPENSSL_cleanse(x, sizeof(x));
+        OPENSSL_cleanse(z, sizeof(z));
+    }
+# endif
+    for (; i < n; i++)
+        x25519_ladder51(x2[i], z2[i], scalar[i], point[i]);
+
+    for (i = 0; i < n; i++) {
+        unsigned int zero = 0;
+
+        fe51_tobytes(s, z2[i]);
+        for (j = 0; j < 32; j++)
+            zero |= s[j];
+        if (zero == 0) {
+            fe51_1(z2[i]);
+            fe51_0(x2[i]);
+        }
+        if (i == 0)
+            fe51_copy(acc[0], z2[0]);
+        else
+            fe51_mul(acc[i], acc[i - 1], z2[i]);
+    }
+
+    fe51_invert(inv, acc[n - 1]);
+    for (i = n - 1; i > 0; i--) {
+        fe51_mul(t, inv, acc[i - 1]);
+        fe51_mul(inv, inv, z2[i]);
+        fe51_mul(x2[i], x2[i], t);
+        fe51_tobytes(out[i], x2[i]);
+    }
+    fe51_mul(x2[0], x2[0], inv);
+    fe51_tobytes(out[0], x2[0]);
+
+    OPENSSL_cleanse(x2, sizeof(x2));
+    OPENSSL_cleanse(z2, sizeof(z2));
+    OPENSSL_cleanse(acc, sizeof(acc));
+    OPENSSL_cleanse(t, sizeof(t));
+    OPENSSL_cleanse(inv, sizeof(inv));
+    OPENSSL_cleanse(s, sizeof(s));
 }
 #endif
 
@@ -4419,6 +4571,18 @@ static void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
                                const uint8_t point[32]) {
     x25519_scalar_mult_generic(out, scalar, point);
 }
+
+# define X25519_BATCH 32
+
+static void x25519_scalar_mult_batch(uint8_t *const out[],
+                                     const uint8_t *const scalar[],
+                                     const uint8_t *const point[], size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        x25519_scalar_mult_generic(out[i], scalar[i], point[i]);
+}
 #endif
 
 static void slide(signed char *r, const uint8_t *a)
@@ -4600,6 +4764,90 @@ static void ge_double_scalarmult_vartime(ge_p2 *r, const uint8_t *a,
     }
 }
 
+/*
+ * Scratch space for ge_multi_scalarmult_vartime(), one per point.
+ */
+typedef struct {
+    signed char slide[256];
+    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+} ge_msm_scratch;
+
+/*
+ * r = a[0] * A[0] + ... + a[n-1] * A[n-1] + b * B
+ * where a[i] and b are 32-byte little-endian scalars and B is the Ed25519
+ * base point. Same sliding windows as in ge_double_scalarmult_vartime(),
+ * but the doublings are shared by all |n| points.
+ */
+static void ge_multi_scalarmult_vartime(ge_p2 *r, const uint8_t (*a)[32],
+                                        const ge_p3 *A, size_t n,
+                                        const uint8_t *b,
+                                        ge_msm_scratch *scratch)
+{
+    signed char bslide[256];
+    ge_p1p1 t;
+    ge_p3 u;
+    ge_p3 A2;
+    size_t j;
+    int i, k, top = -1;
+
+    slide(bslide, b);
+    for (i = 255; i > top; --i) {
+        if (bslide[i]) {
+            top = i;
+            break;
+        }
+    }
+
+    for (j = 0; j < n; j++) {
+        ge_cached *Ai = scratch[j].Ai;
+
+        slide(scratch[j].slide, a[j]);
+        for (i = 255; i > top; --i) {
+            if (scratch[j].slide[i]) {
+                top = i;
+                break;
+            }
+        }
+
+        ge_p3_to_cached(&Ai[0], &A[j]);
+        ge_p3_dbl(&t, &A[j]);
+        ge_p1p1_to_p3(&A2, &t);
+        for (k = 0; k < 7; k++) {
+            ge_add(&t, &A2, &Ai[k]);
+            ge_p1p1_to_p3(&u, &t);
+            ge_p3_to_cached(&Ai[k + 1], &u);
+        }
+    }
+
+    ge_p2_0(r);
+
+    for (i = top; i >= 0; --i) {
+        ge_p2_dbl(&t, r);
+
+        for (j = 0; j < n; j++) {
+            int s = scratch[j].slide[i];
+
+            if (s > 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_add(&t, &u, &scratch[j].Ai[s / 2]);
+            } else if (s < 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_sub(&t, &u, &scratch[j].Ai[(-s) / 2]);
+            }
+        }
+
+        if (bslide[i] > 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_madd(&t, &u, &Bi[bslide[i] / 2]);
+        } else if (bslide[i] < 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_msub(&t, &u, &Bi[(-bslide[i]) / 2]);
+        }
+
+        ge_p1p1_to_p2(r, &t);
+    }
+}
+
 /*
  * The set of scalars is \Z/l
  * where l = 2^252 + 27742317777372353535851937790883648493.
@@ -5473,33 +5721,22 @@ int ED25519_sign(uint8_t *out_sig, const uint8_t *message, size_t message_len,
 
 static const char allzeroes[15];
 
-int ED25519_verify(const uint8_t *message, size_t message_len,
-                   const uint8_t signature[64], const uint8_t public_key[32])
+/*
+ * Check 0 <= s < L where L = 2^252 + 27742317777372353535851937790883648493
+ *
+ * If not the signature is publicly invalid. Since it's public we can do the
+ * check in variable time.
+ */
+static int sc_is_canonical(const uint8_t *s)
 {
     int i;
-    ge_p3 A;
-    const uint8_t *r, *s;
-    SHA512_CTX hash_ctx;
-    ge_p2 R;
-    uint8_t rcheck[32];
-    uint8_t h[SHA512_DIGEST_LENGTH];
     /* 27742317777372353535851937790883648493 in little endian format */
     const uint8_t l_low[16] = {
         0xED, 0xD3, 0xF5, 0x5C, 0x1A, 0x63, 0x12, 0x58, 0xD6, 0x9C, 0xF7, 0xA2,
         0xDE, 0xF9, 0xDE, 0x14
     };
 
-    r = signature;
-    s = signature + 32;
-
-    /*
-     * Check 0 <= s < L where L = 2^252 + 27742317777372353535851937790883648493
-     *
-     * If not the signature is publicly invalid. Since it's public we can do the
-     * check in variable time.
-     *
-     * First check the most significant byte
-     */
+    /* First check the most significant byte */
     if (s[31] > 0x10)
         return 0;
     if (s[31] == 0x10) {
@@ -5518,6 +5755,24 @@ int ED25519_verify(const uint8_t *message, size_t message_len,
         if (i < 0)
             return 0;
     }
+    return 1;
+}
+
+int ED25519_verify(const uint8_t *message, size_t message_len,
+                   const uint8_t signature[64], const uint8_t public_key[32])
+{
+    ge_p3 A;
+    const uint8_t *r, *s;
+    SHA512_CTX hash_ctx;
+    ge_p2 R;
+    uint8_t rcheck[32];
+    uint8_t h[SHA512_DIGEST_LENGTH];
+
+    r = signature;
+    s = signature + 32;
+
+    if (!sc_is_canonical(s))
+        return 0;
 
     if (ge_frombytes_vartime(&A, public_key) != 0) {
         return 0;
@@ -5541,6 +5796,155 @@ int ED25519_verify(const uint8_t *message, size_t message_len,
     return CRYPTO_memcmp(rcheck, r, sizeof(rcheck)) == 0;
 }
 
+/*
+ * ED25519_verify() rejects R unless it is the canonical encoding of a point,
+ * which ge_frombytes_vartime() alone doesn't ensure: y has to be less than
+ * 2^255-19 and the sign bit has to be clear if x is zero, i.e. y is 1 or -1.
+ */
+static int ge_bytes_canonical(const uint8_t s[32])
+{
+    static const uint8_t ones[30] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    static const uint8_t zeroes[30] = { 0 };
+    int sign = s[31] >> 7;
+
+    if ((s[31] & 0x7f) == 0x7f && memcmp(s + 1, ones, sizeof(ones)) == 0)
+        return s[0] < 0xec || (s[0] == 0xec && !sign);
+    if ((s[31] & 0x7f) == 0 && memcmp(s + 1, zeroes, sizeof(zeroes)) == 0)
+        return s[0] != 1 || !sign;
+    return 1;
+}
+
+/*
+ * Signatures are verified ED25519_VERIFY_BATCH at a time, which amortises
+ * the doublings of the multi-scalar multiplication well enough while
+ * keeping the scratch space reasonably small.
+ */
+#define ED25519_VERIFY_BATCH 64
+
+typedef struct {
+    ge_p3 P[2 * ED25519_VERIFY_BATCH];
+    uint8_t a[2 * ED25519_VERIFY_BATCH][32];
+    const uint8_t *key[ED25519_VERIFY_BATCH];
+    ge_msm_scratch scratch[2 * ED25519_VERIFY_BATCH];
+} ed25519_batch;
+
+/*
+ * Verify |n| signatures at once, by checking with random 128-bit z_i that
+ *
+ *     8 * (sum(z_i * R_i) + sum(z_i * k_i * A_i) - sum(z_i * s_i) * B) = 0
+ *
+ * where k_i = SHA512(R_i || A_i || M_i). Terms of signatures made with the
+ * same key are merged. Returns 1 if all signatures are valid. Note that
+ * the equation is cofactored, so unlike ED25519_verify() it accepts
+ * signatures whose R_i - s_i * B + k_i * A_i is a nonzero point of small
+ * order, which only the owner of A_i can produce.
+ */
+int ED25519_verify_batch(const uint8_t *const message[],
+                         const size_t message_len[],
+                         const uint8_t *const signature[],
+                         const uint8_t *const public_key[], size_t n)
+{
+    ed25519_batch *batch;
+    SHA512_CTX hash_ctx;
+    uint8_t h[SHA512_DIGEST_LENGTH];
+    uint8_t z[ED25519_VERIFY_BATCH][32];
+    uint8_t b[32];
+    size_t i, j, m, nkeys;
+    ge_p2 R;
+    fe t;
+    int ret = 1;
+
+    if (n == 1)
+        return ED25519_verify(message[0], message_len[0], signature[0],
+                              public_key[0]);
+    if ((batch = OPENSSL_malloc(sizeof(*batch))) == NULL)
+        return -1;
+
+    for (; n > 0 && ret == 1; n -= m) {
+        m = n < ED25519_VERIFY_BATCH ? n : ED25519_VERIFY_BATCH;
+
+        memset(z, 0, sizeof(z));
+        for (i = 0; i < m; i++) {
+            if (RAND_bytes(z[i], 16) <= 0) {
+                ret = -1;
+                goto err;
+            }
+        }
+
+        memset(b, 0, sizeof(b));
+        nkeys = 0;
+        for (i = 0; i < m; i++) {
+            const uint8_t *r = signature[i], *s = signature[i] + 32;
+            ge_p3 *Ri = &batch->P[m + i];
+
+            if (!sc_is_canonical(s) || !ge_bytes_canonical(r)
+                    || ge_frombytes_vartime(Ri, r) != 0) {
+                ret = 0;
+                goto err;
+            }
+            fe_neg(Ri->X, Ri->X);
+            fe_neg(Ri->T, Ri->T);
+            memcpy(batch->a[m + i], z[i], 32);
+
+            for (j = 0; j < nkeys; j++)
+                if (memcmp(batch->key[j], public_key[i], 32) == 0)
+                    break;
+            if (j == nkeys) {
+                if (ge_frombytes_vartime(&batch->P[j], public_key[i]) != 0) {
+                    ret = 0;
+                    goto err;
+                }
+                fe_neg(batch->P[j].X, batch->P[j].X);
+                fe_neg(batch->P[j].T, batch->P[j].T);
+                memset(batch->a[j], 0, 32);
+                batch->key[nkeys++] = public_key[i];
+            }
+
+            SHA512_Init(&hash_ctx);
+            SHA512_Update(&hash_ctx, r, 32);
+            SHA512_Update(&hash_ctx, public_key[i], 32);
+            SHA512_Update(&hash_ctx, message[i], message_len[i]);
+            SHA512_Final(h, &hash_ctx);
+            x25519_sc_reduce(h);
+
+            sc_muladd(batch->a[j], z[i], h, batch->a[j]);
+            sc_muladd(b, z[i], s, b);
+        }
+
+        /* Pack the R_i next to the distinct keys */
+        if (nkeys != m) {
+            memmove(&batch->P[nkeys], &batch->P[m], m * sizeof(batch->P[0]));
+            memmove(batch->a[nkeys], batch->a[m], m * sizeof(batch->a[0]));
+        }
+        ge_multi_scalarmult_vartime(&R, (const uint8_t (*)[32])batch->a,
+                                    batch->P, nkeys + m, b, batch->scratch);
+
+        /* Multiply by the cofactor and check for the neutral element */
+        for (i = 0; i < 3; i++) {
+            ge_p1p1 t2;
+
+            ge_p2_dbl(&t2, &R);
+            ge_p1p1_to_p2(&R, &t2);
+        }
+        fe_sub(t, R.Y, R.Z);
+        if (fe_isnonzero(R.X) || fe_isnonzero(t))
+            ret = 0;
+
+        message += m;
+        message_len += m;
+        signature += m;
+        public_key += m;
+    }
+
+ err:
+    OPENSSL_free(batch);
+    return ret;
+}
+
 void ED25519_public_from_private(uint8_t out_public_key[32],
                                  const uint8_t private_key[32])
 {
@@ -5568,6 +5972,29 @@ int X25519(uint8_t out_shared_key[32], const uint8_t private_key[32],
     return CRYPTO_memcmp(kZeros, out_shared_key, 32) != 0;
 }
 
+int X25519_batch(uint8_t *const out_shared_key[],
+                 const uint8_t *const private_key[],
+                 const uint8_t *const peer_public_value[], size_t n, int ok[])
+{
+    static const uint8_t kZeros[32] = {0};
+    size_t i, chunk;
+    int ret = 1;
+
+    for (i = 0; i < n; i += chunk) {
+        chunk = n - i < X25519_BATCH ? n - i : X25519_BATCH;
+        x25519_scalar_mult_batch(out_shared_key + i, private_key + i,
+                                 peer_public_value + i, chunk);
+    }
+    for (i = 0; i < n; i++) {
+        int r = CRYPTO_memcmp(kZeros, out_shared_key[i], 32) != 0;
+
+        if (ok != NULL)
+            ok[i] = r;
+        ret &= r;
+    }
+    return ret;
+}
+
 void X25519_public_from_private(uint8_t out_public_value[32],
                                 const uint8_t private_key[32])
 {
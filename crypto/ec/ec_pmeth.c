@@ -148,6 +148,27 @@ static int pkey_ec_verify(EVP_PKEY_CTX *ctx,
     return ret;
 }
 
+static int pkey_ec_verify_batch(EVP_PKEY *const pkey[],
+                                const unsigned char *const sig[],
+                                const size_t siglen[],
+                                const unsigned char *const tbs[],
+                                const size_t tbslen[], size_t n)
+{
+    EC_KEY **ec;
+    size_t i;
+    int ret;
+
+    if ((ec = OPENSSL_malloc(n * sizeof(*ec))) == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    for (i = 0; i < n; i++)
+        ec[i] = pkey[i]->pkey.ec;
+    ret = ossl_ecdsa_verify_batch(tbs, tbslen, sig, siglen, ec, n);
+    OPENSSL_free(ec);
+    return ret;
+}
+
 #ifndef OPENSSL_NO_EC
 static int pkey_ec_derive(EVP_PKEY_CTX *ctx, unsigned char *key, size_t *keylen)
 {
@@ -185,6 +206,33 @@ static int pkey_ec_derive(EVP_PKEY_CTX *ctx, unsigned char *key, size_t *keylen)
     return 1;
 }
 
+static int pkey_ec_derive_batch(EVP_PKEY *const pkey[], EVP_PKEY *const peer[],
+                                unsigned char *const key[], size_t keylen[],
+                                size_t n)
+{
+    EC_KEY **ec;
+    const EC_POINT **pub;
+    size_t i;
+    int ret = -1;
+
+    ec = OPENSSL_malloc(n * sizeof(*ec));
+    pub = OPENSSL_malloc(n * sizeof(*pub));
+    if (ec == NULL || pub == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    for (i = 0; i < n; i++) {
+        ec[i] = pkey[i]->pkey.ec;
+        pub[i] = EC_KEY_get0_public_key(peer[i]->pkey.ec);
+    }
+    ret = ossl_ecdh_compute_key_batch(key, keylen, pub, ec, n);
+
+ err:
+    OPENSSL_free(ec);
+    OPENSSL_free(pub);
+    return ret;
+}
+
 static int pkey_ec_kdf_derive(EVP_PKEY_CTX *ctx,
                               unsigned char *key, size_t *keylen)
 {
@@ -473,5 +521,18 @@ const EVP_PKEY_METHOD ec_pkey_meth = {
     0,
 #endif
     pkey_ec_ctrl,
-    pkey_ec_ctrl_str
+    pkey_ec_ctrl_str,
+
+    0, 0,
+
+    0, 0, 0,
+
+    0,
+
+    pkey_ec_verify_batch,
+#ifndef OPENSSL_NO_EC
+    pkey_ec_derive_batch
+#else
+    0
+#endif
 };
@@ -118,3 +118,163 @@ int ecdh_simple_compute_key(unsigned char **pout, size_t *poutlen,
     OPENSSL_free(buf);
     return ret;
 }
+
+/*
+ * Shared secrets of |n| key pairs on the same |group|. All products are
+ * computed first and then converted to affine coordinates with a single
+ * EC_POINTs_make_affine() call, which shares the field inversion among them.
+ */
+static int ecdh_batch_group(const EC_GROUP *group, unsigned char *const out[],
+                            size_t outlen[], const EC_POINT *const pub_key[],
+                            EC_KEY *const ecdh[], size_t n, BN_CTX *ctx)
+{
+    EC_POINT **tmp = NULL;
+    BIGNUM *x, *k;
+    const BIGNUM *priv_key;
+    unsigned char *buf = NULL, *ok = NULL;
+    size_t i, m, buflen;
+    int ret = -1;
+
+    BN_CTX_start(ctx);
+    x = BN_CTX_get(ctx);
+    k = BN_CTX_get(ctx);
+    buflen = (EC_GROUP_get_degree(group) + 7) / 8;
+    if (k == NULL
+            || (tmp = OPENSSL_zalloc(n * sizeof(*tmp))) == NULL
+            || (ok = OPENSSL_zalloc(n)) == NULL
+            || (buf = OPENSSL_malloc(buflen)) == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    ret = 1;
+    for (i = 0, m = 0; i < n; i++) {
+        priv_key = EC_KEY_get0_private_key(ecdh[i]);
+        if (EC_KEY_get_flags(ecdh[i]) & EC_FLAG_COFACTOR_ECDH) {
+            if (!EC_GROUP_get_cofactor(group, k, NULL)
+                    || !BN_mul(k, k, priv_key, ctx)) {
+                ret = -1;
+                goto err;
+            }
+            priv_key = k;
+        }
+        if ((tmp[m] = EC_POINT_new(group)) == NULL) {
+            ret = -1;
+            goto err;
+        }
+        if (EC_POINT_mul(group, tmp[m], NULL, pub_key[i], priv_key, ctx)
+                && !EC_POINT_is_at_infinity(group, tmp[m])) {
+            ok[i] = 1;
+            m++;
+            continue;
+        }
+        EC_POINT_clear_free(tmp[m]);
+        tmp[m] = NULL;
+        outlen[i] = 0;
+        ret = 0;
+    }
+
+    if (!EC_POINTs_make_affine(group, m, tmp, ctx)) {
+        ret = -1;
+        goto err;
+    }
+
+    /* outlen[i] may legitimately be 0, so it can't mark the failures */
+    for (i = 0, m = 0; i < n; i++) {
+        if (!ok[i])
+            continue;
+        if (!EC_POINT_get_affine_coordinates(group, tmp[m++], x, NULL, ctx)
+                || BN_bn2binpad(x, buf, buflen) < 0) {
+            ret = -1;
+            goto err;
+        }
+        /* Truncated as ECDH_compute_key() without KDF does */
+        if (outlen[i] > buflen)
+            outlen[i] = buflen;
+        memcpy(out[i], buf, outlen[i]);
+    }
+
+ err:
+    if (tmp != NULL)
+        for (i = 0; i < n; i++)
+            EC_POINT_clear_free(tmp[i]);
+    OPENSSL_free(tmp);
+    OPENSSL_free(ok);
+    OPENSSL_clear_free(buf, buflen);
+    BN_CTX_end(ctx);
+    return ret;
+}
+
+/*
+ * ECDH for |n| unrelated key pairs, (ecdh[i], pub_key[i]), with at most
+ * outlen[i] bytes of the i-th shared secret written to out[i]. outlen[i]
+ * is set to the length of the secret, or to zero if it couldn't be
+ * computed. pub_key[i] must be on the curve of ecdh[i], a NULL one fails.
+ * Consecutive keys on the same curve that use the default method are done
+ * together by ecdh_batch_group(), others with ECDH_compute_key().
+ * Returns 1 if all secrets were computed, 0 if some weren't, and -1 on
+ * error.
+ */
+int ossl_ecdh_compute_key_batch(unsigned char *const out[], size_t outlen[],
+                                const EC_POINT *const pub_key[],
+                                EC_KEY *const ecdh[], size_t n)
+{
+    const EC_GROUP *group = NULL;
+    BN_CTX *ctx = NULL;
+    size_t i, start = 0;
+    int ret = 1, r;
+
+    if (n == 0)
+        return 1;
+    if ((ctx = BN_CTX_new_ex(ecdh[0]->libctx)) == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+
+    for (i = 0; i <= n; i++) {
+        const EC_GROUP *g = NULL;
+
+        if (i < n) {
+            g = EC_KEY_get0_group(ecdh[i]);
+            if (ecdh[i]->meth->compute_key != ossl_ecdh_compute_key
+                    || g == NULL
+                    || g->meth->ecdh_compute_key != ecdh_simple_compute_key
+                    || g->meth->points_make_affine == NULL
+                    || EC_KEY_get0_private_key(ecdh[i]) == NULL
+                    || pub_key[i] == NULL)
+                g = NULL;
+        }
+
+        /* Flush the current run when the group changes */
+        if (group != NULL
+                && (g == NULL || (g != group && EC_GROUP_cmp(g, group, ctx)))) {
+            r = ecdh_batch_group(group, out + start, outlen + start,
+                                 pub_key + start, ecdh + start, i - start,
+                                 ctx);
+            if (r < 0) {
+                ret = r;
+                goto err;
+            }
+            ret &= r;
+            group = NULL;
+        }
+        if (i == n)
+            break;
+
+        if (g == NULL) {
+            r = pub_key[i] == NULL ? 0
+                : ECDH_compute_key(out[i], outlen[i], pub_key[i], ecdh[i],
+                                   NULL);
+            outlen[i] = r > 0 ? (size_t)r : 0;
+            if (r <= 0)
+                ret = 0;
+        } else if (group == NULL) {
+            group = g;
+            start = i;
+        }
+    }
+
+ err:
+    BN_CTX_free(ctx);
+    return ret;
+}
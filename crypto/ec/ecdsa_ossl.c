@@ -458,3 +458,227 @@ int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
     EC_POINT_free(point);
     return ret;
 }
+
+/*
+ * Verify |n| signatures made with keys on the same prime field |group|,
+ * sharing one inversion modulo the order between all of them (Montgomery's
+ * trick). The x-coordinate of u1 * G + u2 * Q is compared in Jacobian
+ * coordinates, i.e. as r * Z^2 == X, which saves a field inversion per
+ * signature; the exact affine comparison is only made if that fails, as
+ * x may be larger than the order or X may not be fully reduced.
+ *
+ * Returns 1 if all signatures are valid, 0 if one is not and -1 on error.
+ */
+static int ecdsa_verify_batch_group(const EC_GROUP *group,
+                                    const unsigned char *const dgst[],
+                                    const size_t dgst_len[],
+                                    ECDSA_SIG *const sig[],
+                                    EC_KEY *const eckey[], size_t n,
+                                    BN_CTX *ctx)
+{
+    const BIGNUM *order = EC_GROUP_get0_order(group);
+    BN_MONT_CTX *mont = group->mont_data;
+    BIGNUM **prod = NULL, *inv, *si, *w, *u1, *u2, *m, *t;
+    EC_POINT *point = NULL;
+    size_t i, len;
+    int bits = BN_num_bits(order), ret = -1;
+
+    BN_CTX_start(ctx);
+    inv = BN_CTX_get(ctx);
+    si = BN_CTX_get(ctx);
+    w = BN_CTX_get(ctx);
+    u1 = BN_CTX_get(ctx);
+    u2 = BN_CTX_get(ctx);
+    m = BN_CTX_get(ctx);
+    t = BN_CTX_get(ctx);
+    if (t == NULL
+            || (prod = OPENSSL_malloc(n * sizeof(*prod))) == NULL
+            || (point = EC_POINT_new(group)) == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    /* prod[i] = s_0 * ... * s_i, in Montgomery form */
+    for (i = 0; i < n; i++) {
+        if (BN_is_zero(sig[i]->r) || BN_is_negative(sig[i]->r)
+                || BN_ucmp(sig[i]->r, order) >= 0 || BN_is_zero(sig[i]->s)
+                || BN_is_negative(sig[i]->s)
+                || BN_ucmp(sig[i]->s, order) >= 0) {
+            ret = 0;
+            goto err;
+        }
+        if ((prod[i] = BN_CTX_get(ctx)) == NULL
+                || !BN_to_montgomery(prod[i], sig[i]->s, mont, ctx)
+                || (i > 0 && !BN_mod_mul_montgomery(prod[i], prod[i - 1],
+                                                    prod[i], mont, ctx)))
+            goto err;
+    }
+
+    /* inv = (s_0 * ... * s_(n-1))^-1, in Montgomery form */
+    if (!BN_from_montgomery(t, prod[n - 1], mont, ctx)
+            || !ec_group_do_inverse_ord(group, inv, t, ctx)
+            || !BN_to_montgomery(inv, inv, mont, ctx))
+        goto err;
+
+    for (i = n; i-- > 0; ) {
+        const EC_POINT *pub_key = EC_KEY_get0_public_key(eckey[i]);
+
+        /* w = s_i^-1, then strip s_i off inv */
+        if (i > 0) {
+            if (!BN_mod_mul_montgomery(w, inv, prod[i - 1], mont, ctx)
+                    || !BN_to_montgomery(si, sig[i]->s, mont, ctx)
+                    || !BN_mod_mul_montgomery(inv, inv, si, mont, ctx))
+                goto err;
+        } else if (!BN_copy(w, inv)) {
+            goto err;
+        }
+
+        /* digest -> m, truncated as in ecdsa_simple_verify_sig() */
+        len = dgst_len[i];
+        if (8 * len > (size_t)bits)
+            len = (bits + 7) / 8;
+        if (!BN_bin2bn(dgst[i], (int)len, m)
+                || (8 * len > (size_t)bits
+                    && !BN_rshift(m, m, 8 - (bits & 0x7))))
+            goto err;
+        if (BN_ucmp(m, order) >= 0 && !BN_usub(m, m, order))
+            goto err;
+
+        /* u1 = m * w, u2 = r * w, out of the Montgomery form */
+        if (!BN_mod_mul_montgomery(u1, m, w, mont, ctx)
+                || !BN_mod_mul_montgomery(u2, sig[i]->r, w, mont, ctx)
+                || !EC_POINT_mul(group, point, u1, pub_key, u2, ctx))
+            goto err;
+
+        if (EC_POINT_is_at_infinity(group, point)) {
+            ret = 0;
+            goto err;
+        }
+
+        if (group->meth->field_encode != NULL) {
+            if (!group->meth->field_encode(group, u1, sig[i]->r, ctx))
+                goto err;
+        } else if (!BN_copy(u1, sig[i]->r)) {
+            goto err;
+        }
+        if (!group->meth->field_sqr(group, t, point->Z, ctx)
+                || !group->meth->field_mul(group, t, t, u1, ctx))
+            goto err;
+        if (BN_cmp(t, point->X) == 0)
+            continue;
+
+        if (!EC_POINT_get_affine_coordinates(group, point, t, NULL, ctx)
+                || !BN_nnmod(t, t, order, ctx))
+            goto err;
+        if (BN_ucmp(t, sig[i]->r) != 0) {
+            ret = 0;
+            goto err;
+        }
+    }
+    ret = 1;
+
+ err:
+    OPENSSL_free(prod);
+    EC_POINT_free(point);
+    BN_CTX_end(ctx);
+    return ret;
+}
+
+/*
+ * Verify |n| DER encoded signatures. Runs of signatures made with keys on
+ * the same prime curve, handled by the default ECDSA methods, are verified
+ * together, anything else by ECDSA_verify(). Returns 1 if all signatures
+ * are valid, 0 if one of them is not and -1 on error.
+ */
+int ossl_ecdsa_verify_batch(const unsigned char *const dgst[],
+                            const size_t dgst_len[],
+                            const unsigned char *const sigbuf[],
+                            const size_t sig_len[], EC_KEY *const eckey[],
+                            size_t n)
+{
+    ECDSA_SIG **sig = NULL;
+    const EC_GROUP *group = NULL;
+    BN_CTX *ctx = NULL;
+    size_t i, start = 0;
+    int ret = -1, r;
+
+    if (n == 0)
+        return 1;
+    if ((sig = OPENSSL_zalloc(n * sizeof(*sig))) == NULL
+            || (ctx = BN_CTX_new_ex(eckey[0]->libctx)) == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    for (i = 0; i <= n; i++) {
+        const EC_GROUP *g = NULL;
+
+        if (i < n) {
+            const unsigned char *p = sigbuf[i];
+            unsigned char *der = NULL;
+            int derlen = -1;
+
+            g = EC_KEY_get0_group(eckey[i]);
+            if (eckey[i]->meth->verify != ossl_ecdsa_verify
+                    || eckey[i]->meth->verify_sig != ossl_ecdsa_verify_sig
+                    || g == NULL || EC_KEY_get0_public_key(eckey[i]) == NULL
+                    || !EC_KEY_can_sign(eckey[i])
+                    || g->meth->ecdsa_verify_sig != ecdsa_simple_verify_sig
+                    || EC_METHOD_get_field_type(g->meth)
+                       != NID_X9_62_prime_field
+                    || g->mont_data == NULL
+                    || sig_len[i] > INT_MAX || dgst_len[i] > INT_MAX)
+                g = NULL;
+
+            if (g != NULL) {
+                /* Same encoding rules as ossl_ecdsa_verify() */
+                if ((sig[i] = d2i_ECDSA_SIG(NULL, &p, (long)sig_len[i]))
+                        == NULL
+                        || (derlen = i2d_ECDSA_SIG(sig[i], &der))
+                           != (int)sig_len[i]
+                        || memcmp(sigbuf[i], der, derlen) != 0) {
+                    OPENSSL_clear_free(der, derlen);
+                    ret = 0;
+                    goto err;
+                }
+                OPENSSL_clear_free(der, derlen);
+            }
+        }
+
+        /* Flush the current run when the group changes */
+        if (group != NULL
+                && (g == NULL || (g != group && EC_GROUP_cmp(g, group, ctx)))) {
+            r = ecdsa_verify_batch_group(group, dgst + start, dgst_len + start,
+                                         sig + start, eckey + start,
+                                         i - start, ctx);
+            if (r != 1) {
+                ret = r;
+                goto err;
+            }
+            group = NULL;
+        }
+        if (i == n)
+            break;
+
+        if (g == NULL) {
+            r = ECDSA_verify(0, dgst[i], (int)dgst_len[i], sigbuf[i],
+                             (int)sig_len[i], eckey[i]);
+            if (r != 1) {
+                ret = r;
+                goto err;
+            }
+        } else if (group == NULL) {
+            group = g;
+            start = i;
+        }
+    }
+    ret = 1;
+
+ err:
+    if (sig != NULL)
+        for (i = 0; i < n; i++)
+            ECDSA_SIG_free(sig[i]);
+    OPENSSL_free(sig);
+    BN_CTX_free(ctx);
+    return ret;
+}
@@ -0,0 +1,1924 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A 64-bit implementation of the NIST P-384 elliptic curve point multiplication
+ *
+ * The structure follows ecp_nistp521.c: unsaturated limbs with 128-bit
+ * intermediate products, Jacobian coordinates and constant-time table
+ * lookups. Multiplication by the generator uses the two-table comb from
+ * ecp_nistp256.c, so that key generation and signing need only 47 doublings.
+ */
+
+#include <openssl/e_os2.h>
+#ifdef OPENSSL_NO_EC_NISTP_64_GCC_128
+NON_EMPTY_TRANSLATION_UNIT
+#else
+
+# include <string.h>
+# include <openssl/err.h>
+# include "ec_lcl.h"
+
+# if defined(__SIZEOF_INT128__) && __SIZEOF_INT128__==16
+  /* even with gcc, the typedef won't work for 32-bit platforms */
+typedef __uint128_t uint128_t;  /* nonstandard; implemented by gcc on 64-bit
+                                 * platforms */
+typedef __int128_t int128_t;
+# else
+#  error "Your compiler doesn't appear to support 128-bit integer types"
+# endif
+
+typedef uint8_t u8;
+typedef uint64_t u64;
+typedef int64_t s64;
+
+/*
+ * The underlying field. P384 operates over GF(2^384-2^128-2^96+2^32-1). We
+ * can serialise an element of this field into 48 bytes. We call this an
+ * felem_bytearray.
+ */
+
+typedef u8 felem_bytearray[48];
+
+/*
+ * These are the parameters of P384, taken from FIPS 186-3, section D.1.2.4.
+ * These values are big-endian.
+ */
+static const felem_bytearray nistp384_curve_params[5] = {
+    {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* p */
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+     0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff},
+    {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* a = -3 */
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+     0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xfc},
+    {0xb3, 0x31, 0x2f, 0xa7, 0xe2, 0x3e, 0xe7, 0xe4, /* b */
+     0x98, 0x8e, 0x05, 0x6b, 0xe3, 0xf8, 0x2d, 0x19,
+     0x18, 0x1d, 0x9c, 0x6e, 0xfe, 0x81, 0x41, 0x12,
+     0x03, 0x14, 0x08, 0x8f, 0x50, 0x13, 0x87, 0x5a,
+     0xc6, 0x56, 0x39, 0x8d, 0x8a, 0x2e, 0xd1, 0x9d,
+     0x2a, 0x85, 0xc8, 0xed, 0xd3, 0xec, 0x2a, 0xef},
+    {0xaa, 0x87, 0xca, 0x22, 0xbe, 0x8b, 0x05, 0x37, /* x */
+     0x8e, 0xb1, 0xc7, 0x1e, 0xf3, 0x20, 0xad, 0x74,
+     0x6e, 0x1d, 0x3b, 0x62, 0x8b, 0xa7, 0x9b, 0x98,
+     0x59, 0xf7, 0x41, 0xe0, 0x82, 0x54, 0x2a, 0x38,
+     0x55, 0x02, 0xf2, 0x5d, 0xbf, 0x55, 0x29, 0x6c,
+     0x3a, 0x54, 0x5e, 0x38, 0x72, 0x76, 0x0a, 0xb7},
+    {0x36, 0x17, 0xde, 0x4a, 0x96, 0x26, 0x2c, 0x6f, /* y */
+     0x5d, 0x9e, 0x98, 0xbf, 0x92, 0x92, 0xdc, 0x29,
+     0xf8, 0xf4, 0x1d, 0xbd, 0x28, 0x9a, 0x14, 0x7c,
+     0xe9, 0xda, 0x31, 0x13, 0xb5, 0xf0, 0xb8, 0xc0,
+     0x0a, 0x60, 0xb1, 0xce, 0x1d, 0x7e, 0x81, 0x9d,
+     0x7a, 0x43, 0x1d, 0x7c, 0x90, 0xea, 0x0e, 0x5f}
+};
+
+/*-
+ * The representation of field elements.
+ * ------------------------------------
+ *
+ * We represent field elements with seven values. These values are either 64 or
+ * 128 bits and the field element represented is:
+ *   v[0]*2^0 + v[1]*2^56 + v[2]*2^112 + ... + v[6]*2^336  (mod p)
+ * Each of the seven values is called a 'limb'. Since the limbs are spaced only
+ * 56 bits apart, but are greater than 56 bits in length, the most significant
+ * bits of each limb overlap with the least significant bits of the next.
+ *
+ * A field element with 64-bit limbs is an 'felem'. The product of two felems
+ * has thirteen 128-bit limbs and is a 'widefelem'.
+ */
+
+# define NLIMBS 7
+
+typedef uint64_t limb;
+typedef limb felem[NLIMBS];
+typedef uint128_t widefelem[2 * NLIMBS - 1];
+
+static const limb bottom48bits = 0xffffffffffff;
+static const limb bottom56bits = 0xffffffffffffff;
+
+/* This is 2^384-2^128-2^96+2^32-1, expressed as an felem */
+static const felem kPrime = {
+    0x00000000ffffffff, 0x00ffff0000000000, 0x00fffffffffeffff,
+    0x00ffffffffffffff, 0x00ffffffffffffff, 0x00ffffffffffffff,
+    0x0000ffffffffffff
+};
+
+/*
+ * bin48_to_felem takes a little-endian byte array and converts it into felem
+ * form. This assumes that the CPU is little-endian.
+ */
+static void bin48_to_felem(felem out, const u8 in[48])
+{
+    out[0] = (*((limb *) & in[0])) & bottom56bits;
+    out[1] = (*((limb *) & in[7])) & bottom56bits;
+    out[2] = (*((limb *) & in[14])) & bottom56bits;
+    out[3] = (*((limb *) & in[21])) & bottom56bits;
+    out[4] = (*((limb *) & in[28])) & bottom56bits;
+    out[5] = (*((limb *) & in[35])) & bottom56bits;
+    out[6] = (*((limb *) & in[40])) >> 16;
+}
+
+/*
+ * felem_to_bin48 takes an felem and serialises into a little endian, 48 byte
+ * array. This assumes that the CPU is little-endian.
+ */
+static void felem_to_bin48(u8 out[48], const felem in)
+{
+    memset(out, 0, 48);
+    (*((limb *) & out[0])) |= in[0];
+    (*((limb *) & out[7])) |= in[1];
+    (*((limb *) & out[14])) |= in[2];
+    (*((limb *) & out[21])) |= in[3];
+    (*((limb *) & out[28])) |= in[4];
+    (*((limb *) & out[35])) |= in[5];
+    (*((limb *) & out[40])) |= in[6] << 16;
+}
+
+/* BN_to_felem converts an OpenSSL BIGNUM into an felem */
+static int BN_to_felem(felem out, const BIGNUM *bn)
+{
+    felem_bytearray b_out;
+    int num_bytes;
+
+    if (BN_is_negative(bn)) {
+        ECerr(EC_F_BN_TO_FELEM, EC_R_BIGNUM_OUT_OF_RANGE);
+        return 0;
+    }
+    num_bytes = BN_bn2lebinpad(bn, b_out, sizeof(b_out));
+    if (num_bytes < 0) {
+        ECerr(EC_F_BN_TO_FELEM, EC_R_BIGNUM_OUT_OF_RANGE);
+        return 0;
+    }
+    bin48_to_felem(out, b_out);
+    return 1;
+}
+
+/* felem_to_BN converts an felem into an OpenSSL BIGNUM */
+static BIGNUM *felem_to_BN(BIGNUM *out, const felem in)
+{
+    felem_bytearray b_out;
+    felem_to_bin48(b_out, in);
+    return BN_lebin2bn(b_out, sizeof(b_out), out);
+}
+
+/*-
+ * Field operations
+ * ----------------
+ */
+
+static void felem_one(felem out)
+{
+    out[0] = 1;
+    out[1] = 0;
+    out[2] = 0;
+    out[3] = 0;
+    out[4] = 0;
+    out[5] = 0;
+    out[6] = 0;
+}
+
+static void felem_assign(felem out, const felem in)
+{
+    out[0] = in[0];
+    out[1] = in[1];
+    out[2] = in[2];
+    out[3] = in[3];
+    out[4] = in[4];
+    out[5] = in[5];
+    out[6] = in[6];
+}
+
+/* felem_sum64 sets out = out + in. */
+static void felem_sum64(felem out, const felem in)
+{
+    out[0] += in[0];
+    out[1] += in[1];
+    out[2] += in[2];
+    out[3] += in[3];
+    out[4] += in[4];
+    out[5] += in[5];
+    out[6] += in[6];
+}
+
+/* felem_scalar sets out = in * scalar */
+static void felem_scalar(felem out, const felem in, limb scalar)
+{
+    out[0] = in[0] * scalar;
+    out[1] = in[1] * scalar;
+    out[2] = in[2] * scalar;
+    out[3] = in[3] * scalar;
+    out[4] = in[4] * scalar;
+    out[5] = in[5] * scalar;
+    out[6] = in[6] * scalar;
+}
+
+/* felem_scalar64 sets out = out * scalar */
+static void felem_scalar64(felem out, limb scalar)
+{
+    out[0] *= scalar;
+    out[1] *= scalar;
+    out[2] *= scalar;
+    out[3] *= scalar;
+    out[4] *= scalar;
+    out[5] *= scalar;
+    out[6] *= scalar;
+}
+
+/*
+ * 2^12*p, written with every limb above 2^59 so that any felem with limbs
+ * below that can be subtracted from it without underflow.
+ */
+static const limb two60p44m12 =
+    (((limb) 1) << 60) + (((limb) 1) << 44) - (((limb) 1) << 12);
+static const limb two60m52m4 =
+    (((limb) 1) << 60) - (((limb) 1) << 52) - (((limb) 1) << 4);
+static const limb two60m28m4 =
+    (((limb) 1) << 60) - (((limb) 1) << 28) - (((limb) 1) << 4);
+static const limb two60m4 = (((limb) 1) << 60) - (((limb) 1) << 4);
+
+/*-
+ * felem_neg sets |out| to |-in|
+ * On entry:
+ *   in[i] < 2^59
+ * On exit:
+ *   out[i] < 2^61
+ */
+static void felem_neg(felem out, const felem in)
+{
+    out[0] = two60p44m12 - in[0];
+    out[1] = two60m52m4 - in[1];
+    out[2] = two60m28m4 - in[2];
+    out[3] = two60m4 - in[3];
+    out[4] = two60m4 - in[4];
+    out[5] = two60m4 - in[5];
+    out[6] = two60m4 - in[6];
+}
+
+/*-
+ * felem_diff64 subtracts |in| from |out|
+ * On entry:
+ *   in[i] < 2^59
+ * On exit:
+ *   out[i] < out[i] + 2^61
+ */
+static void felem_diff64(felem out, const felem in)
+{
+    out[0] += two60p44m12 - in[0];
+    out[1] += two60m52m4 - in[1];
+    out[2] += two60m28m4 - in[2];
+    out[3] += two60m4 - in[3];
+    out[4] += two60m4 - in[4];
+    out[5] += two60m4 - in[5];
+    out[6] += two60m4 - in[6];
+}
+
+/*-
+ * felem_diff_128_64 subtracts |in| from the low seven limbs of |out|
+ * On entry:
+ *   in[i] < 2^63
+ * On exit:
+ *   out[i] < out[i] + 2^65
+ */
+static void felem_diff_128_64(widefelem out, const felem in)
+{
+    /*
+     * In order to prevent underflow, we add 2^16*p, written with every limb
+     * above 2^63, before subtracting.
+     */
+    static const uint128_t two64p48m16 =
+        (((uint128_t) 1) << 64) + (((uint128_t) 1) << 48)
+        - (((uint128_t) 1) << 16);
+    static const uint128_t two64m56m8 =
+        (((uint128_t) 1) << 64) - (((uint128_t) 1) << 56)
+        - (((uint128_t) 1) << 8);
+    static const uint128_t two64m32m8 =
+        (((uint128_t) 1) << 64) - (((uint128_t) 1) << 32)
+        - (((uint128_t) 1) << 8);
+    static const uint128_t two64m8 =
+        (((uint128_t) 1) << 64) - (((uint128_t) 1) << 8);
+
+    out[0] += two64p48m16 - in[0];
+    out[1] += two64m56m8 - in[1];
+    out[2] += two64m32m8 - in[2];
+    out[3] += two64m8 - in[3];
+    out[4] += two64m8 - in[4];
+    out[5] += two64m8 - in[5];
+    out[6] += two64m8 - in[6];
+}
+
+/*-
+ * felem_square sets |out| = |in|^2
+ * On entry:
+ *   in[i] < 2^61
+ * On exit:
+ *   out[i] < 7 * 2^122 < 2^125
+ */
+static void felem_square(widefelem out, const felem in)
+{
+    felem inx2;
+    felem_scalar(inx2, in, 2);
+
+    /*
+     * As in ecp_nistp521.c, the cross terms in[x] * in[y] + in[y] * in[x]
+     * are computed as in[x] * 2*in[y] by reading from |inx2|.
+     */
+
+    out[0] = ((uint128_t) in[0]) * in[0];
+    out[1] = ((uint128_t) in[0]) * inx2[1];
+    out[2] = ((uint128_t) in[0]) * inx2[2] + ((uint128_t) in[1]) * in[1];
+    out[3] = ((uint128_t) in[0]) * inx2[3] + ((uint128_t) in[1]) * inx2[2];
+    out[4] = ((uint128_t) in[0]) * inx2[4] +
+             ((uint128_t) in[1]) * inx2[3] + ((uint128_t) in[2]) * in[2];
+    out[5] = ((uint128_t) in[0]) * inx2[5] +
+             ((uint128_t) in[1]) * inx2[4] + ((uint128_t) in[2]) * inx2[3];
+    out[6] = ((uint128_t) in[0]) * inx2[6] +
+             ((uint128_t) in[1]) * inx2[5] +
+             ((uint128_t) in[2]) * inx2[4] + ((uint128_t) in[3]) * in[3];
+    out[7] = ((uint128_t) in[1]) * inx2[6] +
+             ((uint128_t) in[2]) * inx2[5] + ((uint128_t) in[3]) * inx2[4];
+    out[8] = ((uint128_t) in[2]) * inx2[6] +
+             ((uint128_t) in[3]) * inx2[5] + ((uint128_t) in[4]) * in[4];
+    out[9] = ((uint128_t) in[3]) * inx2[6] + ((uint128_t) in[4]) * inx2[5];
+    out[10] = ((uint128_t) in[4]) * inx2[6] + ((uint128_t) in[5]) * in[5];
+    out[11] = ((uint128_t) in[5]) * inx2[6];
+    out[12] = ((uint128_t) in[6]) * in[6];
+}
+
+/*-
+ * felem_mul sets |out| = |in1| * |in2|
+ * On entry:
+ *   in1[i] < 2^61
+ *   in2[i] < 2^61
+ * On exit:
+ *   out[i] < 7 * 2^122 < 2^125
+ */
+static void felem_mul(widefelem out, const felem in1, const felem in2)
+{
+    out[0] = ((uint128_t) in1[0]) * in2[0];
+
+    out[1] = ((uint128_t) in1[0]) * in2[1] +
+             ((uint128_t) in1[1]) * in2[0];
+
+    out[2] = ((uint128_t) in1[0]) * in2[2] +
+             ((uint128_t) in1[1]) * in2[1] +
+             ((uint128_t) in1[2]) * in2[0];
+
+    out[3] = ((uint128_t) in1[0]) * in2[3] +
+             ((uint128_t) in1[1]) * in2[2] +
+             ((uint128_t) in1[2]) * in2[1] +
+             ((uint128_t) in1[3]) * in2[0];
+
+    out[4] = ((uint128_t) in1[0]) * in2[4] +
+             ((uint128_t) in1[1]) * in2[3] +
+             ((uint128_t) in1[2]) * in2[2] +
+             ((uint128_t) in1[3]) * in2[1] +
+             ((uint128_t) in1[4]) * in2[0];
+
+    out[5] = ((uint128_t) in1[0]) * in2[5] +
+             ((uint128_t) in1[1]) * in2[4] +
+             ((uint128_t) in1[2]) * in2[3] +
+             ((uint128_t) in1[3]) * in2[2] +
+             ((uint128_t) in1[4]) * in2[1] +
+             ((uint128_t) in1[5]) * in2[0];
+
+    out[6] = ((uint128_t) in1[0]) * in2[6] +
+             ((uint128_t) in1[1]) * in2[5] +
+             ((uint128_t) in1[2]) * in2[4] +
+             ((uint128_t) in1[3]) * in2[3] +
+             ((uint128_t) in1[4]) * in2[2] +
+             ((uint128_t) in1[5]) * in2[1] +
+             ((uint128_t) in1[6]) * in2[0];
+
+    out[7] = ((uint128_t) in1[1]) * in2[6] +
+             ((uint128_t) in1[2]) * in2[5] +
+             ((uint128_t) in1[3]) * in2[4] +
+             ((uint128_t) in1[4]) * in2[3] +
+             ((uint128_t) in1[5]) * in2[2] +
+             ((uint128_t) in1[6]) * in2[1];
+
+    out[8] = ((uint128_t) in1[2]) * in2[6] +
+             ((uint128_t) in1[3]) * in2[5] +
+             ((uint128_t) in1[4]) * in2[4] +
+             ((uint128_t) in1[5]) * in2[3] +
+             ((uint128_t) in1[6]) * in2[2];
+
+    out[9] = ((uint128_t) in1[3]) * in2[6] +
+             ((uint128_t) in1[4]) * in2[5] +
+             ((uint128_t) in1[5]) * in2[4] +
+             ((uint128_t) in1[6]) * in2[3];
+
+    out[10] = ((uint128_t) in1[4]) * in2[6] +
+              ((uint128_t) in1[5]) * in2[5] +
+              ((uint128_t) in1[6]) * in2[4];
+
+    out[11] = ((uint128_t) in1[5]) * in2[6] +
+              ((uint128_t) in1[6]) * in2[5];
+
+    out[12] = ((uint128_t) in1[6]) * in2[6];
+}
+
+/*-
+ * felem_reduce converts a widefelem to an felem.
+ * On entry:
+ *   in[i] < 2^127
+ * On exit:
+ *   out[i] < 2^57
+ *
+ * Limbs at or above 2^392 are folded down using
+ *   2^392 = 2^136 + 2^104 - 2^40 + 2^8  (mod p),
+ * i.e. a limb at 2^(392 + 56k) moves to limb k+2 shifted by 24, limb k+1
+ * shifted by 48 and limb k shifted by 8 and 40. Every substitution replaces
+ * a non-negative term by a non-negative one, so although individual limbs
+ * may go negative the value as a whole never does, and the signed carries
+ * below always leave a non-negative top limb.
+ */
+static void felem_reduce(felem out, const widefelem in)
+{
+    int128_t acc[2 * NLIMBS];
+    uint128_t carry;
+    unsigned i;
+
+    /* bring every limb but the top one below 2^56 */
+    carry = in[0];
+    acc[0] = carry & bottom56bits;
+    for (i = 1; i < 2 * NLIMBS - 1; i++) {
+        carry = (carry >> 56) + in[i];
+        acc[i] = carry & bottom56bits;
+    }
+    acc[2 * NLIMBS - 1] = carry >> 56;
+    /* acc[13] < 2^72 */
+
+    /* fold limbs 7 .. 13; limbs 7 and 8 pick up new, smaller values */
+    for (i = NLIMBS; i < 2 * NLIMBS; i++) {
+        acc[i - 5] += acc[i] << 24;
+        acc[i - 6] += acc[i] << 48;
+        acc[i - 7] += (acc[i] << 8) - (acc[i] << 40);
+        acc[i] = 0;
+    }
+    /* |acc[i]| < 2^122 */
+
+    for (i = 0; i < NLIMBS + 2; i++) {
+        acc[i + 1] += acc[i] >> 56;
+        acc[i] &= bottom56bits;
+    }
+    /* acc[9] < 2^42, all other limbs are now below 2^56 */
+
+    for (i = NLIMBS; i < NLIMBS + 3; i++) {
+        acc[i - 5] += acc[i] << 24;
+        acc[i - 6] += acc[i] << 48;
+        acc[i - 7] += (acc[i] << 8) - (acc[i] << 40);
+    }
+    /* |acc[i]| < 2^106 */
+
+    for (i = 0; i < NLIMBS - 1; i++) {
+        acc[i + 1] += acc[i] >> 56;
+        acc[i] &= bottom56bits;
+    }
+    /* acc[6] < 2^57 */
+
+    /* fold the bits above 2^384 */
+    carry = acc[6] >> 48;
+    acc[6] &= bottom48bits;
+    acc[0] += carry;
+    acc[0] -= carry << 32;
+    acc[1] += carry << 40;
+    acc[2] += carry << 16;
+    /*
+     * acc[0] may now be negative, but if it is then carry != 0 and acc[1]
+     * >= 2^40 absorbs the borrow.
+     */
+    acc[1] += acc[0] >> 56;
+    acc[0] &= bottom56bits;
+
+    out[0] = (limb) acc[0];
+    out[1] = (limb) acc[1];
+    out[2] = (limb) acc[2];
+    out[3] = (limb) acc[3];
+    out[4] = (limb) acc[4];
+    out[5] = (limb) acc[5];
+    out[6] = (limb) acc[6];
+}
+
+static void felem_square_reduce(felem out, const felem in)
+{
+    widefelem tmp;
+    felem_square(tmp, in);
+    felem_reduce(out, tmp);
+}
+
+static void felem_mul_reduce(felem out, const felem in1, const felem in2)
+{
+    widefelem tmp;
+    felem_mul(tmp, in1, in2);
+    felem_reduce(out, tmp);
+}
+
+/*-
+ * felem_inv calculates |out| = |in|^{-1}
+ *
+ * Based on Fermat's Little Theorem:
+ *   a^p = a (mod p)
+ *   a^{p-1} = 1 (mod p)
+ *   a^{p-2} = a^{-1} (mod p)
+ *
+ * p-2 is 255 ones, a zero, 32 ones, 64 zeros, 30 ones, a zero and a one.
+ */
+static void felem_inv(felem out, const felem in)
+{
+    felem x2, x3, x6, x12, x15, x30, x32, x60, x120, ftmp;
+    unsigned i;
+
+    felem_square_reduce(ftmp, in);
+    felem_mul_reduce(x2, ftmp, in);         /* 2^2 - 1 */
+    felem_square_reduce(ftmp, x2);
+    felem_mul_reduce(x3, ftmp, in);         /* 2^3 - 1 */
+
+    felem_assign(ftmp, x3);
+    for (i = 0; i < 3; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(x6, ftmp, x3);         /* 2^6 - 1 */
+
+    felem_assign(ftmp, x6);
+    for (i = 0; i < 6; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(x12, ftmp, x6);        /* 2^12 - 1 */
+
+    felem_assign(ftmp, x12);
+    for (i = 0; i < 3; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(x15, ftmp, x3);        /* 2^15 - 1 */
+
+    felem_assign(ftmp, x15);
+    for (i = 0; i < 15; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(x30, ftmp, x15);       /* 2^30 - 1 */
+
+    felem_assign(ftmp, x30);
+    for (i = 0; i < 2; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(x32, ftmp, x2);        /* 2^32 - 1 */
+
+    felem_assign(ftmp, x30);
+    for (i = 0; i < 30; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(x60, ftmp, x30);       /* 2^60 - 1 */
+
+    felem_assign(ftmp, x60);
+    for (i = 0; i < 60; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(x120, ftmp, x60);      /* 2^120 - 1 */
+
+    felem_assign(ftmp, x120);
+    for (i = 0; i < 120; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(ftmp, ftmp, x120);     /* 2^240 - 1 */
+
+    for (i = 0; i < 15; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(ftmp, ftmp, x15);      /* 2^255 - 1 */
+
+    for (i = 0; i < 33; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(ftmp, ftmp, x32);      /* 2^288 - 2^33 + 2^32 - 1 */
+
+    for (i = 0; i < 94; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(ftmp, ftmp, x30);      /* ... 64 zeros, 30 ones */
+
+    for (i = 0; i < 2; i++)
+        felem_square_reduce(ftmp, ftmp);
+    felem_mul_reduce(out, ftmp, in);        /* p - 2 */
+}
+
+/*-
+ * felem_contract converts |in| to its unique, minimal representation.
+ * On entry:
+ *   in[i] < 2^62
+ */
+static void felem_contract(felem out, const felem in)
+{
+    s64 tmp[NLIMBS], sub[NLIMBS], top;
+    limb mask;
+    unsigned i, j;
+
+    for (i = 0; i < NLIMBS; i++)
+        tmp[i] = (s64) in[i];
+
+    /*
+     * Carry and fold the bits above 2^384 twice. The first round leaves a
+     * value below 2^384 + 2^143; after the second it is below 2^384.
+     */
+    for (j = 0; j < 2; j++) {
+        for (i = 0; i < NLIMBS - 1; i++) {
+            tmp[i + 1] += tmp[i] >> 56;
+            tmp[i] &= bottom56bits;
+        }
+        top = tmp[6] >> 48;
+        tmp[6] &= bottom48bits;
+        tmp[0] += top;
+        tmp[0] -= top << 32;
+        tmp[1] += top << 40;
+        tmp[2] += top << 16;
+    }
+    for (i = 0; i < NLIMBS - 1; i++) {
+        tmp[i + 1] += tmp[i] >> 56;
+        tmp[i] &= bottom56bits;
+    }
+
+    /* Subtract p if the value is at least p. */
+    for (i = 0; i < NLIMBS; i++)
+        sub[i] = tmp[i] - (s64) kPrime[i];
+    for (i = 0; i < NLIMBS - 1; i++) {
+        sub[i + 1] += sub[i] >> 56;
+        sub[i] &= bottom56bits;
+    }
+    /* mask is all ones iff the subtraction underflowed */
+    mask = 0 - (((limb) sub[6]) >> 63);
+    for (i = 0; i < NLIMBS; i++)
+        out[i] = (((limb) tmp[i]) & mask) | (((limb) sub[i]) & ~mask);
+}
+
+/*-
+ * felem_is_zero returns a limb with all bits set if |in| == 0 (mod p) and 0
+ * otherwise.
+ * On entry:
+ *   in[i] < 2^62
+ */
+static limb felem_is_zero(const felem in)
+{
+    felem ftmp;
+    limb is_zero;
+
+    felem_contract(ftmp, in);
+
+    is_zero = ftmp[0];
+    is_zero |= ftmp[1];
+    is_zero |= ftmp[2];
+    is_zero |= ftmp[3];
+    is_zero |= ftmp[4];
+    is_zero |= ftmp[5];
+    is_zero |= ftmp[6];
+
+    is_zero--;
+    /*
+     * We know that ftmp[i] < 2^56, therefore the only way that the top bit
+     * can be set is if is_zero was 0 before the decrement.
+     */
+    return 0 - (is_zero >> 63);
+}
+
+static int felem_is_zero_int(const void *in)
+{
+    return (int)(felem_is_zero(in) & ((limb) 1));
+}
+
+/*-
+ * Group operations
+ * ----------------
+ *
+ * Building on top of the field operations we have the operations on the
+ * elliptic curve group itself. Points on the curve are represented in Jacobian
+ * coordinates */
+
+/*-
+ * point_double calculates 2*(x_in, y_in, z_in)
+ *
+ * The method is taken from:
+ *   http://hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-3.html#doubling-dbl-2001-b
+ *
+ * Outputs can equal corresponding inputs, i.e., x_out == x_in is allowed.
+ * while x_out == y_in is not (maybe this works, but it's not tested).
+ * Inputs must satisfy in[i] < 2^57. */
+static void
+point_double(felem x_out, felem y_out, felem z_out,
+             const felem x_in, const felem y_in, const felem z_in)
+{
+    widefelem tmp;
+    felem delta, gamma, beta, alpha, ftmp, ftmp2;
+
+    felem_assign(ftmp, x_in);
+    felem_assign(ftmp2, x_in);
+
+    /* delta = z^2 */
+    felem_square(tmp, z_in);
+    felem_reduce(delta, tmp);   /* delta[i] < 2^57 */
+
+    /* gamma = y^2 */
+    felem_square(tmp, y_in);
+    felem_reduce(gamma, tmp);   /* gamma[i] < 2^57 */
+
+    /* beta = x*gamma */
+    felem_mul(tmp, x_in, gamma);
+    felem_reduce(beta, tmp);    /* beta[i] < 2^57 */
+
+    /* alpha = 3*(x-delta)*(x+delta) */
+    felem_diff64(ftmp, delta);
+    /* ftmp[i] < 2^57 + 2^61 */
+    felem_sum64(ftmp2, delta);
+    /* ftmp2[i] < 2^58 */
+    felem_scalar64(ftmp2, 3);
+    /* ftmp2[i] < 3*2^58 */
+    felem_mul(tmp, ftmp, ftmp2);
+    /* tmp[i] < 7 * 2^62 * 2^60 < 2^125 */
+    felem_reduce(alpha, tmp);
+
+    /* x' = alpha^2 - 8*beta */
+    felem_square(tmp, alpha);
+    felem_assign(ftmp, beta);
+    felem_scalar64(ftmp, 8);
+    /* ftmp[i] < 2^60 */
+    felem_diff_128_64(tmp, ftmp);
+    felem_reduce(x_out, tmp);
+
+    /* z' = (y + z)^2 - gamma - delta */
+    felem_sum64(delta, gamma);
+    /* delta[i] < 2^58 */
+    felem_assign(ftmp, y_in);
+    felem_sum64(ftmp, z_in);
+    /* ftmp[i] < 2^58 */
+    felem_square(tmp, ftmp);
+    felem_diff_128_64(tmp, delta);
+    felem_reduce(z_out, tmp);
+
+    /* y' = alpha*(4*beta - x') - 8*gamma^2 */
+    felem_scalar64(beta, 4);
+    /* beta[i] < 2^59 */
+    felem_diff64(beta, x_out);
+    /* beta[i] < 2^59 + 2^61 */
+    felem_mul(tmp, alpha, beta);
+    /* tmp[i] < 7 * 2^57 * 2^62 < 2^122 */
+    felem_square_reduce(gamma, gamma);
+    felem_scalar64(gamma, 8);
+    /* gamma[i] < 2^60 */
+    felem_diff_128_64(tmp, gamma);
+    felem_reduce(y_out, tmp);
+}
+
+/* copy_conditional copies in to out iff mask is all ones. */
+static void copy_conditional(felem out, const felem in, limb mask)
+{
+    unsigned i;
+    for (i = 0; i < NLIMBS; ++i) {
+        const limb tmp = mask & (in[i] ^ out[i]);
+        out[i] ^= tmp;
+    }
+}
+
+/*-
+ * point_add calculates (x1, y1, z1) + (x2, y2, z2)
+ *
+ * The method is taken from
+ *   http://hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-3.html#addition-add-2007-bl,
+ * adapted for mixed addition (z2 = 1, or z2 = 0 for the point at infinity).
+ *
+ * This function includes a branch for checking whether the two input points
+ * are equal (while not equal to the point at infinity). See comment below
+ * on constant-time.
+ *
+ * Inputs must satisfy in[i] < 2^57.
+ */
+static void point_add(felem x3, felem y3, felem z3,
+                      const felem x1, const felem y1, const felem z1,
+                      const int mixed, const felem x2, const felem y2,
+                      const felem z2)
+{
+    felem ftmp, ftmp2, ftmp3, ftmp4, ftmp5, ftmp6, x_out, y_out, z_out;
+    widefelem tmp;
+    limb x_equal, y_equal, z1_is_zero, z2_is_zero;
+
+    z1_is_zero = felem_is_zero(z1);
+    z2_is_zero = felem_is_zero(z2);
+
+    /* ftmp = z1z1 = z1**2 */
+    felem_square(tmp, z1);
+    felem_reduce(ftmp, tmp);
+
+    if (!mixed) {
+        /* ftmp2 = z2z2 = z2**2 */
+        felem_square(tmp, z2);
+        felem_reduce(ftmp2, tmp);
+
+        /* u1 = ftmp3 = x1*z2z2 */
+        felem_mul(tmp, x1, ftmp2);
+        felem_reduce(ftmp3, tmp);
+
+        /* ftmp5 = z1 + z2 */
+        felem_assign(ftmp5, z1);
+        felem_sum64(ftmp5, z2);
+        /* ftmp5[i] < 2^58 */
+
+        /* ftmp5 = (z1 + z2)**2 - z1z1 - z2z2 = 2*z1z2 */
+        felem_square(tmp, ftmp5);
+        felem_diff_128_64(tmp, ftmp);
+        felem_diff_128_64(tmp, ftmp2);
+        felem_reduce(ftmp5, tmp);
+
+        /* ftmp2 = z2 * z2z2 */
+        felem_mul(tmp, ftmp2, z2);
+        felem_reduce(ftmp2, tmp);
+
+        /* s1 = ftmp6 = y1 * z2**3 */
+        felem_mul(tmp, y1, ftmp2);
+        felem_reduce(ftmp6, tmp);
+    } else {
+        /*
+         * We'll assume z2 = 1 (special case z2 = 0 is handled later)
+         */
+
+        /* u1 = ftmp3 = x1*z2z2 */
+        felem_assign(ftmp3, x1);
+
+        /* ftmp5 = 2*z1z2 */
+        felem_scalar(ftmp5, z1, 2);
+
+        /* s1 = ftmp6 = y1 * z2**3 */
+        felem_assign(ftmp6, y1);
+    }
+
+    /* u2 = x2*z1z1 */
+    felem_mul(tmp, x2, ftmp);
+
+    /* h = ftmp4 = u2 - u1 */
+    felem_diff_128_64(tmp, ftmp3);
+    felem_reduce(ftmp4, tmp);
+
+    x_equal = felem_is_zero(ftmp4);
+
+    /* z_out = ftmp5 * h */
+    felem_mul(tmp, ftmp5, ftmp4);
+    felem_reduce(z_out, tmp);
+
+    /* ftmp = z1 * z1z1 */
+    felem_mul(tmp, ftmp, z1);
+    felem_reduce(ftmp, tmp);
+
+    /* s2 = tmp = y2 * z1**3 */
+    felem_mul(tmp, y2, ftmp);
+
+    /* r = ftmp5 = (s2 - s1)*2 */
+    felem_diff_128_64(tmp, ftmp6);
+    felem_reduce(ftmp5, tmp);
+    y_equal = felem_is_zero(ftmp5);
+    felem_scalar64(ftmp5, 2);
+    /* ftmp5[i] < 2^58 */
+
+    if (x_equal && y_equal && !z1_is_zero && !z2_is_zero) {
+        /*
+         * This is obviously not constant-time but it will almost-never happen
+         * for ECDH / ECDSA. The case where it can happen is during scalar-mult
+         * where the intermediate value gets very close to the group order.
+         * Since |ec_GFp_nistp_recode_scalar_bits| produces signed digits for
+         * the scalar, it's possible for the intermediate value to be a small
+         * negative multiple of the base point, and for the final signed digit
+         * to be the same value. See the comment in ecp_nistp521.c; the timing
+         * leak is irrelevant for the same reason.
+         */
+        point_double(x3, y3, z3, x1, y1, z1);
+        return;
+    }
+
+    /* I = ftmp = (2h)**2 */
+    felem_assign(ftmp, ftmp4);
+    felem_scalar64(ftmp, 2);
+    /* ftmp[i] < 2^58 */
+    felem_square(tmp, ftmp);
+    felem_reduce(ftmp, tmp);
+
+    /* J = ftmp2 = h * I */
+    felem_mul(tmp, ftmp4, ftmp);
+    felem_reduce(ftmp2, tmp);
+
+    /* V = ftmp4 = U1 * I */
+    felem_mul(tmp, ftmp3, ftmp);
+    felem_reduce(ftmp4, tmp);
+
+    /* x_out = r**2 - J - 2V */
+    felem_square(tmp, ftmp5);
+    felem_diff_128_64(tmp, ftmp2);
+    felem_assign(ftmp3, ftmp4);
+    felem_scalar64(ftmp4, 2);
+    /* ftmp4[i] < 2^58 */
+    felem_diff_128_64(tmp, ftmp4);
+    felem_reduce(x_out, tmp);
+
+    /* y_out = r(V-x_out) - 2 * s1 * J */
+    felem_diff64(ftmp3, x_out);
+    /* ftmp3[i] < 2^57 + 2^61 */
+    felem_mul(tmp, ftmp5, ftmp3);
+    felem_mul_reduce(ftmp6, ftmp6, ftmp2);
+    felem_scalar64(ftmp6, 2);
+    /* ftmp6[i] < 2^58 */
+    felem_diff_128_64(tmp, ftmp6);
+    felem_reduce(y_out, tmp);
+
+    copy_conditional(x_out, x2, z1_is_zero);
+    copy_conditional(x_out, x1, z2_is_zero);
+    copy_conditional(y_out, y2, z1_is_zero);
+    copy_conditional(y_out, y1, z2_is_zero);
+    copy_conditional(z_out, z2, z1_is_zero);
+    copy_conditional(z_out, z1, z2_is_zero);
+    felem_assign(x3, x_out);
+    felem_assign(y3, y_out);
+    felem_assign(z3, z_out);
+}
+
+/*-
+ * Base point pre computation
+ * --------------------------
+ *
+ * Two different sorts of precomputed tables are used in the following code.
+ * Each contain various points on the curve, where each point is three field
+ * elements (x, y, z).
+ *
+ * For the base point table, z is usually 1 (0 for the point at infinity).
+ * This table has 2 * 16 elements, starting with the following:
+ * index | bits    | point
+ * ------+---------+------------------------------
+ *     0 | 0 0 0 0 | 0G
+ *     1 | 0 0 0 1 | 1G
+ *     2 | 0 0 1 0 | 2^96G
+ *     3 | 0 0 1 1 | (2^96 + 1)G
+ *     4 | 0 1 0 0 | 2^192G
+ *     5 | 0 1 0 1 | (2^192 + 1)G
+ *     6 | 0 1 1 0 | (2^192 + 2^96)G
+ *     7 | 0 1 1 1 | (2^192 + 2^96 + 1)G
+ *     8 | 1 0 0 0 | 2^288G
+ *     9 | 1 0 0 1 | (2^288 + 1)G
+ *    10 | 1 0 1 0 | (2^288 + 2^96)G
+ *    11 | 1 0 1 1 | (2^288 + 2^96 + 1)G
+ *    12 | 1 1 0 0 | (2^288 + 2^192)G
+ *    13 | 1 1 0 1 | (2^288 + 2^192 + 1)G
+ *    14 | 1 1 1 0 | (2^288 + 2^192 + 2^96)G
+ *    15 | 1 1 1 1 | (2^288 + 2^192 + 2^96 + 1)G
+ * followed by a copy of this with each element multiplied by 2^48.
+ *
+ * The reason for this is so that we can clock bits into four different
+ * locations when doing simple scalar multiplies against the base point,
+ * and then another four locations using the second 16 elements.
+ *
+ * Tables for other points have table[i] = iG for i in 0 .. 16. */
+
+/* gmul is the table of precomputed base points */
+static const felem gmul[2][16][3] = {
+    {{{0, 0, 0, 0, 0, 0, 0},
+      {0, 0, 0, 0, 0, 0, 0},
+      {0, 0, 0, 0, 0, 0, 0}},
+     {{0x00545e3872760ab7, 0x00f25dbf55296c3a, 0x00e082542a385502,
+       0x008ba79b9859f741, 0x0020ad746e1d3b62, 0x0005378eb1c71ef3,
+       0x0000aa87ca22be8b},
+      {0x00431d7c90ea0e5f, 0x00b1ce1d7e819d7a, 0x0013b5f0b8c00a60,
+       0x00289a147ce9da31, 0x0092dc29f8f41dbd, 0x002c6f5d9e98bf92,
+       0x00003617de4a9626},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00c1b328d8ee21c9, 0x000c91558717db39, 0x008b3f8686a92c3e,
+       0x0018141b1a4b5880, 0x00ca7abc43603909, 0x00bd1bd6e98b0d37,
+       0x0000f532389a060c},
+      {0x007e183923d86ecd, 0x0031b1085a4e9a7a, 0x005abe64360331ea,
+       0x00a2124163bc40ce, 0x003a82babd22cfb2, 0x008e696f04caa2de,
+       0x0000b9d2852cc3b3},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x004e5246eb09a0e5, 0x00be1132cdf03c26, 0x00835faefa4ff8f4,
+       0x0017a31b22da9d54, 0x00f06145bbbc4fd0, 0x002cabc3decd0c86,
+       0x0000528ef1670a5f},
+      {0x001e9858c14f0dd6, 0x0038a809cb75248a, 0x00b4c87fed225505,
+       0x00631d058dbd60ca, 0x001dcf14f8b76fdd, 0x00f56c5803eaa11a,
+       0x00007b9b1fbe7bcc},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x0028b09aaa03bd53, 0x005458a4f52d78a6, 0x00894d10ddeaba06,
+       0x008a3e297ddb2987, 0x00421279b42a31af, 0x0019c440f7f9e706,
+       0x0000c19e0b4c8001},
+      {0x002d0fc5e6c88c41, 0x00aa6de639d85882, 0x00d135f6ebf2af68,
+       0x00e3567af9c1c7ca, 0x005b77f6577a30ea, 0x00b301e5a0191d1f,
+       0x000016f3fdbf0356},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00991560aa133909, 0x00dbb1c6cb001730, 0x0024b860fae69097,
+       0x0070b375ddd37de4, 0x006ce3a39bb183b2, 0x003088567a6233cd,
+       0x0000aab8bb9f0fdc},
+      {0x00c5b981600ad5a6, 0x0073f2d62faa4416, 0x00b3c9747bf3ebdf,
+       0x0015eb04ac6d955b, 0x002050b5f6005fc8, 0x006d28f0af01d128,
+       0x000048942f81314f},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x002211217716605e, 0x00d2c89ef281c820, 0x0099567d63422347,
+       0x0077c0f03f54ba45, 0x00367444ce0fba30, 0x00a0527022f802cb,
+       0x00007334a936a9a6},
+      {0x00461f68d658a01a, 0x00d519c2bd0efab5, 0x008f697a92800a64,
+       0x007d0e017a9e2eee, 0x00bd4ccd8e5d9b89, 0x00c9261f7c5c367c,
+       0x00007ffceff7f632},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x000ae2e60e758344, 0x00707a371a2ca530, 0x00105052dd32451c,
+       0x004862b95425651d, 0x0081ef13bf88de7f, 0x00090efafce26e03,
+       0x0000dc916c17960e},
+      {0x0017cc44026b0889, 0x001ff19b42441bed, 0x0078cc16069795c0,
+       0x000ba04a35408964, 0x001c295252d154b8, 0x00ca0ab3d92ea470,
+       0x0000266e8a40d69e},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00bfc2c04905ca71, 0x00450ad156f761e4, 0x00dbd08848c2f33a,
+       0x00a23096863d8b29, 0x004972d7097da395, 0x00aa12211905035f,
+       0x0000b2d1055817cb},
+      {0x00cebb55753ee324, 0x00b07c6924666fdd, 0x00744ecf1a68e87a,
+       0x002e6236c09b475d, 0x00fd056bf82be8f5, 0x00cbd2237c0dba3c,
+       0x0000354cd872c3c6},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00104d24708d4cee, 0x006958819cf0438d, 0x00faf0712210197d,
+       0x005c20155847fc87, 0x001ef638103df785, 0x00bfec30b0a9e861,
+       0x000000b19ac8fdfe},
+      {0x000e8d6fd201e03e, 0x00969c2228ff5fd4, 0x0082636164c5bb7c,
+       0x00e754220d688102, 0x00f6edc4cdbb3cd2, 0x0060311418fe25e9,
+       0x0000a72f91059ee3},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00d2c273b769737a, 0x00245197d53ffd64, 0x004be86c46bd2cc0,
+       0x00685e926dc3b6ac, 0x00203a3617e9411f, 0x00b27e136df36b75,
+       0x00003f9561e08bf0},
+      {0x006ff8d527e990a7, 0x00e586f9867a60dd, 0x00478554e014c34b,
+       0x006f52e4cbea0887, 0x002ab641cfced664, 0x0095874b1a5a2041,
+       0x00000b06f0063962},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x004c0dd285651f82, 0x0051e7785d3ef704, 0x006188e95532325c,
+       0x00522c2931b83a18, 0x0080f137539f94ad, 0x0066d715274e5b89,
+       0x00009fd7b010df0f},
+      {0x00a7b94a4064e4c0, 0x00ba4525d7d211e4, 0x0054be8a04e3d44e,
+       0x00149033de0a806b, 0x00739246929226bd, 0x000225795f6fa3c9,
+       0x0000321aa9a3b926},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00bcc2f58b707b8e, 0x00b5191d92898349, 0x00567d49c7802901,
+       0x004c6a99642e4c29, 0x00ee3e13ebd1cff8, 0x0068f72caebbd316,
+       0x000036a543eea87a},
+      {0x00b41c29b569946d, 0x00e7d43ef2267e75, 0x0072d4b3394d1510,
+       0x008fbd85d1912350, 0x00a6784758eaff04, 0x00e41cd349ab0378,
+       0x0000f277bacda50e},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00b056585f863bbd, 0x00dc5ab483283d10, 0x0009dc7c421de92c,
+       0x006d01a5a8ebb312, 0x008b6a513afcbd79, 0x007aebe2b067caa0,
+       0x0000026e0dc2e8cb},
+      {0x00c3502902dde18a, 0x005facd8c6cf36d8, 0x000110781e4564c1,
+       0x001f3443d817ea27, 0x007461a5d68d1ffc, 0x0024e14be256378c,
+       0x0000ae8866bad8ef},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x003a78d0d265a91c, 0x00f8ef6c8f83d3ac, 0x00de8fd8d8171a29,
+       0x00c42bf748ef98fd, 0x00a73dc7df459ea1, 0x00fa2d14dafc3981,
+       0x0000b03dfa54c52a},
+      {0x00406f6e6c0d2ce7, 0x000b2b41fd72cacc, 0x000678f602ddcd12,
+       0x008accf229ef5d90, 0x006d908af5f8a2d1, 0x0085f2aafd1fcfce,
+       0x00002ce2885a0e6d},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00109a0ec62666de, 0x002e757ffcd01e89, 0x0069c48b5ab0c8c1,
+       0x00f983ac6ca82061, 0x00977d234bc2fdcf, 0x00c96a59cfca7155,
+       0x00001264cb335766},
+      {0x006913812e014b4b, 0x008707e4483ec56b, 0x000cffb1975831d2,
+       0x0065a5f248cbf719, 0x003b4f69b66717a0, 0x00a376d94ad8fac5,
+       0x0000119ebeeea1a1},
+      {1, 0, 0, 0, 0, 0, 0}}},
+    {{{0, 0, 0, 0, 0, 0, 0},
+      {0, 0, 0, 0, 0, 0, 0},
+      {0, 0, 0, 0, 0, 0, 0}},
+     {{0x0012e340f47168ac, 0x00d3a09008070591, 0x00a1cc7fdedf3917,
+       0x008512e48ab6971d, 0x00f6297ecbd8aa25, 0x00b6a3804100caa7,
+       0x0000f19c3f9b433e},
+      {0x00e0b1762d8b523f, 0x0078cb39d2cf6c45, 0x008bee4928be1b70,
+       0x005a620149af40b6, 0x0038904565d24d48, 0x00090c4a1e9b515d,
+       0x0000ae61a171f610},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x005e0f5d2805e596, 0x00a01d262810506f, 0x0053ee0d124b89bb,
+       0x00badc49fb712e12, 0x00f0c000d214b583, 0x00c3ef049f9294aa,
+       0x00004e5a9dfe6ac2},
+      {0x005622c691013e25, 0x00321bced6e71496, 0x003d0051e0574b8f,
+       0x007a5e5a25b5a060, 0x006b571281a2b658, 0x00f1717bdd7fa630,
+       0x0000526f1b07f6ac},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00ff5ece88f05154, 0x00be4f62091c2c9b, 0x00b4fc1b7102b008,
+       0x00bf37e0c6bc5cd1, 0x0012eb0e1eadfda0, 0x004fcf1c4a42aae9,
+       0x0000aef19fb9e788},
+      {0x001276425b94e7af, 0x00a2a398102462b8, 0x005834e2fa7ae591,
+       0x00e9413a45ca4d2b, 0x00783cd6fe84fc47, 0x00532f7814995822,
+       0x000023d1ed959bb5},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00de52c7a213e83b, 0x0092d055db2392b3, 0x007fa76f70c9464a,
+       0x00455c1c820f5490, 0x001bfebcf03811a5, 0x00fa7fdbc082aba7,
+       0x0000c6b405288edf},
+      {0x007bb07de3636016, 0x009e9a4c00333ac0, 0x000753eec12112b2,
+       0x00640707c9888e19, 0x00519fa164acc0d1, 0x00eafbb78ca0ff03,
+       0x00005c88fb72c6c4},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00bd2b8ef75508fc, 0x00f29262bfd0c558, 0x0030142ab328a91b,
+       0x00632c89cf88d90e, 0x002d6788729f12b6, 0x004dc6c892750221,
+       0x0000e5003a3f2915},
+      {0x0090953325010799, 0x008d422bb5ff4b0c, 0x003576aa7b5fe70c,
+       0x00a1c6f02e1c1a2a, 0x000ab45f38569944, 0x00d7abb580ce6abc,
+       0x000064aa8ae383c9},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x006f396e7c41cec4, 0x00cf56bdb3029a58, 0x00ffdc28f3ff6273,
+       0x00adcbfafc3e31b2, 0x000a9a632084e14d, 0x00e1dff39aa51ad4,
+       0x0000d1af43828307},
+      {0x00285854d1474980, 0x00b3be7bd30cbff4, 0x0016bdb54eeb6f9c,
+       0x004202560e69efed, 0x00181994b6456f62, 0x007bc3726ea875f8,
+       0x0000a922c4508358},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x000829822360374b, 0x0095a7bae9408424, 0x001074a33f398368,
+       0x004266b4fd8631b5, 0x00a51be58e09378b, 0x005e12e75930f90f,
+       0x0000a06ea7d1fd03},
+      {0x0020ab1e5cb6a429, 0x004118cb96b0e94f, 0x008963edba69630c,
+       0x00b2dc37cba862b0, 0x0077b186a7a42760, 0x00c396405292fe38,
+       0x0000abc08adc6dd6},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00b2e4383f385d2b, 0x008ac4932b516d35, 0x00fe51a3599f6e66,
+       0x00d12c0f3a8a1646, 0x006da385aee309ab, 0x00e9430231423bc4,
+       0x0000f23c10b4637e},
+      {0x00bc215d22248e00, 0x0047e3d45f6553c0, 0x0071daad7d1d9ed4,
+       0x001f2d8179af0847, 0x007bb3fdee94bf70, 0x00ac781e8c72ad26,
+       0x0000c425de168de7},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00a51c99470f3a77, 0x00228125d95dd3d8, 0x003e2a5fab8d8d6a,
+       0x005ac2cb2b57fa04, 0x00628e690677506d, 0x00fe6d134c04ee53,
+       0x000089d95ca20ecc},
+      {0x00c443936ee36b40, 0x006703663f07f9c4, 0x001eeb5d4d0bddba,
+       0x0094b962cc03e7dd, 0x0013cdb6f9d5c477, 0x0047a5eb8ffdb312,
+       0x00009d9927dab768},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00ad4eb3c058ec50, 0x003e243165e00596, 0x00abc2c17c13243b,
+       0x0010135494b483ca, 0x00cc3b8e97a8dc97, 0x0069f824f2c4750d,
+       0x000057d89c1ff7e7},
+      {0x00da442a7bc53acb, 0x001e5a7fb230cd3d, 0x004137b0654b143b,
+       0x00506caa55e86618, 0x002efddfae713a85, 0x0071ca4c177b58ee,
+       0x0000b3ad81083541},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00db76932d4575b7, 0x0073dfc259599ab6, 0x00bbdc10b088830d,
+       0x00d4ace4b2d93c90, 0x000b8d5bcec529b5, 0x001953db269d5d57,
+       0x00001ac4c02a73b1},
+      {0x004d4a8e642fd505, 0x004f3d58d2377703, 0x003eaefe54c00b1d,
+       0x004d8743d300d28d, 0x0082d9cf31b3a326, 0x0062048ac60d5abf,
+       0x0000ebc5abc0e494},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00d0739bc0539803, 0x006bd6cbbec2f6d3, 0x00554f8e076ba512,
+       0x00a5ef3a9a014976, 0x00a01bd3fd7bdc2b, 0x0090ee0d2ee2a8ef,
+       0x0000a905806485a3},
+      {0x00aa5cc6f93f855d, 0x0063117347e35a32, 0x00673141361c0a58,
+       0x000c0cc8b191209b, 0x00f4841d38f98f25, 0x006edf8de6ffdd57,
+       0x0000f5af1a9ac251},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00bd9de80856efa9, 0x0027c03c66ad4cbd, 0x0086aa0dd7a0a36f,
+       0x001314a5c1408ca4, 0x00c4c80f3e877b51, 0x00642956fec23eee,
+       0x0000217186f9324d},
+      {0x00d788ad470678f0, 0x005c3555f895260b, 0x00358fdae64162b9,
+       0x0054304321ef9454, 0x00e02dc8f8e08661, 0x0097edfa9ccf772b,
+       0x0000d419dae5f120},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x009366612dc6971d, 0x002082d99b377eb9, 0x007bee5f6ee7b09d,
+       0x00e8826c629f3759, 0x00cabf536e23d920, 0x003ff4bea835af08,
+       0x00003d245181ea77},
+      {0x0068abef0506d4c9, 0x002a29c53f53e148, 0x00cc5817bdbc91a3,
+       0x0048d6b592c1ed17, 0x009a972a20f09153, 0x00a6a5459978de71,
+       0x0000701432ee05a1},
+      {1, 0, 0, 0, 0, 0, 0}},
+     {{0x00306c550ef05a18, 0x00c94dff356193fa, 0x002d27730e609791,
+       0x0070831c35c0c6a1, 0x00449c11f5b0702a, 0x00111645872e8c32,
+       0x000006c21a5723a4},
+      {0x00704be004e4de38, 0x00e051aab21335ce, 0x00eac9d2f3c924c3,
+       0x0092b962d5bf3fc7, 0x00a8e06c5fffb892, 0x000e750660f04217,
+       0x0000b00515a9c0bf},
+      {1, 0, 0, 0, 0, 0, 0}}}
+};
+
+/*
+ * select_point selects the |idx|th point from a precomputation table and
+ * copies it to out.
+ */
+ /* pre_comp below is of the size provided in |size| */
+static void select_point(const limb idx, unsigned int size,
+                         const felem pre_comp[][3], felem out[3])
+{
+    unsigned i, j;
+    limb *outlimbs = &out[0][0];
+
+    memset(out, 0, sizeof(*out) * 3);
+
+    for (i = 0; i < size; i++) {
+        const limb *inlimbs = &pre_comp[i][0][0];
+        limb mask = i ^ idx;
+        mask |= mask >> 4;
+        mask |= mask >> 2;
+        mask |= mask >> 1;
+        mask &= 1;
+        mask--;
+        for (j = 0; j < NLIMBS * 3; j++)
+            outlimbs[j] |= inlimbs[j] & mask;
+    }
+}
+
+/* get_bit returns the |i|th bit in |in| */
+static char get_bit(const felem_bytearray in, int i)
+{
+    if ((i < 0) || (i >= 384))
+        return 0;
+    return (in[i >> 3] >> (i & 7)) & 1;
+}
+
+/*
+ * Interleaved point multiplication using precomputed point multiples: The
+ * small point multiples 0*P, 1*P, ..., 16*P are in pre_comp[], the scalars
+ * in scalars[]. If g_scalar is non-NULL, we also add this multiple of the
+ * generator, using certain (large) precomputed multiples in g_pre_comp.
+ * Output point (X, Y, Z) is stored in x_out, y_out, z_out
+ */
+static void batch_mul(felem x_out, felem y_out, felem z_out,
+                      const felem_bytearray scalars[],
+                      const unsigned num_points, const u8 *g_scalar,
+                      const int mixed, const felem pre_comp[][17][3],
+                      const felem g_pre_comp[2][16][3])
+{
+    int i, skip;
+    unsigned num, gen_mul = (g_scalar != NULL);
+    felem nq[3], tmp[4];
+    limb bits;
+    u8 sign, digit;
+
+    /* set nq to the point at infinity */
+    memset(nq, 0, sizeof(nq));
+
+    /*
+     * Loop over all scalars msb-to-lsb, interleaving additions of multiples
+     * of the generator (two in each of the last 48 rounds) and additions of
+     * other points multiples (every 5th round).
+     */
+    skip = 1;                   /* save two point operations in the first
+                                 * round */
+    for (i = (num_points ? 383 : 47); i >= 0; --i) {
+        /* double */
+        if (!skip)
+            point_double(nq[0], nq[1], nq[2], nq[0], nq[1], nq[2]);
+
+        /* add multiples of the generator */
+        if (gen_mul && (i <= 47)) {
+            /* first, look 48 bits upwards */
+            bits = get_bit(g_scalar, i + 336) << 3;
+            bits |= get_bit(g_scalar, i + 240) << 2;
+            bits |= get_bit(g_scalar, i + 144) << 1;
+            bits |= get_bit(g_scalar, i + 48);
+            /* select the point to add, in constant time */
+            select_point(bits, 16, g_pre_comp[1], tmp);
+
+            if (!skip) {
+                /* The 1 argument below is for "mixed" */
+                point_add(nq[0], nq[1], nq[2],
+                          nq[0], nq[1], nq[2], 1, tmp[0], tmp[1], tmp[2]);
+            } else {
+                memcpy(nq, tmp, 3 * sizeof(felem));
+                skip = 0;
+            }
+
+            /* second, look at the current position */
+            bits = get_bit(g_scalar, i + 288) << 3;
+            bits |= get_bit(g_scalar, i + 192) << 2;
+            bits |= get_bit(g_scalar, i + 96) << 1;
+            bits |= get_bit(g_scalar, i);
+            /* select the point to add, in constant time */
+            select_point(bits, 16, g_pre_comp[0], tmp);
+            /* The 1 argument below is for "mixed" */
+            point_add(nq[0], nq[1], nq[2],
+                      nq[0], nq[1], nq[2], 1, tmp[0], tmp[1], tmp[2]);
+        }
+
+        /* do other additions every 5 doublings */
+        if (num_points && (i % 5 == 0)) {
+            /* loop over all scalars */
+            for (num = 0; num < num_points; ++num) {
+                bits = get_bit(scalars[num], i + 4) << 5;
+                bits |= get_bit(scalars[num], i + 3) << 4;
+                bits |= get_bit(scalars[num], i + 2) << 3;
+                bits |= get_bit(scalars[num], i + 1) << 2;
+                bits |= get_bit(scalars[num], i) << 1;
+                bits |= get_bit(scalars[num], i - 1);
+                ec_GFp_nistp_recode_scalar_bits(&sign, &digit, bits);
+
+                /*
+                 * select the point to add or subtract, in constant time
+                 */
+                select_point(digit, 17, pre_comp[num], tmp);
+                felem_neg(tmp[3], tmp[1]); /* (X, -Y, Z) is the negative
+                                            * point */
+                copy_conditional(tmp[1], tmp[3], (-(limb) sign));
+                felem_contract(tmp[3], tmp[1]);
+                felem_assign(tmp[1], tmp[3]);
+
+                if (!skip) {
+                    point_add(nq[0], nq[1], nq[2],
+                              nq[0], nq[1], nq[2],
+                              mixed, tmp[0], tmp[1], tmp[2]);
+                } else {
+                    memcpy(nq, tmp, 3 * sizeof(felem));
+                    skip = 0;
+                }
+            }
+        }
+    }
+    felem_assign(x_out, nq[0]);
+    felem_assign(y_out, nq[1]);
+    felem_assign(z_out, nq[2]);
+}
+
+/* Precomputation for the group generator. */
+struct nistp384_pre_comp_st {
+    felem g_pre_comp[2][16][3];
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+};
+
+const EC_METHOD *EC_GFp_nistp384_method(void)
+{
+    static const EC_METHOD ret = {
+        EC_FLAGS_DEFAULT_OCT,
+        NID_X9_62_prime_field,
+        ec_GFp_nistp384_group_init,
+        ec_GFp_simple_group_finish,
+        ec_GFp_simple_group_clear_finish,
+        ec_GFp_nist_group_copy,
+        ec_GFp_nistp384_group_set_curve,
+        ec_GFp_simple_group_get_curve,
+        ec_GFp_simple_group_get_degree,
+        ec_group_simple_order_bits,
+        ec_GFp_simple_group_check_discriminant,
+        ec_GFp_simple_point_init,
+        ec_GFp_simple_point_finish,
+        ec_GFp_simple_point_clear_finish,
+        ec_GFp_simple_point_copy,
+        ec_GFp_simple_point_set_to_infinity,
+        ec_GFp_simple_set_Jprojective_coordinates_GFp,
+        ec_GFp_simple_get_Jprojective_coordinates_GFp,
+        ec_GFp_simple_point_set_affine_coordinates,
+        ec_GFp_nistp384_point_get_affine_coordinates,
+        0 /* point_set_compressed_coordinates */ ,
+        0 /* point2oct */ ,
+        0 /* oct2point */ ,
+        ec_GFp_simple_add,
+        ec_GFp_simple_dbl,
+        ec_GFp_simple_invert,
+        ec_GFp_simple_is_at_infinity,
+        ec_GFp_simple_is_on_curve,
+        ec_GFp_simple_cmp,
+        ec_GFp_simple_make_affine,
+        ec_GFp_simple_points_make_affine,
+        ec_GFp_nistp384_points_mul,
+        ec_GFp_nistp384_precompute_mult,
+        ec_GFp_nistp384_have_precompute_mult,
+        ec_GFp_nist_field_mul,
+        ec_GFp_nist_field_sqr,
+        0 /* field_div */ ,
+        ec_GFp_simple_field_inv,
+        0 /* field_encode */ ,
+        0 /* field_decode */ ,
+        0,                      /* field_set_to_one */
+        ec_key_simple_priv2oct,
+        ec_key_simple_oct2priv,
+        0, /* set private */
+        ec_key_simple_generate_key,
+        ec_key_simple_check_key,
+        ec_key_simple_generate_public_key,
+        0, /* keycopy */
+        0, /* keyfinish */
+        ecdh_simple_compute_key,
+        ecdsa_simple_sign_setup,
+        ecdsa_simple_sign_sig,
+        ecdsa_simple_verify_sig,
+        0, /* field_inverse_mod_ord */
+        0, /* blind_coordinates */
+        0, /* ladder_pre */
+        0, /* ladder_step */
+        0  /* ladder_post */
+    };
+
+    return &ret;
+}
+
+/******************************************************************************/
+/*
+ * FUNCTIONS TO MANAGE PRECOMPUTATION
+ */
+
+static NISTP384_PRE_COMP *nistp384_pre_comp_new(void)
+{
+    NISTP384_PRE_COMP *ret = OPENSSL_zalloc(sizeof(*ret));
+
+    if (ret == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        return ret;
+    }
+
+    ret->references = 1;
+
+    ret->lock = CRYPTO_THREAD_lock_new();
+    if (ret->lock == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+NISTP384_PRE_COMP *EC_nistp384_pre_comp_dup(NISTP384_PRE_COMP *p)
+{
+    int i;
+    if (p != NULL)
+        CRYPTO_UP_REF(&p->references, &i, p->lock);
+    return p;
+}
+
+void EC_nistp384_pre_comp_free(NISTP384_PRE_COMP *p)
+{
+    int i;
+
+    if (p == NULL)
+        return;
+
+    CRYPTO_DOWN_REF(&p->references, &i, p->lock);
+    REF_PRINT_COUNT("EC_nistp384", x);
+    if (i > 0)
+        return;
+    REF_ASSERT_ISNT(i < 0);
+
+    CRYPTO_THREAD_lock_free(p->lock);
+    OPENSSL_free(p);
+}
+
+/******************************************************************************/
+/*
+ * OPENSSL EC_METHOD FUNCTIONS
+ */
+
+int ec_GFp_nistp384_group_init(EC_GROUP *group)
+{
+    int ret;
+    ret = ec_GFp_simple_group_init(group);
+    group->a_is_minus3 = 1;
+    return ret;
+}
+
+int ec_GFp_nistp384_group_set_curve(EC_GROUP *group, const BIGNUM *p,
+                                    const BIGNUM *a, const BIGNUM *b,
+                                    BN_CTX *ctx)
+{
+    int ret = 0;
+    BIGNUM *curve_p, *curve_a, *curve_b;
+#ifndef FIPS_MODE
+    BN_CTX *new_ctx = NULL;
+
+    if (ctx == NULL)
+        ctx = new_ctx = BN_CTX_new();
+#endif
+    if (ctx == NULL)
+        return 0;
+
+    BN_CTX_start(ctx);
+    curve_p = BN_CTX_get(ctx);
+    curve_a = BN_CTX_get(ctx);
+    curve_b = BN_CTX_get(ctx);
+    if (curve_b == NULL)
+        goto err;
+    BN_bin2bn(nistp384_curve_params[0], sizeof(felem_bytearray), curve_p);
+    BN_bin2bn(nistp384_curve_params[1], sizeof(felem_bytearray), curve_a);
+    BN_bin2bn(nistp384_curve_params[2], sizeof(felem_bytearray), curve_b);
+    if ((BN_cmp(curve_p, p)) || (BN_cmp(curve_a, a)) || (BN_cmp(curve_b, b))) {
+        ECerr(0, EC_R_WRONG_CURVE_PARAMETERS);
+        goto err;
+    }
+    group->field_mod_func = BN_nist_mod_384;
+    ret = ec_GFp_simple_group_set_curve(group, p, a, b, ctx);
+ err:
+    BN_CTX_end(ctx);
+#ifndef FIPS_MODE
+    BN_CTX_free(new_ctx);
+#endif
+    return ret;
+}
+
+/*
+ * Takes the Jacobian coordinates (X, Y, Z) of a point and returns (X', Y') =
+ * (X/Z^2, Y/Z^3)
+ */
+int ec_GFp_nistp384_point_get_affine_coordinates(const EC_GROUP *group,
+                                                 const EC_POINT *point,
+                                                 BIGNUM *x, BIGNUM *y,
+                                                 BN_CTX *ctx)
+{
+    felem z1, z2, x_in, y_in, x_out, y_out;
+    widefelem tmp;
+
+    if (EC_POINT_is_at_infinity(group, point)) {
+        ECerr(0, EC_R_POINT_AT_INFINITY);
+        return 0;
+    }
+    if ((!BN_to_felem(x_in, point->X)) || (!BN_to_felem(y_in, point->Y)) ||
+        (!BN_to_felem(z1, point->Z)))
+        return 0;
+    felem_inv(z2, z1);
+    felem_square(tmp, z2);
+    felem_reduce(z1, tmp);
+    felem_mul(tmp, x_in, z1);
+    felem_reduce(x_in, tmp);
+    felem_contract(x_out, x_in);
+    if (x != NULL) {
+        if (!felem_to_BN(x, x_out)) {
+            ECerr(0, ERR_R_BN_LIB);
+            return 0;
+        }
+    }
+    felem_mul(tmp, z1, z2);
+    felem_reduce(z1, tmp);
+    felem_mul(tmp, y_in, z1);
+    felem_reduce(y_in, tmp);
+    felem_contract(y_out, y_in);
+    if (y != NULL) {
+        if (!felem_to_BN(y, y_out)) {
+            ECerr(0, ERR_R_BN_LIB);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* points below is of size |num|, and tmp_felems is of size |num+1| */
+static void make_points_affine(size_t num, felem points[][3],
+                               felem tmp_felems[])
+{
+    /*
+     * Runs in constant time, unless an input is the point at infinity (which
+     * normally shouldn't happen).
+     */
+    ec_GFp_nistp_points_make_affine_internal(num,
+                                             points,
+                                             sizeof(felem),
+                                             tmp_felems,
+                                             (void (*)(void *))felem_one,
+                                             felem_is_zero_int,
+                                             (void (*)(void *, const void *))
+                                             felem_assign,
+                                             (void (*)(void *, const void *))
+                                             felem_square_reduce, (void (*)
+                                                                   (void *,
+                                                                    const void
+                                                                    *,
+                                                                    const void
+                                                                    *))
+                                             felem_mul_reduce,
+                                             (void (*)(void *, const void *))
+                                             felem_inv,
+                                             (void (*)(void *, const void *))
+                                             felem_contract);
+}
+
+/*
+ * Computes scalar*generator + \sum scalars[i]*points[i], ignoring NULL
+ * values Result is stored in r (r can equal one of the inputs).
+ */
+int ec_GFp_nistp384_points_mul(const EC_GROUP *group, EC_POINT *r,
+                               const BIGNUM *scalar, size_t num,
+                               const EC_POINT *points[],
+                               const BIGNUM *scalars[], BN_CTX *ctx)
+{
+    int ret = 0;
+    int j;
+    int mixed = 0;
+    BIGNUM *x, *y, *z, *tmp_scalar;
+    felem_bytearray g_secret;
+    felem_bytearray *secrets = NULL;
+    felem (*pre_comp)[17][3] = NULL;
+    felem *tmp_felems = NULL;
+    unsigned i;
+    int num_bytes;
+    int have_pre_comp = 0;
+    size_t num_points = num;
+    felem x_in, y_in, z_in, x_out, y_out, z_out;
+    NISTP384_PRE_COMP *pre = NULL;
+    felem(*g_pre_comp)[16][3] = NULL;
+    EC_POINT *generator = NULL;
+    const EC_POINT *p = NULL;
+    const BIGNUM *p_scalar = NULL;
+
+    BN_CTX_start(ctx);
+    x = BN_CTX_get(ctx);
+    y = BN_CTX_get(ctx);
+    z = BN_CTX_get(ctx);
+    tmp_scalar = BN_CTX_get(ctx);
+    if (tmp_scalar == NULL)
+        goto err;
+
+    if (scalar != NULL) {
+        pre = group->pre_comp.nistp384;
+        if (pre)
+            /* we have precomputation, try to use it */
+            g_pre_comp = &pre->g_pre_comp[0];
+        else
+            /* try to use the standard precomputation */
+            g_pre_comp = (felem(*)[16][3]) gmul;
+        generator = EC_POINT_new(group);
+        if (generator == NULL)
+            goto err;
+        /* get the generator from precomputation */
+        if (!felem_to_BN(x, g_pre_comp[0][1][0]) ||
+            !felem_to_BN(y, g_pre_comp[0][1][1]) ||
+            !felem_to_BN(z, g_pre_comp[0][1][2])) {
+            ECerr(0, ERR_R_BN_LIB);
+            goto err;
+        }
+        if (!EC_POINT_set_Jprojective_coordinates_GFp(group,
+                                                      generator, x, y, z,
+                                                      ctx))
+            goto err;
+        if (0 == EC_POINT_cmp(group, generator, group->generator, ctx))
+            /* precomputation matches generator */
+            have_pre_comp = 1;
+        else
+            /*
+             * we don't have valid precomputation: treat the generator as a
+             * random point
+             */
+            num_points++;
+    }
+
+    if (num_points > 0) {
+        if (num_points >= 2) {
+            /*
+             * unless we precompute multiples for just one point, converting
+             * those into affine form is time well spent
+             */
+            mixed = 1;
+        }
+        secrets = OPENSSL_zalloc(sizeof(*secrets) * num_points);
+        pre_comp = OPENSSL_zalloc(sizeof(*pre_comp) * num_points);
+        if (mixed)
+            tmp_felems =
+                OPENSSL_malloc(sizeof(*tmp_felems) * (num_points * 17 + 1));
+        if ((secrets == NULL) || (pre_comp == NULL)
+            || (mixed && (tmp_felems == NULL))) {
+            ECerr(0, ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+
+        /*
+         * we treat NULL scalars as 0, and NULL points as points at infinity,
+         * i.e., they contribute nothing to the linear combination
+         */
+        for (i = 0; i < num_points; ++i) {
+            if (i == num) {
+                /*
+                 * we didn't have a valid precomputation, so we pick the
+                 * generator
+                 */
+                p = EC_GROUP_get0_generator(group);
+                p_scalar = scalar;
+            } else {
+                /* the i^th point */
+                p = points[i];
+                p_scalar = scalars[i];
+            }
+            if ((p_scalar != NULL) && (p != NULL)) {
+                /* reduce scalar to 0 <= scalar < 2^384 */
+                if ((BN_num_bits(p_scalar) > 384)
+                    || (BN_is_negative(p_scalar))) {
+                    /*
+                     * this is an unusual input, and we don't guarantee
+                     * constant-timeness
+                     */
+                    if (!BN_nnmod(tmp_scalar, p_scalar, group->order, ctx)) {
+                        ECerr(0, ERR_R_BN_LIB);
+                        goto err;
+                    }
+                    num_bytes = BN_bn2lebinpad(tmp_scalar,
+                                               secrets[i], sizeof(secrets[i]));
+                } else {
+                    num_bytes = BN_bn2lebinpad(p_scalar,
+                                               secrets[i], sizeof(secrets[i]));
+                }
+                if (num_bytes < 0) {
+                    ECerr(0, ERR_R_BN_LIB);
+                    goto err;
+                }
+                /* precompute multiples */
+                if ((!BN_to_felem(x_out, p->X)) ||
+                    (!BN_to_felem(y_out, p->Y)) ||
+                    (!BN_to_felem(z_out, p->Z)))
+                    goto err;
+                memcpy(pre_comp[i][1][0], x_out, sizeof(felem));
+                memcpy(pre_comp[i][1][1], y_out, sizeof(felem));
+                memcpy(pre_comp[i][1][2], z_out, sizeof(felem));
+                for (j = 2; j <= 16; ++j) {
+                    if (j & 1) {
+                        point_add(pre_comp[i][j][0], pre_comp[i][j][1],
+                                  pre_comp[i][j][2], pre_comp[i][1][0],
+                                  pre_comp[i][1][1], pre_comp[i][1][2], 0,
+                                  pre_comp[i][j - 1][0],
+                                  pre_comp[i][j - 1][1],
+                                  pre_comp[i][j - 1][2]);
+                    } else {
+                        point_double(pre_comp[i][j][0], pre_comp[i][j][1],
+                                     pre_comp[i][j][2], pre_comp[i][j / 2][0],
+                                     pre_comp[i][j / 2][1],
+                                     pre_comp[i][j / 2][2]);
+                    }
+                }
+            }
+        }
+        if (mixed)
+            make_points_affine(num_points * 17, pre_comp[0], tmp_felems);
+    }
+
+    /* the scalar for the generator */
+    if ((scalar != NULL) && (have_pre_comp)) {
+        memset(g_secret, 0, sizeof(g_secret));
+        /* reduce scalar to 0 <= scalar < 2^384 */
+        if ((BN_num_bits(scalar) > 384) || (BN_is_negative(scalar))) {
+            /*
+             * this is an unusual input, and we don't guarantee
+             * constant-timeness
+             */
+            if (!BN_nnmod(tmp_scalar, scalar, group->order, ctx)) {
+                ECerr(0, ERR_R_BN_LIB);
+                goto err;
+            }
+            num_bytes = BN_bn2lebinpad(tmp_scalar, g_secret, sizeof(g_secret));
+        } else {
+            num_bytes = BN_bn2lebinpad(scalar, g_secret, sizeof(g_secret));
+        }
+        /* do the multiplication with generator precomputation */
+        batch_mul(x_out, y_out, z_out,
+                  (const felem_bytearray(*))secrets, num_points,
+                  g_secret,
+                  mixed, (const felem(*)[17][3])pre_comp,
+                  (const felem(*)[16][3])g_pre_comp);
+    } else {
+        /* do the multiplication without generator precomputation */
+        batch_mul(x_out, y_out, z_out,
+                  (const felem_bytearray(*))secrets, num_points,
+                  NULL, mixed, (const felem(*)[17][3])pre_comp, NULL);
+    }
+    /* reduce the output to its unique minimal representation */
+    felem_contract(x_in, x_out);
+    felem_contract(y_in, y_out);
+    felem_contract(z_in, z_out);
+    if ((!felem_to_BN(x, x_in)) || (!felem_to_BN(y, y_in)) ||
+        (!felem_to_BN(z, z_in))) {
+        ECerr(0, ERR_R_BN_LIB);
+        goto err;
+    }
+    ret = EC_POINT_set_Jprojective_coordinates_GFp(group, r, x, y, z, ctx);
+
+ err:
+    BN_CTX_end(ctx);
+    EC_POINT_free(generator);
+    OPENSSL_free(secrets);
+    OPENSSL_free(pre_comp);
+    OPENSSL_free(tmp_felems);
+    return ret;
+}
+
+int ec_GFp_nistp384_precompute_mult(EC_GROUP *group, BN_CTX *ctx)
+{
+    int ret = 0;
+    NISTP384_PRE_COMP *pre = NULL;
+    int i, j;
+    BIGNUM *x, *y;
+    EC_POINT *generator = NULL;
+    felem tmp_felems[32];
+#ifndef FIPS_MODE
+    BN_CTX *new_ctx = NULL;
+#endif
+
+    /* throw away old precomputation */
+    EC_pre_comp_free(group);
+
+#ifndef FIPS_MODE
+    if (ctx == NULL)
+        ctx = new_ctx = BN_CTX_new();
+#endif
+    if (ctx == NULL)
+        return 0;
+
+    BN_CTX_start(ctx);
+    x = BN_CTX_get(ctx);
+    y = BN_CTX_get(ctx);
+    if (y == NULL)
+        goto err;
+    /* get the generator */
+    if (group->generator == NULL)
+        goto err;
+    generator = EC_POINT_new(group);
+    if (generator == NULL)
+        goto err;
+    BN_bin2bn(nistp384_curve_params[3], sizeof(felem_bytearray), x);
+    BN_bin2bn(nistp384_curve_params[4], sizeof(felem_bytearray), y);
+    if (!EC_POINT_set_affine_coordinates(group, generator, x, y, ctx))
+        goto err;
+    if ((pre = nistp384_pre_comp_new()) == NULL)
+        goto err;
+    /*
+     * if the generator is the standard one, use built-in precomputation
+     */
+    if (0 == EC_POINT_cmp(group, generator, group->generator, ctx)) {
+        memcpy(pre->g_pre_comp, gmul, sizeof(pre->g_pre_comp));
+        goto done;
+    }
+    if ((!BN_to_felem(pre->g_pre_comp[0][1][0], group->generator->X)) ||
+        (!BN_to_felem(pre->g_pre_comp[0][1][1], group->generator->Y)) ||
+        (!BN_to_felem(pre->g_pre_comp[0][1][2], group->generator->Z)))
+        goto err;
+    /*
+     * compute 2^96*G, 2^192*G, 2^288*G for the first table, 2^48*G, 2^144*G,
+     * 2^240*G, 2^336*G for the second one
+     */
+    for (i = 1; i <= 8; i <<= 1) {
+        point_double(pre->g_pre_comp[1][i][0], pre->g_pre_comp[1][i][1],
+                     pre->g_pre_comp[1][i][2], pre->g_pre_comp[0][i][0],
+                     pre->g_pre_comp[0][i][1], pre->g_pre_comp[0][i][2]);
+        for (j = 0; j < 47; ++j) {
+            point_double(pre->g_pre_comp[1][i][0], pre->g_pre_comp[1][i][1],
+                         pre->g_pre_comp[1][i][2], pre->g_pre_comp[1][i][0],
+                         pre->g_pre_comp[1][i][1], pre->g_pre_comp[1][i][2]);
+        }
+        if (i == 8)
+            break;
+        point_double(pre->g_pre_comp[0][2 * i][0],
+                     pre->g_pre_comp[0][2 * i][1],
+                     pre->g_pre_comp[0][2 * i][2], pre->g_pre_comp[1][i][0],
+                     pre->g_pre_comp[1][i][1], pre->g_pre_comp[1][i][2]);
+        for (j = 0; j < 47; ++j) {
+            point_double(pre->g_pre_comp[0][2 * i][0],
+                         pre->g_pre_comp[0][2 * i][1],
+                         pre->g_pre_comp[0][2 * i][2],
+                         pre->g_pre_comp[0][2 * i][0],
+                         pre->g_pre_comp[0][2 * i][1],
+                         pre->g_pre_comp[0][2 * i][2]);
+        }
+    }
+    for (i = 0; i < 2; i++) {
+        /* g_pre_comp[i][0] is the point at infinity */
+        memset(pre->g_pre_comp[i][0], 0, sizeof(pre->g_pre_comp[i][0]));
+        /* the remaining multiples */
+        /* 2^96*G + 2^192*G resp. 2^144*G + 2^240*G */
+        point_add(pre->g_pre_comp[i][6][0], pre->g_pre_comp[i][6][1],
+                  pre->g_pre_comp[i][6][2], pre->g_pre_comp[i][4][0],
+                  pre->g_pre_comp[i][4][1], pre->g_pre_comp[i][4][2],
+                  0, pre->g_pre_comp[i][2][0], pre->g_pre_comp[i][2][1],
+                  pre->g_pre_comp[i][2][2]);
+        /* 2^96*G + 2^288*G resp. 2^144*G + 2^336*G */
+        point_add(pre->g_pre_comp[i][10][0], pre->g_pre_comp[i][10][1],
+                  pre->g_pre_comp[i][10][2], pre->g_pre_comp[i][8][0],
+                  pre->g_pre_comp[i][8][1], pre->g_pre_comp[i][8][2],
+                  0, pre->g_pre_comp[i][2][0], pre->g_pre_comp[i][2][1],
+                  pre->g_pre_comp[i][2][2]);
+        /* 2^192*G + 2^288*G resp. 2^240*G + 2^336*G */
+        point_add(pre->g_pre_comp[i][12][0], pre->g_pre_comp[i][12][1],
+                  pre->g_pre_comp[i][12][2], pre->g_pre_comp[i][8][0],
+                  pre->g_pre_comp[i][8][1], pre->g_pre_comp[i][8][2],
+                  0, pre->g_pre_comp[i][4][0], pre->g_pre_comp[i][4][1],
+                  pre->g_pre_comp[i][4][2]);
+        /*
+         * 2^96*G + 2^192*G + 2^288*G resp. 2^144*G + 2^240*G + 2^336*G
+         */
+        point_add(pre->g_pre_comp[i][14][0], pre->g_pre_comp[i][14][1],
+                  pre->g_pre_comp[i][14][2], pre->g_pre_comp[i][12][0],
+                  pre->g_pre_comp[i][12][1], pre->g_pre_comp[i][12][2],
+                  0, pre->g_pre_comp[i][2][0], pre->g_pre_comp[i][2][1],
+                  pre->g_pre_comp[i][2][2]);
+        for (j = 1; j < 8; ++j) {
+            /* odd multiples: add G resp. 2^48*G */
+            point_add(pre->g_pre_comp[i][2 * j + 1][0],
+                      pre->g_pre_comp[i][2 * j + 1][1],
+                      pre->g_pre_comp[i][2 * j + 1][2],
+                      pre->g_pre_comp[i][2 * j][0],
+                      pre->g_pre_comp[i][2 * j][1],
+                      pre->g_pre_comp[i][2 * j][2], 0,
+                      pre->g_pre_comp[i][1][0], pre->g_pre_comp[i][1][1],
+                      pre->g_pre_comp[i][1][2]);
+        }
+    }
+    make_points_affine(31, &(pre->g_pre_comp[0][1]), tmp_felems);
+
+ done:
+    SETPRECOMP(group, nistp384, pre);
+    ret = 1;
+    pre = NULL;
+ err:
+    BN_CTX_end(ctx);
+    EC_POINT_free(generator);
+#ifndef FIPS_MODE
+    BN_CTX_free(new_ctx);
+#endif
+    EC_nistp384_pre_comp_free(pre);
+    return ret;
+}
+
+int ec_GFp_nistp384_have_precompute_mult(const EC_GROUP *group)
+{
+    return HAVEPRECOMP(group, nistp384);
+}
+
+#endif
@@ -711,6 +711,46 @@ static int pkey_ecx_derive448(EVP_PKEY_CTX *ctx, unsigned char *key,
     return 1;
 }
 
+static int pkey_ecx_derive_batch25519(EVP_PKEY *const pkey[],
+                                      EVP_PKEY *const peer[],
+                                      unsigned char *const key[],
+                                      size_t keylen[], size_t n)
+{
+    const uint8_t **priv = NULL, **pub = NULL;
+    int *ok = NULL;
+    size_t i;
+    int ret = -1;
+
+    /* Leave missing keys and short buffers to EVP_PKEY_derive() */
+    for (i = 0; i < n; i++) {
+        const ECX_KEY *ecxkey = pkey[i]->pkey.ecx, *peerkey = peer[i]->pkey.ecx;
+
+        if (ecxkey == NULL || ecxkey->privkey == NULL || peerkey == NULL
+                || keylen[i] < X25519_KEYLEN)
+            return -2;
+    }
+    priv = OPENSSL_malloc(n * sizeof(*priv));
+    pub = OPENSSL_malloc(n * sizeof(*pub));
+    ok = OPENSSL_malloc(n * sizeof(*ok));
+    if (priv == NULL || pub == NULL || ok == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    for (i = 0; i < n; i++) {
+        priv[i] = pkey[i]->pkey.ecx->privkey;
+        pub[i] = peer[i]->pkey.ecx->pubkey;
+    }
+    ret = X25519_batch(key, priv, pub, n, ok);
+    for (i = 0; i < n; i++)
+        keylen[i] = ok[i] ? X25519_KEYLEN : 0;
+
+ err:
+    OPENSSL_free(priv);
+    OPENSSL_free(pub);
+    OPENSSL_free(ok);
+    return ret;
+}
+
 static int pkey_ecx_ctrl(EVP_PKEY_CTX *ctx, int type, int p1, void *p2)
 {
     /* Only need to handle peer key for derivation */
@@ -726,7 +766,16 @@ const EVP_PKEY_METHOD ecx25519_pkey_meth = {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
     pkey_ecx_derive25519,
     pkey_ecx_ctrl,
-    0
+    0,
+
+    0, 0,
+
+    0, 0, 0,
+
+    0,
+
+    0,
+    pkey_ecx_derive_batch25519
 };
 
 const EVP_PKEY_METHOD ecx448_pkey_meth = {
@@ -798,6 +847,30 @@ static int pkey_ecd_digestverify25519(EVP_MD_CTX *ctx, const unsigned char *sig,
     return ED25519_verify(tbs, tbslen, sig, edkey->pubkey);
 }
 
+static int pkey_ecd_verify_batch25519(EVP_PKEY *const pkey[],
+                                      const unsigned char *const sig[],
+                                      const size_t siglen[],
+                                      const unsigned char *const tbs[],
+                                      const size_t tbslen[], size_t n)
+{
+    const uint8_t **pub;
+    size_t i;
+    int ret;
+
+    for (i = 0; i < n; i++)
+        if (siglen[i] != ED25519_SIGSIZE)
+            return 0;
+    if ((pub = OPENSSL_malloc(n * sizeof(*pub))) == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    for (i = 0; i < n; i++)
+        pub[i] = pkey[i]->pkey.ecx->pubkey;
+    ret = ED25519_verify_batch(tbs, tbslen, sig, pub, n);
+    OPENSSL_free(pub);
+    return ret;
+}
+
 static int pkey_ecd_digestverify448(EVP_MD_CTX *ctx, const unsigned char *sig,
                                     size_t siglen, const unsigned char *tbs,
                                     size_t tbslen)
@@ -838,7 +911,13 @@ const EVP_PKEY_METHOD ed25519_pkey_meth = {
     pkey_ecd_ctrl,
     0,
     pkey_ecd_digestsign25519,
-    pkey_ecd_digestverify25519
+    pkey_ecd_digestverify25519,
+
+    0, 0, 0,
+
+    0,
+
+    pkey_ecd_verify_batch25519
 };
 
 const EVP_PKEY_METHOD ed448_pkey_meth = {
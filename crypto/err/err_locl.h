@@ -62,6 +62,7 @@ static ossl_inline void err_clear(ERR_STATE *es, size_t i, int deall)
 {
     err_clear_data(es, i, (deall));
     es->err_flags[i] = 0;
+    es->err_marks[i] = 0;
     es->err_buffer[i] = 0;
     es->err_file[i] = NULL;
     es->err_line[i] = -1;
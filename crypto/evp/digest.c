@@ -18,6 +18,11 @@
 #include "internal/provider.h"
 #include "evp_locl.h"
 
+static void *evp_md_from_dispatch(const char *name, const OSSL_DISPATCH *fns,
+                                  OSSL_PROVIDER *prov, void *unused);
+static int evp_md_up_ref(void *md);
+static void evp_md_free(void *md);
+
 /* This call frees resources associated with the context */
 int EVP_MD_CTX_reset(EVP_MD_CTX *ctx)
 {
@@ -174,7 +179,9 @@ int EVP_DigestInit_ex(EVP_MD_CTX *ctx, const EVP_MD *type, ENGINE *impl)
         EVPerr(EVP_F_EVP_DIGESTINIT_EX, EVP_R_INITIALIZATION_ERROR);
         return 0;
 #else
-        EVP_MD *provmd = EVP_MD_fetch(NULL, OBJ_nid2sn(type->type), "");
+        EVP_MD *provmd = evp_legacy_fetch(NULL, OSSL_OP_DIGEST, type->type,
+                                          evp_md_from_dispatch, NULL,
+                                          evp_md_up_ref, evp_md_free);
 
         if (provmd == NULL) {
             EVPerr(EVP_F_EVP_DIGESTINIT_EX, EVP_R_INITIALIZATION_ERROR);
@@ -529,6 +536,58 @@ int EVP_Digest(const void *data, size_t count,
     return ret;
 }
 
+int EVP_DigestBatch(const unsigned char *const data[], const size_t count[],
+                    size_t n, unsigned char *md, const EVP_MD *type)
+{
+    EVP_MD *provmd = NULL;
+    size_t i, outl;
+    int mdlen, ret = 0;
+
+    if (type == NULL || (mdlen = EVP_MD_size(type)) <= 0) {
+        EVPerr(0, EVP_R_INVALID_DIGEST);
+        return 0;
+    }
+    if (n == 0)
+        return 1;
+
+    if (type->prov == NULL) {
+#if !defined(OPENSSL_NO_ENGINE) && !defined(FIPS_MODE)
+        ENGINE *tmpimpl = ENGINE_get_digest_engine(type->type);
+
+        /* Digests provided by an ENGINE are only hashed one by one */
+        if (tmpimpl != NULL) {
+            ENGINE_finish(tmpimpl);
+            goto one_by_one;
+        }
+#endif
+#ifndef FIPS_MODE
+        provmd = evp_legacy_fetch(NULL, OSSL_OP_DIGEST, type->type,
+                                  evp_md_from_dispatch, NULL,
+                                  evp_md_up_ref, evp_md_free);
+        if (provmd != NULL)
+            type = provmd;
+#endif
+    }
+
+    if (type->prov != NULL && type->batch_digest != NULL) {
+        ret = type->batch_digest(ossl_provider_ctx(type->prov), data, count,
+                                 n, md, &outl, n * (size_t)mdlen)
+              && outl == n * (size_t)mdlen;
+        goto end;
+    }
+
+#if !defined(OPENSSL_NO_ENGINE) && !defined(FIPS_MODE)
+ one_by_one:
+#endif
+    for (i = 0; i < n; i++)
+        if (!EVP_Digest(data[i], count[i], md + i * mdlen, NULL, type, NULL))
+            goto end;
+    ret = 1;
+ end:
+    EVP_MD_free(provmd);
+    return ret;
+}
+
 int EVP_MD_get_params(const EVP_MD *digest, OSSL_PARAM params[])
 {
     if (digest != NULL && digest->get_params != NULL)
@@ -577,6 +636,7 @@ int EVP_MD_CTX_ctrl(EVP_MD_CTX *ctx, int cmd, int p1, void *p2)
     int ret = EVP_CTRL_RET_UNSUPPORTED;
     int set_params = 1;
     size_t sz;
+    unsigned int threads;
     OSSL_PARAM params[2] = { OSSL_PARAM_END, OSSL_PARAM_END };
 
     if (ctx == NULL || ctx->digest == NULL) {
@@ -597,6 +657,13 @@ int EVP_MD_CTX_ctrl(EVP_MD_CTX *ctx, int cmd, int p1, void *p2)
         params[0] = OSSL_PARAM_construct_utf8_string(OSSL_DIGEST_PARAM_MICALG,
                                                      p2, p1 ? p1 : 9999);
         break;
+    case EVP_MD_CTRL_SET_THREADS:
+        if (p1 <= 0)
+            return 0;
+        threads = (unsigned int)p1;
+        params[0] = OSSL_PARAM_construct_uint(OSSL_DIGEST_PARAM_THREADS,
+                                              &threads);
+        break;
     default:
         return EVP_CTRL_RET_UNSUPPORTED;
     }
@@ -692,6 +759,10 @@ static void *evp_md_from_dispatch(const char *name, const OSSL_DISPATCH *fns,
                 md->digest = OSSL_get_OP_digest_digest(fns);
             /* We don't increment fnct for this as it is stand alone */
             break;
+        case OSSL_FUNC_DIGEST_BATCH_DIGEST:
+            if (md->batch_digest == NULL)
+                md->batch_digest = OSSL_get_OP_digest_batch_digest(fns);
+            break;
         case OSSL_FUNC_DIGEST_FREECTX:
             if (md->freectx == NULL) {
                 md->freectx = OSSL_get_OP_digest_freectx(fns);
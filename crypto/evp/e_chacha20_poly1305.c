@@ -205,10 +205,111 @@ static int chacha20_poly1305_init_key(EVP_CIPHER_CTX *ctx,
 void *xor128_encrypt_n_pad(void *out, const void *inp, void *otp, size_t len);
 void *xor128_decrypt_n_pad(void *out, const void *inp, void *otp, size_t len);
 static const unsigned char zero[4 * CHACHA_BLK_SIZE] = { 0 };
+
+#    define CHACHA20_POLY1305_STITCH
+#    define CHACHA20_POLY1305_STITCH_MIN (8 * CHACHA_BLK_SIZE)
+extern unsigned int OPENSSL_ia32cap_P[];
+size_t chacha20_poly1305_encrypt(unsigned char *out, const unsigned char *inp,
+                                 size_t len, const unsigned int key[8],
+                                 const unsigned int counter[4],
+                                 uint64_t poly[5]);
+size_t chacha20_poly1305_decrypt(unsigned char *out, const unsigned char *inp,
+                                 size_t len, const unsigned int key[8],
+                                 const unsigned int counter[4],
+                                 uint64_t poly[5]);
+void poly1305_blocks(void *ctx, const unsigned char *inp, size_t len,
+                     unsigned int padbit);
+void poly1305_emit(void *ctx, unsigned char mac[16],
+                   const unsigned int nonce[4]);
 #   else
 static const unsigned char zero[2 * CHACHA_BLK_SIZE] = { 0 };
 #   endif
 
+#   ifdef CHACHA20_POLY1305_STITCH
+/*
+ * Hash |len| bytes of |inp| zero-padded to a multiple of the block size
+ * into the radix 2^64 state |poly|.
+ */
+static void chacha20_poly1305_pad16(uint64_t poly[5],
+                                    const unsigned char *inp, size_t len)
+{
+    unsigned char blk[POLY1305_BLOCK_SIZE] = { 0 };
+    size_t tail = len % POLY1305_BLOCK_SIZE;
+
+    poly1305_blocks(poly, inp, len - tail, 1);
+    if (tail != 0) {
+        memcpy(blk, inp + len - tail, tail);
+        poly1305_blocks(poly, blk, POLY1305_BLOCK_SIZE, 1);
+    }
+}
+
+/*
+ * Large TLS records on AVX2 processors: the bulk of the payload is
+ * encrypted and authenticated in a single pass by the stitched kernel.
+ * The kernel works on a radix 2^64 Poly1305 state of its own, because
+ * the vector code behind Poly1305_Update may switch POLY1305 to another
+ * radix, so the whole record is processed here rather than by the
+ * generic code below.
+ */
+static int chacha20_poly1305_tls_stitch(EVP_CIPHER_CTX *ctx,
+                                        unsigned char *out,
+                                        const unsigned char *in, size_t len)
+{
+    EVP_CHACHA_AEAD_CTX *actx = aead_data(ctx);
+    size_t done, plen = actx->tls_payload_length;
+    uint64_t poly[5] = { 0 };
+    unsigned int nonce[4];
+    unsigned char buf[CHACHA_BLK_SIZE], tag[POLY1305_BLOCK_SIZE];
+
+    actx->key.counter[0] = 0;
+    ChaCha20_ctr32(buf, zero, CHACHA_BLK_SIZE, actx->key.key.d,
+                   actx->key.counter);
+    memcpy(&poly[3], buf, 2 * sizeof(poly[0]));
+    poly[3] &= 0x0ffffffc0fffffffULL;
+    poly[4] &= 0x0ffffffc0ffffffcULL;
+    memcpy(nonce, buf + 16, sizeof(nonce));
+    OPENSSL_cleanse(buf, sizeof(buf));
+    actx->key.counter[0] = 1;
+    actx->key.partial_len = 0;
+    actx->len.aad = EVP_AEAD_TLS1_AAD_LEN;
+    actx->len.text = plen;
+
+    poly1305_blocks(poly, actx->tls_aad, POLY1305_BLOCK_SIZE, 1);
+    if (ctx->encrypt) {
+        done = chacha20_poly1305_encrypt(out, in, plen, actx->key.key.d,
+                                         actx->key.counter, poly);
+        actx->key.counter[0] += (unsigned int)(done / CHACHA_BLK_SIZE);
+        ChaCha20_ctr32(out + done, in + done, plen - done, actx->key.key.d,
+                       actx->key.counter);
+        chacha20_poly1305_pad16(poly, out + done, plen - done);
+    } else {
+        done = chacha20_poly1305_decrypt(out, in, plen, actx->key.key.d,
+                                         actx->key.counter, poly);
+        actx->key.counter[0] += (unsigned int)(done / CHACHA_BLK_SIZE);
+        chacha20_poly1305_pad16(poly, in + done, plen - done);
+        ChaCha20_ctr32(out + done, in + done, plen - done, actx->key.key.d,
+                       actx->key.counter);
+    }
+    /* x86_64 is little-endian, |len| is the final block as is */
+    poly1305_blocks(poly, (unsigned char *)&actx->len, POLY1305_BLOCK_SIZE, 1);
+    poly1305_emit(poly, tag, nonce);
+    OPENSSL_cleanse(poly, sizeof(poly));
+    OPENSSL_cleanse(nonce, sizeof(nonce));
+
+    actx->tls_payload_length = NO_TLS_PAYLOAD_LENGTH;
+
+    if (ctx->encrypt) {
+        memcpy(actx->tag, tag, POLY1305_BLOCK_SIZE);
+        memcpy(out + plen, tag, POLY1305_BLOCK_SIZE);
+    } else if (CRYPTO_memcmp(tag, in + plen, POLY1305_BLOCK_SIZE)) {
+        memset(out, 0, plen);
+        return -1;
+    }
+
+    return len;
+}
+#   endif
+
 static int chacha20_poly1305_tls_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
                                         const unsigned char *in, size_t len)
 {
@@ -219,6 +320,17 @@ static int chacha20_poly1305_tls_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
     if (len != plen + POLY1305_BLOCK_SIZE)
         return -1;
 
+#   ifdef CHACHA20_POLY1305_STITCH
+    /*
+     * AVX2 without AVX512F/VL, processors with AVX512 are better off
+     * with the two-pass code, see chacha20_poly1305-x86_64.pl.
+     */
+    if (plen >= CHACHA20_POLY1305_STITCH_MIN
+            && (OPENSSL_ia32cap_P[2] & (1 << 5 | 1 << 16 | 1U << 31))
+               == 1 << 5)
+        return chacha20_poly1305_tls_stitch(ctx, out, in, len);
+#   endif
+
     buf = storage + ((0 - (size_t)storage) & 15);   /* align */
     ctr = buf + CHACHA_BLK_SIZE;
     tohash = buf + CHACHA_BLK_SIZE - POLY1305_BLOCK_SIZE;
@@ -10,8 +10,9 @@
 #include <stddef.h>
 #include <openssl/ossl_typ.h>
 #include <openssl/evp.h>
+#include <openssl/objects.h>
 #include <openssl/core.h>
-#include "internal/cryptlib.h"
+#include "internal/cryptlib_int.h"
 #include "internal/thread_once.h"
 #include "internal/property.h"
 #include "internal/core.h"
@@ -154,6 +155,220 @@ static void destruct_method(void *method, void *data)
     methdata->destruct_method(method);
 }
 
+#if !defined(FIPS_MODE) && defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+/*
+ * An optional per thread cache in front of evp_generic_fetch(), keyed by
+ * the complete fetch request.  A hit avoids the name map and method store
+ * entirely.  Each thread's cache is emptied when the method generation
+ * changes, i.e. when providers come and go or default properties change.
+ */
+# define THREAD_FETCH_CACHING
+# define THREAD_FETCH_CACHE_SIZE    16      /* Must be a power of 2 */
+
+typedef struct {
+    int operation_id;
+    char *name;
+    char *properties;
+    void *method;
+    void (*free_method)(void *);
+} FETCH_CACHE_ENTRY;
+
+typedef struct {
+    unsigned int generation;
+    FETCH_CACHE_ENTRY entries[THREAD_FETCH_CACHE_SIZE];
+} THREAD_FETCH_CACHE;
+
+typedef struct {
+    CRYPTO_THREAD_LOCAL cache;
+    int enabled;
+} FETCH_CACHE_GLOBAL;
+
+/* The number of library contexts the cache is enabled for */
+static int fetch_cache_users = 0;
+
+static void fetch_cache_entry_clear(FETCH_CACHE_ENTRY *ent)
+{
+    if (ent->method != NULL)
+        ent->free_method(ent->method);
+    OPENSSL_free(ent->name);
+    OPENSSL_free(ent->properties);
+    memset(ent, 0, sizeof(*ent));
+}
+
+static void thread_fetch_cache_clear(THREAD_FETCH_CACHE *cache)
+{
+    size_t i;
+
+    for (i = 0; i < THREAD_FETCH_CACHE_SIZE; i++)
+        fetch_cache_entry_clear(&cache->entries[i]);
+}
+
+static void *fetch_cache_global_new(OPENSSL_CTX *ctx)
+{
+    FETCH_CACHE_GLOBAL *gbl = OPENSSL_zalloc(sizeof(*gbl));
+
+    if (gbl == NULL)
+        return NULL;
+
+    /*
+     * We need to ensure that base libcrypto thread handling has been
+     * initialised.
+     */
+    OPENSSL_init_crypto(0, NULL);
+
+    if (!CRYPTO_THREAD_init_local(&gbl->cache, NULL)) {
+        OPENSSL_free(gbl);
+        return NULL;
+    }
+    return gbl;
+}
+
+static void fetch_cache_global_free(void *vgbl)
+{
+    FETCH_CACHE_GLOBAL *gbl = vgbl;
+
+    if (gbl == NULL)
+        return;
+    if (gbl->enabled)
+        __atomic_sub_fetch(&fetch_cache_users, 1, __ATOMIC_RELAXED);
+    CRYPTO_THREAD_cleanup_local(&gbl->cache);
+    OPENSSL_free(gbl);
+}
+
+static const OPENSSL_CTX_METHOD fetch_cache_global_method = {
+    fetch_cache_global_new,
+    fetch_cache_global_free,
+};
+
+static FETCH_CACHE_GLOBAL *get_fetch_cache_global(OPENSSL_CTX *libctx)
+{
+    return openssl_ctx_get_data(libctx, OPENSSL_CTX_THREAD_FETCH_CACHE_INDEX,
+                                &fetch_cache_global_method);
+}
+
+static void thread_fetch_cache_stop(void *arg)
+{
+    FETCH_CACHE_GLOBAL *gbl = get_fetch_cache_global(arg);
+    THREAD_FETCH_CACHE *cache;
+
+    if (gbl == NULL)
+        return;
+    cache = CRYPTO_THREAD_get_local(&gbl->cache);
+    CRYPTO_THREAD_set_local(&gbl->cache, NULL);
+    if (cache != NULL) {
+        thread_fetch_cache_clear(cache);
+        OPENSSL_free(cache);
+    }
+}
+
+/*
+ * Get this thread's cache for |libctx|, or NULL if caching isn't enabled.
+ * A cache that is found to be from an older generation is emptied first.
+ */
+static THREAD_FETCH_CACHE *get_thread_fetch_cache(OPENSSL_CTX *libctx,
+                                                  int create)
+{
+    FETCH_CACHE_GLOBAL *gbl;
+    THREAD_FETCH_CACHE *cache;
+    unsigned int generation;
+
+    if (__atomic_load_n(&fetch_cache_users, __ATOMIC_RELAXED) == 0
+            || (gbl = get_fetch_cache_global(libctx)) == NULL
+            || !__atomic_load_n(&gbl->enabled, __ATOMIC_RELAXED))
+        return NULL;
+
+    generation = ossl_method_generation();
+    cache = CRYPTO_THREAD_get_local(&gbl->cache);
+    if (cache == NULL) {
+        if (!create
+                || (cache = OPENSSL_zalloc(sizeof(*cache))) == NULL)
+            return NULL;
+        if (!ossl_init_thread_start(NULL, openssl_ctx_get_concrete(libctx),
+                                    thread_fetch_cache_stop)
+                || !CRYPTO_THREAD_set_local(&gbl->cache, cache)) {
+            OPENSSL_free(cache);
+            return NULL;
+        }
+        cache->generation = generation;
+    } else if (cache->generation != generation) {
+        thread_fetch_cache_clear(cache);
+        cache->generation = generation;
+    }
+    return cache;
+}
+
+static FETCH_CACHE_ENTRY *thread_fetch_cache_entry(THREAD_FETCH_CACHE *cache,
+                                                   int operation_id,
+                                                   const char *name)
+{
+    unsigned long h = OPENSSL_LH_strhash(name) + (unsigned long)operation_id;
+
+    return &cache->entries[h & (THREAD_FETCH_CACHE_SIZE - 1)];
+}
+
+static int thread_fetch_cache_match(const FETCH_CACHE_ENTRY *ent,
+                                    int operation_id, const char *name,
+                                    const char *properties)
+{
+    return ent->method != NULL
+        && ent->operation_id == operation_id
+        && strcmp(ent->name, name) == 0
+        && (ent->properties == NULL
+            ? properties == NULL
+            : properties != NULL && strcmp(ent->properties, properties) == 0);
+}
+
+static void *thread_fetch_cache_get(OPENSSL_CTX *libctx, int operation_id,
+                                    const char *name, const char *properties,
+                                    int (*up_ref_method)(void *))
+{
+    THREAD_FETCH_CACHE *cache = get_thread_fetch_cache(libctx, 0);
+    FETCH_CACHE_ENTRY *ent;
+
+    if (cache == NULL || name == NULL)
+        return NULL;
+    ent = thread_fetch_cache_entry(cache, operation_id, name);
+    if (!thread_fetch_cache_match(ent, operation_id, name, properties)
+            || !up_ref_method(ent->method))
+        return NULL;
+    return ent->method;
+}
+
+/*
+ * Remember |method|, which was fetched while the method generation was
+ * |generation|.  Failing to do so is not an error.
+ */
+static void thread_fetch_cache_set(OPENSSL_CTX *libctx,
+                                   unsigned int generation, int operation_id,
+                                   const char *name, const char *properties,
+                                   void *method,
+                                   int (*up_ref_method)(void *),
+                                   void (*free_method)(void *))
+{
+    THREAD_FETCH_CACHE *cache = get_thread_fetch_cache(libctx, 1);
+    FETCH_CACHE_ENTRY *ent, fresh;
+
+    if (cache == NULL || name == NULL || cache->generation != generation)
+        return;
+
+    memset(&fresh, 0, sizeof(fresh));
+    if ((fresh.name = OPENSSL_strdup(name)) == NULL
+            || (properties != NULL
+                && (fresh.properties = OPENSSL_strdup(properties)) == NULL)
+            || !up_ref_method(method)) {
+        fetch_cache_entry_clear(&fresh);
+        return;
+    }
+    fresh.operation_id = operation_id;
+    fresh.method = method;
+    fresh.free_method = free_method;
+
+    ent = thread_fetch_cache_entry(cache, operation_id, name);
+    fetch_cache_entry_clear(ent);
+    *ent = fresh;
+}
+#endif
+
 void *evp_generic_fetch(OPENSSL_CTX *libctx, int operation_id,
                         const char *name, const char *properties,
                         void *(*new_method)(const char *name,
@@ -164,12 +379,21 @@ void *evp_generic_fetch(OPENSSL_CTX *libctx, int operation_id,
                         int (*up_ref_method)(void *),
                         void (*free_method)(void *))
 {
-    OSSL_METHOD_STORE *store = get_default_method_store(libctx);
-    OSSL_NAMEMAP *namemap = ossl_namemap_stored(libctx);
+    OSSL_METHOD_STORE *store;
+    OSSL_NAMEMAP *namemap;
     int nameid = 0;
     uint32_t methid = 0;
     void *method = NULL;
+#ifdef THREAD_FETCH_CACHING
+    unsigned int generation = ossl_method_generation();
+
+    if ((method = thread_fetch_cache_get(libctx, operation_id, name,
+                                         properties, up_ref_method)) != NULL)
+        return method;
+#endif
 
+    store = get_default_method_store(libctx);
+    namemap = ossl_namemap_stored(libctx);
     if (store == NULL || namemap == NULL)
         return NULL;
 
@@ -227,17 +451,331 @@ void *evp_generic_fetch(OPENSSL_CTX *libctx, int operation_id,
         up_ref_method(method);
     }
 
+#ifdef THREAD_FETCH_CACHING
+    if (method != NULL)
+        thread_fetch_cache_set(libctx, generation, operation_id, name,
+                               properties, method, up_ref_method, free_method);
+#endif
     return method;
 }
 
+#if !defined(FIPS_MODE) && defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+/*
+ * Legacy EVP_MD and EVP_CIPHER pointers are replaced with a provider method
+ * each time they are used to initialise a context.  To keep that cheap, the
+ * methods found are cached per library context, keyed by operation and NID.
+ *
+ * The cache is an open addressed table whose slots are only ever filled in
+ * under the lock.  Each entry remembers the method generation it was found
+ * in, and is ignored once providers come and go or the default properties
+ * change.  Such entries are replaced all together by the next entry that is
+ * added.  Lookups read the slots without taking the lock, so the replaced
+ * entries are moved to a retired list, and only freed once the lookups that
+ * could have seen them are done.
+ *
+ * For that, lookups are counted per epoch.  When retired entries are to be
+ * freed, they're set aside and the epoch is advanced under the lock, so that
+ * the lookups which started earlier are the only ones left to wait for, and
+ * their count can only go down.  Entries retired in the meantime wait for
+ * the next round.  Should that take long, caching stops being renewed for
+ * new generations once LEGACY_RETIRED_MAX entries are waiting.
+ */
+# define LEGACY_METHOD_CACHING
+# define LEGACY_CACHE_SIZE      256     /* Must be a power of 2 */
+# define LEGACY_RETIRED_MAX     (4 * LEGACY_CACHE_SIZE)
+
+typedef struct legacy_method_st LEGACY_METHOD;
+struct legacy_method_st {
+    int operation_id;
+    int nid;
+    unsigned int generation;
+    void *method;
+    void (*free_method)(void *);
+    LEGACY_METHOD *next;
+};
+
+typedef struct {
+    CRYPTO_RWLOCK *lock;
+    unsigned int generation;
+    unsigned int epoch;
+    unsigned int readers[2];            /* Lookups in progress, per epoch */
+    LEGACY_METHOD *slots[LEGACY_CACHE_SIZE];
+    LEGACY_METHOD *retired;             /* Retired in the current epoch */
+    LEGACY_METHOD *retiring;            /* Retired in the previous epoch */
+    size_t nretired;
+} LEGACY_METHOD_CACHE;
+
+static void legacy_method_free(LEGACY_METHOD *ent)
+{
+    ent->free_method(ent->method);
+    OPENSSL_free(ent);
+}
+
+static size_t legacy_method_list_free(LEGACY_METHOD **list)
+{
+    LEGACY_METHOD *ent;
+    size_t n = 0;
+
+    while ((ent = *list) != NULL) {
+        *list = ent->next;
+        legacy_method_free(ent);
+        n++;
+    }
+    return n;
+}
+
+static void legacy_method_cache_free(void *vcache)
+{
+    LEGACY_METHOD_CACHE *cache = vcache;
+    size_t i;
+
+    if (cache == NULL)
+        return;
+    for (i = 0; i < LEGACY_CACHE_SIZE; i++)
+        if (cache->slots[i] != NULL)
+            legacy_method_free(cache->slots[i]);
+    legacy_method_list_free(&cache->retired);
+    legacy_method_list_free(&cache->retiring);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+static void *legacy_method_cache_new(OPENSSL_CTX *ctx)
+{
+    LEGACY_METHOD_CACHE *cache = OPENSSL_zalloc(sizeof(*cache));
+
+    if (cache != NULL && (cache->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        OPENSSL_free(cache);
+        cache = NULL;
+    }
+    return cache;
+}
+
+static const OPENSSL_CTX_METHOD legacy_method_cache_method = {
+    legacy_method_cache_new,
+    legacy_method_cache_free,
+};
+
+static LEGACY_METHOD_CACHE *get_legacy_method_cache(OPENSSL_CTX *libctx)
+{
+    return openssl_ctx_get_data(libctx, OPENSSL_CTX_LEGACY_METHOD_CACHE_INDEX,
+                                &legacy_method_cache_method);
+}
+
+/*
+ * Look for the entry for |operation_id| and |nid|.  If there is none and
+ * |empty| isn't NULL, it's set to the slot where the entry would go, or to
+ * LEGACY_CACHE_SIZE if the table is full.
+ */
+static LEGACY_METHOD *legacy_cache_find(LEGACY_METHOD_CACHE *cache,
+                                        int operation_id, int nid,
+                                        size_t *empty)
+{
+    size_t i, slot = ((unsigned int)nid * 31 + (unsigned int)operation_id);
+    LEGACY_METHOD *ent;
+
+    for (i = 0; i < LEGACY_CACHE_SIZE; i++, slot++) {
+        slot &= LEGACY_CACHE_SIZE - 1;
+        if ((ent = __atomic_load_n(&cache->slots[slot],
+                                   __ATOMIC_SEQ_CST)) == NULL) {
+            if (empty != NULL)
+                *empty = slot;
+            return NULL;
+        }
+        if (ent->operation_id == operation_id && ent->nid == nid)
+            return ent;
+    }
+    if (empty != NULL)
+        *empty = LEGACY_CACHE_SIZE;
+    return NULL;
+}
+
+/*
+ * Start over with an empty table for |generation|.  Called with the lock
+ * held.
+ */
+static void legacy_cache_renew(LEGACY_METHOD_CACHE *cache,
+                               unsigned int generation)
+{
+    LEGACY_METHOD *ent;
+    size_t i;
+
+    for (i = 0; i < LEGACY_CACHE_SIZE; i++) {
+        if ((ent = cache->slots[i]) == NULL)
+            continue;
+        __atomic_store_n(&cache->slots[i], NULL, __ATOMIC_SEQ_CST);
+        ent->next = cache->retired;
+        cache->retired = ent;
+        cache->nretired++;
+    }
+    cache->generation = generation;
+}
+
+/*
+ * Register a lookup, and return the epoch it's counted in.  The epoch is
+ * checked again after counting, a lookup that raced with the epoch being
+ * advanced might otherwise be counted in an epoch nobody waits for.
+ */
+static unsigned int legacy_cache_enter(LEGACY_METHOD_CACHE *cache)
+{
+    unsigned int epoch;
+
+    for (;;) {
+        epoch = __atomic_load_n(&cache->epoch, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&cache->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&cache->epoch, __ATOMIC_SEQ_CST) == epoch)
+            return epoch;
+        __atomic_sub_fetch(&cache->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void legacy_cache_leave(LEGACY_METHOD_CACHE *cache, unsigned int epoch)
+{
+    __atomic_sub_fetch(&cache->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Free retired entries that no lookup can still be looking at.  Lookups
+ * that start after the epoch is advanced can't find them, they're no longer
+ * in the table.  Called with the lock held.
+ */
+static void legacy_cache_reap(LEGACY_METHOD_CACHE *cache)
+{
+    if (cache->retiring == NULL && cache->retired != NULL) {
+        cache->retiring = cache->retired;
+        cache->retired = NULL;
+        __atomic_add_fetch(&cache->epoch, 1, __ATOMIC_SEQ_CST);
+    }
+    if (cache->retiring == NULL
+            || __atomic_load_n(&cache->readers[(cache->epoch - 1) & 1],
+                               __ATOMIC_SEQ_CST) != 0)
+        return;
+    cache->nretired -= legacy_method_list_free(&cache->retiring);
+}
+
+/*
+ * Fetch the provider method that stands in for the legacy method with the
+ * given |nid|, i.e. the one that evp_generic_fetch() finds by its short name
+ * and no extra properties.
+ */
+void *evp_legacy_fetch(OPENSSL_CTX *libctx, int operation_id, int nid,
+                       void *(*new_method)(const char *name,
+                                           const OSSL_DISPATCH *fns,
+                                           OSSL_PROVIDER *prov,
+                                           void *method_data),
+                       void *method_data,
+                       int (*up_ref_method)(void *),
+                       void (*free_method)(void *))
+{
+    LEGACY_METHOD_CACHE *cache = get_legacy_method_cache(libctx);
+    LEGACY_METHOD *ent = NULL;
+    unsigned int generation = ossl_method_generation();
+    unsigned int epoch;
+    void *method = NULL;
+    size_t empty;
+
+    if (cache != NULL) {
+        epoch = legacy_cache_enter(cache);
+        if ((ent = legacy_cache_find(cache, operation_id, nid, NULL)) != NULL
+                && ent->generation == generation
+                && up_ref_method(ent->method))
+            method = ent->method;
+        legacy_cache_leave(cache, epoch);
+        if (method != NULL)
+            return method;
+    }
+
+    method = evp_generic_fetch(libctx, operation_id, OBJ_nid2sn(nid), "",
+                               new_method, method_data, up_ref_method,
+                               free_method);
+    if (method == NULL || cache == NULL)
+        return method;
+
+    /* Not being able to cache the method is not an error */
+    if ((ent = OPENSSL_malloc(sizeof(*ent))) == NULL)
+        return method;
+    if (!up_ref_method(method)) {
+        OPENSSL_free(ent);
+        return method;
+    }
+    ent->operation_id = operation_id;
+    ent->nid = nid;
+    ent->generation = generation;
+    ent->method = method;
+    ent->free_method = free_method;
+    ent->next = NULL;
+
+    CRYPTO_THREAD_write_lock(cache->lock);
+    legacy_cache_reap(cache);
+    /* Don't cache what may have been found with the old providers */
+    if (ossl_method_generation() == generation
+            && (cache->generation == generation
+                || cache->nretired < LEGACY_RETIRED_MAX)) {
+        if (cache->generation != generation)
+            legacy_cache_renew(cache, generation);
+        if (legacy_cache_find(cache, operation_id, nid, &empty) == NULL
+                && empty < LEGACY_CACHE_SIZE) {
+            __atomic_store_n(&cache->slots[empty], ent, __ATOMIC_SEQ_CST);
+            ent = NULL;
+        }
+    }
+    legacy_cache_reap(cache);
+    CRYPTO_THREAD_unlock(cache->lock);
+
+    if (ent != NULL)
+        legacy_method_free(ent);
+    return method;
+}
+#elif !defined(FIPS_MODE)
+void *evp_legacy_fetch(OPENSSL_CTX *libctx, int operation_id, int nid,
+                       void *(*new_method)(const char *name,
+                                           const OSSL_DISPATCH *fns,
+                                           OSSL_PROVIDER *prov,
+                                           void *method_data),
+                       void *method_data,
+                       int (*up_ref_method)(void *),
+                       void (*free_method)(void *))
+{
+    return evp_generic_fetch(libctx, operation_id, OBJ_nid2sn(nid), "",
+                             new_method, method_data, up_ref_method,
+                             free_method);
+}
+#endif
+
 int EVP_set_default_properties(OPENSSL_CTX *libctx, const char *propq)
 {
     OSSL_METHOD_STORE *store = get_default_method_store(libctx);
 
-    if (store != NULL)
-        return ossl_method_store_set_global_properties(store, propq);
-    EVPerr(EVP_F_EVP_SET_DEFAULT_PROPERTIES, ERR_R_INTERNAL_ERROR);
-    return 0;
+    if (store == NULL) {
+        EVPerr(EVP_F_EVP_SET_DEFAULT_PROPERTIES, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    if (!ossl_method_store_set_global_properties(store, propq))
+        return 0;
+    ossl_method_generation_bump();
+    return 1;
+}
+
+int EVP_set_thread_fetch_cache(OPENSSL_CTX *libctx, int enable)
+{
+#ifdef THREAD_FETCH_CACHING
+    FETCH_CACHE_GLOBAL *gbl = get_fetch_cache_global(libctx);
+
+    if (gbl == NULL) {
+        EVPerr(EVP_F_EVP_SET_THREAD_FETCH_CACHE, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    enable = enable != 0;
+    if (__atomic_exchange_n(&gbl->enabled, enable, __ATOMIC_RELAXED) != enable)
+        __atomic_add_fetch(&fetch_cache_users, enable ? 1 : -1,
+                           __ATOMIC_RELAXED);
+    /* Make sure nothing stale is found should it be enabled again */
+    if (!enable)
+        ossl_method_generation_bump();
+    return 1;
+#else
+    return !enable;
+#endif
 }
 
 struct do_all_data_st {
@@ -175,6 +175,14 @@ void *evp_generic_fetch(OPENSSL_CTX *ctx, int operation_id,
                         void *method_data,
                         int (*up_ref_method)(void *),
                         void (*free_method)(void *));
+void *evp_legacy_fetch(OPENSSL_CTX *libctx, int operation_id, int nid,
+                       void *(*new_method)(const char *name,
+                                           const OSSL_DISPATCH *fns,
+                                           OSSL_PROVIDER *prov,
+                                           void *method_data),
+                       void *method_data,
+                       int (*up_ref_method)(void *),
+                       void (*free_method)(void *));
 void evp_generic_do_all(OPENSSL_CTX *libctx, int operation_id,
                         void (*user_fn)(void *method, void *arg),
                         void *user_arg,
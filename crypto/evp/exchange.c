@@ -10,6 +10,7 @@
 #include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/err.h>
+#include <openssl/engine.h>
 #include "internal/refcount.h"
 #include "internal/evp_int.h"
 #include "internal/provider.h"
@@ -386,3 +387,69 @@ int EVP_PKEY_derive(EVP_PKEY_CTX *ctx, unsigned char *key, size_t *pkeylen)
     M_check_autoarg(ctx, key, pkeylen, EVP_F_EVP_PKEY_DERIVE)
         return ctx->pmeth->derive(ctx, key, pkeylen);
 }
+
+static int evp_pkey_derive_one(EVP_PKEY *pkey, EVP_PKEY *peer,
+                               unsigned char *key, size_t *keylen)
+{
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    int ret = 0;
+
+    if (ctx != NULL
+            && EVP_PKEY_derive_init(ctx) > 0
+            && EVP_PKEY_derive_set_peer(ctx, peer) > 0)
+        ret = EVP_PKEY_derive(ctx, key, keylen);
+    EVP_PKEY_CTX_free(ctx);
+    return ret;
+}
+
+int EVP_PKEY_derive_batch(EVP_PKEY *const pkey[], EVP_PKEY *const peer[],
+                          unsigned char *const key[], size_t keylen[],
+                          size_t n)
+{
+    const EVP_PKEY_METHOD *pmeth;
+    size_t i;
+    int ret = 1;
+
+    if (n == 0)
+        return 1;
+
+    /*
+     * Batches go to the key type's own implementation only if they are
+     * uniform, and pass the checks of EVP_PKEY_derive_set_peer()
+     */
+    pmeth = EVP_PKEY_meth_find(pkey[0]->type);
+    for (i = 0; i < n && pmeth != NULL; i++) {
+        if (pkey[i]->type != pkey[0]->type || peer[i]->type != pkey[0]->type
+                || pkey[i]->engine != NULL || pkey[i]->pmeth_engine != NULL
+                || peer[i]->engine != NULL || peer[i]->pmeth_engine != NULL
+                || (!EVP_PKEY_missing_parameters(peer[i])
+                    && !EVP_PKEY_cmp_parameters(pkey[i], peer[i])))
+            pmeth = NULL;
+    }
+#ifndef OPENSSL_NO_ENGINE
+    if (pmeth != NULL) {
+        ENGINE *e = ENGINE_get_pkey_meth_engine(pkey[0]->type);
+
+        /* An ENGINE implementing the key type takes over derivation */
+        if (e != NULL) {
+            ENGINE_finish(e);
+            pmeth = NULL;
+        }
+    }
+#endif
+
+    if (pmeth != NULL && pmeth->derive_batch != NULL) {
+        ret = pmeth->derive_batch(pkey, peer, key, keylen, n);
+        if (ret != -2)
+            return ret;
+        ret = 1;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (evp_pkey_derive_one(pkey[i], peer[i], key[i], &keylen[i]) <= 0) {
+            keylen[i] = 0;
+            ret = 0;
+        }
+    }
+    return ret;
+}
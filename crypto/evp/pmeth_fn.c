@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <openssl/objects.h>
 #include <openssl/evp.h>
+#include <openssl/engine.h>
 #include "internal/cryptlib.h"
 #include "internal/evp_int.h"
 #include "internal/provider.h"
@@ -447,6 +448,91 @@ int EVP_PKEY_verify(EVP_PKEY_CTX *ctx,
     return ctx->pmeth->verify(ctx, sig, siglen, tbs, tbslen);
 }
 
+static int evp_pkey_verify_one(EVP_PKEY *pkey,
+                               const unsigned char *sig, size_t siglen,
+                               const unsigned char *tbs, size_t tbslen)
+{
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    EVP_MD_CTX *mctx = NULL;
+    int ret = -1;
+
+    if (ctx == NULL)
+        return -1;
+    if (ctx->pmeth != NULL
+            && (ctx->pmeth->flags & EVP_PKEY_FLAG_SIGCTX_CUSTOM) != 0) {
+        /* The signature scheme takes care of hashing the message */
+        if ((mctx = EVP_MD_CTX_new()) != NULL
+                && EVP_DigestVerifyInit(mctx, NULL, NULL, NULL, pkey) > 0)
+            ret = EVP_DigestVerify(mctx, sig, siglen, tbs, tbslen);
+    } else if (EVP_PKEY_verify_init(ctx) > 0) {
+        ret = EVP_PKEY_verify(ctx, sig, siglen, tbs, tbslen);
+    }
+    EVP_MD_CTX_free(mctx);
+    EVP_PKEY_CTX_free(ctx);
+    return ret;
+}
+
+int EVP_PKEY_verify_batch(EVP_PKEY *const pkey[],
+                          const unsigned char *const sig[],
+                          const size_t siglen[],
+                          const unsigned char *const tbs[],
+                          const size_t tbslen[], size_t n, int status[])
+{
+    const EVP_PKEY_METHOD *pmeth;
+    size_t i;
+    int ret = 1, r;
+
+    if (n == 0)
+        return 1;
+
+    pmeth = EVP_PKEY_meth_find(pkey[0]->type);
+    for (i = 0; i < n && pmeth != NULL; i++) {
+        if (pkey[i]->type != pkey[0]->type
+                || pkey[i]->engine != NULL || pkey[i]->pmeth_engine != NULL)
+            pmeth = NULL;
+    }
+#ifndef OPENSSL_NO_ENGINE
+    if (pmeth != NULL) {
+        ENGINE *e = ENGINE_get_pkey_meth_engine(pkey[0]->type);
+
+        /* An ENGINE implementing the key type takes over verification */
+        if (e != NULL) {
+            ENGINE_finish(e);
+            pmeth = NULL;
+        }
+    }
+#endif
+
+    if (pmeth != NULL && pmeth->verify_batch != NULL) {
+        /*
+         * A passing batch sets every status[i] to 1 without checking the
+         * signatures one by one, so for Ed25519 they get the cofactored
+         * batch semantics documented in EVP_PKEY_verify(3).
+         */
+        ret = pmeth->verify_batch(pkey, sig, siglen, tbs, tbslen, n);
+        if (ret == 1 || status == NULL) {
+            for (i = 0; ret == 1 && status != NULL && i < n; i++)
+                status[i] = 1;
+            return ret;
+        }
+        ret = 1;
+    }
+
+    /* One at a time, which also tells which signatures are bad */
+    for (i = 0; i < n; i++) {
+        r = evp_pkey_verify_one(pkey[i], sig[i], siglen[i], tbs[i], tbslen[i]);
+        if (status != NULL)
+            status[i] = r;
+        if (r != 1) {
+            if (ret == 1 || r < 0)
+                ret = r;
+            if (status == NULL)
+                break;
+        }
+    }
+    return ret;
+}
+
 int EVP_PKEY_verify_recover_init_ex(EVP_PKEY_CTX *ctx, EVP_SIGNATURE *signature)
 {
     return evp_pkey_signature_init(ctx, signature, EVP_PKEY_OP_VERIFYRECOVER);
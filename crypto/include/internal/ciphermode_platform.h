@@ -102,6 +102,8 @@ void AES_xts_decrypt(const unsigned char *inp, unsigned char *out, size_t len,
 
 /* AES-NI section */
 
+extern unsigned int OPENSSL_ia32cap_P[];
+
 #  define AESNI_CAPABLE   (OPENSSL_ia32cap_P[1]&(1<<(57-32)))
 #  ifdef VPAES_ASM
 #   define VPAES_CAPABLE   (OPENSSL_ia32cap_P[1]&(1<<(41-32)))
@@ -182,6 +184,51 @@ void gcm_ghash_avx(u64 Xi[2], const u128 Htable[16], const u8 *in, size_t len);
 
 #   define AES_GCM_ASM(ctx)    (ctx->ctr == aesni_ctr32_encrypt_blocks && \
                                 ctx->gcm.ghash == gcm_ghash_avx)
+
+/*
+ * 512-bit VAES/VPCLMULQDQ flavour, processes whole 256-byte chunks and
+ * returns the number of bytes done; needs AVX512F, AVX512BW and AVX512VL.
+ */
+size_t aesni_gcm_encrypt_avx512(const unsigned char *in, unsigned char *out,
+                                size_t len, const void *key,
+                                unsigned char ivec[16], u64 *Xi);
+size_t aesni_gcm_decrypt_avx512(const unsigned char *in, unsigned char *out,
+                                size_t len, const void *key,
+                                unsigned char ivec[16], u64 *Xi);
+
+#   define AESNI_GCM_AVX512_CAPABLE \
+        ((OPENSSL_ia32cap_P[2] & 0xc0010000) == 0xc0010000 && \
+         (OPENSSL_ia32cap_P[3] & 0x600) == 0x600)
+
+/*
+ * Bulk AES-GCM entry points for the glue code: the widest kernel the CPU
+ * supports takes what it can and aesni_gcm_* picks up the remainder.
+ */
+static ossl_unused ossl_inline
+size_t aesni_gcm_encrypt_bulk(const unsigned char *in, unsigned char *out,
+                              size_t len, const void *key,
+                              unsigned char ivec[16], u64 *Xi)
+{
+    size_t bulk = 0;
+
+    if (AESNI_GCM_AVX512_CAPABLE)
+        bulk = aesni_gcm_encrypt_avx512(in, out, len, key, ivec, Xi);
+    return bulk + aesni_gcm_encrypt(in + bulk, out + bulk, len - bulk,
+                                    key, ivec, Xi);
+}
+
+static ossl_unused ossl_inline
+size_t aesni_gcm_decrypt_bulk(const unsigned char *in, unsigned char *out,
+                              size_t len, const void *key,
+                              unsigned char ivec[16], u64 *Xi)
+{
+    size_t bulk = 0;
+
+    if (AESNI_GCM_AVX512_CAPABLE)
+        bulk = aesni_gcm_decrypt_avx512(in, out, len, key, ivec, Xi);
+    return bulk + aesni_gcm_decrypt(in + bulk, out + bulk, len - bulk,
+                                    key, ivec, Xi);
+}
 #  endif
 
 
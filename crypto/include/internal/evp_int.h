@@ -103,6 +103,16 @@ struct evp_pkey_method_st {
     int (*param_check) (EVP_PKEY *pkey);
 
     int (*digest_custom) (EVP_PKEY_CTX *ctx, EVP_MD_CTX *mctx);
+
+    int (*verify_batch) (EVP_PKEY *const pkey[],
+                         const unsigned char *const sig[],
+                         const size_t siglen[],
+                         const unsigned char *const tbs[],
+                         const size_t tbslen[], size_t n);
+
+    int (*derive_batch) (EVP_PKEY *const pkey[], EVP_PKEY *const peer[],
+                         unsigned char *const key[], size_t keylen[],
+                         size_t n);
 } /* EVP_PKEY_METHOD */ ;
 
 DEFINE_STACK_OF_CONST(EVP_PKEY_METHOD)
@@ -208,6 +218,7 @@ struct evp_md_st {
     OSSL_OP_digest_update_fn *dupdate;
     OSSL_OP_digest_final_fn *dfinal;
     OSSL_OP_digest_digest_fn *digest;
+    OSSL_OP_digest_batch_digest_fn *batch_digest;
     OSSL_OP_digest_freectx_fn *freectx;
     OSSL_OP_digest_dupctx_fn *dupctx;
     OSSL_OP_digest_get_params_fn *get_params;
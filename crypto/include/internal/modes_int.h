@@ -134,6 +134,12 @@ struct gcm128_context {
 #endif
 };
 
+typedef void (*gcm128_run_f)(void (*fn)(void *arg, size_t i), void *arg,
+                             size_t n);
+int CRYPTO_gcm128_crypt_mt(GCM128_CONTEXT *ctx, const unsigned char *in,
+                           unsigned char *out, size_t len, ctr128_f stream,
+                           int enc, size_t nseg, gcm128_run_f run);
+
 /*
  * The maximum permitted number of cipher blocks per data unit in XTS mode.
  * Reference IEEE Std 1619-2018.
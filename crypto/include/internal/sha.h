@@ -16,5 +16,11 @@
 int sha512_224_init(SHA512_CTX *);
 int sha512_256_init(SHA512_CTX *);
 int sha1_ctrl(SHA_CTX *ctx, int cmd, int mslen, void *ms);
+int sha256_digest_batch(const SHA256_CTX *init,
+                        const unsigned char *const in[], const size_t inlen[],
+                        size_t n, unsigned char *md);
+int sha512_digest_batch(const SHA512_CTX *init,
+                        const unsigned char *const in[], const size_t inlen[],
+                        size_t n, unsigned char *md);
 
 #endif
@@ -0,0 +1,24 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#ifndef HEADER_THREAD_POOL_H
+# define HEADER_THREAD_POOL_H
+
+# include <stddef.h>
+
+typedef void (*OSSL_THREAD_POOL_FN)(void *arg, size_t i);
+
+int ossl_thread_pool_init(size_t threads);
+void ossl_thread_pool_cleanup(void);
+void ossl_thread_pool_fork_child(void);
+
+size_t ossl_thread_pool_size(void);
+void ossl_thread_pool_run(OSSL_THREAD_POOL_FN fn, void *arg, size_t n);
+
+#endif
@@ -259,6 +259,11 @@ struct x509_store_ctx_st {      /* X509_STORE_CTX */
     SSL_DANE *dane;
     /* signed via bare TA public key, rather than CA certificate */
     int bare_ta_signed;
+    /* Verified chain cache state, see crypto/x509/x509_vcache.c */
+    int vcache;
+    unsigned long vcache_generation;
+    time_t vcache_expires;
+    unsigned char vcache_key[32];
 };
 
 /* PKCS#8 private key info structure */
@@ -16,6 +16,7 @@
 #include "internal/evp_int.h"
 #include "internal/conf.h"
 #include "internal/async.h"
+#include "internal/thread_pool.h"
 #include "internal/engine.h"
 #include "internal/comp.h"
 #include "internal/err.h"
@@ -253,6 +254,21 @@ DEFINE_RUN_ONCE_STATIC(ossl_init_async)
     return 1;
 }
 
+static CRYPTO_ONCE thread_pool = CRYPTO_ONCE_STATIC_INIT;
+static int thread_pool_inited = 0;
+static const OPENSSL_INIT_SETTINGS *thread_pool_settings = NULL;
+DEFINE_RUN_ONCE_STATIC(ossl_init_thread_pool)
+{
+    unsigned int threads = thread_pool_settings != NULL
+                           ? thread_pool_settings->pool_threads : 0;
+
+    OSSL_TRACE1(INIT, "ossl_thread_pool_init(%u)\n", threads);
+    if (!ossl_thread_pool_init(threads))
+        return 0;
+    thread_pool_inited = 1;
+    return 1;
+}
+
 #ifndef OPENSSL_NO_ENGINE
 static CRYPTO_ONCE engine_openssl = CRYPTO_ONCE_STATIC_INIT;
 DEFINE_RUN_ONCE_STATIC(ossl_init_engine_openssl)
@@ -347,6 +363,12 @@ void OPENSSL_cleanup(void)
         return;
     stopped = 1;
 
+    /* The workers must be gone before any state they might use */
+    if (thread_pool_inited) {
+        OSSL_TRACE(INIT, "OPENSSL_cleanup: ossl_thread_pool_cleanup()\n");
+        ossl_thread_pool_cleanup();
+    }
+
     /*
      * Thread stop may not get automatically called by the thread library for
      * the very last thread in some situations, so call it directly.
@@ -540,6 +562,17 @@ int OPENSSL_init_crypto(uint64_t opts, const OPENSSL_INIT_SETTINGS *settings)
             && !RUN_ONCE(&async, ossl_init_async))
         return 0;
 
+    if (opts & OPENSSL_INIT_THREAD_POOL) {
+        int ret;
+        CRYPTO_THREAD_write_lock(init_lock);
+        thread_pool_settings = settings;
+        ret = RUN_ONCE(&thread_pool, ossl_init_thread_pool);
+        thread_pool_settings = NULL;
+        CRYPTO_THREAD_unlock(init_lock);
+        if (ret <= 0)
+            return 0;
+    }
+
 #ifndef OPENSSL_NO_ENGINE
     if ((opts & OPENSSL_INIT_ENGINE_OPENSSL)
             && !RUN_ONCE(&engine_openssl, ossl_init_engine_openssl))
@@ -677,6 +710,7 @@ void OPENSSL_fork_parent(void)
 void OPENSSL_fork_child(void)
 {
     rand_fork();
+    ossl_thread_pool_fork_child();
     /* TODO(3.0): Inform all providers about a fork event */
 }
 #endif
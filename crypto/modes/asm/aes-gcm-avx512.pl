@@ -0,0 +1,392 @@
+#! /usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+#
+# AES-GCM for processors with VAES and VPCLMULQDQ on 512-bit registers.
+#
+# This is a wide counterpart of aesni_gcm_[en|de]crypt from
+# aesni-gcm-x86_64.pl with the same interface. 16 blocks are processed
+# per iteration, as 4 %zmm registers of 4 blocks each. Counter blocks
+# are encrypted with vaesenc on whole registers, and GHASH of the 16
+# ciphertext blocks is computed with H^16..H^1 and a single reduction,
+# which is done in all lanes at once and folded to one block at the
+# end. H^5..H^16 are derived on every call from H^1..H^4 as found in
+# Htable set up by gcm_init_avx, which takes a dozen multiplications,
+# negligible compared to a TLS record.
+#
+# Only %zmm0-%zmm5 and %zmm16-%zmm31 are used, so that no registers
+# have to be preserved on Win64 and no stack frame is needed.
+#
+# Only whole chunks of 256 bytes are processed, the remainder is left
+# to the caller, which is expected to pass it on to aesni_gcm_* and
+# CRYPTO_gcm128_[en|de]crypt_ctr32.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$vaes = ($1>=2.30);
+}
+
+if (!$vaes && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	   `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)/) {
+	$vaes = ($1>=2.14);
+}
+
+if (!$vaes && `$ENV{CC} -v 2>&1` =~ /((?:^clang|LLVM) version|.*based on LLVM) ([0-9]+)\.([0-9]+)/) {
+	$vaes = ($2>=7);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+if ($vaes) {{{
+
+my ($inp,$out,$len,$key,$ivp,$Xip)=("%rdi","%rsi","%rdx","%rcx","%r8","%r9");
+my ($rounds,$ret)=("%r10d","%rax");
+
+my @B=map("%zmm$_",(0..3));		# counter blocks
+my ($Bswap,$Xi)=map("%zmm$_",(4..5));
+my ($Ctr,$Inc,$Rk0,$Rklast,$T0,$T1,$Lo,$Mi,$Hi,$Rk)=map("%zmm$_",(16..25));
+my @H=map("%zmm$_",(26..29));		# H^16..H^13, ..., H^4..H^1
+my $Poly="%zmm30";
+
+my ($T0x,$Lox,$Xix,$Bswapx,$Ctrx,$H3x)=map { (my $r=$_) =~ s/zmm/xmm/; $r }
+					($T0,$Lo,$Xi,$Bswap,$Ctr,$H[3]);
+my ($T0y,$Loy)=map { (my $r=$_) =~ s/zmm/ymm/; $r } ($T0,$Lo);
+
+# Accumulate unreduced products of the blocks in @D by @H in $Lo, $Mi
+# and $Hi.
+sub ghash_mul16 {
+my @D=@_;
+
+for (my $i=0; $i<4; $i++) {
+$code.=<<___;
+	vpclmulqdq	\$0x00,$H[$i],$D[$i],$T0
+	vpclmulqdq	\$0x11,$H[$i],$D[$i],$T1
+___
+$code.=<<___	if ($i==0);
+	vmovdqa64	$T0,$Lo
+	vmovdqa64	$T1,$Hi
+	vpclmulqdq	\$0x01,$H[$i],$D[$i],$T0
+	vpclmulqdq	\$0x10,$H[$i],$D[$i],$T1
+	vpxorq		$T0,$T1,$Mi
+___
+$code.=<<___	if ($i!=0);
+	vpxorq		$T0,$Lo,$Lo
+	vpxorq		$T1,$Hi,$Hi
+	vpclmulqdq	\$0x01,$H[$i],$D[$i],$T0
+	vpclmulqdq	\$0x10,$H[$i],$D[$i],$T1
+	vpternlogq	\$0x96,$T0,$T1,$Mi
+___
+}
+}
+
+# Reduce $Hi:$Mi:$Lo lane-wise and fold the lanes into $Xi.
+sub ghash_reduce {
+$code.=<<___;
+	vpslldq		\$8,$Mi,$T0
+	vpsrldq		\$8,$Mi,$T1
+	vpxorq		$T0,$Lo,$Lo
+	vpxorq		$T1,$Hi,$Hi
+
+	vpclmulqdq	\$0x10,$Poly,$Lo,$T0	# 1st phase
+	vpshufd		\$0x4e,$Lo,$Lo
+	vpxorq		$T0,$Lo,$Lo
+	vpclmulqdq	\$0x10,$Poly,$Lo,$T0	# 2nd phase
+	vpshufd		\$0x4e,$Lo,$Lo
+	vpternlogq	\$0x96,$T0,$Hi,$Lo
+
+	vextracti64x4	\$1,$Lo,$T0y
+	vpxorq		$T0y,$Loy,$Loy
+	vextracti32x4	\$1,$Loy,$T0x
+	vpxorq		$T0x,$Lox,$Xix
+___
+}
+
+# $dst = $a * $b lane-wise, with full reduction, clobbers $Lo/$Mi/$Hi.
+sub gf_mul4 {
+my ($dst,$a,$b)=@_;
+
+$code.=<<___;
+	vpclmulqdq	\$0x00,$b,$a,$Lo
+	vpclmulqdq	\$0x11,$b,$a,$Hi
+	vpclmulqdq	\$0x01,$b,$a,$T0
+	vpclmulqdq	\$0x10,$b,$a,$T1
+	vpxorq		$T0,$T1,$Mi
+	vpslldq		\$8,$Mi,$T0
+	vpsrldq		\$8,$Mi,$T1
+	vpxorq		$T0,$Lo,$Lo
+	vpxorq		$T1,$Hi,$Hi
+	vpclmulqdq	\$0x10,$Poly,$Lo,$T0
+	vpshufd		\$0x4e,$Lo,$Lo
+	vpxorq		$T0,$Lo,$Lo
+	vpclmulqdq	\$0x10,$Poly,$Lo,$T0
+	vpshufd		\$0x4e,$Lo,$Lo
+	vpternlogq	\$0x96,$T0,$Hi,$Lo
+	vmovdqa64	$Lo,$dst
+___
+}
+
+# Common prologue: load constants, counter, Xi and powers of H.
+sub gcm_setup {
+my $dir=shift;
+
+$code.=<<___;
+	xor	$ret,$ret
+	cmp	\$0x100,$len			# minimal accepted length
+	jb	.Lgcm_${dir}_avx512_abort
+
+	vbroadcasti32x4	.Lbswap_mask(%rip),$Bswap
+	vbroadcasti32x4	.Lpoly(%rip),$Poly
+	vmovdqu64	.Linc4(%rip),$Inc
+	vbroadcasti32x4	($ivp),$Ctr
+	vpshufb		$Bswap,$Ctr,$Ctr
+	vpaddd		.Linit_ctr(%rip),$Ctr,$Ctr	# counters in all lanes
+
+	vmovdqu		($Xip),$Xix
+	vpshufb		$Bswapx,$Xix,$Xix
+
+	mov		240($key),$rounds		# 9, 11 or 13
+	vbroadcasti32x4	($key),$Rk0
+	lea		1(%r10),%r11d
+	shl		\$4,%r11d
+	vbroadcasti32x4	($key,%r11),$Rklast
+
+	vmovdqu64	0x60($Xip),$H3x	# H^4
+	vinserti32x4	\$1,0x50($Xip),$H[3],$H[3]	# H^3
+	vinserti32x4	\$2,0x30($Xip),$H[3],$H[3]	# H^2
+	vinserti32x4	\$3,0x20($Xip),$H[3],$H[3]	# H^1
+	vbroadcasti32x4	0x60($Xip),$Rk		# borrow $Rk for H^4
+___
+gf_mul4($H[2],$H[3],$Rk);			# H^8..H^5
+gf_mul4($H[1],$H[2],$Rk);			# H^12..H^9
+gf_mul4($H[0],$H[1],$Rk);			# H^16..H^13
+$code.=<<___;
+
+	shr		\$8,$len
+	mov		$len,$ret
+	shl		\$8,$ret			# return value
+___
+}
+
+# Encrypt 4 counter blocks in @B, leave the counter to next 16 blocks.
+sub aes_ctr16 {
+my $dir=shift;
+
+for (my $i=0; $i<4; $i++) {
+$code.=<<___;
+	vpshufb		$Bswap,$Ctr,$B[$i]
+	vpaddd		$Inc,$Ctr,$Ctr
+___
+}
+for (my $i=0; $i<4; $i++) {
+$code.=<<___;
+	vpxorq		$Rk0,$B[$i],$B[$i]
+___
+}
+for (my $r=1; $r<14; $r++) {
+$code.=<<___	if ($r==10);
+	cmp		\$11,$rounds
+	jb		.Llast_round_${dir}_avx512
+___
+$code.=<<___	if ($r==12);
+	je		.Llast_round_${dir}_avx512
+___
+$code.=<<___;
+	vbroadcasti32x4	`16*$r`($key),$Rk
+___
+for (my $i=0; $i<4; $i++) {
+$code.=<<___;
+	vaesenc		$Rk,$B[$i],$B[$i]
+___
+}
+}
+$code.=<<___;
+.Llast_round_${dir}_avx512:
+___
+for (my $i=0; $i<4; $i++) {
+$code.=<<___;
+	vaesenclast	$Rklast,$B[$i],$B[$i]
+___
+}
+}
+
+sub gcm_finish {
+my $dir=shift;
+
+$code.=<<___;
+	vpshufb		$Bswapx,$Ctrx,$T0x
+	vmovdqu64	$T0x,($ivp)		# save next counter value
+	vpshufb		$Bswapx,$Xix,$Xix
+	vmovdqu		$Xix,($Xip)		# output Xi
+___
+foreach ($Ctr,$Inc,$Rk0,$Rklast,$T0,$T1,$Lo,$Mi,$Hi,$Rk,@H,$Poly) {
+$code.=<<___;
+	vpxord		$_,$_,$_
+___
+}
+$code.=<<___;
+	vzeroupper
+.Lgcm_${dir}_avx512_abort:
+	ret
+___
+}
+
+######################################################################
+#
+# size_t aesni_gcm_[en|de]crypt_avx512(const void *inp, void *out,
+#		size_t len, const AES_KEY *key, unsigned char iv[16],
+#		struct { u128 Xi,H,Htbl[9]; } *Xip);
+$code.=<<___;
+.text
+
+.globl	aesni_gcm_encrypt_avx512
+.type	aesni_gcm_encrypt_avx512,\@function,6
+.align	32
+aesni_gcm_encrypt_avx512:
+.cfi_startproc
+___
+gcm_setup("enc");
+$code.=<<___;
+
+.align	32
+.Loop_enc_avx512:
+___
+aes_ctr16("enc");
+$code.=<<___;
+
+	vpxorq		0x00($inp),$B[0],$B[0]
+	vpxorq		0x40($inp),$B[1],$B[1]
+	vpxorq		0x80($inp),$B[2],$B[2]
+	vpxorq		0xc0($inp),$B[3],$B[3]
+	lea		0x100($inp),$inp
+	vmovdqu64	$B[0],0x00($out)
+	vmovdqu64	$B[1],0x40($out)
+	vmovdqu64	$B[2],0x80($out)
+	vmovdqu64	$B[3],0xc0($out)
+	lea		0x100($out),$out
+
+	vpshufb		$Bswap,$B[0],$B[0]
+	vpshufb		$Bswap,$B[1],$B[1]
+	vpshufb		$Bswap,$B[2],$B[2]
+	vpshufb		$Bswap,$B[3],$B[3]
+	vpxorq		$Xi,$B[0],$B[0]
+___
+ghash_mul16(@B);
+ghash_reduce();
+$code.=<<___;
+
+	dec		$len
+	jnz		.Loop_enc_avx512
+
+___
+gcm_finish("enc");
+$code.=<<___;
+.cfi_endproc
+.size	aesni_gcm_encrypt_avx512,.-aesni_gcm_encrypt_avx512
+___
+
+{
+# In decryption GHASH works on the input, so that it doesn't depend on
+# the AES rounds of the same iteration.
+$code.=<<___;
+.globl	aesni_gcm_decrypt_avx512
+.type	aesni_gcm_decrypt_avx512,\@function,6
+.align	32
+aesni_gcm_decrypt_avx512:
+.cfi_startproc
+___
+gcm_setup("dec");
+$code.=<<___;
+
+.align	32
+.Loop_dec_avx512:
+	vmovdqu64	0x00($inp),$B[0]
+	vmovdqu64	0x40($inp),$B[1]
+	vmovdqu64	0x80($inp),$B[2]
+	vmovdqu64	0xc0($inp),$B[3]
+	vpshufb		$Bswap,$B[0],$B[0]
+	vpshufb		$Bswap,$B[1],$B[1]
+	vpshufb		$Bswap,$B[2],$B[2]
+	vpshufb		$Bswap,$B[3],$B[3]
+	vpxorq		$Xi,$B[0],$B[0]
+___
+ghash_mul16(@B);
+ghash_reduce();
+aes_ctr16("dec");
+$code.=<<___;
+
+	vpxorq		0x00($inp),$B[0],$B[0]
+	vpxorq		0x40($inp),$B[1],$B[1]
+	vpxorq		0x80($inp),$B[2],$B[2]
+	vpxorq		0xc0($inp),$B[3],$B[3]
+	lea		0x100($inp),$inp
+	vmovdqu64	$B[0],0x00($out)
+	vmovdqu64	$B[1],0x40($out)
+	vmovdqu64	$B[2],0x80($out)
+	vmovdqu64	$B[3],0xc0($out)
+	lea		0x100($out),$out
+
+	dec		$len
+	jnz		.Loop_dec_avx512
+
+___
+gcm_finish("dec");
+$code.=<<___;
+.cfi_endproc
+.size	aesni_gcm_decrypt_avx512,.-aesni_gcm_decrypt_avx512
+___
+}
+
+$code.=<<___;
+.align	64
+.Linit_ctr:
+	.long	0,0,0,0, 1,0,0,0, 2,0,0,0, 3,0,0,0
+.Linc4:
+	.long	4,0,0,0, 4,0,0,0, 4,0,0,0, 4,0,0,0
+.Lbswap_mask:
+	.byte	15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0
+.Lpoly:
+	.byte	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0xc2
+.asciz	"AES-GCM for VAES/VPCLMULQDQ, CRYPTOGAMS by <appro\@openssl.org>"
+.align	64
+___
+}}} else {{{
+$code=<<___;	# assembler is too old
+.text
+
+.globl	aesni_gcm_encrypt_avx512
+.type	aesni_gcm_encrypt_avx512,\@abi-omnipotent
+aesni_gcm_encrypt_avx512:
+	xor	%eax,%eax
+	ret
+.size	aesni_gcm_encrypt_avx512,.-aesni_gcm_encrypt_avx512
+
+.globl	aesni_gcm_decrypt_avx512
+.type	aesni_gcm_decrypt_avx512,\@abi-omnipotent
+aesni_gcm_decrypt_avx512:
+	xor	%eax,%eax
+	ret
+.size	aesni_gcm_decrypt_avx512,.-aesni_gcm_decrypt_avx512
+___
+}}}
+
+$code =~ s/\`([^\`]*)\`/eval($1)/gem;
+
+print $code;
+
+close STDOUT;
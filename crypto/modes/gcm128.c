@@ -1791,6 +1791,164 @@ int CRYPTO_gcm128_decrypt_ctr32(GCM128_CONTEXT *ctx,
 #endif
 }
 
+static int gcm_crypt(GCM128_CONTEXT *ctx, const unsigned char *in,
+                     unsigned char *out, size_t len, ctr128_f stream, int enc)
+{
+    if (enc)
+        return stream != NULL
+               ? CRYPTO_gcm128_encrypt_ctr32(ctx, in, out, len, stream)
+               : CRYPTO_gcm128_encrypt(ctx, in, out, len);
+    return stream != NULL
+           ? CRYPTO_gcm128_decrypt_ctr32(ctx, in, out, len, stream)
+           : CRYPTO_gcm128_decrypt(ctx, in, out, len);
+}
+
+/*
+ * Multiply |x| by |y| in GF(2^128), both given as two 64-bit words with the
+ * first bit of the GCM bit string in the most significant bit of x[0].  This
+ * is slow but constant time, and only used for the handful of products
+ * needed to join the GHASH values of separately hashed segments.
+ */
+static void gcm_mul_generic(u64 x[2], const u64 y[2])
+{
+    u64 zh = 0, zl = 0, vh = y[0], vl = y[1], m;
+    int i;
+
+    for (i = 0; i < 128; i++) {
+        m = 0 - ((x[i >> 6] >> (63 - (i & 63))) & 1);
+        zh ^= vh & m;
+        zl ^= vl & m;
+        m = U64(0xe100000000000000) & (0 - (vl & 1));
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ m;
+    }
+    x[0] = zh;
+    x[1] = zl;
+}
+
+/* Set |p| to H^n for n > 0 */
+static void gcm_hpow(const GCM128_CONTEXT *ctx, u64 p[2], size_t n)
+{
+    u64 h[2];
+
+    h[0] = p[0] = ctx->H.u[0];
+    h[1] = p[1] = ctx->H.u[1];
+    for (n--; n != 0; n >>= 1) {
+        if (n & 1)
+            gcm_mul_generic(p, h);
+        gcm_mul_generic(h, h);
+    }
+}
+
+typedef struct {
+    const GCM128_CONTEXT *ctx;
+    const unsigned char *in;
+    unsigned char *out;
+    size_t blocks;
+    size_t nseg;
+    ctr128_f stream;
+    int enc;
+    u64 (*ghash)[2];
+} GCM128_MT_JOB;
+
+/*
+ * Process segment |i| of the whole blocks of the job with a copy of the
+ * context that starts at the counter value of the segment and with a
+ * zero hash, and save the GHASH value of the segment.
+ */
+static void gcm_mt_segment(void *arg, size_t i)
+{
+    const GCM128_MT_JOB *job = arg;
+    size_t per = job->blocks / job->nseg, rem = job->blocks % job->nseg;
+    size_t first = i * per + (i < rem ? i : rem);
+    size_t len = (per + (i < rem)) * 16;
+    GCM128_CONTEXT seg;
+
+    memcpy(&seg, job->ctx, sizeof(seg));
+    seg.Xi.u[0] = seg.Xi.u[1] = 0;
+    seg.len.u[0] = seg.len.u[1] = 0;
+    seg.ares = seg.mres = 0;
+    PUTU32(seg.Yi.c + 12, GETU32(seg.Yi.c + 12) + (u32)first);
+
+    gcm_crypt(&seg, job->in + first * 16, job->out + first * 16, len,
+              job->stream, job->enc);
+
+    job->ghash[i][0] = (u64)GETU32(seg.Xi.c) << 32 | GETU32(seg.Xi.c + 4);
+    job->ghash[i][1] = (u64)GETU32(seg.Xi.c + 8) << 32 | GETU32(seg.Xi.c + 12);
+    OPENSSL_cleanse(&seg, sizeof(seg));
+}
+
+/*
+ * Encrypt or decrypt |len| bytes like CRYPTO_gcm128_encrypt_ctr32() and
+ * CRYPTO_gcm128_decrypt_ctr32() do, or like their block cipher counterparts
+ * if |stream| is NULL, but split the whole blocks into |nseg| segments that
+ * |run| may process concurrently.  GHASH is linear, so the hash over all the
+ * blocks is the hash so far multiplied by H^n, n being the number of blocks
+ * in the first segment, xored with the hash of that segment on its own, and
+ * so on for the next segments.
+ */
+int CRYPTO_gcm128_crypt_mt(GCM128_CONTEXT *ctx, const unsigned char *in,
+                           unsigned char *out, size_t len, ctr128_f stream,
+                           int enc, size_t nseg, gcm128_run_f run)
+{
+    GCM128_MT_JOB job;
+    u64 mlen = ctx->len.u[1] + len, x[2], hp[2], hp1[2];
+    size_t head, i;
+
+    if (mlen > ((U64(1) << 36) - 32) || (sizeof(len) == 8 && mlen < len))
+        return -1;
+
+    /*
+     * Finish any pending AAD and partial block and process one more whole
+     * block on this thread, which leaves the context without buffered data.
+     */
+    head = (16 - ctx->mres % 16) % 16 + 16;
+    if (nseg < 2 || len < head + nseg * 16)
+        return gcm_crypt(ctx, in, out, len, stream, enc);
+    job.ghash = OPENSSL_malloc(nseg * sizeof(*job.ghash));
+    if (job.ghash == NULL)
+        return gcm_crypt(ctx, in, out, len, stream, enc);
+    if (gcm_crypt(ctx, in, out, head, stream, enc) != 0)
+        goto err;
+    in += head;
+    out += head;
+    len -= head;
+
+    job.ctx = ctx;
+    job.in = in;
+    job.out = out;
+    job.blocks = len / 16;
+    job.nseg = nseg;
+    job.stream = stream;
+    job.enc = enc;
+    run(gcm_mt_segment, &job, nseg);
+
+    gcm_hpow(ctx, hp, job.blocks / nseg);
+    hp1[0] = hp[0];
+    hp1[1] = hp[1];
+    gcm_mul_generic(hp1, ctx->H.u);
+    x[0] = (u64)GETU32(ctx->Xi.c) << 32 | GETU32(ctx->Xi.c + 4);
+    x[1] = (u64)GETU32(ctx->Xi.c + 8) << 32 | GETU32(ctx->Xi.c + 12);
+    for (i = 0; i < nseg; i++) {
+        gcm_mul_generic(x, i < job.blocks % nseg ? hp1 : hp);
+        x[0] ^= job.ghash[i][0];
+        x[1] ^= job.ghash[i][1];
+    }
+    PUTU32(ctx->Xi.c, (u32)(x[0] >> 32));
+    PUTU32(ctx->Xi.c + 4, (u32)x[0]);
+    PUTU32(ctx->Xi.c + 8, (u32)(x[1] >> 32));
+    PUTU32(ctx->Xi.c + 12, (u32)x[1]);
+    PUTU32(ctx->Yi.c + 12, GETU32(ctx->Yi.c + 12) + (u32)job.blocks);
+    ctx->len.u[1] += job.blocks * 16;
+    OPENSSL_clear_free(job.ghash, nseg * sizeof(*job.ghash));
+
+    return gcm_crypt(ctx, in + job.blocks * 16, out + job.blocks * 16,
+                     len - job.blocks * 16, stream, enc);
+ err:
+    OPENSSL_free(job.ghash);
+    return -1;
+}
+
 int CRYPTO_gcm128_finish(GCM128_CONTEXT *ctx, const unsigned char *tag,
                          size_t len)
 {
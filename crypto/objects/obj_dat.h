@@ -1084,7 +1084,7 @@ static const unsigned char so[7813] = {
     0x2A,0x81,0x1C,0xCF,0x55,0x01,0x83,0x75,       /* [ 7804] OBJ_SM2_with_SM3 */
 };
 
-#define NUM_NID 1208
+#define NUM_NID 1211
 static const ASN1_OBJECT nid_objs[NUM_NID] = {
     {"UNDEF", "undefined", NID_undef},
     {"rsadsi", "RSA Data Security, Inc.", NID_rsadsi, 6, &so[0]},
@@ -2294,9 +2294,12 @@ static const ASN1_OBJECT nid_objs[NUM_NID] = {
     {"SSKDF", "sskdf", NID_sskdf},
     {"X963KDF", "x963kdf", NID_x963kdf},
     {"X942KDF", "x942kdf", NID_x942kdf},
+    {"BLAKE2bp512", "blake2bp512", NID_blake2bp512},
+    {"BLAKE2sp256", "blake2sp256", NID_blake2sp256},
+    {"BLAKE3", "blake3", NID_blake3},
 };
 
-#define NUM_SN 1199
+#define NUM_SN 1202
 static const unsigned int sn_objs[NUM_SN] = {
      364,    /* "AD_DVCS" */
      419,    /* "AES-128-CBC" */
@@ -2377,7 +2380,10 @@ static const unsigned int sn_objs[NUM_SN] = {
     1201,    /* "BLAKE2BMAC" */
     1202,    /* "BLAKE2SMAC" */
     1056,    /* "BLAKE2b512" */
+    1208,    /* "BLAKE2bp512" */
     1057,    /* "BLAKE2s256" */
+    1209,    /* "BLAKE2sp256" */
+    1210,    /* "BLAKE3" */
       14,    /* "C" */
      751,    /* "CAMELLIA-128-CBC" */
      962,    /* "CAMELLIA-128-CCM" */
@@ -3499,7 +3505,7 @@ static const unsigned int sn_objs[NUM_SN] = {
     1093,    /* "x509ExtAdmission" */
 };
 
-#define NUM_LN 1199
+#define NUM_LN 1202
 static const unsigned int ln_objs[NUM_LN] = {
      363,    /* "AD Time Stamping" */
      405,    /* "ANSI X9.62" */
@@ -3803,8 +3809,11 @@ static const unsigned int ln_objs[NUM_LN] = {
       94,    /* "bf-ofb" */
     1056,    /* "blake2b512" */
     1201,    /* "blake2bmac" */
+    1208,    /* "blake2bp512" */
     1057,    /* "blake2s256" */
     1202,    /* "blake2smac" */
+    1209,    /* "blake2sp256" */
+    1210,    /* "blake3" */
      921,    /* "brainpoolP160r1" */
      922,    /* "brainpoolP160t1" */
      923,    /* "brainpoolP192r1" */
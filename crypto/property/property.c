@@ -24,6 +24,30 @@
 /* The number of elements in the query cache before we initiate a flush */
 #define IMPL_CACHE_FLUSH_THRESHOLD  500
 
+/*
+ * The query cache is fronted by a direct mapped table that is read without
+ * taking the store lock.  Each slot is guarded by its own sequence count,
+ * which is odd while the slot is being written, so that readers can detect
+ * and ignore torn entries without writing to shared memory themselves.
+ * Flushing the cache publishes a new generation, which invalidates all
+ * slots at once.  The table never shrinks or moves, so readers can't find
+ * themselves looking at freed memory.  Anything not found in the table is
+ * looked up in the locked per algorithm caches below as before.
+ */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+# define QUERY_FAST_CACHE
+# define QUERY_FAST_SLOTS           256     /* Must be a power of 2 */
+# define QUERY_FAST_MAX_QUERY       48
+
+typedef struct {
+    uint32_t seq;
+    uint32_t gen;
+    int nid;
+    void *method;
+    char query[QUERY_FAST_MAX_QUERY];
+} QUERY_FAST_SLOT;
+#endif
+
 typedef struct {
     const OSSL_PROVIDER *provider;
     OSSL_PROPERTY_LIST *properties;
@@ -56,6 +80,11 @@ struct ossl_method_store_st {
     unsigned int nbits;
     unsigned char rand_bits[(IMPL_CACHE_FLUSH_THRESHOLD + 7) / 8];
     CRYPTO_RWLOCK *lock;
+#ifdef QUERY_FAST_CACHE
+    /* Allocated on the first cache insertion, slots are valid if gen matches */
+    QUERY_FAST_SLOT *fast;
+    uint32_t fast_gen;
+#endif
 };
 
 typedef struct {
@@ -94,6 +123,87 @@ static int query_cmp(const QUERY *a, const QUERY *b)
     return strcmp(a->query, b->query);
 }
 
+#ifdef QUERY_FAST_CACHE
+static QUERY_FAST_SLOT *query_fast_slot(QUERY_FAST_SLOT *fast, int nid,
+                                        const char *query)
+{
+    unsigned long h = OPENSSL_LH_strhash(query) ^ ((unsigned long)nid * 31);
+
+    return fast + (h & (QUERY_FAST_SLOTS - 1));
+}
+
+static int query_fast_get(OSSL_METHOD_STORE *store, int nid,
+                          const char *query, void **method)
+{
+    QUERY_FAST_SLOT *fast = __atomic_load_n(&store->fast, __ATOMIC_ACQUIRE);
+    QUERY_FAST_SLOT *slot;
+    size_t len = strlen(query);
+    uint32_t seq, gen;
+    void *m;
+    int n;
+    char q[QUERY_FAST_MAX_QUERY];
+
+    if (fast == NULL || len >= QUERY_FAST_MAX_QUERY)
+        return 0;
+    slot = query_fast_slot(fast, nid, query);
+    gen = __atomic_load_n(&store->fast_gen, __ATOMIC_ACQUIRE);
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if ((seq & 1) != 0
+            || __atomic_load_n(&slot->gen, __ATOMIC_RELAXED) != gen)
+        return 0;
+    n = __atomic_load_n(&slot->nid, __ATOMIC_RELAXED);
+    m = __atomic_load_n(&slot->method, __ATOMIC_RELAXED);
+    memcpy(q, slot->query, len + 1);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq
+            || n != nid || memcmp(q, query, len + 1) != 0)
+        return 0;
+    *method = m;
+    return 1;
+}
+
+/*
+ * Must be called with the store lock held, for reading at least, so that the
+ * generation can't change under our feet.  Writers that race for the same
+ * slot don't wait for each other, all but one simply give up.
+ */
+static void query_fast_set(OSSL_METHOD_STORE *store, int nid,
+                           const char *query, void *method)
+{
+    QUERY_FAST_SLOT *fast = __atomic_load_n(&store->fast, __ATOMIC_ACQUIRE);
+    QUERY_FAST_SLOT *slot;
+    size_t len = strlen(query);
+    uint32_t seq;
+
+    if (fast == NULL || len >= QUERY_FAST_MAX_QUERY)
+        return;
+    slot = query_fast_slot(fast, nid, query);
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    if ((seq & 1) != 0
+            || !__atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, 0,
+                                            __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED))
+        return;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&slot->gen, store->fast_gen, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->nid, nid, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->method, method, __ATOMIC_RELAXED);
+    memcpy(slot->query, query, len + 1);
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* Must be called with the store write lock held */
+static void query_fast_flush(OSSL_METHOD_STORE *store)
+{
+    uint32_t gen = store->fast_gen + 1;
+
+    /* Generation 0 is what never written slots have */
+    if (gen == 0)
+        gen = 1;
+    __atomic_store_n(&store->fast_gen, gen, __ATOMIC_RELEASE);
+}
+#endif
+
 static void impl_free(IMPLEMENTATION *impl)
 {
     if (impl != NULL) {
@@ -138,6 +248,9 @@ OSSL_METHOD_STORE *ossl_method_store_new(OPENSSL_CTX *ctx)
             OPENSSL_free(res);
             return NULL;
         }
+#ifdef QUERY_FAST_CACHE
+        res->fast_gen = 1;
+#endif
     }
     return res;
 }
@@ -148,6 +261,9 @@ void ossl_method_store_free(OSSL_METHOD_STORE *store)
         ossl_sa_ALGORITHM_doall(store->algs, &alg_cleanup);
         ossl_sa_ALGORITHM_free(store->algs);
         ossl_property_free(store->global_properties);
+#ifdef QUERY_FAST_CACHE
+        OPENSSL_free(store->fast);
+#endif
         CRYPTO_THREAD_lock_free(store->lock);
         OPENSSL_free(store);
     }
@@ -368,9 +484,12 @@ static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid)
 {
     ALGORITHM *alg = ossl_method_store_retrieve(store, nid);
 
-    if (alg != NULL) {
+    if (alg != NULL && lh_QUERY_num_items(alg->cache) > 0) {
         store->nelem -= lh_QUERY_num_items(alg->cache);
         impl_cache_flush_alg(0, alg);
+#ifdef QUERY_FAST_CACHE
+        query_fast_flush(store);
+#endif
     }
 }
 
@@ -378,6 +497,9 @@ static void ossl_method_cache_flush_all(OSSL_METHOD_STORE *store)
 {
     ossl_sa_ALGORITHM_doall(store->algs, &impl_cache_flush_alg);
     store->nelem = 0;
+#ifdef QUERY_FAST_CACHE
+    query_fast_flush(store);
+#endif
 }
 
 IMPLEMENT_LHASH_DOALL_ARG(QUERY, IMPL_CACHE_FLUSH);
@@ -441,6 +563,9 @@ static void ossl_method_cache_flush_some(OSSL_METHOD_STORE *store)
     store->need_flush = 0;
     ossl_sa_ALGORITHM_doall_arg(store->algs, &impl_cache_flush_one_alg, &state);
     store->nelem = state.nelem;
+#ifdef QUERY_FAST_CACHE
+    query_fast_flush(store);
+#endif
 }
 
 int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, int nid,
@@ -452,6 +577,12 @@ int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, int nid,
     if (nid <= 0 || store == NULL)
         return 0;
 
+    elem.query = prop_query != NULL ? prop_query : "";
+#ifdef QUERY_FAST_CACHE
+    if (query_fast_get(store, nid, elem.query, method))
+        return 1;
+#endif
+
     ossl_property_read_lock(store);
     alg = ossl_method_store_retrieve(store, nid);
     if (alg == NULL) {
@@ -459,13 +590,15 @@ int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, int nid,
         return 0;
     }
 
-    elem.query = prop_query != NULL ? prop_query : "";
     r = lh_QUERY_retrieve(alg->cache, &elem);
     if (r == NULL) {
         ossl_property_unlock(store);
         return 0;
     }
     *method = r->method;
+#ifdef QUERY_FAST_CACHE
+    query_fast_set(store, nid, elem.query, r->method);
+#endif
     ossl_property_unlock(store);
     return 1;
 }
@@ -493,11 +626,22 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, int nid,
 
     if (method == NULL) {
         elem.query = prop_query;
-        if (lh_QUERY_delete(alg->cache, &elem) != NULL)
+        if ((old = lh_QUERY_delete(alg->cache, &elem)) != NULL) {
+            OPENSSL_free(old);
             store->nelem--;
+#ifdef QUERY_FAST_CACHE
+            query_fast_flush(store);
+#endif
+        }
         ossl_property_unlock(store);
         return 1;
     }
+#ifdef QUERY_FAST_CACHE
+    if (store->fast == NULL)
+        __atomic_store_n(&store->fast,
+                         OPENSSL_zalloc(QUERY_FAST_SLOTS * sizeof(*store->fast)),
+                         __ATOMIC_RELEASE);
+#endif
     p = OPENSSL_malloc(sizeof(*p) + (len = strlen(prop_query)));
     if (p != NULL) {
         p->query = p->body;
@@ -505,12 +649,18 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, int nid,
         memcpy((char *)p->query, prop_query, len + 1);
         if ((old = lh_QUERY_insert(alg->cache, p)) != NULL) {
             OPENSSL_free(old);
+#ifdef QUERY_FAST_CACHE
+            query_fast_set(store, nid, prop_query, method);
+#endif
             ossl_property_unlock(store);
             return 1;
         }
         if (!lh_QUERY_error(alg->cache)) {
             if (++store->nelem >= IMPL_CACHE_FLUSH_THRESHOLD)
                 store->need_flush = 1;
+#ifdef QUERY_FAST_CACHE
+            query_fast_set(store, nid, prop_query, method);
+#endif
             ossl_property_unlock(store);
             return 1;
         }
@@ -11,6 +11,7 @@
 #include <openssl/cryptoerr.h>
 #include <openssl/provider.h>
 #include "internal/provider.h"
+#include "internal/core.h"
 
 OSSL_PROVIDER *OSSL_PROVIDER_load(OPENSSL_CTX *libctx, const char *name)
 {
@@ -32,6 +33,7 @@ OSSL_PROVIDER *OSSL_PROVIDER_load(OPENSSL_CTX *libctx, const char *name)
 int OSSL_PROVIDER_unload(OSSL_PROVIDER *prov)
 {
     ossl_provider_free(prov);
+    ossl_method_generation_bump();
     return 1;
 }
 
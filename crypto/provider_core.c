@@ -17,6 +17,7 @@
 #include "internal/thread_once.h"
 #include "internal/provider.h"
 #include "internal/refcount.h"
+#include "internal/core.h"
 #include "provider_local.h"
 
 static OSSL_PROVIDER *provider_new(const char *name,
@@ -312,6 +313,7 @@ void ossl_provider_free(OSSL_PROVIDER *prov)
 # endif
 #endif
             prov->flag_initialized = 0;
+            ossl_method_generation_bump();
         }
 
         /*
@@ -535,6 +537,7 @@ static int provider_activate(OSSL_PROVIDER *prov)
 
     /* With this flag set, this provider has become fully "loaded". */
     prov->flag_initialized = 1;
+    ossl_method_generation_bump();
 
     return 1;
 }
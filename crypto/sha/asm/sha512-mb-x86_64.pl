@@ -0,0 +1,672 @@
+#! /usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+# ====================================================================
+# Multi-buffer SHA512 procedure processes n buffers in parallel by
+# placing buffer data to designated lane of SIMD register. Unlike
+# sha256-mb-x86_64.pl there is no 128-bit code path, because two
+# 64-bit lanes don't beat scalar sha512-x86_64.pl, so n is 4 on
+# AVX2-capable processors and 8 on AVX512-capable ones. The latter
+# benefits from vprorq and vpternlogq, which halve the instruction
+# count of Sigma and Ch/Maj computations.
+#
+# Procedure returns 1 if the buffers were processed and 0 if processor
+# [or assembler] lacks the required capabilities, in which case the
+# caller is expected to fall back to the scalar code.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+$avx=0;
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$avx = ($1>=2.19) + ($1>=2.22) + ($1>=2.25) + ($1>=2.26);
+}
+
+if (!$avx && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	   `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)(?:\.([0-9]+))?/) {
+	$avx = ($1>=2.09) + ($1>=2.10) + 2 * ($1>=2.12);
+	$avx += 2 if ($1==2.11 && $2>=8);
+}
+
+if (!$avx && $win64 && ($flavour =~ /masm/ || $ENV{ASM} =~ /ml64/) &&
+	   `ml64 2>&1` =~ /Version ([0-9]+)\./) {
+	$avx = ($1>=10) + ($1>=12);
+}
+
+if (!$avx && `$ENV{CC} -v 2>&1` =~ /((?:^clang|LLVM) version|.*based on LLVM) ([3-9]\.[0-9]+)/) {
+	$avx = ($2>=3.0) + ($2>3.0);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+# int sha512_multi_block (
+#     struct {	unsigned long long A[8];
+#		unsigned long long B[8];
+#		unsigned long long C[8];
+#		unsigned long long D[8];
+#		unsigned long long E[8];
+#		unsigned long long F[8];
+#		unsigned long long G[8];
+#		unsigned long long H[8];	} *ctx,
+#     struct {	void *ptr; int blocks;	} inp[8],
+#     int num);		/* 1 or 2 */
+#
+$ctx="%rdi";	# 1st arg
+$inp="%rsi";	# 2nd arg
+$num="%edx";	# 3rd arg
+@ptr=map("%r$_",(12..15,8..11));
+$Tbl="%rbp";
+
+$FRAME=64*18;	# same for both code paths, so that there is one handler
+
+sub Xi_off {
+my $off = shift;
+
+    $off %= 16; $off *= $REG_SZ;
+    "$off-128(%rax)";
+}
+
+sub as_xmm { (my $r=shift) =~ s/[yz]mm/xmm/; $r; }
+sub as_ymm { (my $r=shift) =~ s/zmm/ymm/; $r; }
+
+# Load i-th 64-bit word of every lane's block, byte-swapped, to $Xi.
+sub GATHER {
+my $i=shift;
+my ($xi,$x1,$x2,$x3)=map(&as_xmm($_),($Xi,$t1,$t2,$t3));
+my ($yi,$y2)=map(&as_ymm($_),($Xi,$t2));
+
+if ($REG_SZ==32) {
+$code.=<<___;
+	vmovq		`8*$i`(@ptr[0]),$xi
+	vmovq		`8*$i`(@ptr[2]),$x1
+	vpinsrq		\$1,`8*$i`(@ptr[1]),$xi,$xi
+	vpinsrq		\$1,`8*$i`(@ptr[3]),$x1,$x1
+	vinserti128	\$1,$x1,$Xi,$Xi
+	vpshufb		$Xn,$Xi,$Xi
+___
+} else {
+$code.=<<___;
+	vmovq		`8*$i`(@ptr[0]),$xi
+	vmovq		`8*$i`(@ptr[2]),$x1
+	vmovq		`8*$i`(@ptr[4]),$x2
+	vmovq		`8*$i`(@ptr[6]),$x3
+	vpinsrq		\$1,`8*$i`(@ptr[1]),$xi,$xi
+	vpinsrq		\$1,`8*$i`(@ptr[3]),$x1,$x1
+	vpinsrq		\$1,`8*$i`(@ptr[5]),$x2,$x2
+	vpinsrq		\$1,`8*$i`(@ptr[7]),$x3,$x3
+	vinserti128	\$1,$x1,$yi,$yi
+	vinserti128	\$1,$x3,$y2,$y2
+	vinserti64x4	\$1,$y2,$Xi,$Xi
+	vpshufb		$Xn,$Xi,$Xi
+___
+}
+if ($i==15) {
+    for (my $j=0; $j<$REG_SZ/8; $j++) {
+	$code.="	lea	`16*8`(@ptr[$j]),@ptr[$j]\n";
+    }
+}
+}
+
+sub ROUND_00_15 {
+my ($i,$a,$b,$c,$d,$e,$f,$g,$h)=@_;
+
+&GATHER($i)	if ($i<16);
+$code.=<<___;
+	$movdqu	$Xi,`&Xi_off($i)`
+	vpaddq	$h,$Xi,$Xi			# Xi+=h
+	vpbroadcastq	`8*($i%16)-128`($Tbl),$t1
+	vpaddq	$t1,$Xi,$Xi			# Xi+=K[round]
+___
+if ($REG_SZ==64) {
+$code.=<<___;
+	vprorq	\$14,$e,$sigma
+	vprorq	\$18,$e,$t2
+	vprorq	\$41,$e,$t3
+	vmovdqa64	$e,$t1
+	vpternlogq	\$0x96,$t3,$t2,$sigma	# Sigma1(e)
+	vpternlogq	\$0xca,$g,$f,$t1	# Ch(e,f,g)
+	vpaddq	$sigma,$Xi,$Xi			# Xi+=Sigma1(e)
+
+	vprorq	\$28,$a,$sigma
+	 vpaddq	$t1,$Xi,$Xi			# Xi+=Ch(e,f,g)
+	vprorq	\$34,$a,$t2
+	vprorq	\$39,$a,$t3
+	 vmovdqa64	$a,$h
+	vpternlogq	\$0x96,$t3,$t2,$sigma	# Sigma0(a)
+	 vpternlogq	\$0xe8,$c,$b,$h		# h=Maj(a,b,c)
+	 vpaddq	$Xi,$d,$d			# d+=Xi
+
+	vpaddq	$Xi,$h,$h			# h+=Xi
+	vpaddq	$sigma,$h,$h			# h+=Sigma0(a)
+___
+} else {
+$code.=<<___;
+	vpsrlq	\$14,$e,$sigma
+	vpsllq	\$50,$e,$t3
+	vpsrlq	\$18,$e,$t2
+	vpxor	$t3,$sigma,$sigma
+	vpsllq	\$46,$e,$t3
+	vpxor	$t2,$sigma,$sigma
+	vpsrlq	\$41,$e,$t2
+	vpxor	$t3,$sigma,$sigma
+	vpsllq	\$23,$e,$t3
+	vpxor	$t2,$sigma,$sigma
+	 vpandn	$g,$e,$t1
+	vpxor	$t3,$sigma,$sigma		# Sigma1(e)
+	 vpand	$f,$e,$axb			# borrow $axb
+	vpaddq	$sigma,$Xi,$Xi			# Xi+=Sigma1(e)
+	 vpxor	$axb,$t1,$t1			# Ch(e,f,g)
+
+	vpsrlq	\$28,$a,$sigma
+	 vpaddq	$t1,$Xi,$Xi			# Xi+=Ch(e,f,g)
+	vpsllq	\$36,$a,$t3
+	 vpxor	$a,$b,$axb			# a^b, b^c in next round
+	vpsrlq	\$34,$a,$t2
+	vpxor	$t3,$sigma,$sigma
+	vpsllq	\$30,$a,$t3
+	 vpand	$axb,$bxc,$bxc
+	vpxor	$t2,$sigma,$sigma
+	vpsrlq	\$39,$a,$t2
+	vpxor	$t3,$sigma,$sigma
+	vpsllq	\$25,$a,$t3
+	 vpxor	$bxc,$b,$h			# h=Maj(a,b,c)=Ch(a^b,c,b)
+	vpxor	$t2,$sigma,$sigma
+	 vpaddq	$Xi,$d,$d			# d+=Xi
+	vpxor	$t3,$sigma,$sigma		# Sigma0(a)
+
+	vpaddq	$Xi,$h,$h			# h+=Xi
+	vpaddq	$sigma,$h,$h			# h+=Sigma0(a)
+___
+	($axb,$bxc)=($bxc,$axb);
+}
+$code.=<<___ if (($i%16)==15);
+	add	\$`16*8`,$Tbl
+___
+}
+
+sub ROUND_16_XX {
+my $i=shift;
+
+$code.=<<___;
+	$movdqu	`&Xi_off($i+1)`,$Xn
+	vpaddq	`&Xi_off($i+9)`,$Xi,$Xi		# Xi+=X[i+9]
+	$movdqu	`&Xi_off($i+14)`,$t1
+___
+if ($REG_SZ==64) {
+$code.=<<___;
+	vprorq	\$1,$Xn,$sigma
+	vprorq	\$8,$Xn,$t2
+	vpsrlq	\$7,$Xn,$t3
+	vpternlogq	\$0x96,$t3,$t2,$sigma	# sigma0(X[i+1])
+	vprorq	\$19,$t1,$axb
+	vprorq	\$61,$t1,$t2
+	vpsrlq	\$6,$t1,$t3
+	vpternlogq	\$0x96,$t3,$t2,$axb	# sigma1(X[i+14])
+	vpaddq	$sigma,$Xi,$Xi			# Xi+=sigma0(X[i+1])
+	vpaddq	$axb,$Xi,$Xi			# Xi+=sigma1(X[i+14])
+___
+} else {
+$code.=<<___;
+	vpsrlq	\$7,$Xn,$sigma
+	vpsrlq	\$1,$Xn,$t2
+	vpsllq	\$63,$Xn,$t3
+	vpxor	$t2,$sigma,$sigma
+	vpsrlq	\$8,$Xn,$t2
+	vpxor	$t3,$sigma,$sigma
+	vpsllq	\$56,$Xn,$t3
+	vpxor	$t2,$sigma,$sigma
+	vpxor	$t3,$sigma,$sigma		# sigma0(X[i+1])
+	vpsrlq	\$6,$t1,$axb			# borrow $axb
+	 vpaddq	$sigma,$Xi,$Xi			# Xi+=sigma0(X[i+1])
+	vpsrlq	\$19,$t1,$t2
+	vpsllq	\$45,$t1,$t3
+	vpxor	$t2,$axb,$sigma
+	vpsrlq	\$61,$t1,$t2
+	vpxor	$t3,$sigma,$sigma
+	vpsllq	\$3,$t1,$t3
+	vpxor	$t2,$sigma,$sigma
+	vpxor	$t3,$sigma,$sigma		# sigma1(X[i+14])
+	vpaddq	$sigma,$Xi,$Xi			# Xi+=sigma1(X[i+14])
+___
+}
+	&ROUND_00_15($i,@_);
+	($Xi,$Xn)=($Xn,$Xi);
+}
+
+$code.=<<___;
+.text
+
+.extern	OPENSSL_ia32cap_P
+
+.globl	sha512_multi_block
+.type	sha512_multi_block,\@function,3
+.align	32
+sha512_multi_block:
+.cfi_startproc
+___
+if ($avx>1) {
+$code.=<<___;
+	mov	OPENSSL_ia32cap_P+8(%rip),%ecx
+___
+$code.=<<___ if ($avx>2);
+	cmp	\$2,$num
+	jb	.Lavx2
+	mov	%ecx,%eax
+	and	\$`1<<16|1<<30`,%eax		# AVX512F and AVX512BW
+	cmp	\$`1<<16|1<<30`,%eax
+	je	_avx512_shortcut
+.Lavx2:
+___
+$code.=<<___;
+	test	\$`1<<5`,%ecx			# AVX2?
+	jnz	_avx2_shortcut
+___
+}
+$code.=<<___;
+	xor	%eax,%eax			# unsupported
+	ret
+.cfi_endproc
+.size	sha512_multi_block,.-sha512_multi_block
+___
+
+foreach $REG_SZ (32,64) {
+last if ($REG_SZ==32 && $avx<2);
+last if ($REG_SZ==64 && $avx<3);
+
+my $sfx = $REG_SZ==32 ? "avx2" : "avx512";
+my $lanes = $REG_SZ/8;
+my $reg = $REG_SZ==32 ? "ymm" : "zmm";
+
+local $movdqu = $REG_SZ==32 ? "vmovdqu" : "vmovdqu64";
+local $movdqa = $REG_SZ==32 ? "vmovdqa" : "vmovdqa64";
+local @V=($A,$B,$C,$D,$E,$F,$G,$H)=map("%$reg$_",(8..15));
+local ($t1,$t2,$t3,$axb,$bxc,$Xi,$Xn,$sigma)=map("%$reg$_",(0..7));
+
+$code.=<<___;
+.type	sha512_multi_block_$sfx,\@function,3
+.align	32
+sha512_multi_block_$sfx:
+.cfi_startproc
+_${sfx}_shortcut:
+	mov	%rsp,%rax
+.cfi_def_cfa_register	%rax
+	push	%rbx
+.cfi_push	%rbx
+	push	%rbp
+.cfi_push	%rbp
+	push	%r12
+.cfi_push	%r12
+	push	%r13
+.cfi_push	%r13
+	push	%r14
+.cfi_push	%r14
+	push	%r15
+.cfi_push	%r15
+___
+$code.=<<___ if ($win64);
+	lea	-0xa8(%rsp),%rsp
+	movaps	%xmm6,(%rsp)
+	movaps	%xmm7,0x10(%rsp)
+	movaps	%xmm8,0x20(%rsp)
+	movaps	%xmm9,0x30(%rsp)
+	movaps	%xmm10,0x40(%rsp)
+	movaps	%xmm11,0x50(%rsp)
+	movaps	%xmm12,-0x78(%rax)
+	movaps	%xmm13,-0x68(%rax)
+	movaps	%xmm14,-0x58(%rax)
+	movaps	%xmm15,-0x48(%rax)
+___
+$code.=<<___;
+	sub	\$$FRAME,%rsp
+	and	\$-256,%rsp
+	mov	%rax,`64*17`(%rsp)		# original %rsp
+.cfi_cfa_expression	%rsp+`64*17`,deref,+8
+.Lbody_$sfx:
+	lea	K512+128(%rip),$Tbl
+	lea	0x80($ctx),$ctx			# size optimization
+
+.Loop_grande_$sfx:
+	mov	$num,`64*17+8`(%rsp)		# original $num
+	xor	$num,$num
+	lea	`64*16`(%rsp),%rbx
+___
+for($i=0;$i<$lanes;$i++) {
+    $code.=<<___;
+	mov	`16*$i+0`($inp),@ptr[$i]	# input pointer
+	mov	`16*$i+8`($inp),%ecx		# number of blocks
+	cmp	$num,%ecx
+	cmovg	%ecx,$num			# find maximum
+	test	%ecx,%ecx
+	mov	%rcx,`8*$i`(%rbx)		# initialize counters
+	cmovle	$Tbl,@ptr[$i]			# cancel input
+___
+}
+$code.=<<___;
+	test	$num,$num
+	jz	.Lnext_$sfx
+___
+for($i=0;$i<8;$i++) {
+    $code.=<<___;
+	$movdqu	`64*$i-128`($ctx),$V[$i]	# load context
+___
+}
+$code.=<<___;
+	lea	128(%rsp),%rax
+	$movdqu	.Lpbswap(%rip),$Xn
+	jmp	.Loop_$sfx
+
+.align	32
+.Loop_$sfx:
+___
+$code.=<<___ if ($REG_SZ==32);
+	vpxor	$B,$C,$bxc			# magic seed
+___
+for($i=0;$i<16;$i++)	{ &ROUND_00_15($i,@V); unshift(@V,pop(@V)); }
+$code.=<<___;
+	$movdqu	`&Xi_off($i)`,$Xi
+	mov	\$4,%ecx
+	jmp	.Loop_16_xx_$sfx
+.align	32
+.Loop_16_xx_$sfx:
+___
+for(;$i<32;$i++)	{ &ROUND_16_XX($i,@V); unshift(@V,pop(@V)); }
+$code.=<<___;
+	dec	%ecx
+	jnz	.Loop_16_xx_$sfx
+
+	mov	\$1,%ecx
+	lea	K512+128(%rip),$Tbl
+___
+for($i=0;$i<$lanes;$i++) {
+    $code.=<<___;
+	cmp	`8*$i`(%rbx),%rcx		# examine counters
+	cmovge	$Tbl,@ptr[$i]			# cancel input
+___
+}
+if ($REG_SZ==32) {
+$code.=<<___;
+	vmovdqa	(%rbx),$sigma			# pull counters
+	vpxor	$t1,$t1,$t1
+	vpcmpgtq $t1,$sigma,$Xn			# mask value
+	vpaddq	$Xn,$sigma,$sigma		# counters--
+___
+for($i=0;$i<8;$i++) {
+    $code.=<<___;
+	vpand	$Xn,$V[$i],$V[$i]
+	vpaddq	`64*$i-128`($ctx),$V[$i],$V[$i]
+	vmovdqu	$V[$i],`64*$i-128`($ctx)
+___
+}
+} else {
+$code.=<<___;
+	vmovdqa64	(%rbx),$sigma		# pull counters
+	vpxorq	$t1,$t1,$t1
+	vpcmpgtq $t1,$sigma,%k1			# mask value
+	vpternlogq	\$0xff,$t1,$t1,$t1
+	vpaddq	$t1,$sigma,$sigma\{%k1\}	# counters--
+___
+for($i=0;$i<8;$i++) {
+    $code.=<<___;
+	vpaddq	`64*$i-128`($ctx),$V[$i],$V[$i]\{%k1\}
+	vmovdqu64	$V[$i],`64*$i-128`($ctx)\{%k1\}
+___
+}
+}
+$code.=<<___;
+
+	$movdqa	$sigma,(%rbx)			# save counters
+	$movdqu	.Lpbswap(%rip),$Xn
+	dec	$num
+	jnz	.Loop_$sfx
+
+.Lnext_$sfx:
+___
+$code.=<<___ if ($REG_SZ==32);
+	mov	`64*17+8`(%rsp),$num
+	lea	$REG_SZ($ctx),$ctx
+	lea	`16*$lanes`($inp),$inp
+	dec	$num
+	jnz	.Loop_grande_$sfx
+___
+$code.=<<___;
+
+	mov	`64*17`(%rsp),%rax		# original %rsp
+.cfi_def_cfa	%rax,8
+	vzeroupper
+___
+$code.=<<___ if ($win64);
+	movaps	-0xd8(%rax),%xmm6
+	movaps	-0xc8(%rax),%xmm7
+	movaps	-0xb8(%rax),%xmm8
+	movaps	-0xa8(%rax),%xmm9
+	movaps	-0x98(%rax),%xmm10
+	movaps	-0x88(%rax),%xmm11
+	movaps	-0x78(%rax),%xmm12
+	movaps	-0x68(%rax),%xmm13
+	movaps	-0x58(%rax),%xmm14
+	movaps	-0x48(%rax),%xmm15
+___
+$code.=<<___;
+	mov	-48(%rax),%r15
+.cfi_restore	%r15
+	mov	-40(%rax),%r14
+.cfi_restore	%r14
+	mov	-32(%rax),%r13
+.cfi_restore	%r13
+	mov	-24(%rax),%r12
+.cfi_restore	%r12
+	mov	-16(%rax),%rbp
+.cfi_restore	%rbp
+	mov	-8(%rax),%rbx
+.cfi_restore	%rbx
+	lea	(%rax),%rsp
+.cfi_def_cfa_register	%rsp
+	mov	\$1,%eax
+.Lepilogue_$sfx:
+	ret
+.cfi_endproc
+.size	sha512_multi_block_$sfx,.-sha512_multi_block_$sfx
+___
+$code =~ s/\`([^\`]*)\`/eval($1)/gem;	# while \$REG_SZ is still set
+}
+
+$code.=<<___;
+.align	64
+K512:
+	.quad	0x428a2f98d728ae22,0x7137449123ef65cd
+	.quad	0xb5c0fbcfec4d3b2f,0xe9b5dba58189dbbc
+	.quad	0x3956c25bf348b538,0x59f111f1b605d019
+	.quad	0x923f82a4af194f9b,0xab1c5ed5da6d8118
+	.quad	0xd807aa98a3030242,0x12835b0145706fbe
+	.quad	0x243185be4ee4b28c,0x550c7dc3d5ffb4e2
+	.quad	0x72be5d74f27b896f,0x80deb1fe3b1696b1
+	.quad	0x9bdc06a725c71235,0xc19bf174cf692694
+	.quad	0xe49b69c19ef14ad2,0xefbe4786384f25e3
+	.quad	0x0fc19dc68b8cd5b5,0x240ca1cc77ac9c65
+	.quad	0x2de92c6f592b0275,0x4a7484aa6ea6e483
+	.quad	0x5cb0a9dcbd41fbd4,0x76f988da831153b5
+	.quad	0x983e5152ee66dfab,0xa831c66d2db43210
+	.quad	0xb00327c898fb213f,0xbf597fc7beef0ee4
+	.quad	0xc6e00bf33da88fc2,0xd5a79147930aa725
+	.quad	0x06ca6351e003826f,0x142929670a0e6e70
+	.quad	0x27b70a8546d22ffc,0x2e1b21385c26c926
+	.quad	0x4d2c6dfc5ac42aed,0x53380d139d95b3df
+	.quad	0x650a73548baf63de,0x766a0abb3c77b2a8
+	.quad	0x81c2c92e47edaee6,0x92722c851482353b
+	.quad	0xa2bfe8a14cf10364,0xa81a664bbc423001
+	.quad	0xc24b8b70d0f89791,0xc76c51a30654be30
+	.quad	0xd192e819d6ef5218,0xd69906245565a910
+	.quad	0xf40e35855771202a,0x106aa07032bbd1b8
+	.quad	0x19a4c116b8d2d0c8,0x1e376c085141ab53
+	.quad	0x2748774cdf8eeb99,0x34b0bcb5e19b48a8
+	.quad	0x391c0cb3c5c95a63,0x4ed8aa4ae3418acb
+	.quad	0x5b9cca4f7763e373,0x682e6ff3d6b2b8a3
+	.quad	0x748f82ee5defb2fc,0x78a5636f43172f60
+	.quad	0x84c87814a1f0ab72,0x8cc702081a6439ec
+	.quad	0x90befffa23631e28,0xa4506cebde82bde9
+	.quad	0xbef9a3f7b2c67915,0xc67178f2e372532b
+	.quad	0xca273eceea26619c,0xd186b8c721c0c207
+	.quad	0xeada7dd6cde0eb1e,0xf57d4f7fee6ed178
+	.quad	0x06f067aa72176fba,0x0a637dc5a2c898a6
+	.quad	0x113f9804bef90dae,0x1b710b35131c471b
+	.quad	0x28db77f523047d84,0x32caab7b40c72493
+	.quad	0x3c9ebe0a15c9bebc,0x431d67c49c100d4c
+	.quad	0x4cc5d4becb3e42b6,0x597f299cfc657e2a
+	.quad	0x5fcb6fab3ad6faec,0x6c44198c4a475817
+.Lpbswap:
+	.quad	0x0001020304050607,0x08090a0b0c0d0e0f	# pbswap
+	.quad	0x0001020304050607,0x08090a0b0c0d0e0f	# pbswap
+	.quad	0x0001020304050607,0x08090a0b0c0d0e0f	# pbswap
+	.quad	0x0001020304050607,0x08090a0b0c0d0e0f	# pbswap
+	.asciz	"SHA512 multi-block transform for x86_64, CRYPTOGAMS by <appro\@openssl.org>"
+___
+
+if ($win64 && $avx>1) {
+# EXCEPTION_DISPOSITION handler (EXCEPTION_RECORD *rec,ULONG64 frame,
+#		CONTEXT *context,DISPATCHER_CONTEXT *disp)
+$rec="%rcx";
+$frame="%rdx";
+$context="%r8";
+$disp="%r9";
+
+$code.=<<___;
+.extern	__imp_RtlVirtualUnwind
+.type	se_handler,\@abi-omnipotent
+.align	16
+se_handler:
+	push	%rsi
+	push	%rdi
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	pushfq
+	sub	\$64,%rsp
+
+	mov	120($context),%rax	# pull context->Rax
+	mov	248($context),%rbx	# pull context->Rip
+
+	mov	8($disp),%rsi		# disp->ImageBase
+	mov	56($disp),%r11		# disp->HandlerData
+
+	mov	0(%r11),%r10d		# HandlerData[0]
+	lea	(%rsi,%r10),%r10	# end of prologue label
+	cmp	%r10,%rbx		# context->Rip<body label
+	jb	.Lin_prologue
+
+	mov	152($context),%rax	# pull context->Rsp
+
+	mov	4(%r11),%r10d		# HandlerData[1]
+	lea	(%rsi,%r10),%r10	# epilogue label
+	cmp	%r10,%rbx		# context->Rip>=epilogue label
+	jae	.Lin_prologue
+
+	mov	`64*17`(%rax),%rax	# pull saved stack pointer
+
+	mov	-8(%rax),%rbx
+	mov	-16(%rax),%rbp
+	mov	-24(%rax),%r12
+	mov	-32(%rax),%r13
+	mov	-40(%rax),%r14
+	mov	-48(%rax),%r15
+	mov	%rbx,144($context)	# restore context->Rbx
+	mov	%rbp,160($context)	# restore context->Rbp
+	mov	%r12,216($context)	# restore context->R12
+	mov	%r13,224($context)	# restore context->R13
+	mov	%r14,232($context)	# restore context->R14
+	mov	%r15,240($context)	# restore context->R15
+
+	lea	-56-10*16(%rax),%rsi
+	lea	512($context),%rdi	# &context.Xmm6
+	mov	\$20,%ecx
+	.long	0xa548f3fc		# cld; rep movsq
+
+.Lin_prologue:
+	mov	8(%rax),%rdi
+	mov	16(%rax),%rsi
+	mov	%rax,152($context)	# restore context->Rsp
+	mov	%rsi,168($context)	# restore context->Rsi
+	mov	%rdi,176($context)	# restore context->Rdi
+
+	mov	40($disp),%rdi		# disp->ContextRecord
+	mov	$context,%rsi		# context
+	mov	\$154,%ecx		# sizeof(CONTEXT)
+	.long	0xa548f3fc		# cld; rep movsq
+
+	mov	$disp,%rsi
+	xor	%rcx,%rcx		# arg1, UNW_FLAG_NHANDLER
+	mov	8(%rsi),%rdx		# arg2, disp->ImageBase
+	mov	0(%rsi),%r8		# arg3, disp->ControlPc
+	mov	16(%rsi),%r9		# arg4, disp->FunctionEntry
+	mov	40(%rsi),%r10		# disp->ContextRecord
+	lea	56(%rsi),%r11		# &disp->HandlerData
+	lea	24(%rsi),%r12		# &disp->EstablisherFrame
+	mov	%r10,32(%rsp)		# arg5
+	mov	%r11,40(%rsp)		# arg6
+	mov	%r12,48(%rsp)		# arg7
+	mov	%rcx,56(%rsp)		# arg8, (NULL)
+	call	*__imp_RtlVirtualUnwind(%rip)
+
+	mov	\$1,%eax		# ExceptionContinueSearch
+	add	\$64,%rsp
+	popfq
+	pop	%r15
+	pop	%r14
+	pop	%r13
+	pop	%r12
+	pop	%rbp
+	pop	%rbx
+	pop	%rdi
+	pop	%rsi
+	ret
+.size	se_handler,.-se_handler
+
+.section	.pdata
+.align	4
+	.rva	.LSEH_begin_sha512_multi_block_avx2
+	.rva	.LSEH_end_sha512_multi_block_avx2
+	.rva	.LSEH_info_sha512_multi_block_avx2
+___
+$code.=<<___ if ($avx>2);
+	.rva	.LSEH_begin_sha512_multi_block_avx512
+	.rva	.LSEH_end_sha512_multi_block_avx512
+	.rva	.LSEH_info_sha512_multi_block_avx512
+___
+$code.=<<___;
+.section	.xdata
+.align	8
+.LSEH_info_sha512_multi_block_avx2:
+	.byte	9,0,0,0
+	.rva	se_handler
+	.rva	.Lbody_avx2,.Lepilogue_avx2		# HandlerData[]
+___
+$code.=<<___ if ($avx>2);
+.LSEH_info_sha512_multi_block_avx512:
+	.byte	9,0,0,0
+	.rva	se_handler
+	.rva	.Lbody_avx512,.Lepilogue_avx512		# HandlerData[]
+___
+}
+
+$code =~ s/\`([^\`]*)\`/eval($1)/gem;
+
+print $code;
+close STDOUT or die "error closing STDOUT: $!";
@@ -15,6 +15,8 @@
 #include <openssl/crypto.h>
 #include <openssl/sha.h>
 #include <openssl/opensslv.h>
+#include "internal/cryptlib.h"
+#include "internal/sha.h"
 
 int SHA224_Init(SHA256_CTX *c)
 {
@@ -84,6 +86,181 @@ int SHA224_Final(unsigned char *md, SHA256_CTX *c)
     return SHA256_Final(md, c);
 }
 
+#if defined(SHA256_ASM) && \
+    (defined(__x86_64) || defined(__x86_64__) || \
+     defined(_M_AMD64) || defined(_M_X64))
+# define SHA256_MULTI_BLOCK
+
+typedef struct {
+    unsigned int A[8], B[8], C[8], D[8], E[8], F[8], G[8], H[8];
+} SHA256_MB_CTX;
+typedef struct {
+    const unsigned char *ptr;
+    int blocks;
+} HASH_DESC;
+
+void sha256_multi_block(SHA256_MB_CTX *, const HASH_DESC *, int);
+
+/*
+ * See sha512_digest_batch() for details, message tails and padding are
+ * handled the same way.
+ */
+typedef struct {
+    const unsigned char *ptr;   /* NULL if the lane is idle */
+    size_t blocks;
+    size_t tail_blocks;
+    size_t idx;
+    unsigned char buf[2 * SHA256_CBLOCK];
+} SHA256_MB_LANE;
+
+static void sha256_mb_lane_set(SHA256_MB_CTX *mctx, SHA256_MB_LANE *lane,
+                               int j, const SHA256_CTX *init,
+                               const unsigned char *in, size_t len)
+{
+    size_t rem = len % SHA256_CBLOCK;
+    unsigned char *p;
+    uint64_t l;
+    int k;
+
+    mctx->A[j] = init->h[0];
+    mctx->B[j] = init->h[1];
+    mctx->C[j] = init->h[2];
+    mctx->D[j] = init->h[3];
+    mctx->E[j] = init->h[4];
+    mctx->F[j] = init->h[5];
+    mctx->G[j] = init->h[6];
+    mctx->H[j] = init->h[7];
+
+    memset(lane->buf, 0, sizeof(lane->buf));
+    if (rem != 0)
+        memcpy(lane->buf, in + len - rem, rem);
+    lane->buf[rem] = 0x80;
+    lane->tail_blocks = rem < SHA256_CBLOCK - 8 ? 1 : 2;
+
+    /* 64-bit message length in bits, big-endian */
+    p = lane->buf + lane->tail_blocks * SHA256_CBLOCK;
+    for (l = (uint64_t)len << 3, k = 0; k < 8; k++, l >>= 8)
+        *--p = (unsigned char)l;
+
+    lane->blocks = len / SHA256_CBLOCK;
+    if (lane->blocks != 0) {
+        lane->ptr = in;
+    } else {
+        lane->ptr = lane->buf;
+        lane->blocks = lane->tail_blocks;
+        lane->tail_blocks = 0;
+    }
+}
+
+static void sha256_mb_lane_out(const SHA256_MB_CTX *mctx, int j,
+                               unsigned char *md, size_t mdlen)
+{
+    unsigned int h[8];
+    unsigned char out[SHA256_DIGEST_LENGTH];
+    int k, b;
+
+    h[0] = mctx->A[j];
+    h[1] = mctx->B[j];
+    h[2] = mctx->C[j];
+    h[3] = mctx->D[j];
+    h[4] = mctx->E[j];
+    h[5] = mctx->F[j];
+    h[6] = mctx->G[j];
+    h[7] = mctx->H[j];
+    for (k = 0; k < 8; k++)
+        for (b = 0; b < 4; b++)
+            out[4 * k + b] = (unsigned char)(h[k] >> (24 - 8 * b));
+    memcpy(md, out, mdlen);
+}
+#endif
+
+/*
+ * Hash |n| independent messages, each one starting from freshly initialised
+ * |init|, and write digests |init->md_len| bytes apart to |md|.
+ */
+int sha256_digest_batch(const SHA256_CTX *init,
+                        const unsigned char *const in[], const size_t inlen[],
+                        size_t n, unsigned char *md)
+{
+    size_t mdlen = init->md_len, i = 0;
+#ifdef SHA256_MULTI_BLOCK
+    SHA256_MB_CTX mctx;
+    SHA256_MB_LANE lane[8];
+    HASH_DESC hd[8];
+    const unsigned char *busy = NULL;
+    size_t step;
+    int j, active = 0;
+
+    /* the multi-block procedure takes SSSE3 as the baseline */
+    if (n > 1 && (OPENSSL_ia32cap_P[1] & (1 << (41 - 32)))) {
+        for (j = 0; j < 8; j++)
+            lane[j].ptr = NULL;
+
+        for (;;) {
+            for (j = 0; j < 8 && i < n; j++) {
+                if (lane[j].ptr != NULL)
+                    continue;
+                lane[j].idx = i;
+                sha256_mb_lane_set(&mctx, &lane[j], j, init, in[i], inlen[i]);
+                i++;
+                active++;
+            }
+            if (active == 0)
+                break;
+
+            step = INT_MAX;
+            for (j = 0; j < 8; j++)
+                if (lane[j].ptr != NULL && lane[j].blocks < step) {
+                    step = lane[j].blocks;
+                    busy = lane[j].ptr;
+                }
+            /*
+             * The multi-block procedure stops at the first group of lanes
+             * without any input, so idle lanes hash the same data as a busy
+             * one, their state is discarded anyway.
+             */
+            for (j = 0; j < 8; j++) {
+                hd[j].ptr = lane[j].ptr != NULL ? lane[j].ptr : busy;
+                hd[j].blocks = (int)step;
+            }
+            sha256_multi_block(&mctx, hd, 2);
+
+            for (j = 0; j < 8; j++) {
+                if (lane[j].ptr == NULL)
+                    continue;
+                lane[j].ptr += step * SHA256_CBLOCK;
+                if ((lane[j].blocks -= step) != 0)
+                    continue;
+                if (lane[j].tail_blocks != 0) {
+                    lane[j].ptr = lane[j].buf;
+                    lane[j].blocks = lane[j].tail_blocks;
+                    lane[j].tail_blocks = 0;
+                } else {
+                    sha256_mb_lane_out(&mctx, j, md + lane[j].idx * mdlen,
+                                       mdlen);
+                    lane[j].ptr = NULL;
+                    active--;
+                }
+            }
+        }
+        OPENSSL_cleanse(lane, sizeof(lane));
+        OPENSSL_cleanse(&mctx, sizeof(mctx));
+        return 1;
+    }
+#endif
+
+    for (; i < n; i++) {
+        SHA256_CTX c = *init;
+        int ok = SHA256_Update(&c, in[i], inlen[i])
+                 && SHA256_Final(md + i * mdlen, &c);
+
+        OPENSSL_cleanse(&c, sizeof(c));
+        if (!ok)
+            return 0;
+    }
+    return 1;
+}
+
 #define DATA_ORDER_IS_BIG_ENDIAN
 
 #define HASH_LONG               SHA_LONG
@@ -351,6 +351,178 @@ unsigned char *SHA512(const unsigned char *d, size_t n, unsigned char *md)
     return md;
 }
 
+#if defined(SHA512_ASM) && \
+    (defined(__x86_64) || defined(__x86_64__) || \
+     defined(_M_AMD64) || defined(_M_X64))
+# define SHA512_MULTI_BLOCK
+
+typedef struct {
+    SHA_LONG64 A[8], B[8], C[8], D[8], E[8], F[8], G[8], H[8];
+} SHA512_MB_CTX;
+typedef struct {
+    const unsigned char *ptr;
+    int blocks;
+} HASH_DESC;
+
+int sha512_multi_block(SHA512_MB_CTX *, const HASH_DESC *, int);
+
+/*
+ * Every lane of the multi-block procedure hashes first the whole blocks
+ * of its message in place and then one or two blocks with the rest of
+ * the message and padding, which are prepared in |buf|.
+ */
+typedef struct {
+    const unsigned char *ptr;   /* NULL if the lane is idle */
+    size_t blocks;
+    size_t tail_blocks;
+    size_t idx;
+    unsigned char buf[2 * SHA512_CBLOCK];
+} SHA512_MB_LANE;
+
+static void sha512_mb_lane_set(SHA512_MB_CTX *mctx, SHA512_MB_LANE *lane,
+                               int j, const SHA512_CTX *init,
+                               const unsigned char *in, size_t len)
+{
+    size_t rem = len % SHA512_CBLOCK;
+    unsigned char *p;
+    SHA_LONG64 l;
+    int k;
+
+    mctx->A[j] = init->h[0];
+    mctx->B[j] = init->h[1];
+    mctx->C[j] = init->h[2];
+    mctx->D[j] = init->h[3];
+    mctx->E[j] = init->h[4];
+    mctx->F[j] = init->h[5];
+    mctx->G[j] = init->h[6];
+    mctx->H[j] = init->h[7];
+
+    memset(lane->buf, 0, sizeof(lane->buf));
+    if (rem != 0)
+        memcpy(lane->buf, in + len - rem, rem);
+    lane->buf[rem] = 0x80;
+    lane->tail_blocks = rem < SHA512_CBLOCK - 16 ? 1 : 2;
+
+    /* 128-bit message length in bits, big-endian */
+    p = lane->buf + lane->tail_blocks * SHA512_CBLOCK;
+    for (l = (SHA_LONG64)len << 3, k = 0; k < 8; k++, l >>= 8)
+        *--p = (unsigned char)l;
+    for (l = (SHA_LONG64)len >> 61, k = 0; k < 8; k++, l >>= 8)
+        *--p = (unsigned char)l;
+
+    lane->blocks = len / SHA512_CBLOCK;
+    if (lane->blocks != 0) {
+        lane->ptr = in;
+    } else {
+        lane->ptr = lane->buf;
+        lane->blocks = lane->tail_blocks;
+        lane->tail_blocks = 0;
+    }
+}
+
+static void sha512_mb_lane_out(const SHA512_MB_CTX *mctx, int j,
+                               unsigned char *md, size_t mdlen)
+{
+    SHA_LONG64 h[8];
+    unsigned char out[SHA512_DIGEST_LENGTH];
+    int k, b;
+
+    h[0] = mctx->A[j];
+    h[1] = mctx->B[j];
+    h[2] = mctx->C[j];
+    h[3] = mctx->D[j];
+    h[4] = mctx->E[j];
+    h[5] = mctx->F[j];
+    h[6] = mctx->G[j];
+    h[7] = mctx->H[j];
+    for (k = 0; k < 8; k++)
+        for (b = 0; b < 8; b++)
+            out[8 * k + b] = (unsigned char)(h[k] >> (56 - 8 * b));
+    memcpy(md, out, mdlen);
+}
+#endif
+
+/*
+ * Hash |n| independent messages, each one starting from |init|, which has
+ * to be freshly initialised, and write digests |init->md_len| bytes apart
+ * to |md|. Multi-block code is used where available, lanes being refilled
+ * with the next message as soon as they are done with the previous one.
+ */
+int sha512_digest_batch(const SHA512_CTX *init,
+                        const unsigned char *const in[], const size_t inlen[],
+                        size_t n, unsigned char *md)
+{
+    size_t mdlen = init->md_len, i = 0;
+#ifdef SHA512_MULTI_BLOCK
+    SHA512_MB_CTX mctx;
+    SHA512_MB_LANE lane[8];
+    HASH_DESC hd[8];
+    size_t step;
+    int j, active = 0;
+
+    memset(hd, 0, sizeof(hd));
+    if (n > 1 && sha512_multi_block(&mctx, hd, 2)) {
+        for (j = 0; j < 8; j++)
+            lane[j].ptr = NULL;
+
+        for (;;) {
+            for (j = 0; j < 8 && i < n; j++) {
+                if (lane[j].ptr != NULL)
+                    continue;
+                lane[j].idx = i;
+                sha512_mb_lane_set(&mctx, &lane[j], j, init, in[i], inlen[i]);
+                i++;
+                active++;
+            }
+            if (active == 0)
+                break;
+
+            step = INT_MAX;
+            for (j = 0; j < 8; j++)
+                if (lane[j].ptr != NULL && lane[j].blocks < step)
+                    step = lane[j].blocks;
+            for (j = 0; j < 8; j++) {
+                hd[j].ptr = lane[j].ptr;
+                hd[j].blocks = lane[j].ptr != NULL ? (int)step : 0;
+            }
+            sha512_multi_block(&mctx, hd, 2);
+
+            for (j = 0; j < 8; j++) {
+                if (lane[j].ptr == NULL)
+                    continue;
+                lane[j].ptr += step * SHA512_CBLOCK;
+                if ((lane[j].blocks -= step) != 0)
+                    continue;
+                if (lane[j].tail_blocks != 0) {
+                    lane[j].ptr = lane[j].buf;
+                    lane[j].blocks = lane[j].tail_blocks;
+                    lane[j].tail_blocks = 0;
+                } else {
+                    sha512_mb_lane_out(&mctx, j, md + lane[j].idx * mdlen,
+                                       mdlen);
+                    lane[j].ptr = NULL;
+                    active--;
+                }
+            }
+        }
+        OPENSSL_cleanse(lane, sizeof(lane));
+        OPENSSL_cleanse(&mctx, sizeof(mctx));
+        return 1;
+    }
+#endif
+
+    for (; i < n; i++) {
+        SHA512_CTX c = *init;
+        int ok = SHA512_Update(&c, in[i], inlen[i])
+                 && SHA512_Final(md + i * mdlen, &c);
+
+        OPENSSL_cleanse(&c, sizeof(c));
+        if (!ok)
+            return 0;
+    }
+    return 1;
+}
+
 #ifndef SHA512_ASM
 static const SHA_LONG64 K512[80] = {
     U64(0x428a2f98d728ae22), U64(0x7137449123ef65cd),
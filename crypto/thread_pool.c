@@ -0,0 +1,264 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A small pool of worker threads owned by the library, started by
+ * OPENSSL_init_crypto() with OPENSSL_INIT_THREAD_POOL.  Algorithms that can
+ * split a large operation into independent pieces submit them as a batch of
+ * jobs with ossl_thread_pool_run().  The submitting thread works on its own
+ * batch as well and returns once every job of it has completed, so a batch
+ * always makes progress, even when the workers are busy or gone (e.g. in the
+ * child after a fork()).
+ *
+ * Without thread support all jobs are run by the calling thread.
+ */
+
+#include <openssl/crypto.h>
+#include "internal/cryptlib.h"
+#include "internal/thread_pool.h"
+
+#if defined(OPENSSL_THREADS) && !defined(CRYPTO_TDEBUG) \
+    && !defined(OPENSSL_SYS_WINDOWS)
+
+# include <pthread.h>
+# include <unistd.h>
+
+/* A sane upper bound on the number of workers */
+# define THREAD_POOL_MAX_THREADS  256
+
+typedef struct thread_pool_batch_st THREAD_POOL_BATCH;
+
+struct thread_pool_batch_st {
+    OSSL_THREAD_POOL_FN fn;
+    void *arg;
+    size_t n;                   /* Number of jobs */
+    size_t started;             /* Jobs handed out so far */
+    size_t done;                /* Jobs completed so far */
+    THREAD_POOL_BATCH *next;    /* Queue link */
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+
+/* The batches with jobs that haven't been handed out yet, oldest first */
+static THREAD_POOL_BATCH *pool_queue = NULL;
+static int pool_stopping = 0;
+
+static pthread_t *pool_threads = NULL;
+static size_t pool_nthreads = 0;
+/* The number of workers available to this process, 0 after a fork() */
+static size_t pool_active = 0;
+/* The process the workers belong to */
+static pid_t pool_pid = 0;
+
+/* Remove |b| from the queue, it must be on it.  Called with the lock held */
+static void thread_pool_unqueue(THREAD_POOL_BATCH *b)
+{
+    THREAD_POOL_BATCH **p;
+
+    for (p = &pool_queue; *p != b; p = &(*p)->next)
+        continue;
+    *p = b->next;
+}
+
+/*
+ * Hand out the next job of |b| and run it.  Called with the lock held,
+ * which is released while the job runs.
+ */
+static void thread_pool_run_job(THREAD_POOL_BATCH *b)
+{
+    size_t i = b->started++;
+
+    if (b->started == b->n)
+        thread_pool_unqueue(b);
+    pthread_mutex_unlock(&pool_lock);
+
+    b->fn(b->arg, i);
+
+    pthread_mutex_lock(&pool_lock);
+    /* |b| may be gone as soon as its last job is done */
+    if (++b->done == b->n)
+        pthread_cond_broadcast(&pool_done);
+}
+
+static void *thread_pool_worker(void *unused)
+{
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pool_queue == NULL && !pool_stopping)
+            pthread_cond_wait(&pool_work, &pool_lock);
+        if (pool_queue == NULL)
+            break;
+        thread_pool_run_job(pool_queue);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+/*
+ * The lock is held across fork(), so that the child doesn't inherit it in
+ * the hands of a worker, nor the queue in an inconsistent state.  The child
+ * has none of the workers, nor the threads whose batches are queued.
+ */
+static void thread_pool_fork_prepare(void)
+{
+    pthread_mutex_lock(&pool_lock);
+}
+
+static void thread_pool_fork_parent(void)
+{
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static void thread_pool_fork_child(void)
+{
+    pool_active = 0;
+    pool_queue = NULL;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/*
+ * Start |threads| workers, or one less than the number of online processors
+ * if |threads| is 0.  Returns 1 if at least one worker is running, or if
+ * none were needed, and 0 otherwise.
+ */
+int ossl_thread_pool_init(size_t threads)
+{
+    size_t i;
+
+    if (threads == 0) {
+# ifdef _SC_NPROCESSORS_ONLN
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (ncpu > 1)
+            threads = (size_t)ncpu - 1;
+# endif
+        if (threads == 0)
+            return 1;
+    }
+    if (threads > THREAD_POOL_MAX_THREADS)
+        threads = THREAD_POOL_MAX_THREADS;
+
+    if (pthread_atfork(thread_pool_fork_prepare, thread_pool_fork_parent,
+                       thread_pool_fork_child) != 0)
+        return 0;
+    pool_threads = OPENSSL_malloc(threads * sizeof(*pool_threads));
+    if (pool_threads == NULL)
+        return 0;
+    for (i = 0; i < threads; i++)
+        if (pthread_create(&pool_threads[i], NULL, thread_pool_worker,
+                           NULL) != 0)
+            break;
+    if (i == 0) {
+        OPENSSL_free(pool_threads);
+        pool_threads = NULL;
+        return 0;
+    }
+    pool_nthreads = pool_active = i;
+    pool_pid = getpid();
+    return 1;
+}
+
+void ossl_thread_pool_cleanup(void)
+{
+    size_t i;
+
+    /* The workers didn't survive the fork(), they are the parent's */
+    if (pool_active != 0 && pool_pid == getpid()) {
+        pthread_mutex_lock(&pool_lock);
+        pool_stopping = 1;
+        pthread_cond_broadcast(&pool_work);
+        pthread_mutex_unlock(&pool_lock);
+        for (i = 0; i < pool_nthreads; i++)
+            pthread_join(pool_threads[i], NULL);
+    }
+    OPENSSL_free(pool_threads);
+    pool_threads = NULL;
+    pool_nthreads = pool_active = 0;
+    pool_stopping = 0;
+}
+
+/*
+ * For applications that call OPENSSL_fork_child() themselves.  Must be
+ * async-signal-safe.
+ */
+void ossl_thread_pool_fork_child(void)
+{
+    pool_active = 0;
+}
+
+size_t ossl_thread_pool_size(void)
+{
+    return pool_active;
+}
+
+/*
+ * Run fn(arg, i) for every i from 0 to |n| - 1, spread over the workers and
+ * the calling thread, and wait for all of them to complete.
+ */
+void ossl_thread_pool_run(OSSL_THREAD_POOL_FN fn, void *arg, size_t n)
+{
+    THREAD_POOL_BATCH b, **p;
+    size_t i;
+
+    if (pool_active == 0 || n < 2) {
+        for (i = 0; i < n; i++)
+            fn(arg, i);
+        return;
+    }
+
+    b.fn = fn;
+    b.arg = arg;
+    b.n = n;
+    b.started = b.done = 0;
+    b.next = NULL;
+
+    pthread_mutex_lock(&pool_lock);
+    for (p = &pool_queue; *p != NULL; p = &(*p)->next)
+        continue;
+    *p = &b;
+    pthread_cond_broadcast(&pool_work);
+
+    while (b.started < b.n)
+        thread_pool_run_job(&b);
+    while (b.done < b.n)
+        pthread_cond_wait(&pool_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+#else
+
+int ossl_thread_pool_init(size_t threads)
+{
+    return 1;
+}
+
+void ossl_thread_pool_cleanup(void)
+{
+}
+
+void ossl_thread_pool_fork_child(void)
+{
+}
+
+size_t ossl_thread_pool_size(void)
+{
+    return 0;
+}
+
+void ossl_thread_pool_run(OSSL_THREAD_POOL_FN fn, void *arg, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        fn(arg, i);
+}
+
+#endif
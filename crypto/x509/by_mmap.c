@@ -0,0 +1,436 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "e_os.h"
+#include "internal/cryptlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+
+#if defined(OPENSSL_SYS_UNIX) && !defined(OPENSSL_NO_POSIX_IO)
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+# define MMAP_TRUST_STORE
+#endif
+
+#include <openssl/buffer.h>
+#include <openssl/x509.h>
+#include "internal/x509_int.h"
+#include "x509_lcl.h"
+
+/*
+ * A precompiled trust store: the DER encodings of a set of certificates
+ * with a hash table over X509_NAME_hash() of their subjects.  All integers
+ * are 32-bit big-endian.
+ *
+ *  header    "OSSLTRST", version (1), number of certificates, number of
+ *            buckets (a power of 2), reserved (0)
+ *  buckets   one more entry than there are buckets: the certificates whose
+ *            subject hash maps to bucket b are entries buckets[b] up to
+ *            buckets[b + 1]
+ *  entries   subject hash, offset of the DER from the start of the file,
+ *            DER length
+ *  data      the DER encodings
+ *
+ * The file is mapped read-only where possible, so the pages are shared by
+ * every process that loads it.  Certificates are only decoded, and added to
+ * the store, when a lookup hits their bucket.
+ */
+
+#define TRUST_STORE_MAGIC       "OSSLTRST"
+#define TRUST_STORE_VERSION     1
+#define TRUST_STORE_HDRLEN      24
+#define TRUST_STORE_ENTLEN      12
+
+typedef struct by_mmap_file_st {
+    struct by_mmap_file_st *next;
+    const unsigned char *data;
+    size_t len;
+    int mapped;
+    unsigned int count, nbuckets;
+    const unsigned char *buckets, *entries;
+    unsigned char *decoded;     /* one flag per entry */
+} BY_MMAP_FILE;
+
+typedef struct lookup_mmap_st {
+    BY_MMAP_FILE *files;
+    CRYPTO_RWLOCK *lock;
+} BY_MMAP;
+
+static int mmap_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
+                     char **ret);
+static int new_mmap(X509_LOOKUP *lu);
+static void free_mmap(X509_LOOKUP *lu);
+static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
+                               X509_NAME *name, X509_OBJECT *ret);
+static X509_LOOKUP_METHOD x509_mmap_lookup = {
+    "Load certs from a precompiled trust store",
+    new_mmap,                   /* new_item */
+    free_mmap,                  /* free */
+    NULL,                       /* init */
+    NULL,                       /* shutdown */
+    mmap_ctrl,                  /* ctrl */
+    get_cert_by_subject,        /* get_by_subject */
+    NULL,                       /* get_by_issuer_serial */
+    NULL,                       /* get_by_fingerprint */
+    NULL,                       /* get_by_alias */
+};
+
+X509_LOOKUP_METHOD *X509_LOOKUP_mmap(void)
+{
+    return &x509_mmap_lookup;
+}
+
+static unsigned int get_u32(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16)
+           | ((unsigned int)p[2] << 8) | p[3];
+}
+
+static void put_u32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void mmap_file_free(BY_MMAP_FILE *f)
+{
+    if (f == NULL)
+        return;
+#ifdef MMAP_TRUST_STORE
+    if (f->mapped)
+        munmap((void *)f->data, f->len);
+    else
+#endif
+        OPENSSL_free((void *)f->data);
+    OPENSSL_free(f->decoded);
+    OPENSSL_free(f);
+}
+
+#ifdef MMAP_TRUST_STORE
+static int mmap_file_map(BY_MMAP_FILE *f, const char *file)
+{
+    struct stat st;
+    void *p;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0) {
+        ERR_raise_data(ERR_LIB_SYS, errno, "calling open(%s)", file);
+        return 0;
+    }
+    if (fstat(fd, &st) < 0) {
+        ERR_raise_data(ERR_LIB_SYS, errno, "calling fstat(%s)", file);
+        close(fd);
+        return 0;
+    }
+    if (st.st_size < TRUST_STORE_HDRLEN
+        || (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        close(fd);
+        X509err(0, X509_R_INVALID_TRUST_STORE);
+        return 0;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        ERR_raise_data(ERR_LIB_SYS, errno, "calling mmap(%s)", file);
+        return 0;
+    }
+    f->data = p;
+    f->len = (size_t)st.st_size;
+    f->mapped = 1;
+    return 1;
+}
+#else
+static int mmap_file_map(BY_MMAP_FILE *f, const char *file)
+{
+    BIO *in = BIO_new_file(file, "rb");
+    BUF_MEM *buf = BUF_MEM_new();
+    size_t len = 0;
+    int n, ok = 0;
+
+    if (in == NULL || buf == NULL)
+        goto err;
+    for (;;) {
+        if (!BUF_MEM_grow(buf, len + 4096)) {
+            X509err(0, ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+        if ((n = BIO_read(in, buf->data + len, 4096)) <= 0)
+            break;
+        len += n;
+    }
+    f->data = (unsigned char *)buf->data;
+    f->len = len;
+    buf->data = NULL;
+    ok = 1;
+ err:
+    BUF_MEM_free(buf);
+    BIO_free(in);
+    return ok;
+}
+#endif
+
+/* Check that everything but the certificates themselves is sound */
+static int mmap_file_check(BY_MMAP_FILE *f)
+{
+    const unsigned char *p = f->data;
+    unsigned int i, prev = 0;
+    size_t avail = f->len - TRUST_STORE_HDRLEN;
+
+    if (memcmp(p, TRUST_STORE_MAGIC, 8) != 0
+        || get_u32(p + 8) != TRUST_STORE_VERSION)
+        return 0;
+    f->count = get_u32(p + 12);
+    f->nbuckets = get_u32(p + 16);
+    if (f->nbuckets == 0 || (f->nbuckets & (f->nbuckets - 1)) != 0
+        || f->nbuckets >= avail / 4
+        || f->count > (avail - 4 * ((size_t)f->nbuckets + 1))
+                      / TRUST_STORE_ENTLEN)
+        return 0;
+    f->buckets = p + TRUST_STORE_HDRLEN;
+    f->entries = f->buckets + 4 * ((size_t)f->nbuckets + 1);
+    for (i = 0; i <= f->nbuckets; i++) {
+        unsigned int start = get_u32(f->buckets + 4 * (size_t)i);
+
+        if (start < prev || start > f->count)
+            return 0;
+        prev = start;
+    }
+    return get_u32(f->buckets) == 0 && prev == f->count;
+}
+
+static int add_mmap_file(BY_MMAP *ctx, const char *file)
+{
+    BY_MMAP_FILE *f, **pf;
+
+    if (file == NULL || *file == '\0') {
+        X509err(0, X509_R_INVALID_TRUST_STORE);
+        return 0;
+    }
+    if ((f = OPENSSL_zalloc(sizeof(*f))) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    if (!mmap_file_map(f, file))
+        goto err;
+    if (f->len < TRUST_STORE_HDRLEN || !mmap_file_check(f)) {
+        X509err(0, X509_R_INVALID_TRUST_STORE);
+        ERR_add_error_data(1, file);
+        goto err;
+    }
+    if (f->count > 0 && (f->decoded = OPENSSL_zalloc(f->count)) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    /* Files are searched in the order they were added */
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    for (pf = &ctx->files; *pf != NULL; pf = &(*pf)->next)
+        continue;
+    *pf = f;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return 1;
+
+ err:
+    mmap_file_free(f);
+    return 0;
+}
+
+static int mmap_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
+                     char **retp)
+{
+    BY_MMAP *lm = (BY_MMAP *)ctx->method_data;
+
+    switch (cmd) {
+    case X509_L_MMAP_LOAD:
+        return add_mmap_file(lm, argp);
+    }
+    return 0;
+}
+
+static int new_mmap(X509_LOOKUP *lu)
+{
+    BY_MMAP *a = OPENSSL_zalloc(sizeof(*a));
+
+    if (a == NULL || (a->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        OPENSSL_free(a);
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    lu->method_data = a;
+    return 1;
+}
+
+static void free_mmap(X509_LOOKUP *lu)
+{
+    BY_MMAP *a = (BY_MMAP *)lu->method_data;
+
+    while (a->files != NULL) {
+        BY_MMAP_FILE *next = a->files->next;
+
+        mmap_file_free(a->files);
+        a->files = next;
+    }
+    CRYPTO_THREAD_lock_free(a->lock);
+    OPENSSL_free(a);
+}
+
+/*
+ * Decode every certificate in |f| with subject hash |h| that hasn't been
+ * seen yet, and add it to the store.  Must be called with the lookup's
+ * lock held.
+ */
+static void mmap_file_load(X509_LOOKUP *xl, BY_MMAP_FILE *f, unsigned int h)
+{
+    const unsigned char *b = f->buckets + 4 * (size_t)(h & (f->nbuckets - 1));
+    unsigned int i, end = get_u32(b + 4);
+
+    for (i = get_u32(b); i < end; i++) {
+        const unsigned char *e = f->entries + TRUST_STORE_ENTLEN * (size_t)i;
+        size_t off = get_u32(e + 4), len = get_u32(e + 8);
+        const unsigned char *p = f->data + off;
+        X509 *x;
+
+        if (get_u32(e) != h || f->decoded[i])
+            continue;
+        f->decoded[i] = 1;
+        if (off > f->len || len > f->len - off || len > LONG_MAX)
+            continue;
+        if ((x = d2i_X509(NULL, &p, (long)len)) != NULL)
+            X509_STORE_add_cert(xl->store_ctx, x);
+        X509_free(x);
+    }
+}
+
+static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
+                               X509_NAME *name, X509_OBJECT *ret)
+{
+    BY_MMAP *ctx = (BY_MMAP *)xl->method_data;
+    BY_MMAP_FILE *f;
+    X509_INDEX_QUERY q;
+    X509_OBJECT *tmp = NULL;
+    unsigned int h;
+
+    /* There are only certificates in a trust store */
+    if (name == NULL || type != X509_LU_X509)
+        return 0;
+
+    h = (unsigned int)(X509_NAME_hash(name) & 0xffffffffUL);
+    /* Drop any errors raised by malformed entries, but only those */
+    ERR_set_mark();
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    for (f = ctx->files; f != NULL; f = f->next)
+        mmap_file_load(xl, f, h);
+    CRYPTO_THREAD_unlock(ctx->lock);
+    ERR_pop_to_mark();
+
+    if (x509_index_query_subject(&q, type, name)) {
+        x509_store_read_lock(xl->store_ctx);
+        tmp = x509_store_index_next(xl->store_ctx, &q);
+        x509_store_read_unlock(xl->store_ctx);
+    }
+    if (tmp == NULL)
+        return 0;
+    ret->type = tmp->type;
+    memcpy(&ret->data, &tmp->data, sizeof(ret->data));
+    return 1;
+}
+
+typedef struct {
+    unsigned int hash, bucket;
+    int idx, len;
+    unsigned char *der;
+} MMAP_WRITE_ENTRY;
+
+static int mmap_write_entry_cmp(const void *a, const void *b)
+{
+    const MMAP_WRITE_ENTRY *ea = a, *eb = b;
+
+    if (ea->bucket != eb->bucket)
+        return ea->bucket < eb->bucket ? -1 : 1;
+    return ea->idx - eb->idx;
+}
+
+int X509_LOOKUP_mmap_write(BIO *out, STACK_OF(X509) *certs)
+{
+    MMAP_WRITE_ENTRY *ents = NULL;
+    unsigned char *hdr = NULL;
+    int i, num = sk_X509_num(certs), ok = 0;
+    unsigned int nbuckets = 1, b;
+    size_t hdrlen, off;
+
+    while (nbuckets < (unsigned int)num)
+        nbuckets <<= 1;
+    if (num > 0 && (ents = OPENSSL_zalloc(num * sizeof(*ents))) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    hdrlen = TRUST_STORE_HDRLEN + 4 * ((size_t)nbuckets + 1)
+             + TRUST_STORE_ENTLEN * (size_t)num;
+    for (off = hdrlen, i = 0; i < num; i++) {
+        X509 *x = sk_X509_value(certs, i);
+
+        ents[i].idx = i;
+        ents[i].hash = (unsigned int)(X509_NAME_hash(X509_get_subject_name(x))
+                                      & 0xffffffffUL);
+        ents[i].bucket = ents[i].hash & (nbuckets - 1);
+        if ((ents[i].len = i2d_X509(x, &ents[i].der)) <= 0)
+            goto err;
+        off += ents[i].len;
+        if (off > 0xffffffffUL) {
+            X509err(0, X509_R_INVALID_TRUST_STORE);
+            goto err;
+        }
+    }
+    if (num > 0)
+        qsort(ents, num, sizeof(*ents), mmap_write_entry_cmp);
+
+    if ((hdr = OPENSSL_zalloc(hdrlen)) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    memcpy(hdr, TRUST_STORE_MAGIC, 8);
+    put_u32(hdr + 8, TRUST_STORE_VERSION);
+    put_u32(hdr + 12, (unsigned int)num);
+    put_u32(hdr + 16, nbuckets);
+    for (i = 0, b = 0; b <= nbuckets; b++) {
+        while (i < num && ents[i].bucket < b)
+            i++;
+        put_u32(hdr + TRUST_STORE_HDRLEN + 4 * (size_t)b, (unsigned int)i);
+    }
+    for (off = hdrlen, i = 0; i < num; i++) {
+        unsigned char *e = hdr + TRUST_STORE_HDRLEN + 4 * ((size_t)nbuckets + 1)
+                           + TRUST_STORE_ENTLEN * (size_t)i;
+
+        put_u32(e, ents[i].hash);
+        put_u32(e + 4, (unsigned int)off);
+        put_u32(e + 8, (unsigned int)ents[i].len);
+        off += ents[i].len;
+    }
+
+    if (BIO_write(out, hdr, (int)hdrlen) != (int)hdrlen)
+        goto err;
+    for (i = 0; i < num; i++)
+        if (BIO_write(out, ents[i].der, ents[i].len) != ents[i].len)
+            goto err;
+    ok = BIO_flush(out) > 0;
+
+ err:
+    for (i = 0; i < num && ents != NULL; i++)
+        OPENSSL_free(ents[i].der);
+    OPENSSL_free(ents);
+    OPENSSL_free(hdr);
+    return ok;
+}
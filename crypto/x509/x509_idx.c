@@ -0,0 +1,313 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "internal/cryptlib.h"
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include "internal/x509_int.h"
+#include "x509_lcl.h"
+
+/*
+ * Hash indexes over the objects in an X509_STORE.
+ *
+ * Objects are never removed from a store, so each index is an append-only
+ * chained hash table.  Nodes are carved out of a pool owned by the table
+ * and are appended to the tail of their bucket, so that matches come back
+ * in the order they were added.  Appending publishes a fully initialised
+ * node with a single release store, which lets readers walk a bucket
+ * without taking the store lock while a writer (who does hold it) adds to
+ * it.
+ *
+ * When a table's pool is exhausted a table twice the size is built from
+ * the store's object stack and published in its place.  The old table is
+ * kept, still intact, until the store is freed because a reader may be
+ * walking it.  That costs at most as much memory again as the live tables.
+ */
+
+struct x509_index_node_st {
+    unsigned long hash;
+    X509_OBJECT *obj;
+    X509_INDEX_NODE *next;
+};
+
+struct x509_index_table_st {
+    size_t mask;                /* number of buckets - 1 */
+    size_t used, size;          /* nodes used and available */
+    X509_INDEX_NODE *nodes;
+    X509_INDEX_NODE **buckets;
+    X509_INDEX_NODE **tails;    /* only used by writers */
+    X509_INDEX_TABLE *retired;  /* the table this one replaced */
+};
+
+#ifdef X509_INDEX_LOCKLESS
+# define index_load(p)          __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define index_store(p, v)      __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+# define index_load(p)          (*(p))
+# define index_store(p, v)      (*(p) = (v))
+#endif
+
+#define INDEX_MIN_SIZE          16
+
+/* FNV-1a */
+static unsigned long index_hash_bytes(unsigned long h, const unsigned char *p,
+                                      size_t len)
+{
+    while (len-- > 0)
+        h = (h ^ *p++) * 0x01000193UL;
+    return h;
+}
+
+#define INDEX_HASH_INIT         0x811c9dc5UL
+
+static int index_hash_name(unsigned long *h, X509_NAME *name)
+{
+    /* Ensure the canonical encoding is present, as X509_NAME_cmp() does */
+    if ((name->canon_enc == NULL || name->modified)
+        && i2d_X509_NAME(name, NULL) < 0)
+        return 0;
+    *h = index_hash_bytes(*h, name->canon_enc, name->canon_enclen);
+    return 1;
+}
+
+int x509_index_query_subject(X509_INDEX_QUERY *q, X509_LOOKUP_TYPE type,
+                             X509_NAME *name)
+{
+    memset(q, 0, sizeof(*q));
+    q->kind = X509_INDEX_SUBJECT;
+    q->type = type;
+    q->name = name;
+    q->hash = INDEX_HASH_INIT;
+    return index_hash_name(&q->hash, name);
+}
+
+int x509_index_query_skid(X509_INDEX_QUERY *q, const ASN1_OCTET_STRING *skid)
+{
+    memset(q, 0, sizeof(*q));
+    q->kind = X509_INDEX_SKID;
+    q->type = X509_LU_X509;
+    q->skid = skid;
+    q->hash = index_hash_bytes(INDEX_HASH_INIT, skid->data, skid->length);
+    return 1;
+}
+
+int x509_index_query_issuer_serial(X509_INDEX_QUERY *q, X509_NAME *issuer,
+                                   const ASN1_INTEGER *serial)
+{
+    memset(q, 0, sizeof(*q));
+    q->kind = X509_INDEX_ISSUER_SERIAL;
+    q->type = X509_LU_X509;
+    q->name = issuer;
+    q->serial = serial;
+    q->hash = index_hash_bytes(INDEX_HASH_INIT, serial->data, serial->length);
+    return index_hash_name(&q->hash, issuer);
+}
+
+/* Set up |q| to find |obj| in the |kind| index, if it belongs there */
+static int index_query_object(X509_INDEX_QUERY *q, int kind, X509_OBJECT *obj)
+{
+    const ASN1_OCTET_STRING *skid;
+
+    switch (obj->type) {
+    case X509_LU_X509:
+        switch (kind) {
+        case X509_INDEX_SUBJECT:
+            return x509_index_query_subject(q, obj->type,
+                                            X509_get_subject_name(obj->data.x509));
+        case X509_INDEX_SKID:
+            skid = X509_get0_subject_key_id(obj->data.x509);
+            return skid != NULL && x509_index_query_skid(q, skid);
+        case X509_INDEX_ISSUER_SERIAL:
+            return x509_index_query_issuer_serial(q,
+                       X509_get_issuer_name(obj->data.x509),
+                       X509_get0_serialNumber(obj->data.x509));
+        }
+        break;
+    case X509_LU_CRL:
+        if (kind == X509_INDEX_SUBJECT)
+            return x509_index_query_subject(q, obj->type,
+                                            X509_CRL_get_issuer(obj->data.crl));
+        break;
+    case X509_LU_NONE:
+        break;
+    }
+    return 0;
+}
+
+static int index_match(const X509_INDEX_QUERY *q, X509_OBJECT *obj)
+{
+    if (obj->type != q->type)
+        return 0;
+    switch (q->kind) {
+    case X509_INDEX_SUBJECT:
+        if (obj->type == X509_LU_CRL)
+            return X509_NAME_cmp(q->name,
+                                 X509_CRL_get_issuer(obj->data.crl)) == 0;
+        return X509_NAME_cmp(q->name,
+                             X509_get_subject_name(obj->data.x509)) == 0;
+    case X509_INDEX_SKID:
+        return ASN1_OCTET_STRING_cmp(q->skid,
+                                     X509_get0_subject_key_id(obj->data.x509))
+               == 0;
+    case X509_INDEX_ISSUER_SERIAL:
+        return ASN1_INTEGER_cmp(q->serial,
+                                X509_get0_serialNumber(obj->data.x509)) == 0
+               && X509_NAME_cmp(q->name,
+                                X509_get_issuer_name(obj->data.x509)) == 0;
+    }
+    return 0;
+}
+
+/*
+ * Return the next object matching |q|, or NULL when there are no more.
+ * Unless X509_INDEX_LOCKLESS is defined the caller must hold the store
+ * lock.
+ */
+X509_OBJECT *x509_store_index_next(X509_STORE *store, X509_INDEX_QUERY *q)
+{
+    const X509_INDEX_NODE *node;
+
+    if (q->done)
+        return NULL;
+    if (q->node == NULL) {
+        X509_INDEX_TABLE *t = index_load(&store->index[q->kind]);
+
+        if (t == NULL)
+            return NULL;
+        node = index_load(&t->buckets[q->hash & t->mask]);
+    } else {
+        node = index_load(&q->node->next);
+    }
+    for (; node != NULL; node = index_load(&node->next)) {
+        if (node->hash == q->hash && index_match(q, node->obj)) {
+            q->node = node;
+            return node->obj;
+        }
+    }
+    q->done = 1;
+    return NULL;
+}
+
+static void index_table_free(X509_INDEX_TABLE *t)
+{
+    while (t != NULL) {
+        X509_INDEX_TABLE *retired = t->retired;
+
+        OPENSSL_free(t->nodes);
+        OPENSSL_free(t->buckets);
+        OPENSSL_free(t->tails);
+        OPENSSL_free(t);
+        t = retired;
+    }
+}
+
+static X509_INDEX_TABLE *index_table_new(size_t size)
+{
+    X509_INDEX_TABLE *t = OPENSSL_zalloc(sizeof(*t));
+    size_t n = INDEX_MIN_SIZE;
+
+    if (t == NULL)
+        return NULL;
+    while (n < size)
+        n <<= 1;
+    t->mask = n - 1;
+    t->size = n;
+    t->nodes = OPENSSL_zalloc(n * sizeof(*t->nodes));
+    t->buckets = OPENSSL_zalloc(n * sizeof(*t->buckets));
+    t->tails = OPENSSL_zalloc(n * sizeof(*t->tails));
+    if (t->nodes == NULL || t->buckets == NULL || t->tails == NULL) {
+        index_table_free(t);
+        return NULL;
+    }
+    return t;
+}
+
+static void index_table_insert(X509_INDEX_TABLE *t, unsigned long hash,
+                               X509_OBJECT *obj)
+{
+    X509_INDEX_NODE *node = &t->nodes[t->used++];
+    size_t b = hash & t->mask;
+
+    node->hash = hash;
+    node->obj = obj;
+    node->next = NULL;
+    if (t->tails[b] == NULL)
+        index_store(&t->buckets[b], node);
+    else
+        index_store(&t->tails[b]->next, node);
+    t->tails[b] = node;
+}
+
+/* Build a new |kind| table of at least |size| nodes over all of objs */
+static X509_INDEX_TABLE *index_rebuild(X509_STORE *store, int kind,
+                                       size_t size)
+{
+    X509_INDEX_TABLE *t;
+    X509_INDEX_QUERY q;
+    int i, num = sk_X509_OBJECT_num(store->objs);
+
+    if (size < (size_t)num)
+        size = num;
+    if ((t = index_table_new(size)) == NULL)
+        return NULL;
+    for (i = 0; i < num; i++) {
+        X509_OBJECT *obj = sk_X509_OBJECT_value(store->objs, i);
+
+        if (index_query_object(&q, kind, obj))
+            index_table_insert(t, q.hash, obj);
+    }
+    return t;
+}
+
+/*
+ * Add |obj|, which must be the last object pushed onto objs, to the
+ * indexes.  Must be called with the store lock held.  On failure the
+ * indexes don't refer to |obj|, so the caller can pop it off objs again.
+ */
+int x509_store_index_add(X509_STORE *store, X509_OBJECT *obj)
+{
+    X509_INDEX_TABLE *grown[X509_INDEX_NUM] = { NULL };
+    X509_INDEX_QUERY q[X509_INDEX_NUM];
+    int kind, in[X509_INDEX_NUM];
+
+    /* Any table whose pool is exhausted is rebuilt, picking |obj| up */
+    for (kind = 0; kind < X509_INDEX_NUM; kind++) {
+        X509_INDEX_TABLE *t = store->index[kind];
+
+        in[kind] = index_query_object(&q[kind], kind, obj);
+        if (!in[kind] || (t != NULL && t->used < t->size))
+            continue;
+        grown[kind] = index_rebuild(store, kind, t != NULL ? 2 * t->size : 0);
+        if (grown[kind] == NULL) {
+            while (--kind >= 0)
+                index_table_free(grown[kind]);
+            return 0;
+        }
+    }
+
+    for (kind = 0; kind < X509_INDEX_NUM; kind++) {
+        if (grown[kind] != NULL) {
+            grown[kind]->retired = store->index[kind];
+            index_store(&store->index[kind], grown[kind]);
+        } else if (in[kind]) {
+            index_table_insert(store->index[kind], q[kind].hash, obj);
+        }
+    }
+    return 1;
+}
+
+void x509_store_index_free(X509_STORE *store)
+{
+    int kind;
+
+    for (kind = 0; kind < X509_INDEX_NUM; kind++) {
+        index_table_free(store->index[kind]);
+        store->index[kind] = NULL;
+    }
+}
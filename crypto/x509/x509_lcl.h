@@ -102,6 +102,41 @@ struct x509_lookup_st {
  * validation.  Once we have a certificate chain, the 'verify' function is
  * then called to actually check the cert chain.
  */
+typedef struct x509_verify_cache_st X509_VERIFY_CACHE;
+typedef struct x509_sig_memo_st X509_SIG_MEMO;
+typedef struct x509_index_table_st X509_INDEX_TABLE;
+typedef struct x509_index_node_st X509_INDEX_NODE;
+
+/* The hash indexes over the objects in an X509_STORE, see x509_idx.c */
+#define X509_INDEX_SUBJECT          0 /* Certificate subject, CRL issuer */
+#define X509_INDEX_SKID             1 /* Certificate subject key id */
+#define X509_INDEX_ISSUER_SERIAL    2 /* Certificate issuer and serial */
+#define X509_INDEX_NUM              3
+
+typedef struct {
+    int kind;
+    X509_LOOKUP_TYPE type;
+    X509_NAME *name;
+    const ASN1_INTEGER *serial;
+    const ASN1_OCTET_STRING *skid;
+    unsigned long hash;
+    const X509_INDEX_NODE *node;
+    int done;
+} X509_INDEX_QUERY;
+
+/*
+ * With atomics the indexes can be searched without holding the store lock,
+ * otherwise readers lock the store like writers do.
+ */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+# define X509_INDEX_LOCKLESS
+# define x509_store_read_lock(s)     (void)(s)
+# define x509_store_read_unlock(s)   (void)(s)
+#else
+# define x509_store_read_lock(s)     X509_STORE_lock(s)
+# define x509_store_read_unlock(s)   X509_STORE_unlock(s)
+#endif
+
 struct x509_store_st {
     /* The following is a cache of trusted certs */
     int cache;                  /* if true, stash any hits */
@@ -134,6 +169,14 @@ struct x509_store_st {
     CRYPTO_EX_DATA ex_data;
     CRYPTO_REF_COUNT references;
     CRYPTO_RWLOCK *lock;
+    /* Hash indexes over objs, replaced only with lock held */
+    X509_INDEX_TABLE *index[X509_INDEX_NUM];
+    /* Bumped whenever a certificate, CRL or lookup method is added */
+    unsigned long generation;
+    /* Optional cache of successful verifications */
+    X509_VERIFY_CACHE *vcache;
+    /* Optional memo of good certificate signatures */
+    X509_SIG_MEMO *sigmemo;
 };
 
 typedef struct lookup_dir_hashes_st BY_DIR_HASH;
@@ -145,3 +188,20 @@ DEFINE_STACK_OF(STACK_OF_X509_NAME_ENTRY)
 
 void x509_set_signature_info(X509_SIG_INFO *siginf, const X509_ALGOR *alg,
                              const ASN1_STRING *sig);
+
+void x509_verify_cache_free(X509_VERIFY_CACHE *cache);
+int x509_verify_cache_lookup(X509_STORE_CTX *ctx);
+void x509_verify_cache_add(X509_STORE_CTX *ctx);
+void x509_verify_cache_limit(X509_STORE_CTX *ctx, const ASN1_TIME *t);
+
+void x509_sig_memo_free(X509_SIG_MEMO *memo);
+int x509_sig_memo_verify(X509_SIG_MEMO *memo, X509 *x, EVP_PKEY *pkey);
+
+int x509_store_index_add(X509_STORE *store, X509_OBJECT *obj);
+void x509_store_index_free(X509_STORE *store);
+int x509_index_query_subject(X509_INDEX_QUERY *q, X509_LOOKUP_TYPE type,
+                             X509_NAME *name);
+int x509_index_query_skid(X509_INDEX_QUERY *q, const ASN1_OCTET_STRING *skid);
+int x509_index_query_issuer_serial(X509_INDEX_QUERY *q, X509_NAME *issuer,
+                                   const ASN1_INTEGER *serial);
+X509_OBJECT *x509_store_index_next(X509_STORE *store, X509_INDEX_QUERY *q);
@@ -222,7 +222,10 @@ void X509_STORE_free(X509_STORE *vfy)
         X509_LOOKUP_free(lu);
     }
     sk_X509_LOOKUP_free(sk);
+    x509_store_index_free(vfy);
     sk_X509_OBJECT_pop_free(vfy->objs, X509_OBJECT_free);
+    x509_verify_cache_free(vfy->vcache);
+    x509_sig_memo_free(vfy->sigmemo);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_X509_STORE, vfy, &vfy->ex_data);
     X509_VERIFY_PARAM_free(vfy->param);
@@ -263,8 +266,12 @@ X509_LOOKUP *X509_STORE_add_lookup(X509_STORE *v, X509_LOOKUP_METHOD *m)
     }
 
     lu->store_ctx = v;
-    if (sk_X509_LOOKUP_push(v->get_cert_methods, lu))
+    if (sk_X509_LOOKUP_push(v->get_cert_methods, lu)) {
+        X509_STORE_lock(v);
+        v->generation++;
+        X509_STORE_unlock(v);
         return lu;
+    }
     /* malloc failed */
     X509err(X509_F_X509_STORE_ADD_LOOKUP, ERR_R_MALLOC_FAILURE);
     X509_LOOKUP_free(lu);
@@ -291,7 +298,8 @@ int X509_STORE_CTX_get_by_subject(X509_STORE_CTX *vs, X509_LOOKUP_TYPE type,
 {
     X509_STORE *store = vs->store;
     X509_LOOKUP *lu;
-    X509_OBJECT stmp, *tmp;
+    X509_INDEX_QUERY q;
+    X509_OBJECT stmp, *tmp = NULL;
     int i, j;
 
     if (store == NULL)
@@ -300,10 +308,11 @@ int X509_STORE_CTX_get_by_subject(X509_STORE_CTX *vs, X509_LOOKUP_TYPE type,
     stmp.type = X509_LU_NONE;
     stmp.data.ptr = NULL;
 
-
-    X509_STORE_lock(store);
-    tmp = X509_OBJECT_retrieve_by_subject(store->objs, type, name);
-    X509_STORE_unlock(store);
+    if (x509_index_query_subject(&q, type, name)) {
+        x509_store_read_lock(store);
+        tmp = x509_store_index_next(store, &q);
+        x509_store_read_unlock(store);
+    }
 
     if (tmp == NULL || type == X509_LU_CRL) {
         for (i = 0; i < sk_X509_LOOKUP_num(store->get_cert_methods); i++) {
@@ -327,6 +336,35 @@ int X509_STORE_CTX_get_by_subject(X509_STORE_CTX *vs, X509_LOOKUP_TYPE type,
     return 1;
 }
 
+/*
+ * Find an object in the store that is the same as |x|.  Certificates are
+ * found by issuer and serial number, CRLs by issuer name.  Must be called
+ * with the store lock held.
+ */
+static X509_OBJECT *x509_store_find_match(X509_STORE *store, X509_OBJECT *x)
+{
+    X509_INDEX_QUERY q;
+    X509_OBJECT *obj;
+
+    if (x->type == X509_LU_X509) {
+        if (!x509_index_query_issuer_serial(&q,
+                                            X509_get_issuer_name(x->data.x509),
+                                            X509_get0_serialNumber(x->data.x509)))
+            return NULL;
+        while ((obj = x509_store_index_next(store, &q)) != NULL)
+            if (X509_cmp(obj->data.x509, x->data.x509) == 0)
+                return obj;
+    } else if (x->type == X509_LU_CRL) {
+        if (!x509_index_query_subject(&q, X509_LU_CRL,
+                                      X509_CRL_get_issuer(x->data.crl)))
+            return NULL;
+        while ((obj = x509_store_index_next(store, &q)) != NULL)
+            if (X509_CRL_match(obj->data.crl, x->data.crl) == 0)
+                return obj;
+    }
+    return NULL;
+}
+
 static int x509_store_add(X509_STORE *store, void *x, int crl) {
     X509_OBJECT *obj;
     int ret = 0, added = 0;
@@ -351,11 +389,17 @@ static int x509_store_add(X509_STORE *store, void *x, int crl) {
     }
 
     X509_STORE_lock(store);
-    if (X509_OBJECT_retrieve_match(store->objs, obj)) {
+    if (x509_store_find_match(store, obj)) {
         ret = 1;
     } else {
         added = sk_X509_OBJECT_push(store->objs, obj);
+        if (added != 0 && !x509_store_index_add(store, obj)) {
+            (void)sk_X509_OBJECT_pop(store->objs);
+            added = 0;
+        }
         ret = added != 0;
+        if (added != 0)
+            store->generation++;
     }
     X509_STORE_unlock(store);
 
@@ -534,26 +578,25 @@ STACK_OF(X509_OBJECT) *X509_STORE_get0_objects(X509_STORE *v)
 
 STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
 {
-    int i, idx, cnt;
     STACK_OF(X509) *sk = NULL;
     X509 *x;
     X509_OBJECT *obj;
     X509_STORE *store = ctx->store;
+    X509_INDEX_QUERY q;
 
-    if (store == NULL)
+    if (store == NULL || !x509_index_query_subject(&q, X509_LU_X509, nm))
         return NULL;
 
-    X509_STORE_lock(store);
-    idx = x509_object_idx_cnt(store->objs, X509_LU_X509, nm, &cnt);
-    if (idx < 0) {
+    x509_store_read_lock(store);
+    obj = x509_store_index_next(store, &q);
+    x509_store_read_unlock(store);
+    if (obj == NULL) {
         /*
          * Nothing found in cache: do lookup to possibly add new objects to
          * cache
          */
         X509_OBJECT *xobj = X509_OBJECT_new();
 
-        X509_STORE_unlock(store);
-
         if (xobj == NULL)
             return NULL;
         if (!X509_STORE_CTX_get_by_subject(ctx, X509_LU_X509, nm, xobj)) {
@@ -561,76 +604,75 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
             return NULL;
         }
         X509_OBJECT_free(xobj);
-        X509_STORE_lock(store);
-        idx = x509_object_idx_cnt(store->objs, X509_LU_X509, nm, &cnt);
-        if (idx < 0) {
-            X509_STORE_unlock(store);
+        x509_index_query_subject(&q, X509_LU_X509, nm);
+        x509_store_read_lock(store);
+        obj = x509_store_index_next(store, &q);
+        x509_store_read_unlock(store);
+        if (obj == NULL)
             return NULL;
-        }
     }
 
     sk = sk_X509_new_null();
-    for (i = 0; i < cnt; i++, idx++) {
-        obj = sk_X509_OBJECT_value(store->objs, idx);
+    x509_store_read_lock(store);
+    for (; obj != NULL; obj = x509_store_index_next(store, &q)) {
         x = obj->data.x509;
         if (!X509_up_ref(x)) {
-            X509_STORE_unlock(store);
+            x509_store_read_unlock(store);
             sk_X509_pop_free(sk, X509_free);
             return NULL;
         }
         if (!sk_X509_push(sk, x)) {
-            X509_STORE_unlock(store);
+            x509_store_read_unlock(store);
             X509_free(x);
             sk_X509_pop_free(sk, X509_free);
             return NULL;
         }
     }
-    X509_STORE_unlock(store);
+    x509_store_read_unlock(store);
     return sk;
 }
 
 STACK_OF(X509_CRL) *X509_STORE_CTX_get1_crls(X509_STORE_CTX *ctx, X509_NAME *nm)
 {
-    int i, idx, cnt;
     STACK_OF(X509_CRL) *sk = sk_X509_CRL_new_null();
     X509_CRL *x;
     X509_OBJECT *obj, *xobj = X509_OBJECT_new();
     X509_STORE *store = ctx->store;
+    X509_INDEX_QUERY q;
 
     /* Always do lookup to possibly add new CRLs to cache */
     if (sk == NULL
             || xobj == NULL
             || store == NULL
-            || !X509_STORE_CTX_get_by_subject(ctx, X509_LU_CRL, nm, xobj)) {
+            || !X509_STORE_CTX_get_by_subject(ctx, X509_LU_CRL, nm, xobj)
+            || !x509_index_query_subject(&q, X509_LU_CRL, nm)) {
         X509_OBJECT_free(xobj);
         sk_X509_CRL_free(sk);
         return NULL;
     }
     X509_OBJECT_free(xobj);
-    X509_STORE_lock(store);
-    idx = x509_object_idx_cnt(store->objs, X509_LU_CRL, nm, &cnt);
-    if (idx < 0) {
-        X509_STORE_unlock(store);
+    x509_store_read_lock(store);
+    if ((obj = x509_store_index_next(store, &q)) == NULL) {
+        x509_store_read_unlock(store);
         sk_X509_CRL_free(sk);
         return NULL;
     }
 
-    for (i = 0; i < cnt; i++, idx++) {
-        obj = sk_X509_OBJECT_value(store->objs, idx);
+    for (; obj != NULL; obj = x509_store_index_next(store, &q)) {
         x = obj->data.crl;
         if (!X509_CRL_up_ref(x)) {
-            X509_STORE_unlock(store);
+            x509_store_read_unlock(store);
             sk_X509_CRL_pop_free(sk, X509_CRL_free);
             return NULL;
         }
         if (!sk_X509_CRL_push(sk, x)) {
-            X509_STORE_unlock(store);
+            x509_store_read_unlock(store);
             X509_CRL_free(x);
             sk_X509_CRL_pop_free(sk, X509_CRL_free);
             return NULL;
         }
     }
-    X509_STORE_unlock(store);
+    x509_store_read_unlock(store);
     return sk;
 }
 
@@ -679,7 +721,9 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
     X509_NAME *xn;
     X509_OBJECT *obj = X509_OBJECT_new(), *pobj = NULL;
     X509_STORE *store = ctx->store;
-    int i, ok, idx, ret;
+    const ASN1_OCTET_STRING *akid;
+    X509_INDEX_QUERY q;
+    int ok, ret;
 
     if (obj == NULL)
         return -1;
@@ -707,20 +751,20 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
     if (store == NULL)
         return 0;
 
-    /* Else find index of first cert accepted by 'check_issued' */
+    /*
+     * Else look through all matching certs for the first one accepted by
+     * 'check_issued'.  Candidates whose key id matches the authority key id
+     * are tried first.
+     */
     ret = 0;
-    X509_STORE_lock(store);
-    idx = X509_OBJECT_idx_by_subject(store->objs, X509_LU_X509, xn);
-    if (idx != -1) {            /* should be true as we've had at least one
-                                 * match */
-        /* Look through all matching certs for suitable issuer */
-        for (i = idx; i < sk_X509_OBJECT_num(store->objs); i++) {
-            pobj = sk_X509_OBJECT_value(store->objs, i);
-            /* See if we've run past the matches */
-            if (pobj->type != X509_LU_X509)
-                break;
-            if (X509_NAME_cmp(xn, X509_get_subject_name(pobj->data.x509)))
-                break;
+    akid = X509_get0_authority_key_id(x);
+    if (akid != NULL)
+        ok = x509_index_query_skid(&q, akid);
+    else
+        ok = x509_index_query_subject(&q, X509_LU_X509, xn);
+    x509_store_read_lock(store);
+    while (ok) {
+        while ((pobj = x509_store_index_next(store, &q)) != NULL) {
             if (ctx->check_issued(ctx, x, pobj->data.x509)) {
                 *issuer = pobj->data.x509;
                 ret = 1;
@@ -730,17 +774,20 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
                  * match in issuer so we return nearest
                  * match if no certificate time is OK.
                  */
-
                 if (x509_check_cert_time(ctx, *issuer, -1))
-                    break;
+                    goto found;
             }
         }
+        /* Fall back to all certificates with the right subject */
+        ok = q.kind == X509_INDEX_SKID
+             && x509_index_query_subject(&q, X509_LU_X509, xn);
     }
+ found:
     if (*issuer && !X509_up_ref(*issuer)) {
         *issuer = NULL;
         ret = -1;
     }
-    X509_STORE_unlock(store);
+    x509_store_read_unlock(store);
     return ret;
 }
 
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "internal/cryptlib.h"
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include "internal/x509_int.h"
+#include "x509_lcl.h"
+
+/*
+ * A memo of certificate signatures that have been checked, owned by an
+ * X509_STORE.  Each slot records that the certificate with a given SHA-256
+ * was found to be signed by the public key with a given SHA-256.  That is a
+ * fact about the two encodings that never goes stale, so there's no expiry
+ * and nothing to invalidate.  The memo is direct mapped: a new record simply
+ * replaces whatever occupied its slot.
+ */
+
+typedef struct {
+    int used;
+    unsigned char key[SHA256_DIGEST_LENGTH];
+} X509_SIG_MEMO_SLOT;
+
+struct x509_sig_memo_st {
+    CRYPTO_RWLOCK *lock;
+    X509_SIG_MEMO_SLOT *slots;
+    size_t nslots;
+    uint64_t hits, misses;
+};
+
+void x509_sig_memo_free(X509_SIG_MEMO *memo)
+{
+    if (memo == NULL)
+        return;
+    CRYPTO_THREAD_lock_free(memo->lock);
+    OPENSSL_free(memo->slots);
+    OPENSSL_free(memo);
+}
+
+static X509_SIG_MEMO *x509_sig_memo_new(size_t size)
+{
+    X509_SIG_MEMO *memo = OPENSSL_zalloc(sizeof(*memo));
+
+    if (size > SIZE_MAX / sizeof(*memo->slots))
+        size = 0;
+    if (memo == NULL || size == 0
+        || (memo->lock = CRYPTO_THREAD_lock_new()) == NULL
+        || (memo->slots = OPENSSL_zalloc(size * sizeof(*memo->slots)))
+           == NULL) {
+        x509_sig_memo_free(memo);
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    memo->nslots = size;
+    return memo;
+}
+
+/*
+ * The key is the hash of the certificate hash and the issuer key hash.  The
+ * key is hashed from the EVP_PKEY rather than the issuer's SPKI, because
+ * parameters may have been inherited from further up the chain.
+ */
+static int sig_memo_key(X509 *x, EVP_PKEY *pkey, unsigned char *key)
+{
+    unsigned char dgst[2 * SHA256_DIGEST_LENGTH];
+    unsigned char *der = NULL;
+    unsigned int len;
+    int derlen, ret;
+
+    if (!X509_digest(x, EVP_sha256(), dgst, &len)
+        || (derlen = i2d_PUBKEY(pkey, &der)) <= 0)
+        return 0;
+    ret = EVP_Digest(der, derlen, dgst + SHA256_DIGEST_LENGTH, NULL,
+                     EVP_sha256(), NULL)
+          && EVP_Digest(dgst, sizeof(dgst), key, NULL, EVP_sha256(), NULL);
+    OPENSSL_free(der);
+    return ret;
+}
+
+static X509_SIG_MEMO_SLOT *sig_memo_slot(X509_SIG_MEMO *memo,
+                                         const unsigned char *key)
+{
+    size_t h = 0, i;
+
+    for (i = 0; i < sizeof(h); i++)
+        h = (h << 8) | key[i];
+    return &memo->slots[h % memo->nslots];
+}
+
+/*
+ * Check the signature on |x| with |pkey|, unless the memo already records
+ * that it's good.  Returns the same values as X509_verify().
+ */
+int x509_sig_memo_verify(X509_SIG_MEMO *memo, X509 *x, EVP_PKEY *pkey)
+{
+    unsigned char key[SHA256_DIGEST_LENGTH];
+    X509_SIG_MEMO_SLOT *slot;
+    int ret, found;
+
+    if (!sig_memo_key(x, pkey, key)) {
+        ERR_clear_error();
+        return X509_verify(x, pkey);
+    }
+    slot = sig_memo_slot(memo, key);
+
+    CRYPTO_THREAD_write_lock(memo->lock);
+    found = slot->used && memcmp(slot->key, key, sizeof(key)) == 0;
+    if (found)
+        memo->hits++;
+    else
+        memo->misses++;
+    CRYPTO_THREAD_unlock(memo->lock);
+    if (found)
+        return 1;
+
+    if ((ret = X509_verify(x, pkey)) > 0) {
+        CRYPTO_THREAD_write_lock(memo->lock);
+        memcpy(slot->key, key, sizeof(key));
+        slot->used = 1;
+        CRYPTO_THREAD_unlock(memo->lock);
+    }
+    return ret;
+}
+
+int X509_STORE_set_signature_memo_size(X509_STORE *ctx, size_t size)
+{
+    X509_SIG_MEMO *memo = NULL;
+
+    if (size > 0 && (memo = x509_sig_memo_new(size)) == NULL)
+        return 0;
+    x509_sig_memo_free(ctx->sigmemo);
+    ctx->sigmemo = memo;
+    return 1;
+}
+
+int X509_STORE_get_signature_memo_stats(X509_STORE *ctx, uint64_t *hits,
+                                        uint64_t *misses)
+{
+    X509_SIG_MEMO *memo = ctx->sigmemo;
+
+    if (memo == NULL) {
+        *hits = *misses = 0;
+        return 0;
+    }
+    CRYPTO_THREAD_read_lock(memo->lock);
+    *hits = memo->hits;
+    *misses = memo->misses;
+    CRYPTO_THREAD_unlock(memo->lock);
+    return 1;
+}
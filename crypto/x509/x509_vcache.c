@@ -0,0 +1,414 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <time.h>
+#include "internal/cryptlib.h"
+#include <openssl/evp.h>
+#include <openssl/lhash.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include "internal/x509_int.h"
+#include "x509_lcl.h"
+
+/*
+ * A cache of successful X509_verify_cert() results, owned by an X509_STORE.
+ *
+ * Entries are keyed on a SHA-256 hash of the target certificate, the
+ * untrusted certificates and CRLs supplied by the caller, and every
+ * verification parameter that can change the outcome.  A hit hands back the
+ * chain built the first time round, without doing any chain building or
+ * signature checks.  An entry is only good until the earliest notAfter of
+ * the chain (and nextUpdate of any CRL consulted), and until anything new
+ * is added to the store, which is tracked with the store generation.
+ *
+ * The least recently used entry is evicted when the cache is full.
+ */
+
+typedef struct x509_vcache_entry_st X509_VCACHE_ENTRY;
+
+struct x509_vcache_entry_st {
+    unsigned char key[SHA256_DIGEST_LENGTH];
+    unsigned long generation;
+    time_t expires;             /* 0 if the result doesn't expire */
+    STACK_OF(X509) *chain;
+    int num_untrusted;
+    char *peername;
+    X509_VCACHE_ENTRY *prev, *next;
+};
+
+DEFINE_LHASH_OF(X509_VCACHE_ENTRY);
+
+struct x509_verify_cache_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(X509_VCACHE_ENTRY) *entries;
+    X509_VCACHE_ENTRY *head, *tail;     /* most and least recently used */
+    size_t num, max;
+    uint64_t hits, misses;
+};
+
+static unsigned long vcache_entry_hash(const X509_VCACHE_ENTRY *e)
+{
+    unsigned long h = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(h); i++)
+        h = (h << 8) | e->key[i];
+    return h;
+}
+
+static int vcache_entry_cmp(const X509_VCACHE_ENTRY *a,
+                            const X509_VCACHE_ENTRY *b)
+{
+    return memcmp(a->key, b->key, sizeof(a->key));
+}
+
+static void vcache_entry_free(X509_VCACHE_ENTRY *e)
+{
+    sk_X509_pop_free(e->chain, X509_free);
+    OPENSSL_free(e->peername);
+    OPENSSL_free(e);
+}
+
+static void vcache_unlink(X509_VERIFY_CACHE *cache, X509_VCACHE_ENTRY *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        cache->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void vcache_push(X509_VERIFY_CACHE *cache, X509_VCACHE_ENTRY *e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head != NULL)
+        cache->head->prev = e;
+    else
+        cache->tail = e;
+    cache->head = e;
+}
+
+/* Must be called with the cache lock held */
+static void vcache_remove(X509_VERIFY_CACHE *cache, X509_VCACHE_ENTRY *e)
+{
+    (void)lh_X509_VCACHE_ENTRY_delete(cache->entries, e);
+    vcache_unlink(cache, e);
+    cache->num--;
+    vcache_entry_free(e);
+}
+
+/* Must be called with the cache lock held */
+static void vcache_flush(X509_VERIFY_CACHE *cache)
+{
+    while (cache->head != NULL)
+        vcache_remove(cache, cache->head);
+}
+
+static X509_VERIFY_CACHE *x509_verify_cache_new(size_t max)
+{
+    X509_VERIFY_CACHE *cache = OPENSSL_zalloc(sizeof(*cache));
+
+    if (cache == NULL
+        || (cache->lock = CRYPTO_THREAD_lock_new()) == NULL
+        || (cache->entries = lh_X509_VCACHE_ENTRY_new(vcache_entry_hash,
+                                                      vcache_entry_cmp))
+           == NULL) {
+        x509_verify_cache_free(cache);
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    cache->max = max;
+    return cache;
+}
+
+void x509_verify_cache_free(X509_VERIFY_CACHE *cache)
+{
+    if (cache == NULL)
+        return;
+    if (cache->entries != NULL)
+        vcache_flush(cache);
+    lh_X509_VCACHE_ENTRY_free(cache->entries);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+/*
+ * Each field is prefixed with its length so that adjacent fields can't be
+ * confused with each other.
+ */
+static int vcache_hash_bytes(EVP_MD_CTX *md, const void *data, size_t len)
+{
+    return EVP_DigestUpdate(md, &len, sizeof(len))
+           && (len == 0 || EVP_DigestUpdate(md, data, len));
+}
+
+static int vcache_hash_long(EVP_MD_CTX *md, long v)
+{
+    return vcache_hash_bytes(md, &v, sizeof(v));
+}
+
+static int vcache_hash_cert(EVP_MD_CTX *md, const X509 *x)
+{
+    unsigned char dgst[SHA256_DIGEST_LENGTH];
+    unsigned int len;
+
+    return X509_digest(x, EVP_sha256(), dgst, &len)
+           && vcache_hash_bytes(md, dgst, len);
+}
+
+static int vcache_hash_crl(EVP_MD_CTX *md, const X509_CRL *crl)
+{
+    unsigned char dgst[SHA256_DIGEST_LENGTH];
+    unsigned int len;
+
+    return X509_CRL_digest(crl, EVP_sha256(), dgst, &len)
+           && vcache_hash_bytes(md, dgst, len);
+}
+
+static int vcache_hash_param(EVP_MD_CTX *md, const X509_VERIFY_PARAM *param)
+{
+    int i;
+
+    if (!vcache_hash_long(md, (long)param->flags)
+        || !vcache_hash_long(md, param->purpose)
+        || !vcache_hash_long(md, param->trust)
+        || !vcache_hash_long(md, param->depth)
+        || !vcache_hash_long(md, param->auth_level)
+        || !vcache_hash_long(md, param->hostflags))
+        return 0;
+    if ((param->flags & X509_V_FLAG_USE_CHECK_TIME) != 0
+        && !vcache_hash_long(md, (long)param->check_time))
+        return 0;
+
+    if (!vcache_hash_long(md, sk_ASN1_OBJECT_num(param->policies)))
+        return 0;
+    for (i = 0; i < sk_ASN1_OBJECT_num(param->policies); i++) {
+        const ASN1_OBJECT *obj = sk_ASN1_OBJECT_value(param->policies, i);
+
+        if (!vcache_hash_bytes(md, OBJ_get0_data(obj), OBJ_length(obj)))
+            return 0;
+    }
+
+    if (!vcache_hash_long(md, sk_OPENSSL_STRING_num(param->hosts)))
+        return 0;
+    for (i = 0; i < sk_OPENSSL_STRING_num(param->hosts); i++) {
+        const char *host = sk_OPENSSL_STRING_value(param->hosts, i);
+
+        if (!vcache_hash_bytes(md, host, strlen(host)))
+            return 0;
+    }
+
+    return vcache_hash_bytes(md, param->email,
+                             param->email != NULL ? param->emaillen : 0)
+           && vcache_hash_bytes(md, param->ip,
+                                param->ip != NULL ? param->iplen : 0);
+}
+
+static int vcache_key(X509_STORE_CTX *ctx, unsigned char *key)
+{
+    EVP_MD_CTX *md = EVP_MD_CTX_new();
+    int i, ret = 0;
+
+    if (md == NULL || !EVP_DigestInit_ex(md, EVP_sha256(), NULL)
+        || !vcache_hash_cert(md, ctx->cert)
+        || !vcache_hash_long(md, sk_X509_num(ctx->untrusted)))
+        goto end;
+    for (i = 0; i < sk_X509_num(ctx->untrusted); i++)
+        if (!vcache_hash_cert(md, sk_X509_value(ctx->untrusted, i)))
+            goto end;
+    if (!vcache_hash_long(md, sk_X509_CRL_num(ctx->crls)))
+        goto end;
+    for (i = 0; i < sk_X509_CRL_num(ctx->crls); i++)
+        if (!vcache_hash_crl(md, sk_X509_CRL_value(ctx->crls, i)))
+            goto end;
+    ret = vcache_hash_param(md, ctx->param)
+          && EVP_DigestFinal_ex(md, key, NULL);
+ end:
+    EVP_MD_CTX_free(md);
+    return ret;
+}
+
+/*
+ * Look up the result of verifying |ctx| in the store cache.  On a hit the
+ * verified chain is installed in |ctx| and 1 is returned.  Otherwise the
+ * cache key is left in |ctx| for x509_verify_cache_add() to use, provided
+ * it could be computed, and 0 is returned.
+ */
+int x509_verify_cache_lookup(X509_STORE_CTX *ctx)
+{
+    X509_VERIFY_CACHE *cache = ctx->store->vcache;
+    X509_VCACHE_ENTRY tmp, *e;
+    STACK_OF(X509) *chain = NULL;
+    char *peername = NULL;
+    int i, num_untrusted = 0, ret = 0;
+
+    ctx->vcache = 0;
+    ctx->vcache_expires = 0;
+    if (!vcache_key(ctx, ctx->vcache_key)) {
+        ERR_clear_error();
+        return 0;
+    }
+    X509_STORE_lock(ctx->store);
+    ctx->vcache_generation = ctx->store->generation;
+    X509_STORE_unlock(ctx->store);
+    ctx->vcache = 1;
+
+    memcpy(tmp.key, ctx->vcache_key, sizeof(tmp.key));
+    CRYPTO_THREAD_write_lock(cache->lock);
+    e = lh_X509_VCACHE_ENTRY_retrieve(cache->entries, &tmp);
+    if (e != NULL
+        && (e->generation != ctx->vcache_generation
+            || (e->expires != 0 && e->expires <= time(NULL)))) {
+        vcache_remove(cache, e);
+        e = NULL;
+    }
+    if (e != NULL
+        && (chain = sk_X509_new_reserve(NULL, sk_X509_num(e->chain))) != NULL
+        && (e->peername == NULL
+            || (peername = OPENSSL_strdup(e->peername)) != NULL)) {
+        /* The target is always the caller's, the rest comes from the entry */
+        X509_up_ref(ctx->cert);
+        sk_X509_push(chain, ctx->cert);
+        for (i = 1; i < sk_X509_num(e->chain); i++) {
+            X509 *x = sk_X509_value(e->chain, i);
+
+            X509_up_ref(x);
+            sk_X509_push(chain, x);
+        }
+        num_untrusted = e->num_untrusted;
+        vcache_unlink(cache, e);
+        vcache_push(cache, e);
+        cache->hits++;
+        ret = 1;
+    } else {
+        cache->misses++;
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+
+    if (!ret) {
+        sk_X509_free(chain);
+        return 0;
+    }
+    ctx->chain = chain;
+    ctx->num_untrusted = num_untrusted;
+    ctx->error = X509_V_OK;
+    ctx->error_depth = 0;
+    ctx->current_cert = ctx->cert;
+    if (peername != NULL) {
+        OPENSSL_free(ctx->param->peername);
+        ctx->param->peername = peername;
+    }
+    return 1;
+}
+
+/* Shorten the lifetime of the result being built in |ctx| to |t| */
+void x509_verify_cache_limit(X509_STORE_CTX *ctx, const ASN1_TIME *t)
+{
+    int days, secs;
+    time_t when;
+
+    if (!ctx->vcache || t == NULL
+        || (ctx->param->flags & (X509_V_FLAG_USE_CHECK_TIME
+                                 | X509_V_FLAG_NO_CHECK_TIME)) != 0)
+        return;
+    if (!ASN1_TIME_diff(&days, &secs, NULL, t)) {
+        ERR_clear_error();
+        ctx->vcache = 0;
+        return;
+    }
+    when = time(NULL) + (time_t)days * 86400 + secs;
+    if (ctx->vcache_expires == 0 || when < ctx->vcache_expires)
+        ctx->vcache_expires = when;
+}
+
+/* Remember the successful verification in |ctx| */
+void x509_verify_cache_add(X509_STORE_CTX *ctx)
+{
+    X509_VERIFY_CACHE *cache = ctx->store->vcache;
+    X509_VCACHE_ENTRY *e, *old;
+    int i;
+
+    for (i = 0; i < sk_X509_num(ctx->chain); i++)
+        x509_verify_cache_limit(ctx, X509_get0_notAfter(sk_X509_value(ctx->chain,
+                                                                      i)));
+    if (!ctx->vcache
+        || (ctx->vcache_expires != 0 && ctx->vcache_expires <= time(NULL)))
+        return;
+
+    if ((e = OPENSSL_zalloc(sizeof(*e))) == NULL
+        || (e->chain = X509_chain_up_ref(ctx->chain)) == NULL
+        || (ctx->param->peername != NULL
+            && (e->peername = OPENSSL_strdup(ctx->param->peername)) == NULL)) {
+        if (e != NULL)
+            vcache_entry_free(e);
+        ERR_clear_error();
+        return;
+    }
+    memcpy(e->key, ctx->vcache_key, sizeof(e->key));
+    e->generation = ctx->vcache_generation;
+    e->expires = ctx->vcache_expires;
+    e->num_untrusted = ctx->num_untrusted;
+
+    CRYPTO_THREAD_write_lock(cache->lock);
+    if ((old = lh_X509_VCACHE_ENTRY_retrieve(cache->entries, e)) != NULL)
+        vcache_remove(cache, old);
+    if (cache->num >= cache->max)
+        vcache_remove(cache, cache->tail);
+    (void)lh_X509_VCACHE_ENTRY_insert(cache->entries, e);
+    if (lh_X509_VCACHE_ENTRY_error(cache->entries)) {
+        vcache_entry_free(e);
+    } else {
+        vcache_push(cache, e);
+        cache->num++;
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+int X509_STORE_set_verify_cache_size(X509_STORE *ctx, size_t size)
+{
+    X509_VERIFY_CACHE *cache = NULL;
+
+    if (size > 0 && (cache = x509_verify_cache_new(size)) == NULL)
+        return 0;
+    x509_verify_cache_free(ctx->vcache);
+    ctx->vcache = cache;
+    return 1;
+}
+
+void X509_STORE_flush_verify_cache(X509_STORE *ctx)
+{
+    X509_VERIFY_CACHE *cache = ctx->vcache;
+
+    if (cache == NULL)
+        return;
+    CRYPTO_THREAD_write_lock(cache->lock);
+    vcache_flush(cache);
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+int X509_STORE_get_verify_cache_stats(X509_STORE *ctx, uint64_t *hits,
+                                      uint64_t *misses)
+{
+    X509_VERIFY_CACHE *cache = ctx->vcache;
+
+    if (cache == NULL) {
+        *hits = *misses = 0;
+        return 0;
+    }
+    CRYPTO_THREAD_read_lock(cache->lock);
+    *hits = cache->hits;
+    *misses = cache->misses;
+    CRYPTO_THREAD_unlock(cache->lock);
+    return 1;
+}
@@ -92,6 +92,8 @@ static void crl_akid_check(X509_STORE_CTX *ctx, X509_CRL *crl, X509 **pissuer,
                            int *pcrl_score);
 static int crl_crldp_check(X509 *x, X509_CRL *crl, int crl_score,
                            unsigned int *preasons);
+static int check_crl(X509_STORE_CTX *ctx, X509_CRL *crl);
+static int cert_crl(X509_STORE_CTX *ctx, X509_CRL *crl, X509 *x);
 static int check_crl_path(X509_STORE_CTX *ctx, X509 *x);
 static int check_crl_chain(X509_STORE_CTX *ctx,
                            STACK_OF(X509) *cert_path,
@@ -250,6 +252,32 @@ static int verify_chain(X509_STORE_CTX *ctx)
     return ok;
 }
 
+/*
+ * Results may only be served from the store's verified chain cache when
+ * nothing outside the cache key can observe or change the outcome: there's
+ * no callback that expects to see every certificate, every other hook is
+ * the library's own (which also rules out caller supplied trust anchors),
+ * there's no DANE and no policy tree for the caller to inspect.
+ */
+static int verify_cacheable(X509_STORE_CTX *ctx)
+{
+    return ctx->store != NULL && ctx->store->vcache != NULL
+           && ctx->parent == NULL
+           && ctx->verify_cb == null_callback
+           && ctx->verify == internal_verify
+           && ctx->get_issuer == X509_STORE_CTX_get1_issuer
+           && ctx->check_issued == check_issued
+           && ctx->check_revocation == check_revocation
+           && ctx->get_crl == NULL
+           && ctx->check_crl == check_crl
+           && ctx->cert_crl == cert_crl
+           && ctx->check_policy == check_policy
+           && ctx->lookup_certs == X509_STORE_CTX_get1_certs
+           && ctx->lookup_crls == X509_STORE_CTX_get1_crls
+           && !DANETLS_ENABLED(ctx->dane)
+           && (ctx->param->flags & X509_V_FLAG_POLICY_CHECK) == 0;
+}
+
 int X509_verify_cert(X509_STORE_CTX *ctx)
 {
     SSL_DANE *dane = ctx->dane;
@@ -271,6 +299,10 @@ int X509_verify_cert(X509_STORE_CTX *ctx)
         return -1;
     }
 
+    ctx->vcache = 0;
+    if (verify_cacheable(ctx) && x509_verify_cache_lookup(ctx))
+        return 1;
+
     /*
      * first we make sure the chain we are going to build is present and that
      * the first entry is in place
@@ -294,6 +326,9 @@ int X509_verify_cert(X509_STORE_CTX *ctx)
     else
         ret = verify_chain(ctx);
 
+    if (ret > 0 && ctx->vcache && ctx->error == X509_V_OK)
+        x509_verify_cache_add(ctx);
+
     /*
      * Safety-net.  If we are returning an error, we must also set ctx->error,
      * so that the chain is not considered verified should the error be ignored
@@ -905,8 +940,12 @@ static int check_cert(X509_STORE_CTX *ctx)
             ok = ctx->cert_crl(ctx, dcrl, x);
             if (!ok)
                 goto done;
-        } else
+            /* A valid delta CRL overrides the expiry of the base CRL */
+            x509_verify_cache_limit(ctx, X509_CRL_get0_nextUpdate(dcrl));
+        } else {
             ok = 1;
+            x509_verify_cache_limit(ctx, X509_CRL_get0_nextUpdate(crl));
+        }
 
         /* Don't look in full CRL if delta reason is removefromCRL */
         if (ok != 2) {
@@ -1697,6 +1736,18 @@ int x509_check_cert_time(X509_STORE_CTX *ctx, X509 *x, int depth)
     return 1;
 }
 
+/*
+ * The leaf is rarely seen again, so only issuer certificates are looked up
+ * in the store's signature memo, if there is one.
+ */
+static int verify_signature(X509_STORE_CTX *ctx, X509 *x, EVP_PKEY *pkey,
+                            int depth)
+{
+    if (depth > 0 && ctx->store != NULL && ctx->store->sigmemo != NULL)
+        return x509_sig_memo_verify(ctx->store->sigmemo, x, pkey);
+    return X509_verify(x, pkey);
+}
+
 static int internal_verify(X509_STORE_CTX *ctx)
 {
     int n = sk_X509_num(ctx->chain) - 1;
@@ -1747,7 +1798,7 @@ static int internal_verify(X509_STORE_CTX *ctx)
                 if (!verify_cb_cert(ctx, xi, xi != xs ? n+1 : n,
                         X509_V_ERR_UNABLE_TO_DECODE_ISSUER_PUBLIC_KEY))
                     return 0;
-            } else if (X509_verify(xs, pkey) <= 0) {
+            } else if (verify_signature(ctx, xs, pkey, n) <= 0) {
                 if (!verify_cb_cert(ctx, xs, n,
                                     X509_V_ERR_CERT_SIGNATURE_FAILURE))
                     return 0;
@@ -2225,6 +2276,8 @@ int X509_STORE_CTX_init(X509_STORE_CTX *ctx, X509_STORE *store, X509 *x509,
     ctx->parent = NULL;
     ctx->dane = NULL;
     ctx->bare_ta_signed = 0;
+    ctx->vcache = 0;
+    ctx->vcache_expires = 0;
     /* Zero ex_data to make sure we're cleanup-safe */
     memset(&ctx->ex_data, 0, sizeof(ctx->ex_data));
 
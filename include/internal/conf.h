@@ -21,6 +21,7 @@ struct ossl_init_settings_st {
     char *filename;
     char *appname;
     unsigned long flags;
+    unsigned int pool_threads;
 };
 
 int openssl_config_int(const OPENSSL_INIT_SETTINGS *);
@@ -51,6 +51,15 @@ void *ossl_method_construct(OPENSSL_CTX *ctx, int operation_id,
                             int force_cache,
                             OSSL_METHOD_CONSTRUCT_METHOD *mcm, void *mcm_data);
 
+/*
+ * A counter that changes whenever something happens that may change what
+ * a method fetch finds, such as a provider being activated or deactivated,
+ * or the default properties being changed.  It can be used to invalidate
+ * caches of fetched methods held outside of the method stores.
+ */
+unsigned int ossl_method_generation(void);
+void ossl_method_generation_bump(void);
+
 void ossl_algorithm_do_all(OPENSSL_CTX *libctx, int operation_id,
                            OSSL_PROVIDER *provider,
                            void (*fn)(OSSL_PROVIDER *provider,
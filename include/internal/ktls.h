@@ -36,6 +36,8 @@
 
 #    define TLS_SET_RECORD_TYPE     1
 
+#    define OPENSSL_KTLS_AES_GCM_128
+
 struct tls_crypto_info {
     unsigned short version;
     unsigned short cipher_type;
@@ -55,9 +57,8 @@ static ossl_inline int ktls_enable(int fd)
     return 0;
 }
 
-static ossl_inline int ktls_start(int fd,
-                                  struct tls12_crypto_info_aes_gcm_128
-                                  *crypto_info, size_t len, int is_tx)
+static ossl_inline int ktls_start(int fd, void *crypto_info, size_t len,
+                                  int is_tx)
 {
     return 0;
 }
@@ -100,6 +101,22 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off, size_t s
 #     define TLS_RX                  2
 #    endif
 
+/*
+ * The ciphers supported by the kernel depend on the version of the kernel
+ * headers. TLSv1.3 record protection is available from Linux 5.2 onwards.
+ */
+#    define OPENSSL_KTLS_AES_GCM_128
+#    if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 1, 0)
+#     define OPENSSL_KTLS_AES_GCM_256
+#    endif
+#    if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+#     define OPENSSL_KTLS_AES_CCM_128
+#     define OPENSSL_KTLS_TLS13
+#    endif
+#    if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+#     define OPENSSL_KTLS_CHACHA20_POLY1305
+#    endif
+
 /*
  * When successful, this socket option doesn't change the behaviour of the
  * TCP socket, except changing the TCP setsockopt handler to enable the
@@ -119,12 +136,11 @@ static ossl_inline int ktls_enable(int fd)
  * If successful, then data received using this socket will be decrypted,
  * authenticated and decapsulated using the crypto_info provided here.
  */
-static ossl_inline int ktls_start(int fd,
-                                  struct tls12_crypto_info_aes_gcm_128
-                                  *crypto_info, size_t len, int is_tx)
+static ossl_inline int ktls_start(int fd, void *crypto_info, size_t len,
+                                  int is_tx)
 {
     return setsockopt(fd, SOL_TLS, is_tx ? TLS_TX : TLS_RX,
-                      crypto_info, sizeof(*crypto_info)) ? 0 : 1;
+                      crypto_info, len) ? 0 : 1;
 }
 
 /*
@@ -207,6 +223,7 @@ static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
     unsigned char *p = data;
     const size_t prepend_length = SSL3_RT_HEADER_LENGTH;
 
+    /* All the ciphers supported by the kernel use a 16 byte tag */
     if (length < prepend_length + EVP_GCM_TLS_TAG_LEN) {
         errno = EINVAL;
         return -1;
@@ -243,6 +260,56 @@ static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
 
 #    endif
 #   endif
+
+/*
+ * The key material handed to the kernel. The common |info| header selects
+ * which of the cipher specific structures is in use.
+ */
+union tls_crypto_info_all {
+    struct tls_crypto_info info;
+#   ifdef OPENSSL_KTLS_AES_GCM_128
+    struct tls12_crypto_info_aes_gcm_128 gcm128;
+#   endif
+#   ifdef OPENSSL_KTLS_AES_GCM_256
+    struct tls12_crypto_info_aes_gcm_256 gcm256;
+#   endif
+#   ifdef OPENSSL_KTLS_AES_CCM_128
+    struct tls12_crypto_info_aes_ccm_128 ccm128;
+#   endif
+#   ifdef OPENSSL_KTLS_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305 chacha20poly1305;
+#   endif
+};
+
+/*
+ * The kernel insists on getting exactly the size of the structure for the
+ * cipher, so work it out from the cipher type. Returns 0 for unknown ciphers.
+ */
+static ossl_inline size_t
+ktls_crypto_info_len(const union tls_crypto_info_all *crypto_info)
+{
+    switch (crypto_info->info.cipher_type) {
+#   ifdef OPENSSL_KTLS_AES_GCM_128
+    case TLS_CIPHER_AES_GCM_128:
+        return sizeof(crypto_info->gcm128);
+#   endif
+#   ifdef OPENSSL_KTLS_AES_GCM_256
+    case TLS_CIPHER_AES_GCM_256:
+        return sizeof(crypto_info->gcm256);
+#   endif
+#   ifdef OPENSSL_KTLS_AES_CCM_128
+    case TLS_CIPHER_AES_CCM_128:
+        return sizeof(crypto_info->ccm128);
+#   endif
+#   ifdef OPENSSL_KTLS_CHACHA20_POLY1305
+    case TLS_CIPHER_CHACHA20_POLY1305:
+        return sizeof(crypto_info->chacha20poly1305);
+#   endif
+    default:
+        return 0;
+    }
+}
+
 #  endif
 # endif
 #endif
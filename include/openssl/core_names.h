@@ -65,6 +65,9 @@ extern "C" {
 #define OSSL_CIPHER_PARAM_AEAD_TLS1_IV_FIXED "tlsivfixed" /* octet_string */
 #define OSSL_CIPHER_PARAM_AEAD_IVLEN OSSL_CIPHER_PARAM_IVLEN
 #define OSSL_CIPHER_PARAM_RANDOM_KEY         "randkey"    /* octet_string */
+#define OSSL_CIPHER_PARAM_THREADS   "threads"    /* uint */
+#define OSSL_CIPHER_PARAM_XTS_SECTOR_SIZE "xts-sector-size" /* size_t */
+#define OSSL_CIPHER_PARAM_XTS_SECTOR      "xts-sector"      /* uint64 */
 
 /* digest parameters */
 #define OSSL_DIGEST_PARAM_XOFLEN     "xoflen"    /* size_t */
@@ -74,6 +77,7 @@ extern "C" {
 #define OSSL_DIGEST_PARAM_BLOCK_SIZE "blocksize" /* size_t */
 #define OSSL_DIGEST_PARAM_SIZE       "size"      /* size_t */
 #define OSSL_DIGEST_PARAM_FLAGS      "flags"     /* ulong */
+#define OSSL_DIGEST_PARAM_THREADS    "threads"   /* uint */
 
 /* Known DIGEST names (not a complete list) */
 #define OSSL_DIGEST_NAME_KECCAK_KMAC128 "KECCAK_KMAC128"
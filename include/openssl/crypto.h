@@ -406,7 +406,7 @@ int CRYPTO_memcmp(const void * in_a, const void * in_b, size_t len);
 /* OPENSSL_INIT_BASE_ONLY                    0x00040000L */
 # define OPENSSL_INIT_NO_ATEXIT              0x00080000L
 /* OPENSSL_INIT flag range 0x03f00000 reserved for OPENSSL_init_ssl() */
-/* FREE: 0x04000000L */
+# define OPENSSL_INIT_THREAD_POOL            0x04000000L
 /* FREE: 0x08000000L */
 /* FREE: 0x10000000L */
 /* FREE: 0x20000000L */
@@ -438,6 +438,8 @@ void OPENSSL_INIT_set_config_file_flags(OPENSSL_INIT_SETTINGS *settings,
 int OPENSSL_INIT_set_config_appname(OPENSSL_INIT_SETTINGS *settings,
                                     const char *config_appname);
 # endif
+void OPENSSL_INIT_set_thread_pool_size(OPENSSL_INIT_SETTINGS *settings,
+                                       unsigned int threads);
 void OPENSSL_INIT_free(OPENSSL_INIT_SETTINGS *settings);
 
 # if defined(OPENSSL_THREADS) && !defined(CRYPTO_TDEBUG)
@@ -78,6 +78,11 @@ const EC_METHOD *EC_GFp_nistp224_method(void);
  */
 const EC_METHOD *EC_GFp_nistp256_method(void);
 
+/** Returns 64-bit optimized methods for nistp384
+ *  \return  EC_METHOD object
+ */
+const EC_METHOD *EC_GFp_nistp384_method(void);
+
 /** Returns 64-bit optimized methods for nistp521
  *  \return  EC_METHOD object
  */
@@ -72,6 +72,7 @@ extern "C" {
 #endif
 
 int EVP_set_default_properties(OPENSSL_CTX *libctx, const char *propq);
+int EVP_set_thread_fetch_cache(OPENSSL_CTX *libctx, int enable);
 
 # define EVP_PKEY_MO_SIGN        0x0001
 # define EVP_PKEY_MO_VERIFY      0x0002
@@ -145,6 +146,7 @@ int (*EVP_MD_meth_get_ctrl(const EVP_MD *md))(EVP_MD_CTX *ctx, int cmd,
 #  define EVP_MD_CTRL_DIGALGID                    0x1
 #  define EVP_MD_CTRL_MICALG                      0x2
 #  define EVP_MD_CTRL_XOF_LEN                     0x3
+#  define EVP_MD_CTRL_SET_THREADS                 0x4
 
 /* Minimum Algorithm specific ctrl value */
 
@@ -363,6 +365,8 @@ int (*EVP_CIPHER_meth_get_ctrl(const EVP_CIPHER *cipher))(EVP_CIPHER_CTX *,
 # define         EVP_CTRL_GET_IV                         0x26
 /* Tell the cipher it's doing a speed test (SIV disallows multiple ops) */
 # define         EVP_CTRL_SET_SPEED                      0x27
+/* Set the number of threads large operations may be spread over */
+# define         EVP_CTRL_SET_THREADS                    0x28
 
 /* Padding modes */
 #define EVP_PADDING_PKCS7       1
@@ -575,6 +579,9 @@ __owur int EVP_DigestFinal_ex(EVP_MD_CTX *ctx, unsigned char *md,
 __owur int EVP_Digest(const void *data, size_t count,
                           unsigned char *md, unsigned int *size,
                           const EVP_MD *type, ENGINE *impl);
+__owur int EVP_DigestBatch(const unsigned char *const data[],
+                           const size_t count[], size_t n, unsigned char *md,
+                           const EVP_MD *type);
 
 __owur int EVP_MD_CTX_copy(EVP_MD_CTX *out, const EVP_MD_CTX *in);
 __owur int EVP_DigestInit(EVP_MD_CTX *ctx, const EVP_MD *type);
@@ -737,6 +744,11 @@ const EVP_MD *EVP_md5_sha1(void);
 # ifndef OPENSSL_NO_BLAKE2
 const EVP_MD *EVP_blake2b512(void);
 const EVP_MD *EVP_blake2s256(void);
+const EVP_MD *EVP_blake2bp512(void);
+const EVP_MD *EVP_blake2sp256(void);
+# endif
+# ifndef OPENSSL_NO_BLAKE3
+const EVP_MD *EVP_blake3(void);
 # endif
 const EVP_MD *EVP_sha1(void);
 const EVP_MD *EVP_sha224(void);
@@ -1484,6 +1496,11 @@ int EVP_PKEY_verify_init(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_verify(EVP_PKEY_CTX *ctx,
                     const unsigned char *sig, size_t siglen,
                     const unsigned char *tbs, size_t tbslen);
+int EVP_PKEY_verify_batch(EVP_PKEY *const pkey[],
+                          const unsigned char *const sig[],
+                          const size_t siglen[],
+                          const unsigned char *const tbs[],
+                          const size_t tbslen[], size_t n, int status[]);
 int EVP_PKEY_verify_recover_init_ex(EVP_PKEY_CTX *ctx, EVP_SIGNATURE *signature);
 int EVP_PKEY_verify_recover_init(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_verify_recover(EVP_PKEY_CTX *ctx,
@@ -1502,6 +1519,9 @@ int EVP_PKEY_derive_init_ex(EVP_PKEY_CTX *ctx, EVP_KEYEXCH *exchange);
 int EVP_PKEY_derive_init(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_derive_set_peer(EVP_PKEY_CTX *ctx, EVP_PKEY *peer);
 int EVP_PKEY_derive(EVP_PKEY_CTX *ctx, unsigned char *key, size_t *keylen);
+int EVP_PKEY_derive_batch(EVP_PKEY *const pkey[], EVP_PKEY *const peer[],
+                          unsigned char *const key[], size_t keylen[],
+                          size_t n);
 
 typedef int EVP_PKEY_gen_cb(EVP_PKEY_CTX *ctx);
 
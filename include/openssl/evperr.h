@@ -131,6 +131,7 @@ int ERR_load_EVP_strings(void);
 #  define EVP_F_EVP_PKEY_VERIFY_RECOVER                    0
 #  define EVP_F_EVP_PKEY_VERIFY_RECOVER_INIT               0
 #  define EVP_F_EVP_SET_DEFAULT_PROPERTIES                 0
+#  define EVP_F_EVP_SET_THREAD_FETCH_CACHE                 0
 #  define EVP_F_EVP_SIGNFINAL                              0
 #  define EVP_F_EVP_VERIFYFINAL                            0
 #  define EVP_F_GMAC_CTRL                                  0
@@ -2143,6 +2143,18 @@
 #define NID_blake2s256          1057
 #define OBJ_blake2s256          OBJ_blake2smac,8L
 
+#define SN_blake2bp512          "BLAKE2bp512"
+#define LN_blake2bp512          "blake2bp512"
+#define NID_blake2bp512         1208
+
+#define SN_blake2sp256          "BLAKE2sp256"
+#define LN_blake2sp256          "blake2sp256"
+#define NID_blake2sp256         1209
+
+#define SN_blake3               "BLAKE3"
+#define LN_blake3               "blake3"
+#define NID_blake3              1210
+
 #define SN_sxnet                "SXNetID"
 #define LN_sxnet                "Strong Extranet ID"
 #define NID_sxnet               143
@@ -234,6 +234,12 @@ typedef struct srtp_protection_profile_st {
 
 DEFINE_STACK_OF(SRTP_PROTECTION_PROFILE)
 
+/* A buffer to be written by SSL_writev() */
+typedef struct ssl_iovec_st {
+    const void *buf;
+    size_t len;
+} SSL_IOVEC;
+
 typedef int (*tls_session_ticket_ext_cb_fn)(SSL *s, const unsigned char *data,
                                             int len, void *arg);
 typedef int (*tls_session_secret_cb_fn)(SSL *s, void *secret, int *secret_len,
@@ -695,6 +701,7 @@ typedef int (*GEN_SESSION_CB) (SSL *ssl, unsigned char *id,
 # define SSL_SESS_CACHE_NO_INTERNAL_STORE        0x0200
 # define SSL_SESS_CACHE_NO_INTERNAL \
         (SSL_SESS_CACHE_NO_INTERNAL_LOOKUP|SSL_SESS_CACHE_NO_INTERNAL_STORE)
+# define SSL_SESS_CACHE_SHARDED                  0x0400
 
 LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx);
 # define SSL_CTX_sess_number(ctx) \
@@ -1681,6 +1688,10 @@ void SSL_SESSION_free(SSL_SESSION *ses);
 __owur int i2d_SSL_SESSION(const SSL_SESSION *in, unsigned char **pp);
 __owur int SSL_set_session(SSL *to, SSL_SESSION *session);
 int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *session);
+# define SSL_SHARED_SESS_CACHE_SESS_SIZE_DEFAULT 4096
+__owur int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, const char *path,
+                                            size_t num_slots,
+                                            size_t sess_size);
 int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *session);
 __owur int SSL_CTX_set_generate_session_id(SSL_CTX *ctx, GEN_SESSION_CB cb);
 __owur int SSL_set_generate_session_id(SSL *s, GEN_SESSION_CB cb);
@@ -1863,6 +1874,8 @@ __owur ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size,
                                  int flags);
 __owur int SSL_write(SSL *ssl, const void *buf, int num);
 __owur int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written);
+__owur int SSL_writev(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                      size_t *written);
 __owur int SSL_write_early_data(SSL *s, const void *buf, size_t num,
                                 size_t *written);
 long SSL_ctrl(SSL *ssl, int cmd, long larg, void *parg);
@@ -2158,6 +2171,9 @@ int SSL_set_num_tickets(SSL *s, size_t num_tickets);
 size_t SSL_get_num_tickets(const SSL *s);
 int SSL_CTX_set_num_tickets(SSL_CTX *ctx, size_t num_tickets);
 size_t SSL_CTX_get_num_tickets(const SSL_CTX *ctx);
+__owur int SSL_CTX_set_ticket_key_rotation(SSL_CTX *ctx, long interval,
+                                           long grace);
+__owur int SSL_CTX_rotate_ticket_keys(SSL_CTX *ctx);
 
 # if !OPENSSL_API_1_1_0
 #  define SSL_cache_hit(s) SSL_session_reused(s)
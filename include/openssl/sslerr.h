@@ -116,9 +116,11 @@ int ERR_load_SSL_strings(void);
 #  define SSL_F_SSL3_OUTPUT_CERT_CHAIN                     0
 #  define SSL_F_SSL3_READ_BYTES                            0
 #  define SSL_F_SSL3_READ_N                                0
+#  define SSL_F_SSL3_SEAL_GATHER_RECORD                    0
 #  define SSL_F_SSL3_SETUP_KEY_BLOCK                       0
 #  define SSL_F_SSL3_SETUP_READ_BUFFER                     0
 #  define SSL_F_SSL3_SETUP_WRITE_BUFFER                    0
+#  define SSL_F_SSL3_WRITEV_BYTES                          0
 #  define SSL_F_SSL3_WRITE_BYTES                           0
 #  define SSL_F_SSL3_WRITE_PENDING                         0
 #  define SSL_F_SSL_ADD_CERT_CHAIN                         0
@@ -159,12 +161,15 @@ int ERR_load_SSL_strings(void);
 #  define SSL_F_SSL_CTX_ENABLE_CT                          0
 #  define SSL_F_SSL_CTX_MAKE_PROFILES                      0
 #  define SSL_F_SSL_CTX_NEW                                0
+#  define SSL_F_SSL_CTX_ROTATE_TICKET_KEYS                 0
 #  define SSL_F_SSL_CTX_SET_ALPN_PROTOS                    0
 #  define SSL_F_SSL_CTX_SET_CIPHER_LIST                    0
 #  define SSL_F_SSL_CTX_SET_CLIENT_CERT_ENGINE             0
 #  define SSL_F_SSL_CTX_SET_CT_VALIDATION_CALLBACK         0
 #  define SSL_F_SSL_CTX_SET_SESSION_ID_CONTEXT             0
+#  define SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE           0
 #  define SSL_F_SSL_CTX_SET_SSL_VERSION                    0
+#  define SSL_F_SSL_CTX_SET_TICKET_KEY_ROTATION            0
 #  define SSL_F_SSL_CTX_SET_TLSEXT_MAX_FRAGMENT_LENGTH     0
 #  define SSL_F_SSL_CTX_USE_CERTIFICATE                    0
 #  define SSL_F_SSL_CTX_USE_CERTIFICATE_ASN1               0
@@ -219,6 +224,7 @@ int ERR_load_SSL_strings(void);
 #  define SSL_F_SSL_SCAN_CLIENTHELLO_TLSEXT                0
 #  define SSL_F_SSL_SCAN_SERVERHELLO_TLSEXT                0
 #  define SSL_F_SSL_SENDFILE                               0
+#  define SSL_F_SSL_SESSION_CACHE_SET_SHARDED              0
 #  define SSL_F_SSL_SESSION_DUP                            0
 #  define SSL_F_SSL_SESSION_NEW                            0
 #  define SSL_F_SSL_SESSION_PRINT_FP                       0
@@ -256,6 +262,7 @@ int ERR_load_SSL_strings(void);
 #  define SSL_F_SSL_VERIFY_CERT_CHAIN                      0
 #  define SSL_F_SSL_VERIFY_CLIENT_POST_HANDSHAKE           0
 #  define SSL_F_SSL_WRITE                                  0
+#  define SSL_F_SSL_WRITEV                                 0
 #  define SSL_F_SSL_WRITE_EARLY_DATA                       0
 #  define SSL_F_SSL_WRITE_EARLY_FINISH                     0
 #  define SSL_F_SSL_WRITE_EX                               0
@@ -271,6 +278,7 @@ int ERR_load_SSL_strings(void);
 #  define SSL_F_TLS13_RESTORE_HANDSHAKE_DIGEST_FOR_PHA     0
 #  define SSL_F_TLS13_SAVE_HANDSHAKE_DIGEST_FOR_PHA        0
 #  define SSL_F_TLS13_SETUP_KEY_BLOCK                      0
+#  define SSL_F_TLS13_UPDATE_KEY                           0
 #  define SSL_F_TLS1_CHANGE_CIPHER_STATE                   0
 #  define SSL_F_TLS1_CHECK_DUPLICATE_EXTENSIONS            0
 #  define SSL_F_TLS1_ENC                                   0
@@ -584,6 +592,7 @@ int ERR_load_SSL_strings(void);
 # define SSL_R_INVALID_SRP_USERNAME                       357
 # define SSL_R_INVALID_STATUS_RESPONSE                    328
 # define SSL_R_INVALID_TICKET_KEYS_LENGTH                 325
+# define SSL_R_KTLS_REKEY_FAILED                          294
 # define SSL_R_LENGTH_MISMATCH                            159
 # define SSL_R_LENGTH_TOO_LONG                            404
 # define SSL_R_LENGTH_TOO_SHORT                           160
@@ -665,6 +674,8 @@ int ERR_load_SSL_strings(void);
 # define SSL_R_SCT_VERIFICATION_FAILED                    208
 # define SSL_R_SERVERHELLO_TLSEXT                         275
 # define SSL_R_SESSION_ID_CONTEXT_UNINITIALIZED           277
+# define SSL_R_SHARED_SESSION_CACHE_MISMATCH              295
+# define SSL_R_SHARED_SESSION_CACHE_NOT_SUPPORTED         296
 # define SSL_R_SHUTDOWN_WHILE_IN_INIT                     407
 # define SSL_R_SIGNATURE_ALGORITHMS_ERROR                 360
 # define SSL_R_SIGNATURE_FOR_NON_SIGNING_CERTIFICATE      220
@@ -702,6 +713,7 @@ int ERR_load_SSL_strings(void);
 # define SSL_R_SSL_SESSION_ID_TOO_LONG                    408
 # define SSL_R_SSL_SESSION_VERSION_MISMATCH               210
 # define SSL_R_STILL_IN_INIT                              121
+# define SSL_R_TICKET_KEY_ROTATION_NOT_ENABLED            297
 # define SSL_R_TLSV13_ALERT_CERTIFICATE_REQUIRED          1116
 # define SSL_R_TLSV13_ALERT_MISSING_EXTENSION             1109
 # define SSL_R_TLSV1_ALERT_ACCESS_DENIED                  1049
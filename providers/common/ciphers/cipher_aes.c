@@ -32,6 +32,9 @@ static void *aes_dupctx(void *ctx)
         return NULL;
     }
     *ret = *in;
+    /* The key schedule pointer must refer to our own copy */
+    if (in->base.ks != NULL)
+        ret->base.ks = &ret->ks.ks;
 
     return ret;
 }
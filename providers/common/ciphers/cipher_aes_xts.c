@@ -0,0 +1,436 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* Dispatch functions for AES XTS mode */
+
+#include "cipher_aes_xts.h"
+#include "internal/provider_algs.h"
+#include "internal/providercommonerr.h"
+#ifndef FIPS_MODE
+# include "internal/thread_pool.h"
+#endif
+
+#define AES_XTS_FLAGS (EVP_CIPH_FLAG_DEFAULT_ASN1 | EVP_CIPH_CUSTOM_IV         \
+                       | EVP_CIPH_ALWAYS_CALL_INIT | EVP_CIPH_CTRL_INIT        \
+                       | EVP_CIPH_CUSTOM_COPY)
+#define AES_XTS_IV_BITS 128
+#define AES_XTS_BLOCK_BITS 8
+
+#define AES_XTS_MAX_DATA_UNIT (XTS_MAX_BLOCKS_PER_DATA_UNIT * AES_BLOCK_SIZE)
+
+/*
+ * Using the same key for the data and the tweak is always banned when
+ * encrypting, but only banned for decryption in FIPS mode.
+ */
+#ifdef FIPS_MODE
+static const int allow_insecure_decrypt = 0;
+#else
+static const int allow_insecure_decrypt = 1;
+#endif
+
+static OSSL_OP_cipher_encrypt_init_fn aes_xts_einit;
+static OSSL_OP_cipher_decrypt_init_fn aes_xts_dinit;
+static OSSL_OP_cipher_update_fn aes_xts_stream_update;
+static OSSL_OP_cipher_final_fn aes_xts_stream_final;
+static OSSL_OP_cipher_cipher_fn aes_xts_cipher;
+static OSSL_OP_cipher_freectx_fn aes_xts_freectx;
+static OSSL_OP_cipher_dupctx_fn aes_xts_dupctx;
+static OSSL_OP_cipher_get_ctx_params_fn aes_xts_get_ctx_params;
+static OSSL_OP_cipher_set_ctx_params_fn aes_xts_set_ctx_params;
+static OSSL_OP_cipher_gettable_ctx_params_fn aes_xts_gettable_ctx_params;
+static OSSL_OP_cipher_settable_ctx_params_fn aes_xts_settable_ctx_params;
+
+/*
+ * Verify that the two keys are different.
+ *
+ * This addresses the vulnerability described in Rogaway's
+ * September 2004 paper:
+ *
+ *      "Efficient Instantiations of Tweakable Blockciphers and
+ *       Refinements to Modes OCB and PMAC".
+ *      (http://web.cs.ucdavis.edu/~rogaway/papers/offsets.pdf)
+ *
+ * FIPS 140-2 IG A.9 XTS-AES Key Generation Requirements states
+ * that:
+ *      "The check for Key_1 != Key_2 shall be done at any place
+ *       BEFORE using the keys in the XTS-AES algorithm to process
+ *       data with them."
+ */
+static int aes_xts_check_keys(const unsigned char *key, size_t bytes, int enc)
+{
+    if ((!allow_insecure_decrypt || enc)
+            && CRYPTO_memcmp(key, key + bytes, bytes) == 0) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_XTS_DUPLICATED_KEYS);
+        return 0;
+    }
+    return 1;
+}
+
+static int aes_xts_init(void *vctx, const unsigned char *key, size_t keylen,
+                        const unsigned char *iv, size_t ivlen, int enc)
+{
+    PROV_AES_XTS_CTX *xctx = (PROV_AES_XTS_CTX *)vctx;
+    PROV_CIPHER_CTX *ctx = &xctx->base;
+
+    ctx->enc = enc;
+
+    if (iv != NULL) {
+        if (ivlen != ctx->ivlen) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_IVLEN);
+            return 0;
+        }
+        memcpy(ctx->iv, iv, ivlen);
+    }
+    if (key != NULL) {
+        if (keylen != ctx->keylen) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_KEYLEN);
+            return 0;
+        }
+        if (!aes_xts_check_keys(key, keylen / 2, enc))
+            return 0;
+        return ctx->hw->init(ctx, key, keylen);
+    }
+    return 1;
+}
+
+static int aes_xts_einit(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen)
+{
+    return aes_xts_init(vctx, key, keylen, iv, ivlen, 1);
+}
+
+static int aes_xts_dinit(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen)
+{
+    return aes_xts_init(vctx, key, keylen, iv, ivlen, 0);
+}
+
+static void *aes_xts_newctx(void *provctx, unsigned int mode, size_t kbits,
+                            size_t blkbits, size_t ivbits)
+{
+    PROV_AES_XTS_CTX *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+    if (ctx != NULL)
+        cipher_generic_initkey(&ctx->base, kbits, blkbits, ivbits, mode,
+                               PROV_CIPHER_HW_aes_xts(kbits), NULL);
+    return ctx;
+}
+
+static void aes_xts_freectx(void *vctx)
+{
+    PROV_AES_XTS_CTX *ctx = (PROV_AES_XTS_CTX *)vctx;
+
+    OPENSSL_clear_free(ctx,  sizeof(*ctx));
+}
+
+static void *aes_xts_dupctx(void *vctx)
+{
+    PROV_AES_XTS_CTX *in = (PROV_AES_XTS_CTX *)vctx;
+    PROV_AES_XTS_CTX *ret = OPENSSL_malloc(sizeof(*ret));
+
+    if (ret == NULL) {
+        ERR_raise(ERR_LIB_PROV, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    *ret = *in;
+    /* The key schedule pointers must refer to our own copies */
+    if (in->xts.key1 != NULL)
+        ret->xts.key1 = &ret->ks1;
+    if (in->xts.key2 != NULL)
+        ret->xts.key2 = &ret->ks2;
+    return ret;
+}
+
+/* Encrypt or decrypt the single data unit |in| with the tweak |iv| */
+static void aes_xts_unit(PROV_AES_XTS_CTX *ctx, unsigned char *out,
+                         const unsigned char *in, size_t len,
+                         const unsigned char iv[16])
+{
+    if (ctx->stream != NULL)
+        (*ctx->stream)(in, out, len, ctx->xts.key1, ctx->xts.key2, iv);
+    else
+        CRYPTO_xts128_encrypt(&ctx->xts, iv, in, out, len, ctx->base.enc);
+}
+
+/*
+ * Process |n| consecutive sectors starting with sector number |sector|.
+ * As in IEEE Std 1619 the tweak of a sector is its number encoded as a
+ * little endian 128-bit value.
+ */
+static void aes_xts_sectors(PROV_AES_XTS_CTX *ctx, unsigned char *out,
+                            const unsigned char *in, uint64_t sector, size_t n)
+{
+    size_t size = ctx->sector_size;
+    unsigned char iv[16];
+    int i;
+
+    memset(iv, 0, sizeof(iv));
+    for (; n > 0; n--, sector++, in += size, out += size) {
+        for (i = 0; i < 8; i++)
+            iv[i] = (unsigned char)(sector >> (8 * i));
+        aes_xts_unit(ctx, out, in, size, iv);
+    }
+}
+
+#ifndef FIPS_MODE
+# define XTS_MT_MIN_SEGMENT  (64 * 1024)
+
+typedef struct {
+    PROV_AES_XTS_CTX *ctx;
+    unsigned char *out;
+    const unsigned char *in;
+    size_t sectors;
+    size_t nseg;
+} XTS_MT_JOB;
+
+/* Process segment |i| of the sectors of the job */
+static void aes_xts_mt_segment(void *arg, size_t i)
+{
+    const XTS_MT_JOB *job = arg;
+    size_t per = job->sectors / job->nseg, rem = job->sectors % job->nseg;
+    size_t first = i * per + (i < rem ? i : rem);
+    size_t off = first * job->ctx->sector_size;
+
+    aes_xts_sectors(job->ctx, job->out + off, job->in + off,
+                    job->ctx->sector + first, per + (i < rem));
+}
+#endif
+
+/*
+ * Every sector is independent of the others, so large batches are spread
+ * over the library's thread pool if the application allows it.
+ */
+static void aes_xts_batch(PROV_AES_XTS_CTX *ctx, unsigned char *out,
+                          const unsigned char *in, size_t len)
+{
+    size_t sectors = len / ctx->sector_size;
+#ifndef FIPS_MODE
+    size_t threads = ossl_thread_pool_size() + 1;
+    XTS_MT_JOB job;
+
+    job.nseg = len / XTS_MT_MIN_SEGMENT;
+    if (job.nseg > ctx->base.threads)
+        job.nseg = ctx->base.threads;
+    if (job.nseg > threads)
+        job.nseg = threads;
+    if (job.nseg > sectors)
+        job.nseg = sectors;
+    if (job.nseg > 1) {
+        job.ctx = ctx;
+        job.out = out;
+        job.in = in;
+        job.sectors = sectors;
+        ossl_thread_pool_run(aes_xts_mt_segment, &job, job.nseg);
+    } else
+#endif
+    {
+        aes_xts_sectors(ctx, out, in, ctx->sector, sectors);
+    }
+    ctx->sector += sectors;
+}
+
+static int aes_xts_cipher(void *vctx, unsigned char *out, size_t *outl,
+                          size_t outsize, const unsigned char *in, size_t inl)
+{
+    PROV_AES_XTS_CTX *ctx = (PROV_AES_XTS_CTX *)vctx;
+
+    if (ctx->xts.key1 == NULL || ctx->xts.key2 == NULL) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_NO_KEY_SET);
+        return 0;
+    }
+    if (out == NULL || in == NULL) {
+        ERR_raise(ERR_LIB_PROV, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+    if (outsize < inl) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+
+    if (ctx->sector_size != 0) {
+        if (inl % ctx->sector_size != 0) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_BAD_LENGTH);
+            return 0;
+        }
+        aes_xts_batch(ctx, out, in, inl);
+        *outl = inl;
+        return 1;
+    }
+
+    if (inl < AES_BLOCK_SIZE) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_BAD_LENGTH);
+        return 0;
+    }
+    /*
+     * Impose a limit of 2^20 blocks per data unit as specifed by
+     * IEEE Std 1619-2018.  The earlier and obsolete IEEE Std 1619-2007
+     * indicated that this was a SHOULD NOT rather than a MUST NOT.
+     * NIST SP 800-38E mandates the same limit.
+     */
+    if (inl > AES_XTS_MAX_DATA_UNIT) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_XTS_DATA_UNIT_IS_TOO_LARGE);
+        return 0;
+    }
+    aes_xts_unit(ctx, out, in, inl, ctx->base.iv);
+    *outl = inl;
+    return 1;
+}
+
+static int aes_xts_stream_update(void *vctx, unsigned char *out, size_t *outl,
+                                 size_t outsize, const unsigned char *in,
+                                 size_t inl)
+{
+    return aes_xts_cipher(vctx, out, outl, outsize, in, inl);
+}
+
+static int aes_xts_stream_final(void *vctx, unsigned char *out, size_t *outl,
+                                size_t outsize)
+{
+    *outl = 0;
+    return 1;
+}
+
+static const OSSL_PARAM aes_xts_known_gettable_ctx_params[] = {
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_IVLEN, NULL),
+    OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_IV, NULL, 0),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_XTS_SECTOR_SIZE, NULL),
+    OSSL_PARAM_uint64(OSSL_CIPHER_PARAM_XTS_SECTOR, NULL),
+    OSSL_PARAM_END
+};
+static const OSSL_PARAM *aes_xts_gettable_ctx_params(void)
+{
+    return aes_xts_known_gettable_ctx_params;
+}
+
+static int aes_xts_get_ctx_params(void *vctx, OSSL_PARAM params[])
+{
+    PROV_AES_XTS_CTX *ctx = (PROV_AES_XTS_CTX *)vctx;
+    OSSL_PARAM *p;
+
+    if (!cipher_generic_get_ctx_params(vctx, params))
+        return 0;
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_XTS_SECTOR_SIZE);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, ctx->sector_size)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_XTS_SECTOR);
+    if (p != NULL && !OSSL_PARAM_set_uint64(p, ctx->sector)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    return 1;
+}
+
+static const OSSL_PARAM aes_xts_known_settable_ctx_params[] = {
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
+    OSSL_PARAM_uint(OSSL_CIPHER_PARAM_THREADS, NULL),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_XTS_SECTOR_SIZE, NULL),
+    OSSL_PARAM_uint64(OSSL_CIPHER_PARAM_XTS_SECTOR, NULL),
+    OSSL_PARAM_END
+};
+static const OSSL_PARAM *aes_xts_settable_ctx_params(void)
+{
+    return aes_xts_known_settable_ctx_params;
+}
+
+static int aes_xts_set_ctx_params(void *vctx, const OSSL_PARAM params[])
+{
+    PROV_AES_XTS_CTX *ctx = (PROV_AES_XTS_CTX *)vctx;
+    const OSSL_PARAM *p;
+
+    /* The key length of XTS is fixed */
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL) {
+        size_t keylen;
+
+        if (!OSSL_PARAM_get_size_t(p, &keylen)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (keylen != ctx->base.keylen) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_KEYLEN);
+            return 0;
+        }
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_THREADS);
+    if (p != NULL) {
+        unsigned int threads;
+
+        if (!OSSL_PARAM_get_uint(p, &threads)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        ctx->base.threads = threads;
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_XTS_SECTOR_SIZE);
+    if (p != NULL) {
+        size_t sz;
+
+        if (!OSSL_PARAM_get_size_t(p, &sz)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (sz != 0 && (sz < AES_BLOCK_SIZE || sz > AES_XTS_MAX_DATA_UNIT)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_DATA_UNIT_SIZE);
+            return 0;
+        }
+        ctx->sector_size = sz;
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_XTS_SECTOR);
+    if (p != NULL && !OSSL_PARAM_get_uint64(p, &ctx->sector)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+        return 0;
+    }
+    return 1;
+}
+
+#define IMPLEMENT_cipher(lcmode, UCMODE, kbits, ivbits)                        \
+static OSSL_OP_cipher_get_params_fn aes_##kbits##_##lcmode##_get_params;       \
+static int aes_##kbits##_##lcmode##_get_params(OSSL_PARAM params[])            \
+{                                                                              \
+    return cipher_generic_get_params(params, EVP_CIPH_##UCMODE##_MODE,         \
+                                     AES_XTS_FLAGS, 2 * kbits,                 \
+                                     AES_XTS_BLOCK_BITS, ivbits);              \
+}                                                                              \
+static OSSL_OP_cipher_newctx_fn aes_##kbits##_xts_newctx;                      \
+static void *aes_##kbits##_xts_newctx(void *provctx)                           \
+{                                                                              \
+    return aes_xts_newctx(provctx, EVP_CIPH_##UCMODE##_MODE, 2 * kbits,        \
+                          AES_XTS_BLOCK_BITS, ivbits);                         \
+}                                                                              \
+const OSSL_DISPATCH aes##kbits##xts_functions[] = {                            \
+    { OSSL_FUNC_CIPHER_NEWCTX, (void (*)(void))aes_##kbits##_xts_newctx },     \
+    { OSSL_FUNC_CIPHER_ENCRYPT_INIT, (void (*)(void))aes_xts_einit },          \
+    { OSSL_FUNC_CIPHER_DECRYPT_INIT, (void (*)(void))aes_xts_dinit },          \
+    { OSSL_FUNC_CIPHER_UPDATE, (void (*)(void))aes_xts_stream_update },        \
+    { OSSL_FUNC_CIPHER_FINAL, (void (*)(void))aes_xts_stream_final },          \
+    { OSSL_FUNC_CIPHER_CIPHER, (void (*)(void))aes_xts_cipher },               \
+    { OSSL_FUNC_CIPHER_FREECTX, (void (*)(void))aes_xts_freectx },             \
+    { OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void))aes_xts_dupctx },               \
+    { OSSL_FUNC_CIPHER_GET_PARAMS,                                             \
+      (void (*)(void))aes_##kbits##_##lcmode##_get_params },                   \
+    { OSSL_FUNC_CIPHER_GETTABLE_PARAMS,                                        \
+      (void (*)(void))cipher_generic_gettable_params },                        \
+    { OSSL_FUNC_CIPHER_GET_CTX_PARAMS,                                         \
+      (void (*)(void))aes_xts_get_ctx_params },                                \
+    { OSSL_FUNC_CIPHER_GETTABLE_CTX_PARAMS,                                    \
+      (void (*)(void))aes_xts_gettable_ctx_params },                           \
+    { OSSL_FUNC_CIPHER_SET_CTX_PARAMS,                                         \
+      (void (*)(void))aes_xts_set_ctx_params },                                \
+    { OSSL_FUNC_CIPHER_SETTABLE_CTX_PARAMS,                                    \
+     (void (*)(void))aes_xts_settable_ctx_params },                            \
+    { 0, NULL }                                                                \
+}
+
+/* aes256xts_functions */
+IMPLEMENT_cipher(xts, XTS, 256, AES_XTS_IV_BITS);
+/* aes128xts_functions */
+IMPLEMENT_cipher(xts, XTS, 128, AES_XTS_IV_BITS);
@@ -8,6 +8,9 @@
  */
 
 #include "cipher_locl.h"
+#ifndef FIPS_MODE
+# include "internal/thread_pool.h"
+#endif
 
 /*-
  * The generic cipher functions for cipher modes cbc, ecb, ofb, cfb and ctr.
@@ -103,17 +106,111 @@ int cipher_hw_generic_cfb1(PROV_CIPHER_CTX *dat, unsigned char *out,
     return 1;
 }
 
+static void ctr_encrypt(PROV_CIPHER_CTX *dat, unsigned char *out,
+                        const unsigned char *in, size_t len,
+                        unsigned char ctr[16], unsigned char ecount[16],
+                        unsigned int *num)
+{
+    if (dat->stream.ctr)
+        CRYPTO_ctr128_encrypt_ctr32(in, out, len, dat->ks, ctr, ecount,
+                                    num, dat->stream.ctr);
+    else
+        CRYPTO_ctr128_encrypt(in, out, len, dat->ks, ctr, ecount,
+                              num, dat->block);
+}
+
+#ifndef FIPS_MODE
+/* The least amount of data worth handing to another thread */
+# define CTR_MT_MIN_SEGMENT  (64 * 1024)
+
+typedef struct {
+    PROV_CIPHER_CTX *dat;
+    unsigned char *out;
+    const unsigned char *in;
+    size_t blocks;
+    size_t nseg;
+} CTR_MT_JOB;
+
+/* Add |n| to the 128-bit big endian counter |ctr| */
+static void ctr128_add(unsigned char ctr[16], size_t n)
+{
+    unsigned int carry = 0;
+    int i;
+
+    for (i = 15; i >= 0 && (n != 0 || carry != 0); i--, n >>= 8) {
+        carry += ctr[i] + (unsigned int)(n & 0xff);
+        ctr[i] = (unsigned char)carry;
+        carry >>= 8;
+    }
+}
+
+/* Encrypt segment |i| of the whole blocks of the job with its own counter */
+static void ctr_mt_segment(void *arg, size_t i)
+{
+    const CTR_MT_JOB *job = arg;
+    size_t per = job->blocks / job->nseg, rem = job->blocks % job->nseg;
+    size_t first = i * per + (i < rem ? i : rem);
+    size_t len = (per + (i < rem)) * 16;
+    unsigned char ctr[16], ecount[16];
+    unsigned int num = 0;
+
+    memcpy(ctr, job->dat->iv, sizeof(ctr));
+    ctr128_add(ctr, first);
+    ctr_encrypt(job->dat, job->out + first * 16, job->in + first * 16, len,
+                ctr, ecount, &num);
+    OPENSSL_cleanse(ecount, sizeof(ecount));
+}
+
+/*
+ * Each block of CTR mode only depends on its counter value, so the whole
+ * blocks can be split into segments that are encrypted on different threads.
+ * A partially used block of key stream is finished first and a partial
+ * block at the end is done last, both by the calling thread, which leaves
+ * the context as if all the data had been encrypted in one go.
+ */
+static int ctr_mt(PROV_CIPHER_CTX *dat, unsigned char *out,
+                  const unsigned char *in, size_t len)
+{
+    unsigned int num = dat->num;
+    size_t head = num == 0 ? 0 : 16 - num;
+    size_t threads = ossl_thread_pool_size() + 1;
+    CTR_MT_JOB job;
+
+    ctr_encrypt(dat, out, in, head, dat->iv, dat->buf, &num);
+    out += head;
+    in += head;
+    len -= head;
+
+    job.dat = dat;
+    job.out = out;
+    job.in = in;
+    job.blocks = len / 16;
+    job.nseg = len / CTR_MT_MIN_SEGMENT;
+    if (job.nseg > dat->threads)
+        job.nseg = dat->threads;
+    if (job.nseg > threads)
+        job.nseg = threads;
+    ossl_thread_pool_run(ctr_mt_segment, &job, job.nseg);
+    ctr128_add(dat->iv, job.blocks);
+
+    ctr_encrypt(dat, out + job.blocks * 16, in + job.blocks * 16,
+                len - job.blocks * 16, dat->iv, dat->buf, &num);
+    dat->num = num;
+    return 1;
+}
+#endif
+
 int cipher_hw_generic_ctr(PROV_CIPHER_CTX *dat, unsigned char *out,
                           const unsigned char *in, size_t len)
 {
     unsigned int num = dat->num;
 
-    if (dat->stream.ctr)
-        CRYPTO_ctr128_encrypt_ctr32(in, out, len, dat->ks, dat->iv, dat->buf,
-                                    &num, dat->stream.ctr);
-    else
-        CRYPTO_ctr128_encrypt(in, out, len, dat->ks, dat->iv, dat->buf,
-                              &num, dat->block);
+#ifndef FIPS_MODE
+    if (dat->threads > 1 && len >= 2 * CTR_MT_MIN_SEGMENT
+            && ossl_thread_pool_size() > 0)
+        return ctr_mt(dat, out, in, len);
+#endif
+    ctr_encrypt(dat, out, in, len, dat->iv, dat->buf, &num);
     dat->num = num;
 
     return 1;
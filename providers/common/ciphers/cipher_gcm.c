@@ -196,6 +196,17 @@ int gcm_set_ctx_params(void *vctx, const OSSL_PARAM params[])
         }
     }
 
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_THREADS);
+    if (p != NULL) {
+        unsigned int threads;
+
+        if (!OSSL_PARAM_get_uint(p, &threads)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        ctx->threads = threads;
+    }
+
     /*
      * TODO(3.0) Temporary solution to address fuzz test crash, which will be
      * reworked once the discussion in PR #9510 is resolved. i.e- We need a
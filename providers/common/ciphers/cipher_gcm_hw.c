@@ -9,7 +9,12 @@
 
 #include "cipher_locl.h"
 #include "internal/ciphers/cipher_gcm.h"
+#ifndef FIPS_MODE
+# include "internal/thread_pool.h"
 
+/* The least amount of data worth handing to another thread */
+# define GCM_MT_MIN_SEGMENT  (64 * 1024)
+#endif
 
 int gcm_setiv(PROV_GCM_CTX *ctx, const unsigned char *iv, size_t ivlen)
 {
@@ -25,6 +30,20 @@ int gcm_aad_update(PROV_GCM_CTX *ctx, const unsigned char *aad, size_t aad_len)
 int gcm_cipher_update(PROV_GCM_CTX *ctx, const unsigned char *in,
                       size_t len, unsigned char *out)
 {
+#ifndef FIPS_MODE
+    if (ctx->threads > 1 && len >= 2 * GCM_MT_MIN_SEGMENT
+            && ossl_thread_pool_size() > 0) {
+        size_t nseg = len / GCM_MT_MIN_SEGMENT;
+
+        if (nseg > ctx->threads)
+            nseg = ctx->threads;
+        if (nseg > ossl_thread_pool_size() + 1)
+            nseg = ossl_thread_pool_size() + 1;
+        return CRYPTO_gcm128_crypt_mt(&ctx->gcm, in, out, len, ctx->ctr,
+                                      ctx->enc, nseg,
+                                      ossl_thread_pool_run) == 0;
+    }
+#endif
     if (ctx->enc) {
         if (ctx->ctr != NULL) {
 #if defined(AES_GCM_ASM)
@@ -35,9 +54,9 @@ int gcm_cipher_update(PROV_GCM_CTX *ctx, const unsigned char *in,
 
                 if (CRYPTO_gcm128_encrypt(&ctx->gcm, in, out, res))
                     return 0;
-                bulk = aesni_gcm_encrypt(in + res, out + res, len - res,
-                                         ctx->gcm.key,
-                                         ctx->gcm.Yi.c, ctx->gcm.Xi.u);
+                bulk = aesni_gcm_encrypt_bulk(in + res, out + res, len - res,
+                                              ctx->gcm.key,
+                                              ctx->gcm.Yi.c, ctx->gcm.Xi.u);
                 ctx->gcm.len.u[1] += bulk;
                 bulk += res;
             }
@@ -63,9 +82,9 @@ int gcm_cipher_update(PROV_GCM_CTX *ctx, const unsigned char *in,
                 if (CRYPTO_gcm128_decrypt(&ctx->gcm, in, out, res))
                     return -1;
 
-                bulk = aesni_gcm_decrypt(in + res, out + res, len - res,
-                                         ctx->gcm.key,
-                                         ctx->gcm.Yi.c, ctx->gcm.Xi.u);
+                bulk = aesni_gcm_decrypt_bulk(in + res, out + res, len - res,
+                                              ctx->gcm.key,
+                                              ctx->gcm.Yi.c, ctx->gcm.Xi.u);
                 ctx->gcm.len.u[1] += bulk;
                 bulk += res;
             }
@@ -53,6 +53,8 @@ struct prov_cipher_ctx_st {
      */
     unsigned int num;
     uint64_t flags;
+    /* Number of threads large operations may be spread over */
+    unsigned int threads;
 
     /* Buffer of partial blocks processed via update calls */
     unsigned char buf[GENERIC_BLOCK_SIZE];
@@ -91,6 +91,33 @@ PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_START(name, CTX, blksize, dgstsize, flags, \
 { OSSL_FUNC_DIGEST_SET_CTX_PARAMS, (void (*)(void))set_ctx_params },           \
 PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_END
 
+/*
+ * |batch| hashes a number of messages starting from the same initialised
+ * |CTX|, which is prepared by |init|, see OP_digest_batch_digest.
+ */
+# define IMPLEMENT_digest_functions_with_batch(                                \
+    name, CTX, blksize, dgstsize, flags, init, upd, fin, batch)                \
+static OSSL_OP_digest_batch_digest_fn name##_batch_digest;                     \
+static int name##_batch_digest(void *provctx, const unsigned char *const in[], \
+                               const size_t inl[], size_t n,                   \
+                               unsigned char *out, size_t *outl, size_t outsz) \
+{                                                                              \
+    CTX ctx;                                                                   \
+    int ret;                                                                   \
+                                                                               \
+    if (outsz / dgstsize < n || !init(&ctx))                                   \
+        return 0;                                                              \
+    ret = batch(&ctx, in, inl, n, out);                                        \
+    OPENSSL_cleanse(&ctx, sizeof(ctx));                                        \
+    if (ret)                                                                   \
+        *outl = n * dgstsize;                                                  \
+    return ret;                                                                \
+}                                                                              \
+PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_START(name, CTX, blksize, dgstsize, flags, \
+                                          init, upd, fin),                     \
+{ OSSL_FUNC_DIGEST_BATCH_DIGEST, (void (*)(void))name##_batch_digest },        \
+PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_END
+
 
 const OSSL_PARAM *digest_default_gettable_params(void);
 int digest_default_get_params(OSSL_PARAM params[], size_t blksz, size_t paramsz,
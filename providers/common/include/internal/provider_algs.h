@@ -25,6 +25,9 @@ extern const OSSL_DISPATCH shake_128_functions[];
 extern const OSSL_DISPATCH shake_256_functions[];
 extern const OSSL_DISPATCH blake2s256_functions[];
 extern const OSSL_DISPATCH blake2b512_functions[];
+extern const OSSL_DISPATCH blake2sp256_functions[];
+extern const OSSL_DISPATCH blake2bp512_functions[];
+extern const OSSL_DISPATCH blake3_functions[];
 extern const OSSL_DISPATCH md5_functions[];
 extern const OSSL_DISPATCH md5_sha1_functions[];
 extern const OSSL_DISPATCH sm3_functions[];
@@ -62,6 +65,8 @@ extern const OSSL_DISPATCH aes128gcm_functions[];
 extern const OSSL_DISPATCH aes256ccm_functions[];
 extern const OSSL_DISPATCH aes192ccm_functions[];
 extern const OSSL_DISPATCH aes128ccm_functions[];
+extern const OSSL_DISPATCH aes256xts_functions[];
+extern const OSSL_DISPATCH aes128xts_functions[];
 #ifndef OPENSSL_NO_ARIA
 extern const OSSL_DISPATCH aria256gcm_functions[];
 extern const OSSL_DISPATCH aria192gcm_functions[];
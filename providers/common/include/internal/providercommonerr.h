@@ -62,6 +62,7 @@ int ERR_load_PROV_strings(void);
 # define PROV_R_INVALID_AAD                               108
 # define PROV_R_INVALID_CUSTOM_LENGTH                     111
 # define PROV_R_INVALID_DATA                              115
+# define PROV_R_INVALID_DATA_UNIT_SIZE                    148
 # define PROV_R_INVALID_DIGEST                            122
 # define PROV_R_INVALID_ITERATION_COUNT                   123
 # define PROV_R_INVALID_IVLEN                             116
@@ -97,5 +98,7 @@ int ERR_load_PROV_strings(void);
 # define PROV_R_VALUE_ERROR                               138
 # define PROV_R_WRONG_FINAL_BLOCK_LENGTH                  107
 # define PROV_R_WRONG_OUTPUT_BUFFER_SIZE                  139
+# define PROV_R_XTS_DATA_UNIT_IS_TOO_LARGE                149
+# define PROV_R_XTS_DUPLICATED_KEYS                       150
 
 #endif
@@ -78,7 +78,12 @@ static const OSSL_ALGORITHM deflt_digests[] = {
 #ifndef OPENSSL_NO_BLAKE2
     { "BLAKE2s256", "default=yes", blake2s256_functions },
     { "BLAKE2b512", "default=yes", blake2b512_functions },
+    { "BLAKE2sp256", "default=yes", blake2sp256_functions },
+    { "BLAKE2bp512", "default=yes", blake2bp512_functions },
 #endif /* OPENSSL_NO_BLAKE2 */
+#ifndef OPENSSL_NO_BLAKE3
+    { "BLAKE3", "default=yes", blake3_functions },
+#endif
 
 #ifndef OPENSSL_NO_SM3
     { "SM3", "default=yes", sm3_functions },
@@ -121,6 +126,8 @@ static const OSSL_ALGORITHM deflt_ciphers[] = {
     { "id-aes256-CCM", "default=yes", aes256ccm_functions },
     { "id-aes192-CCM", "default=yes", aes192ccm_functions },
     { "id-aes128-CCM", "default=yes", aes128ccm_functions },
+    { "AES-256-XTS", "default=yes", aes256xts_functions },
+    { "AES-128-XTS", "default=yes", aes128xts_functions },
 #ifndef OPENSSL_NO_ARIA
     { "ARIA-256-GCM", "default=yes", aria256gcm_functions },
     { "ARIA-192-GCM", "default=yes", aria192gcm_functions },
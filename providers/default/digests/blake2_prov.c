@@ -14,6 +14,8 @@
 
 OSSL_OP_digest_init_fn blake2s256_init;
 OSSL_OP_digest_init_fn blake2b512_init;
+OSSL_OP_digest_init_fn blake2sp256_init;
+OSSL_OP_digest_init_fn blake2bp512_init;
 
 int blake2s256_init(void *ctx)
 {
@@ -31,6 +33,16 @@ int blake2b512_init(void *ctx)
     return blake2b_init((BLAKE2B_CTX *)ctx, &P);
 }
 
+int blake2sp256_init(void *ctx)
+{
+    return blake2sp_init((BLAKE2SP_CTX *)ctx);
+}
+
+int blake2bp512_init(void *ctx)
+{
+    return blake2bp_init((BLAKE2BP_CTX *)ctx);
+}
+
 /* blake2s256_functions */
 IMPLEMENT_digest_functions(blake2s256, BLAKE2S_CTX,
                            BLAKE2S_BLOCKBYTES, BLAKE2S_DIGEST_LENGTH, 0,
@@ -40,3 +52,13 @@ IMPLEMENT_digest_functions(blake2s256, BLAKE2S_CTX,
 IMPLEMENT_digest_functions(blake2b512, BLAKE2B_CTX,
                            BLAKE2B_BLOCKBYTES, BLAKE2B_DIGEST_LENGTH, 0,
                            blake2b512_init, blake2b_update, blake2b_final)
+
+/* blake2sp256_functions */
+IMPLEMENT_digest_functions(blake2sp256, BLAKE2SP_CTX,
+                           BLAKE2S_BLOCKBYTES, BLAKE2SP_DIGEST_LENGTH, 0,
+                           blake2sp256_init, blake2sp_update, blake2sp_final)
+
+/* blake2bp512_functions */
+IMPLEMENT_digest_functions(blake2bp512, BLAKE2BP_CTX,
+                           BLAKE2B_BLOCKBYTES, BLAKE2BP_DIGEST_LENGTH, 0,
+                           blake2bp512_init, blake2bp_update, blake2bp_final)
@@ -0,0 +1,256 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * BLAKE2bp as specified in the BLAKE2 paper and implemented in the
+ * reference code at https://blake2.net: four BLAKE2b leaves with fanout 4
+ * and depth 2, hashed into a BLAKE2b root node.
+ *
+ * The leaves are advanced in lockstep by a compression function that works
+ * on all four of them at once, one leaf per SIMD lane in the assembler
+ * version.  In the C version every operation is a loop over the leaves.
+ * The tail of the input, where the leaves may no longer be in step, is
+ * finished with the scalar BLAKE2b code.
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include "blake2_impl.h"
+#include "internal/blake2.h"
+
+static const uint64_t blake2b_IV[8] =
+{
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint8_t blake2b_sigma[12][16] =
+{
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 } ,
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 } ,
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 } ,
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 } ,
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 } ,
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 } ,
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 } ,
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 } ,
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13 , 0 } ,
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+#ifdef BLAKE2_ASM
+/* Returns 0 if the processor lacks the required SIMD extension */
+int blake2bp_compress_avx2(uint64_t h[8][BLAKE2BP_PARALLELISM], uint64_t t[2],
+                           const uint8_t *in, size_t n);
+#endif
+
+/* Set up the parameter block shared by the leaves and the root */
+static void blake2bp_param_init(BLAKE2B_PARAM *P, uint8_t node_depth)
+{
+    blake2b_param_init(P);
+    P->fanout = BLAKE2BP_PARALLELISM;
+    P->depth = 2;
+    P->node_depth = node_depth;
+    P->inner_length = BLAKE2B_OUTBYTES;
+}
+
+/*
+ * Initialize the four leaves.  They only differ by their node offset.
+ * Always returns 1.
+ */
+int blake2bp_init(BLAKE2BP_CTX *c)
+{
+    BLAKE2B_PARAM P;
+    BLAKE2B_CTX leaf;
+    size_t i, l;
+
+    memset(c, 0, sizeof(*c));
+    blake2bp_param_init(&P, 0);
+    for (l = 0; l < BLAKE2BP_PARALLELISM; l++) {
+        store64(P.node_offset, l);
+        blake2b_init(&leaf, &P);
+        for (i = 0; i < 8; i++)
+            c->h[i][l] = leaf.h[i];
+    }
+    return 1;
+}
+
+/*
+ * Compress |n| strides of input, one block into each leaf.  None of these
+ * blocks can be the last one of its leaf.
+ */
+static void blake2bp_compress(BLAKE2BP_CTX *S, const uint8_t *in, size_t n)
+{
+    uint64_t m[16][BLAKE2BP_PARALLELISM];
+    uint64_t v[16][BLAKE2BP_PARALLELISM];
+    size_t i, l;
+
+#ifdef BLAKE2_ASM
+    if (blake2bp_compress_avx2(S->h, S->t, in, n))
+        return;
+#endif
+
+    for (; n > 0; n--, in += BLAKE2BP_STRIDE) {
+        for (i = 0; i < 16; i++)
+            for (l = 0; l < BLAKE2BP_PARALLELISM; l++)
+                m[i][l] = load64(in + l * BLAKE2B_BLOCKBYTES + i * 8);
+
+        /* blake2b_increment_counter, the leaves always share it */
+        S->t[0] += BLAKE2B_BLOCKBYTES;
+        S->t[1] += (S->t[0] < BLAKE2B_BLOCKBYTES);
+
+        for (l = 0; l < BLAKE2BP_PARALLELISM; l++) {
+            for (i = 0; i < 8; i++)
+                v[i][l] = S->h[i][l];
+            v[8][l]  = blake2b_IV[0];
+            v[9][l]  = blake2b_IV[1];
+            v[10][l] = blake2b_IV[2];
+            v[11][l] = blake2b_IV[3];
+            v[12][l] = S->t[0] ^ blake2b_IV[4];
+            v[13][l] = S->t[1] ^ blake2b_IV[5];
+            v[14][l] = blake2b_IV[6];
+            v[15][l] = blake2b_IV[7];
+        }
+#define G(r,i,a,b,c,d) \
+        do { \
+            const uint64_t *x = m[blake2b_sigma[r][2*i+0]]; \
+            const uint64_t *y = m[blake2b_sigma[r][2*i+1]]; \
+            for (l = 0; l < BLAKE2BP_PARALLELISM; l++) { \
+                v[a][l] = v[a][l] + v[b][l] + x[l]; \
+                v[d][l] = rotr64(v[d][l] ^ v[a][l], 32); \
+                v[c][l] = v[c][l] + v[d][l]; \
+                v[b][l] = rotr64(v[b][l] ^ v[c][l], 24); \
+                v[a][l] = v[a][l] + v[b][l] + y[l]; \
+                v[d][l] = rotr64(v[d][l] ^ v[a][l], 16); \
+                v[c][l] = v[c][l] + v[d][l]; \
+                v[b][l] = rotr64(v[b][l] ^ v[c][l], 63); \
+            } \
+        } while (0)
+#define ROUND(r)  \
+        do { \
+            G(r,0, 0, 4, 8,12); \
+            G(r,1, 1, 5, 9,13); \
+            G(r,2, 2, 6,10,14); \
+            G(r,3, 3, 7,11,15); \
+            G(r,4, 0, 5,10,15); \
+            G(r,5, 1, 6,11,12); \
+            G(r,6, 2, 7, 8,13); \
+            G(r,7, 3, 4, 9,14); \
+        } while (0)
+#if defined(OPENSSL_SMALL_FOOTPRINT)
+        for (i = 0; i < 12; i++) {
+            ROUND(i);
+        }
+#else
+        ROUND(0);
+        ROUND(1);
+        ROUND(2);
+        ROUND(3);
+        ROUND(4);
+        ROUND(5);
+        ROUND(6);
+        ROUND(7);
+        ROUND(8);
+        ROUND(9);
+        ROUND(10);
+        ROUND(11);
+#endif
+
+        for (i = 0; i < 8; i++)
+            for (l = 0; l < BLAKE2BP_PARALLELISM; l++)
+                S->h[i][l] ^= v[i][l] ^ v[i + 8][l];
+#undef G
+#undef ROUND
+    }
+}
+
+/* Absorb the input data into the hash state.  Always returns 1. */
+int blake2bp_update(BLAKE2BP_CTX *c, const void *data, size_t datalen)
+{
+    const uint8_t *in = data;
+    size_t fill;
+
+    /*
+     * The first stride of what is available can be compressed as soon as
+     * there is data past the block of the last leaf in the next stride,
+     * i.e. as soon as there is more than c->buf can hold.
+     */
+    while (c->buflen + datalen > sizeof(c->buf)) {
+        if (c->buflen == 0) {
+            size_t n = (datalen - sizeof(c->buf) + BLAKE2BP_STRIDE - 1)
+                       / BLAKE2BP_STRIDE;
+
+            blake2bp_compress(c, in, n);
+            in += n * BLAKE2BP_STRIDE;
+            datalen -= n * BLAKE2BP_STRIDE;
+            break;
+        }
+        if (c->buflen < BLAKE2BP_STRIDE) {
+            fill = BLAKE2BP_STRIDE - c->buflen;
+            memcpy(c->buf + c->buflen, in, fill);
+            c->buflen += fill;
+            in += fill;
+            datalen -= fill;
+        }
+        blake2bp_compress(c, c->buf, 1);
+        c->buflen -= BLAKE2BP_STRIDE;
+        memmove(c->buf, c->buf + BLAKE2BP_STRIDE, c->buflen);
+    }
+
+    memcpy(c->buf + c->buflen, in, datalen);
+    c->buflen += datalen;
+
+    return 1;
+}
+
+/*
+ * Finish the leaves with what is left in the buffer, then hash their
+ * digests in the root node and save the result in md.
+ * Always returns 1.
+ */
+int blake2bp_final(unsigned char *md, BLAKE2BP_CTX *c)
+{
+    uint8_t hash[BLAKE2BP_PARALLELISM][BLAKE2B_OUTBYTES];
+    BLAKE2B_PARAM P;
+    BLAKE2B_CTX S;
+    size_t i, l, off, len;
+
+    for (l = 0; l < BLAKE2BP_PARALLELISM; l++) {
+        memset(&S, 0, sizeof(S));
+        for (i = 0; i < 8; i++)
+            S.h[i] = c->h[i][l];
+        S.t[0] = c->t[0];
+        S.t[1] = c->t[1];
+        S.outlen = BLAKE2B_OUTBYTES;
+        for (off = l * BLAKE2B_BLOCKBYTES; off < c->buflen;
+             off += BLAKE2BP_STRIDE) {
+            len = c->buflen - off;
+            blake2b_update(&S, c->buf + off,
+                           len < BLAKE2B_BLOCKBYTES ? len : BLAKE2B_BLOCKBYTES);
+        }
+        /* The last leaf is the last node of its level */
+        if (l == BLAKE2BP_PARALLELISM - 1)
+            S.f[1] = -1;
+        blake2b_final(hash[l], &S);
+    }
+
+    blake2bp_param_init(&P, 1);
+    blake2b_init(&S, &P);
+    blake2b_update(&S, hash, sizeof(hash));
+    S.f[1] = -1;
+    blake2b_final(md, &S);
+
+    OPENSSL_cleanse(hash, sizeof(hash));
+    OPENSSL_cleanse(c, sizeof(*c));
+    return 1;
+}
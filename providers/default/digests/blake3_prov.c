@@ -0,0 +1,503 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * BLAKE3 as specified at https://github.com/BLAKE3-team/BLAKE3-specs, in its
+ * default hashing mode with a 256-bit output.
+ *
+ * The input is split into 1KiB chunks that are hashed independently and
+ * then combined in a binary tree.  Whenever enough whole chunks are
+ * available they are hashed up to eight at a time, one chunk per SIMD lane,
+ * by the assembler version where there is one, and one after another
+ * otherwise.
+ * Large updates can additionally be spread over the library's thread pool,
+ * each thread hashing whole subtrees of BLAKE3_THREAD_CHUNKS chunks.
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/params.h>
+#include <openssl/core_names.h>
+#include "blake2_impl.h"
+#include "internal/blake3.h"
+#include "internal/digestcommon.h"
+#include "internal/provider_algs.h"
+#include "internal/thread_pool.h"
+
+#define BLAKE3_LANES            8
+#define BLAKE3_THREAD_CHUNKS    1024
+
+#define CHUNK_START             (1 << 0)
+#define CHUNK_END               (1 << 1)
+#define PARENT                  (1 << 2)
+#define ROOT                    (1 << 3)
+
+static const uint32_t blake3_IV[8] =
+{
+    0x6A09E667U, 0xBB67AE85U, 0x3C6EF372U, 0xA54FF53AU,
+    0x510E527FU, 0x9B05688CU, 0x1F83D9ABU, 0x5BE0CD19U
+};
+
+/* The message word permutation, applied 0 to 6 times */
+static const uint8_t blake3_sigma[7][16] =
+{
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    {  2,  6,  3, 10,  7,  0,  4, 13,  1, 11, 12,  5,  9, 14, 15,  8 },
+    {  3,  4, 10, 12, 13,  2,  7, 14,  6,  5,  9,  0, 11, 15,  8,  1 },
+    { 10,  7, 12,  9, 14,  3, 13, 15,  4,  0, 11,  2,  5,  8,  1,  6 },
+    { 12, 13,  9, 11, 15, 10, 14,  8,  7,  2,  5,  3,  0,  1,  6,  4 },
+    {  9, 14, 11,  5,  8, 12, 15,  1, 13,  3,  0, 10,  2,  6,  4,  7 },
+    { 11, 15,  5,  0,  1,  9,  8,  6, 14, 10,  2, 12,  3,  4,  7, 13 }
+};
+
+/* Compress one block |m| into the chaining value |cv| */
+static void blake3_compress(uint32_t cv[8], const uint32_t m[16],
+                            uint64_t counter, uint32_t blocklen,
+                            uint32_t flags)
+{
+    uint32_t v[16];
+    int i;
+
+    for (i = 0; i < 8; i++)
+        v[i] = cv[i];
+    v[8]  = blake3_IV[0];
+    v[9]  = blake3_IV[1];
+    v[10] = blake3_IV[2];
+    v[11] = blake3_IV[3];
+    v[12] = (uint32_t)counter;
+    v[13] = (uint32_t)(counter >> 32);
+    v[14] = blocklen;
+    v[15] = flags;
+#define G(r,i,a,b,c,d) \
+    do { \
+        a = a + b + m[blake3_sigma[r][2*i+0]]; \
+        d = rotr32(d ^ a, 16); \
+        c = c + d; \
+        b = rotr32(b ^ c, 12); \
+        a = a + b + m[blake3_sigma[r][2*i+1]]; \
+        d = rotr32(d ^ a, 8); \
+        c = c + d; \
+        b = rotr32(b ^ c, 7); \
+    } while (0)
+#define ROUND(r)  \
+    do { \
+        G(r,0,v[ 0],v[ 4],v[ 8],v[12]); \
+        G(r,1,v[ 1],v[ 5],v[ 9],v[13]); \
+        G(r,2,v[ 2],v[ 6],v[10],v[14]); \
+        G(r,3,v[ 3],v[ 7],v[11],v[15]); \
+        G(r,4,v[ 0],v[ 5],v[10],v[15]); \
+        G(r,5,v[ 1],v[ 6],v[11],v[12]); \
+        G(r,6,v[ 2],v[ 7],v[ 8],v[13]); \
+        G(r,7,v[ 3],v[ 4],v[ 9],v[14]); \
+    } while (0)
+    for (i = 0; i < 7; i++)
+        ROUND(i);
+#undef G
+#undef ROUND
+
+    for (i = 0; i < 8; i++)
+        cv[i] = v[i] ^ v[i + 8];
+}
+
+static void blake3_compress_bytes(uint32_t cv[8], const uint8_t *block,
+                                  uint64_t counter, uint32_t blocklen,
+                                  uint32_t flags)
+{
+    uint32_t m[16];
+    int i;
+
+    for (i = 0; i < 16; i++)
+        m[i] = load32(block + i * 4);
+    blake3_compress(cv, m, counter, blocklen, flags);
+}
+
+/* Combine two chaining values into |out|, which may alias either of them */
+static void blake3_parent(uint32_t out[8], const uint32_t left[8],
+                          const uint32_t right[8], uint32_t flags)
+{
+    uint32_t m[16];
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        m[i] = left[i];
+        m[i + 8] = right[i];
+        out[i] = blake3_IV[i];
+    }
+    blake3_compress(out, m, 0, BLAKE3_BLOCKBYTES, PARENT | flags);
+}
+
+/* Hash one whole chunk with chunk number |counter| into |cv| */
+static void blake3_hash_chunk(const uint8_t *in, uint64_t counter,
+                              uint32_t cv[8])
+{
+    size_t n;
+
+    memcpy(cv, blake3_IV, sizeof(blake3_IV));
+    for (n = 0; n < BLAKE3_CHUNKBYTES; n += BLAKE3_BLOCKBYTES)
+        blake3_compress_bytes(cv, in + n, counter, BLAKE3_BLOCKBYTES,
+                              (n == 0 ? CHUNK_START : 0)
+                              | (n == BLAKE3_CHUNKBYTES - BLAKE3_BLOCKBYTES
+                                 ? CHUNK_END : 0));
+}
+
+#ifdef BLAKE3_ASM
+/* Returns 0 if the processor lacks the required SIMD extension */
+int blake3_hash_chunks_avx2(const uint8_t *in, uint64_t counter,
+                            uint32_t cvs[BLAKE3_LANES][8]);
+#endif
+
+/*
+ * Hash |n| consecutive whole chunks starting at chunk number |counter|, and
+ * store their chaining values in |cvs|.  The chunks must not cross a
+ * multiple of BLAKE3_LANES.
+ */
+static void blake3_hash_chunks(const uint8_t *in, uint64_t counter, size_t n,
+                               uint32_t cvs[BLAKE3_LANES][8])
+{
+    size_t i;
+#ifdef BLAKE3_ASM
+    uint8_t buf[BLAKE3_LANES * BLAKE3_CHUNKBYTES];
+
+    if (n == BLAKE3_LANES) {
+        if (blake3_hash_chunks_avx2(in, counter, cvs))
+            return;
+    } else if (n > 1) {
+        /* The unused lanes are hashed too, do not read past the input */
+        memcpy(buf, in, n * BLAKE3_CHUNKBYTES);
+        memset(buf + n * BLAKE3_CHUNKBYTES, 0,
+               sizeof(buf) - n * BLAKE3_CHUNKBYTES);
+        if (blake3_hash_chunks_avx2(buf, counter, cvs))
+            return;
+    }
+#endif
+
+    for (i = 0; i < n; i++)
+        blake3_hash_chunk(in + i * BLAKE3_CHUNKBYTES, counter + i, cvs[i]);
+}
+
+/*
+ * Hash |n| whole chunks starting at chunk number |counter| into the
+ * chaining value of the subtree they form.  |n| must be a power of two
+ * that is at least BLAKE3_LANES.
+ */
+static void blake3_hash_subtree(const uint8_t *in, uint64_t counter,
+                                size_t n, uint32_t cv[8])
+{
+    uint32_t stack[BLAKE3_MAX_DEPTH][8];
+    uint32_t cvs[BLAKE3_LANES][8];
+    size_t i, stack_len = 0, done;
+
+    for (i = 0; i < n; i += BLAKE3_LANES) {
+        blake3_hash_chunks(in + i * BLAKE3_CHUNKBYTES, counter + i,
+                           BLAKE3_LANES, cvs);
+        blake3_parent(cvs[0], cvs[0], cvs[1], 0);
+        blake3_parent(cvs[2], cvs[2], cvs[3], 0);
+        blake3_parent(cvs[4], cvs[4], cvs[5], 0);
+        blake3_parent(cvs[6], cvs[6], cvs[7], 0);
+        blake3_parent(cvs[0], cvs[0], cvs[2], 0);
+        blake3_parent(cvs[4], cvs[4], cvs[6], 0);
+        blake3_parent(cvs[0], cvs[0], cvs[4], 0);
+        /* None of the nodes of a complete subtree is the root */
+        for (done = i / BLAKE3_LANES + 1; (done & 1) == 0; done >>= 1)
+            blake3_parent(cvs[0], stack[--stack_len], cvs[0], 0);
+        memcpy(stack[stack_len++], cvs[0], sizeof(cvs[0]));
+    }
+    memcpy(cv, stack[0], sizeof(stack[0]));
+    OPENSSL_cleanse(stack, sizeof(stack));
+    OPENSSL_cleanse(cvs, sizeof(cvs));
+}
+
+/*
+ * Merge the completed subtrees on the stack until there are as many of them
+ * as |total_chunks| has bits set.  This is done lazily, when more input is
+ * known to follow, because the last parent node has to be hashed as the root.
+ */
+static void blake3_merge_stack(BLAKE3_CTX *c, uint64_t total_chunks)
+{
+    size_t post_merge = 0;
+
+    for (; total_chunks != 0; total_chunks &= total_chunks - 1)
+        post_merge++;
+    while (c->stack_len > post_merge) {
+        blake3_parent(c->stack[c->stack_len - 2], c->stack[c->stack_len - 2],
+                      c->stack[c->stack_len - 1], 0);
+        c->stack_len--;
+    }
+}
+
+/* Push the chaining value of the subtree starting at chunk |counter| */
+static void blake3_push_cv(BLAKE3_CTX *c, const uint32_t cv[8],
+                           uint64_t counter)
+{
+    blake3_merge_stack(c, counter);
+    memcpy(c->stack[c->stack_len++], cv, sizeof(c->stack[0]));
+}
+
+static ossl_inline size_t blake3_chunk_len(const BLAKE3_CTX *c)
+{
+    return c->blocks_compressed * BLAKE3_BLOCKBYTES + c->buflen;
+}
+
+/* Absorb |len| bytes, which must fit, into the current chunk */
+static void blake3_chunk_update(BLAKE3_CTX *c, const uint8_t *in, size_t len)
+{
+    size_t fill;
+
+    while (len > 0) {
+        /* The last block of the chunk is only compressed at its end */
+        if (c->buflen == BLAKE3_BLOCKBYTES) {
+            blake3_compress_bytes(c->cv, c->buf, c->chunk_counter,
+                                  BLAKE3_BLOCKBYTES,
+                                  c->blocks_compressed == 0 ? CHUNK_START : 0);
+            c->blocks_compressed++;
+            c->buflen = 0;
+        }
+        fill = BLAKE3_BLOCKBYTES - c->buflen;
+        if (fill > len)
+            fill = len;
+        memcpy(c->buf + c->buflen, in, fill);
+        c->buflen += fill;
+        in += fill;
+        len -= fill;
+    }
+}
+
+/* Compute the chaining value of the current chunk into |cv| */
+static void blake3_chunk_output(BLAKE3_CTX *c, uint32_t cv[8], uint32_t flags)
+{
+    memset(c->buf + c->buflen, 0, sizeof(c->buf) - c->buflen);
+    memcpy(cv, c->cv, sizeof(c->cv));
+    if (c->blocks_compressed == 0)
+        flags |= CHUNK_START;
+    blake3_compress_bytes(cv, c->buf, c->chunk_counter, (uint32_t)c->buflen,
+                          CHUNK_END | flags);
+}
+
+static void blake3_chunk_reset(BLAKE3_CTX *c)
+{
+    memcpy(c->cv, blake3_IV, sizeof(c->cv));
+    c->chunk_counter++;
+    c->buflen = 0;
+    c->blocks_compressed = 0;
+}
+
+typedef struct {
+    const uint8_t *in;
+    uint64_t counter;
+    size_t n;
+    size_t njobs;
+    uint32_t (*cvs)[8];
+} BLAKE3_JOB;
+
+/* Hash the subtrees of share |i| of the job */
+static void blake3_run_job(void *arg, size_t i)
+{
+    const BLAKE3_JOB *job = arg;
+    size_t per = job->n / job->njobs, rem = job->n % job->njobs;
+    size_t first = i * per + (i < rem ? i : rem);
+    size_t last = first + per + (i < rem);
+
+    for (; first < last; first++)
+        blake3_hash_subtree(job->in + first * BLAKE3_THREAD_CHUNKS
+                                      * BLAKE3_CHUNKBYTES,
+                            job->counter + first * BLAKE3_THREAD_CHUNKS,
+                            BLAKE3_THREAD_CHUNKS, job->cvs[first]);
+}
+
+/*
+ * Hash |n| subtrees of BLAKE3_THREAD_CHUNKS chunks each, starting at the
+ * current chunk, spread over up to c->threads threads of the library's
+ * thread pool.  Returns 0 without touching the state if the memory for it
+ * cannot be allocated.
+ */
+static int blake3_hash_subtrees_mt(BLAKE3_CTX *c, const uint8_t *in, size_t n)
+{
+    BLAKE3_JOB job;
+    size_t i;
+
+    job.cvs = OPENSSL_malloc(n * sizeof(*job.cvs));
+    if (job.cvs == NULL)
+        return 0;
+    job.in = in;
+    job.counter = c->chunk_counter;
+    job.n = n;
+    job.njobs = ossl_thread_pool_size() + 1;
+    if (job.njobs > c->threads)
+        job.njobs = c->threads;
+    if (job.njobs > n)
+        job.njobs = n;
+    ossl_thread_pool_run(blake3_run_job, &job, job.njobs);
+
+    for (i = 0; i < n; i++) {
+        blake3_push_cv(c, job.cvs[i], c->chunk_counter);
+        c->chunk_counter += BLAKE3_THREAD_CHUNKS;
+    }
+
+    OPENSSL_clear_free(job.cvs, n * sizeof(*job.cvs));
+    return 1;
+}
+
+/*
+ * Hash whole chunks while there is more input after them, the current chunk
+ * being empty.  Returns the number of bytes consumed.
+ */
+static size_t blake3_hash_bulk(BLAKE3_CTX *c, const uint8_t *in, size_t len)
+{
+    const size_t subtree = BLAKE3_THREAD_CHUNKS * BLAKE3_CHUNKBYTES;
+    const size_t group = BLAKE3_LANES * BLAKE3_CHUNKBYTES;
+    const uint8_t *start = in;
+    uint32_t cvs[BLAKE3_LANES][8];
+    size_t i, n;
+
+    while (len > BLAKE3_CHUNKBYTES) {
+        /* Subtrees pushed on the stack must be aligned on their size */
+        if (c->threads > 1 && len > 2 * subtree
+                && c->chunk_counter % BLAKE3_THREAD_CHUNKS == 0
+                && ossl_thread_pool_size() > 0) {
+            n = (len - 1) / subtree;
+            if (blake3_hash_subtrees_mt(c, in, n)) {
+                in += n * subtree;
+                len -= n * subtree;
+                continue;
+            }
+        }
+        if (len > group && c->chunk_counter % BLAKE3_LANES == 0) {
+            blake3_hash_subtree(in, c->chunk_counter, BLAKE3_LANES, cvs[0]);
+            blake3_push_cv(c, cvs[0], c->chunk_counter);
+            c->chunk_counter += BLAKE3_LANES;
+            in += group;
+            len -= group;
+            continue;
+        }
+        /* Up to the next group boundary, or as much as can be hashed */
+        n = BLAKE3_LANES - c->chunk_counter % BLAKE3_LANES;
+        if (n > (len - 1) / BLAKE3_CHUNKBYTES)
+            n = (len - 1) / BLAKE3_CHUNKBYTES;
+        blake3_hash_chunks(in, c->chunk_counter, n, cvs);
+        for (i = 0; i < n; i++) {
+            blake3_push_cv(c, cvs[i], c->chunk_counter);
+            c->chunk_counter++;
+        }
+        in += n * BLAKE3_CHUNKBYTES;
+        len -= n * BLAKE3_CHUNKBYTES;
+    }
+    OPENSSL_cleanse(cvs, sizeof(cvs));
+    return in - start;
+}
+
+/*
+ * Initialize the hashing context.  The number of threads is reset to 1.
+ * Always returns 1.
+ */
+int blake3_init(BLAKE3_CTX *c)
+{
+    memset(c, 0, sizeof(*c));
+    memcpy(c->cv, blake3_IV, sizeof(c->cv));
+    c->threads = 1;
+    return 1;
+}
+
+/* Absorb the input data into the hash state.  Always returns 1. */
+int blake3_update(BLAKE3_CTX *c, const void *data, size_t datalen)
+{
+    const uint8_t *in = data;
+    uint32_t cv[8];
+    size_t fill;
+
+    while (datalen > 0) {
+        /* The current chunk is full and more input follows */
+        if (blake3_chunk_len(c) == BLAKE3_CHUNKBYTES) {
+            blake3_chunk_output(c, cv, 0);
+            blake3_push_cv(c, cv, c->chunk_counter);
+            blake3_chunk_reset(c);
+        }
+        if (blake3_chunk_len(c) == 0) {
+            fill = blake3_hash_bulk(c, in, datalen);
+            in += fill;
+            datalen -= fill;
+            /* Everything on the stack is now known to have a right sibling */
+            blake3_merge_stack(c, c->chunk_counter);
+        }
+        fill = BLAKE3_CHUNKBYTES - blake3_chunk_len(c);
+        if (fill > datalen)
+            fill = datalen;
+        blake3_chunk_update(c, in, fill);
+        in += fill;
+        datalen -= fill;
+    }
+    return 1;
+}
+
+/*
+ * Calculate the final hash and save it in md.
+ * Always returns 1.
+ */
+int blake3_final(unsigned char *md, BLAKE3_CTX *c)
+{
+    uint32_t cv[8];
+    size_t i;
+
+    if (c->stack_len == 0) {
+        blake3_chunk_output(c, cv, ROOT);
+    } else {
+        blake3_chunk_output(c, cv, 0);
+        for (i = c->stack_len - 1; i > 0; i--)
+            blake3_parent(cv, c->stack[i], cv, 0);
+        blake3_parent(cv, c->stack[0], cv, ROOT);
+    }
+    for (i = 0; i < 8; i++)
+        store32(md + i * 4, cv[i]);
+
+    OPENSSL_cleanse(cv, sizeof(cv));
+    OPENSSL_cleanse(c, sizeof(*c));
+    return 1;
+}
+
+static OSSL_OP_digest_init_fn blake3_256_init;
+static OSSL_OP_digest_set_ctx_params_fn blake3_set_ctx_params;
+static OSSL_OP_digest_settable_ctx_params_fn blake3_settable_ctx_params;
+
+static int blake3_256_init(void *ctx)
+{
+    return blake3_init((BLAKE3_CTX *)ctx);
+}
+
+static const OSSL_PARAM known_blake3_settable_ctx_params[] = {
+    OSSL_PARAM_uint(OSSL_DIGEST_PARAM_THREADS, NULL),
+    OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *blake3_settable_ctx_params(void)
+{
+    return known_blake3_settable_ctx_params;
+}
+
+static int blake3_set_ctx_params(void *vctx, const OSSL_PARAM params[])
+{
+    const OSSL_PARAM *p;
+    BLAKE3_CTX *ctx = (BLAKE3_CTX *)vctx;
+    unsigned int threads;
+
+    if (ctx != NULL && params != NULL) {
+        p = OSSL_PARAM_locate_const(params, OSSL_DIGEST_PARAM_THREADS);
+        if (p != NULL) {
+            if (!OSSL_PARAM_get_uint(p, &threads) || threads == 0)
+                return 0;
+            ctx->threads = threads;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/* blake3_functions */
+IMPLEMENT_digest_functions_with_settable_ctx(
+    blake3, BLAKE3_CTX, BLAKE3_BLOCKBYTES, BLAKE3_DIGEST_LENGTH, 0,
+    blake3_256_init, blake3_update, blake3_final,
+    blake3_settable_ctx_params, blake3_set_ctx_params)
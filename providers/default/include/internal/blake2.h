@@ -79,12 +79,51 @@ struct blake2b_ctx_st {
 
 #define BLAKE2B_DIGEST_LENGTH 64
 #define BLAKE2S_DIGEST_LENGTH 32
+#define BLAKE2BP_DIGEST_LENGTH BLAKE2B_DIGEST_LENGTH
+#define BLAKE2SP_DIGEST_LENGTH BLAKE2S_DIGEST_LENGTH
 
 typedef struct blake2s_ctx_st BLAKE2S_CTX;
 typedef struct blake2b_ctx_st BLAKE2B_CTX;
 
+/*
+ * BLAKE2bp and BLAKE2sp hash the input on 4 and 8 leaves respectively, leaf
+ * |i| taking every block whose index is |i| modulo the degree of parallelism.
+ * The leaf states are kept lane-interleaved, so that one pass of the
+ * compression function advances all of them on a full stride of input.  A
+ * stride may hold the last block of some leaf, which has to be compressed
+ * with the finalisation flag set, so up to one stride plus all but one leaf
+ * block is held back until more data arrives.
+ */
+# define BLAKE2BP_PARALLELISM  4
+# define BLAKE2SP_PARALLELISM  8
+
+# define BLAKE2BP_STRIDE       (BLAKE2BP_PARALLELISM * BLAKE2B_BLOCKBYTES)
+# define BLAKE2SP_STRIDE       (BLAKE2SP_PARALLELISM * BLAKE2S_BLOCKBYTES)
+
+# define BLAKE2BP_BUFBYTES     (2 * BLAKE2BP_STRIDE - BLAKE2B_BLOCKBYTES)
+# define BLAKE2SP_BUFBYTES     (2 * BLAKE2SP_STRIDE - BLAKE2S_BLOCKBYTES)
+
+struct blake2bp_ctx_st {
+    uint64_t h[8][BLAKE2BP_PARALLELISM];
+    uint64_t t[2];
+    uint8_t  buf[BLAKE2BP_BUFBYTES];
+    size_t   buflen;
+};
+
+struct blake2sp_ctx_st {
+    uint32_t h[8][BLAKE2SP_PARALLELISM];
+    uint32_t t[2];
+    uint8_t  buf[BLAKE2SP_BUFBYTES];
+    size_t   buflen;
+};
+
+typedef struct blake2bp_ctx_st BLAKE2BP_CTX;
+typedef struct blake2sp_ctx_st BLAKE2SP_CTX;
+
 int blake2s256_init(void *ctx);
 int blake2b512_init(void *ctx);
+int blake2sp256_init(void *ctx);
+int blake2bp512_init(void *ctx);
 
 int blake2b_init(BLAKE2B_CTX *c, const BLAKE2B_PARAM *P);
 int blake2b_init_key(BLAKE2B_CTX *c, const BLAKE2B_PARAM *P, const void *key);
@@ -113,4 +152,12 @@ void blake2s_param_set_key_length(BLAKE2S_PARAM *P, uint8_t keylen);
 void blake2s_param_set_personal(BLAKE2S_PARAM *P, const uint8_t *personal, size_t length);
 void blake2s_param_set_salt(BLAKE2S_PARAM *P, const uint8_t *salt, size_t length);
 
+int blake2bp_init(BLAKE2BP_CTX *c);
+int blake2bp_update(BLAKE2BP_CTX *c, const void *data, size_t datalen);
+int blake2bp_final(unsigned char *md, BLAKE2BP_CTX *c);
+
+int blake2sp_init(BLAKE2SP_CTX *c);
+int blake2sp_update(BLAKE2SP_CTX *c, const void *data, size_t datalen);
+int blake2sp_final(unsigned char *md, BLAKE2SP_CTX *c);
+
 #endif /* HEADER_BLAKE2_H */
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#ifndef HEADER_BLAKE3_H
+# define HEADER_BLAKE3_H
+
+# include <openssl/opensslconf.h>
+
+# include <openssl/e_os2.h>
+# include <stddef.h>
+
+# define BLAKE3_BLOCKBYTES     64
+# define BLAKE3_CHUNKBYTES     1024
+# define BLAKE3_DIGEST_LENGTH  32
+
+/*
+ * Enough chaining values for 2^54 chunks, that is the 2^64 bytes of input
+ * the counters can describe.
+ */
+# define BLAKE3_MAX_DEPTH      54
+
+struct blake3_ctx_st {
+    /* The chunk that is being absorbed */
+    uint32_t cv[8];
+    uint64_t chunk_counter;
+    uint8_t  buf[BLAKE3_BLOCKBYTES];
+    size_t   buflen;
+    unsigned int blocks_compressed;
+    /* Chaining values of the completed subtrees to the left */
+    uint32_t stack[BLAKE3_MAX_DEPTH][8];
+    size_t   stack_len;
+    /* Number of threads large updates may be spread over */
+    unsigned int threads;
+};
+
+typedef struct blake3_ctx_st BLAKE3_CTX;
+
+int blake3_init(BLAKE3_CTX *c);
+int blake3_update(BLAKE3_CTX *c, const void *data, size_t datalen);
+int blake3_final(unsigned char *md, BLAKE3_CTX *c);
+
+#endif /* HEADER_BLAKE3_H */
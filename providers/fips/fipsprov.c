@@ -281,6 +281,10 @@ const char *ossl_prov_util_nid_to_name(int nid)
         return "id-aes192-CCM";
     case NID_aes_128_ccm:
         return "id-aes128-CCM";
+    case NID_aes_256_xts:
+        return "AES-256-XTS";
+    case NID_aes_128_xts:
+        return "AES-128-XTS";
     default:
         break;
     }
@@ -327,6 +331,8 @@ static const OSSL_ALGORITHM fips_ciphers[] = {
     { "id-aes256-CCM", "fips=yes", aes256ccm_functions },
     { "id-aes192-CCM", "fips=yes", aes192ccm_functions },
     { "id-aes128-CCM", "fips=yes", aes128ccm_functions },
+    { "AES-256-XTS", "fips=yes", aes256xts_functions },
+    { "AES-128-XTS", "fips=yes", aes128xts_functions },
 #ifndef OPENSSL_NO_DES
     { "DES-EDE3", "fips=yes", tdes_ede3_ecb_functions },
     { "DES-EDE3-CBC", "fips=yes", tdes_ede3_cbc_functions },
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2018-2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "ssl_locl.h"
+#include "record/record_locl.h"
+#include "internal/ktls.h"
+
+/*
+ * Count the number of records that were not processed yet from record boundary.
+ *
+ * This function assumes that there are only fully formed records read in the
+ * record layer. If read_ahead is enabled, then this might be false and this
+ * function will fail.
+ */
+static int count_unprocessed_records(SSL *s)
+{
+    SSL3_BUFFER *rbuf = RECORD_LAYER_get_rbuf(&s->rlayer);
+    PACKET pkt, subpkt;
+    int count = 0;
+
+    if (!PACKET_buf_init(&pkt, rbuf->buf + rbuf->offset, rbuf->left))
+        return -1;
+
+    while (PACKET_remaining(&pkt) > 0) {
+        /* Skip record type and version */
+        if (!PACKET_forward(&pkt, 3))
+            return -1;
+
+        /* Read until next record */
+        if (!PACKET_get_length_prefixed_2(&pkt, &subpkt))
+            return -1;
+
+        count += 1;
+    }
+
+    return count;
+}
+
+/*
+ * Check whether the kernel can take over the record protection for the
+ * negotiated protocol version and cipher |c|. The setsockopt() may still fail
+ * later on if the kernel has no implementation of the cipher available.
+ */
+int ktls_check_supported_cipher(const SSL *s, const EVP_CIPHER *c)
+{
+    switch (s->version) {
+    case TLS1_2_VERSION:
+#ifdef OPENSSL_KTLS_TLS13
+    case TLS1_3_VERSION:
+#endif
+        break;
+    default:
+        return 0;
+    }
+
+    switch (EVP_CIPHER_nid(c)) {
+#ifdef OPENSSL_KTLS_AES_CCM_128
+    case NID_aes_128_ccm:
+        /* The kernel only does CCM with the full 16 byte tag */
+        if (s->s3.tmp.new_cipher == NULL
+                || (s->s3.tmp.new_cipher->algorithm_enc & SSL_AES128CCM8) != 0)
+            return 0;
+        return 1;
+#endif
+#ifdef OPENSSL_KTLS_AES_GCM_128
+    case NID_aes_128_gcm:
+#endif
+#ifdef OPENSSL_KTLS_AES_GCM_256
+    case NID_aes_256_gcm:
+#endif
+#ifdef OPENSSL_KTLS_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+#endif
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Fill in |crypto_info| for the direction given in |which| from the key |key|
+ * and the implicit IV |iv| produced by the key schedule, i.e. the 4 byte fixed
+ * IV for AES-GCM and AES-CCM in TLSv1.2, and the full 12 byte IV otherwise.
+ * The record sequence number is taken from the record layer, skipping over any
+ * records that have already been read into the record buffer but not
+ * processed yet.
+ *
+ * Returns 1 on success or 0 if ktls cannot be used in the current state.
+ */
+int ktls_configure_crypto(SSL *s, const EVP_CIPHER *c, EVP_CIPHER_CTX *dd,
+                          int which, const unsigned char *iv,
+                          const unsigned char *key,
+                          union tls_crypto_info_all *crypto_info)
+{
+    unsigned char nonce[EVP_GCM_TLS_FIXED_IV_LEN + EVP_GCM_TLS_EXPLICIT_IV_LEN];
+    unsigned char *seq = (which & SSL3_CC_WRITE) ? s->rlayer.write_sequence
+                                                 : s->rlayer.read_sequence;
+    unsigned char *rec_seq;
+    int count_unprocessed;
+    int bit;
+
+    /*
+     * Work out the 12 byte nonce base. In TLSv1.2 AES-GCM and AES-CCM send an
+     * explicit nonce in every record which the kernel derives by incrementing
+     * an initial value: for GCM we use the one the cipher generated, for CCM
+     * OpenSSL uses the record sequence number.
+     */
+    if (s->version == TLS1_2_VERSION
+            && (EVP_CIPHER_mode(c) == EVP_CIPH_GCM_MODE
+                || EVP_CIPHER_mode(c) == EVP_CIPH_CCM_MODE)) {
+        if (EVP_CIPHER_mode(c) == EVP_CIPH_GCM_MODE) {
+            if (EVP_CIPHER_CTX_ctrl(dd, EVP_CTRL_GET_IV, sizeof(nonce),
+                                    nonce) <= 0)
+                return 0;
+        } else {
+            memcpy(nonce, iv, EVP_CCM_TLS_FIXED_IV_LEN);
+            memcpy(nonce + EVP_CCM_TLS_FIXED_IV_LEN, seq,
+                   EVP_CCM_TLS_EXPLICIT_IV_LEN);
+        }
+    } else {
+        memcpy(nonce, iv, sizeof(nonce));
+    }
+
+    memset(crypto_info, 0, sizeof(*crypto_info));
+    switch (EVP_CIPHER_nid(c)) {
+#ifdef OPENSSL_KTLS_AES_GCM_128
+    case NID_aes_128_gcm:
+        crypto_info->gcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(crypto_info->gcm128.salt, nonce,
+               TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+        memcpy(crypto_info->gcm128.iv,
+               nonce + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+               TLS_CIPHER_AES_GCM_128_IV_SIZE);
+        memcpy(crypto_info->gcm128.key, key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+        rec_seq = crypto_info->gcm128.rec_seq;
+        break;
+#endif
+#ifdef OPENSSL_KTLS_AES_GCM_256
+    case NID_aes_256_gcm:
+        crypto_info->gcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        memcpy(crypto_info->gcm256.salt, nonce,
+               TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+        memcpy(crypto_info->gcm256.iv,
+               nonce + TLS_CIPHER_AES_GCM_256_SALT_SIZE,
+               TLS_CIPHER_AES_GCM_256_IV_SIZE);
+        memcpy(crypto_info->gcm256.key, key, TLS_CIPHER_AES_GCM_256_KEY_SIZE);
+        rec_seq = crypto_info->gcm256.rec_seq;
+        break;
+#endif
+#ifdef OPENSSL_KTLS_AES_CCM_128
+    case NID_aes_128_ccm:
+        crypto_info->ccm128.info.cipher_type = TLS_CIPHER_AES_CCM_128;
+        memcpy(crypto_info->ccm128.salt, nonce,
+               TLS_CIPHER_AES_CCM_128_SALT_SIZE);
+        memcpy(crypto_info->ccm128.iv,
+               nonce + TLS_CIPHER_AES_CCM_128_SALT_SIZE,
+               TLS_CIPHER_AES_CCM_128_IV_SIZE);
+        memcpy(crypto_info->ccm128.key, key, TLS_CIPHER_AES_CCM_128_KEY_SIZE);
+        rec_seq = crypto_info->ccm128.rec_seq;
+        break;
+#endif
+#ifdef OPENSSL_KTLS_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+        crypto_info->chacha20poly1305.info.cipher_type
+            = TLS_CIPHER_CHACHA20_POLY1305;
+        memcpy(crypto_info->chacha20poly1305.iv, nonce,
+               TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE);
+        memcpy(crypto_info->chacha20poly1305.key, key,
+               TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE);
+        rec_seq = crypto_info->chacha20poly1305.rec_seq;
+        break;
+#endif
+    default:
+        OPENSSL_cleanse(nonce, sizeof(nonce));
+        return 0;
+    }
+    OPENSSL_cleanse(nonce, sizeof(nonce));
+    crypto_info->info.version = s->version;
+
+    /* All the ciphers supported by the kernel use an 8 byte record sequence */
+    memcpy(rec_seq, seq, SEQ_NUM_SIZE);
+    if (which & SSL3_CC_WRITE)
+        return 1;
+
+    count_unprocessed = count_unprocessed_records(s);
+    if (count_unprocessed < 0) {
+        OPENSSL_cleanse(crypto_info, sizeof(*crypto_info));
+        return 0;
+    }
+
+    /* increment the crypto_info record sequence */
+    while (count_unprocessed) {
+        for (bit = SEQ_NUM_SIZE - 1; bit >= 0; bit--) { /* increment */
+            ++rec_seq[bit];
+            if (rec_seq[bit] != 0)
+                break;
+        }
+        count_unprocessed--;
+    }
+
+    return 1;
+}
@@ -94,8 +94,14 @@ int RECORD_LAYER_processed_read_pending(const RECORD_LAYER *rl)
 
 int RECORD_LAYER_write_pending(const RECORD_LAYER *rl)
 {
-    return (rl->numwpipes > 0)
-        && SSL3_BUFFER_get_left(&rl->wbuf[rl->numwpipes - 1]) != 0;
+    size_t currbuf;
+
+    /* A write might not have used all of the pipeline buffers */
+    for (currbuf = 0; currbuf < rl->numwpipes; currbuf++) {
+        if (SSL3_BUFFER_get_left(&rl->wbuf[currbuf]) != 0)
+            return 1;
+    }
+    return 0;
 }
 
 void RECORD_LAYER_reset_read_sequence(RECORD_LAYER *rl)
@@ -202,10 +208,12 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
         /* start with empty packet ... */
         if (left == 0)
             rb->offset = align;
-        else if (align != 0 && left >= SSL3_RT_HEADER_LENGTH) {
+        else if (align != 0 && clearold == 1
+                 && left >= SSL3_RT_HEADER_LENGTH) {
             /*
              * check if next packet length is large enough to justify payload
-             * alignment...
+             * alignment... but don't move it over any records that are still
+             * waiting to be processed as part of a pipeline.
              */
             pkt = rb->buf + rb->offset;
             if (pkt[0] == SSL3_RT_APPLICATION_DATA
@@ -335,24 +343,19 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
 }
 
 /*
- * Call this to write data in records of type 'type' It will return <= 0 if
- * not all data has been sent or non-blocking IO.
+ * Common start of a write of |len| bytes: check that a retried
+ * write is consistent with the one that didn't complete, account for early
+ * data and run the handshake if one is due. On success |*tot| is set to the
+ * number of bytes sent by previous calls and 1 is returned. Otherwise the
+ * return value is as per SSL_write().
  */
-int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
-                     size_t *written)
+static int ssl3_write_start(SSL *s, size_t len, size_t *tot)
 {
-    const unsigned char *buf = buf_;
-    size_t tot;
-    size_t n, max_send_fragment, split_send_fragment, maxpipes;
-#if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
-    size_t nw;
-#endif
     SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
     int i;
-    size_t tmpwrit;
 
     s->rwstate = SSL_NOTHING;
-    tot = s->rlayer.wnum;
+    *tot = s->rlayer.wnum;
     /*
      * ensure that if we end up with a smaller value of data to write out
      * than the original len from a write which didn't complete for
@@ -400,6 +403,30 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         }
     }
 
+    return 1;
+}
+
+/*
+ * Call this to write data in records of type 'type' It will return <= 0 if
+ * not all data has been sent or non-blocking IO.
+ */
+int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
+                     size_t *written)
+{
+    const unsigned char *buf = buf_;
+    size_t tot;
+    size_t n, max_send_fragment, split_send_fragment, maxpipes;
+#if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
+    size_t nw;
+#endif
+    SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
+    int i;
+    size_t tmpwrit;
+
+    i = ssl3_write_start(s, len, &tot);
+    if (i <= 0)
+        return i;
+
     /*
      * first check if there is a SSL3_BUFFER still being written out.  This
      * will happen with non blocking IO
@@ -562,7 +589,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
      * If max_pipelines is 0 then this means "undefined" and we default to
      * 1 pipeline. Similarly if the cipher does not support pipelined
      * processing then we also only use 1 pipeline, or if we're not using
-     * explicit IVs
+     * explicit IVs, or if the kernel does the record encryption
      */
     maxpipes = s->max_pipelines;
     if (maxpipes > SSL_MAX_PIPELINES) {
@@ -578,7 +605,8 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         || s->enc_write_ctx == NULL
         || !(EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(s->enc_write_ctx))
              & EVP_CIPH_FLAG_PIPELINE)
-        || !SSL_USE_EXPLICIT_IV(s))
+        || !SSL_USE_EXPLICIT_IV(s)
+        || BIO_get_ktls_send(s->wbio))
         maxpipes = 1;
     if (max_send_fragment == 0 || split_send_fragment == 0
         || split_send_fragment > max_send_fragment) {
@@ -653,6 +681,43 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
     }
 }
 
+/*
+ * Work out how many bytes of TLSv1.3 padding to add to a record of type |type|
+ * whose inner plaintext, including the content type, is |rlen| bytes long.
+ */
+static size_t ssl3_tls13_padding(SSL *s, int type, size_t rlen)
+{
+    size_t max_send_fragment = ssl_get_max_send_fragment(s);
+    size_t padding = 0;
+
+    if (rlen >= max_send_fragment)
+        return 0;
+
+    if (s->record_padding_cb != NULL) {
+        padding = s->record_padding_cb(s, type, rlen, s->record_padding_arg);
+    } else if (s->block_padding > 0) {
+        size_t mask = s->block_padding - 1;
+        size_t remainder;
+
+        /* optimize for power of 2 */
+        if ((s->block_padding & mask) == 0)
+            remainder = rlen & mask;
+        else
+            remainder = rlen % s->block_padding;
+        /* don't want to add a block of padding if we don't have to */
+        if (remainder == 0)
+            padding = 0;
+        else
+            padding = s->block_padding - remainder;
+    }
+
+    /* do not allow the record to exceed max plaintext length */
+    if (padding > max_send_fragment - rlen)
+        padding = max_send_fragment - rlen;
+
+    return padding;
+}
+
 int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                   size_t *pipelens, size_t numpipes,
                   int create_empty_fragment, size_t *written)
@@ -929,11 +994,16 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
             }
         }
 
+        /*
+         * With ktls the kernel adds the TLSv1.3 inner content type, which is
+         * passed down through BIO_set_ktls_ctrl_msg()
+         */
         if (SSL_TREAT_AS_TLS13(s)
+                && !BIO_get_ktls_send(s->wbio)
                 && s->enc_write_ctx != NULL
                 && (s->statem.enc_write_state != ENC_WRITE_STATE_WRITE_PLAIN_ALERTS
                     || type != SSL3_RT_ALERT)) {
-            size_t rlen, max_send_fragment;
+            size_t padding;
 
             if (!WPACKET_put_bytes_u8(thispkt, type)) {
                 SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
@@ -943,39 +1013,15 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
             SSL3_RECORD_add_length(thiswr, 1);
 
             /* Add TLS1.3 padding */
-            max_send_fragment = ssl_get_max_send_fragment(s);
-            rlen = SSL3_RECORD_get_length(thiswr);
-            if (rlen < max_send_fragment) {
-                size_t padding = 0;
-                size_t max_padding = max_send_fragment - rlen;
-                if (s->record_padding_cb != NULL) {
-                    padding = s->record_padding_cb(s, type, rlen, s->record_padding_arg);
-                } else if (s->block_padding > 0) {
-                    size_t mask = s->block_padding - 1;
-                    size_t remainder;
-
-                    /* optimize for power of 2 */
-                    if ((s->block_padding & mask) == 0)
-                        remainder = rlen & mask;
-                    else
-                        remainder = rlen % s->block_padding;
-                    /* don't want to add a block of padding if we don't have to */
-                    if (remainder == 0)
-                        padding = 0;
-                    else
-                        padding = s->block_padding - remainder;
-                }
-                if (padding > 0) {
-                    /* do not allow the record to exceed max plaintext length */
-                    if (padding > max_padding)
-                        padding = max_padding;
-                    if (!WPACKET_memset(thispkt, 0, padding)) {
-                        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
-                                 ERR_R_INTERNAL_ERROR);
-                        goto err;
-                    }
-                    SSL3_RECORD_add_length(thiswr, padding);
+            padding = ssl3_tls13_padding(s, type,
+                                         SSL3_RECORD_get_length(thiswr));
+            if (padding > 0) {
+                if (!WPACKET_memset(thispkt, 0, padding)) {
+                    SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
+                             ERR_R_INTERNAL_ERROR);
+                    goto err;
                 }
+                SSL3_RECORD_add_length(thiswr, padding);
             }
         }
 
@@ -1184,6 +1230,15 @@ int ssl3_write_pending(SSL *s, int type, const unsigned char *buf, size_t len,
             currbuf++;
             continue;
         }
+        /*
+         * The buffers are kept around after a write that used more pipelines,
+         * so the trailing ones may not have been used at all this time
+         */
+        if (SSL3_BUFFER_get_left(&wb[currbuf]) == 0 && currbuf > 0) {
+            s->rwstate = SSL_NOTHING;
+            *written = s->rlayer.wpend_ret;
+            return 1;
+        }
         clear_sys_error();
         if (s->wbio != NULL) {
             s->rwstate = SSL_WRITING;
@@ -1237,6 +1292,411 @@ int ssl3_write_pending(SSL *s, int type, const unsigned char *buf, size_t len,
     }
 }
 
+/*
+ * Whether records can be built straight from a gather list by
+ * ssl3_writev_bytes(). This needs a plain software record layer: no kernel
+ * offload, no compression and no CBC empty fragments.
+ */
+static int ssl3_writev_can_pack(SSL *s)
+{
+    return s->enc_write_ctx != NULL
+        && s->compress == NULL
+        && !s->s3.need_empty_fragments
+        && s->wbio != NULL
+        && !BIO_get_ktls_send(s->wbio);
+}
+
+/*
+ * Append one record of type |type| carrying the next |len| bytes of the
+ * gather list |iov| to |pkt|. |*idx| and |*off| locate the first byte to take
+ * and are moved past the bytes consumed. With TLSv1.3 the record is sealed
+ * straight from the caller's buffers, otherwise the cipher works in place and
+ * the plaintext is gathered into |pkt| first. Returns 1 on success or 0 on
+ * error.
+ */
+static int ssl3_seal_gather_record(SSL *s, int type, WPACKET *pkt,
+                                   size_t mac_size, size_t eivlen,
+                                   const SSL_IOVEC *iov, size_t *idx,
+                                   size_t *off, size_t len)
+{
+    SSL3_RECORD wr;
+    unsigned int version = (s->version == TLS1_3_VERSION) ? TLS1_2_VERSION
+                                                          : s->version;
+    int tls13 = SSL_TREAT_AS_TLS13(s);
+    unsigned int rectype = tls13 ? SSL3_RT_APPLICATION_DATA : type;
+    unsigned char *data, *recordstart, *mac;
+    size_t copied, chunk, reclen, origlen, padding, i, o, nsegs = 0;
+    SSL_IOVEC segs[SSL3_WRITEV_MAX_SEGMENTS + 1];
+    /* CCM can't be fed the plaintext in pieces */
+    int direct = tls13
+        && s->statem.enc_write_state != ENC_WRITE_STATE_WRITE_PLAIN_ALERTS
+        && EVP_CIPHER_CTX_mode(s->enc_write_ctx) != EVP_CIPH_CCM_MODE;
+
+    /* Count the caller's buffers the record spans */
+    i = *idx;
+    o = *off;
+    for (copied = 0; direct && copied < len; copied += chunk) {
+        chunk = iov[i].len - o;
+        if (chunk > len - copied)
+            chunk = len - copied;
+        if (chunk > 0 && ++nsegs > SSL3_WRITEV_MAX_SEGMENTS)
+            direct = 0;
+        i++;
+        o = 0;
+    }
+    nsegs = 0;
+
+    memset(&wr, 0, sizeof(wr));
+    SSL3_RECORD_set_type(&wr, rectype);
+    SSL3_RECORD_set_rec_version(&wr, version);
+
+    if (!WPACKET_put_bytes_u8(pkt, rectype)
+            || !WPACKET_put_bytes_u16(pkt, version)
+            || !WPACKET_start_sub_packet_u16(pkt)
+            || (eivlen > 0 && !WPACKET_allocate_bytes(pkt, eivlen, NULL))
+            || !WPACKET_allocate_bytes(pkt, len, &data)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_SEAL_GATHER_RECORD,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+
+    /* Gather the payload from the caller's buffers, or note where it is */
+    for (copied = 0; copied < len; copied += chunk) {
+        chunk = iov[*idx].len - *off;
+        if (chunk > len - copied)
+            chunk = len - copied;
+        if (!direct) {
+            memcpy(data + copied, (const unsigned char *)iov[*idx].buf + *off,
+                   chunk);
+        } else if (chunk > 0) {
+            segs[nsegs].buf = (const unsigned char *)iov[*idx].buf + *off;
+            segs[nsegs++].len = chunk;
+        }
+        *off += chunk;
+        if (*off == iov[*idx].len) {
+            (*idx)++;
+            *off = 0;
+        }
+    }
+    SSL3_RECORD_set_data(&wr, data);
+    SSL3_RECORD_reset_input(&wr);
+    SSL3_RECORD_set_length(&wr, len);
+
+    if (tls13) {
+        if (!WPACKET_put_bytes_u8(pkt, type)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_SEAL_GATHER_RECORD,
+                     ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+        SSL3_RECORD_add_length(&wr, 1);
+
+        padding = ssl3_tls13_padding(s, type, SSL3_RECORD_get_length(&wr));
+        if (padding > 0) {
+            if (!WPACKET_memset(pkt, 0, padding)) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                         SSL_F_SSL3_SEAL_GATHER_RECORD, ERR_R_INTERNAL_ERROR);
+                return 0;
+            }
+            SSL3_RECORD_add_length(&wr, padding);
+        }
+
+        /* The content type and padding are encrypted in place */
+        segs[nsegs].buf = data + len;
+        segs[nsegs++].len = SSL3_RECORD_get_length(&wr) - len;
+    }
+
+    if (!SSL_WRITE_ETM(s) && mac_size != 0) {
+        if (!WPACKET_allocate_bytes(pkt, mac_size, &mac)
+                || !s->method->ssl3_enc->mac(s, &wr, mac, 1)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_SEAL_GATHER_RECORD,
+                     ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+    }
+
+    /* Leave room for the cipher to grow the record, as do_ssl3_write() does */
+    if (!WPACKET_reserve_bytes(pkt, SSL_RT_MAX_CIPHER_BLOCK_SIZE, NULL)
+            || !WPACKET_get_length(pkt, &reclen)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_SEAL_GATHER_RECORD,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    recordstart = WPACKET_get_curr(pkt) - reclen;
+    SSL3_RECORD_set_data(&wr, recordstart);
+    SSL3_RECORD_reset_input(&wr);
+    SSL3_RECORD_set_length(&wr, reclen);
+
+    if (direct) {
+        if (tls13_enc_gather(s, &wr, segs, nsegs) < 1) {
+            if (!ossl_statem_in_error(s)) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                         SSL_F_SSL3_SEAL_GATHER_RECORD, ERR_R_INTERNAL_ERROR);
+            }
+            return 0;
+        }
+    } else if (s->statem.enc_write_state
+               == ENC_WRITE_STATE_WRITE_PLAIN_ALERTS) {
+        if (tls13_enc(s, &wr, 1, 1) < 1) {
+            if (!ossl_statem_in_error(s)) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                         SSL_F_SSL3_SEAL_GATHER_RECORD, ERR_R_INTERNAL_ERROR);
+            }
+            return 0;
+        }
+    } else if (s->method->ssl3_enc->enc(s, &wr, 1, 1) < 1) {
+        if (!ossl_statem_in_error(s)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_SEAL_GATHER_RECORD,
+                     ERR_R_INTERNAL_ERROR);
+        }
+        return 0;
+    }
+
+    if (!WPACKET_get_length(pkt, &origlen)
+               /* Encryption should never shrink the data! */
+            || origlen > wr.length
+            || (wr.length > origlen
+                && !WPACKET_allocate_bytes(pkt, wr.length - origlen, NULL))) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_SEAL_GATHER_RECORD,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    if (SSL_WRITE_ETM(s) && mac_size != 0) {
+        if (!WPACKET_allocate_bytes(pkt, mac_size, &mac)
+                || !s->method->ssl3_enc->mac(s, &wr, mac, 1)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_SEAL_GATHER_RECORD,
+                     ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+        SSL3_RECORD_add_length(&wr, mac_size);
+    }
+
+    if (!WPACKET_get_length(pkt, &reclen) || !WPACKET_close(pkt)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_SEAL_GATHER_RECORD,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+
+    if (s->msg_callback) {
+        recordstart = WPACKET_get_curr(pkt) - reclen - SSL3_RT_HEADER_LENGTH;
+        s->msg_callback(1, 0, SSL3_RT_HEADER, recordstart,
+                        SSL3_RT_HEADER_LENGTH, s, s->msg_callback_arg);
+
+        if (tls13) {
+            unsigned char ctype = type;
+
+            s->msg_callback(1, s->version, SSL3_RT_INNER_CONTENT_TYPE,
+                            &ctype, 1, s, s->msg_callback_arg);
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Write the buffers in |iov| one after the other with ssl3_write_bytes(). The
+ * progress over the whole list is kept in s->rlayer.wnum between calls, in
+ * the same way as ssl3_writev_bytes() does.
+ */
+static int ssl3_writev_each(SSL *s, int type, const SSL_IOVEC *iov,
+                            size_t iovcnt, size_t *written)
+{
+    size_t off = s->rlayer.wnum, base = 0, tmpwrit, i;
+    int ret;
+
+    /* Skip over the buffers that have been written out already */
+    for (i = 0; i < iovcnt && off >= iov[i].len; i++) {
+        off -= iov[i].len;
+        base += iov[i].len;
+    }
+
+    for (; i < iovcnt; i++) {
+        s->rlayer.wnum = off;
+        ret = ssl3_write_bytes(s, type, iov[i].buf, iov[i].len, &tmpwrit);
+        if (ret <= 0) {
+            /* SSLfatal() already called if appropriate */
+            s->rlayer.wnum += base;
+            return ret;
+        }
+        if (tmpwrit < iov[i].len) {
+            /* SSL_MODE_ENABLE_PARTIAL_WRITE */
+            *written = base + tmpwrit;
+            return 1;
+        }
+        base += iov[i].len;
+        off = 0;
+    }
+
+    *written = base;
+    return 1;
+}
+
+/*
+ * Write the concatenation of the |iovcnt| buffers in |iov| in records of type
+ * |type|. Records are filled to the maximum fragment length straight from the
+ * caller's buffers, so that small buffers don't end up in records of their
+ * own, and up to SSL3_WRITEV_MAX_RECORDS records are packed into the write
+ * buffer and handed to the BIO with a single write.
+ *
+ * Return values are as per ssl3_write_bytes(). On retry the same |iov| must be
+ * passed again, unless SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER is set.
+ */
+int ssl3_writev_bytes(SSL *s, int type, const SSL_IOVEC *iov, size_t iovcnt,
+                      size_t *written)
+{
+    /* The gather list identifies the write for the bad write retry check */
+    const unsigned char *wid = (const unsigned char *)iov;
+    SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
+    WPACKET pkt;
+    size_t len = 0, tot, n, nw, reclen, packlen, tmpwrit;
+    size_t max_send_fragment, align = 0, mac_size = 0, eivlen = 0;
+    size_t idx, off, i;
+    int ret;
+
+    for (i = 0; i < iovcnt; i++)
+        len += iov[i].len;
+
+    if (!ssl3_writev_can_pack(s))
+        return ssl3_writev_each(s, type, iov, iovcnt, written);
+
+    ret = ssl3_write_start(s, len, &tot);
+    if (ret <= 0)
+        return ret;
+
+    if (wb->left != 0) {
+        /* SSLfatal() already called if appropriate */
+        ret = ssl3_write_pending(s, type, wid, s->rlayer.wpend_tot, &tmpwrit);
+        if (ret <= 0) {
+            s->rlayer.wnum = tot;
+            return ret;
+        }
+        tot += tmpwrit;
+    } else if (!ssl3_writev_can_pack(s)) {
+        /* The handshake we just ran changed the way records get written */
+        s->rlayer.wnum = tot;
+        return ssl3_writev_each(s, type, iov, iovcnt, written);
+    }
+
+    if (tot == len) {
+        if (s->mode & SSL_MODE_RELEASE_BUFFERS)
+            ssl3_release_write_buffer(s);
+        *written = tot;
+        return 1;
+    }
+
+    max_send_fragment = ssl_get_max_send_fragment(s);
+    if (EVP_MD_CTX_md(s->write_hash) != NULL) {
+        int mac_sizei = EVP_MD_CTX_size(s->write_hash);
+
+        if (mac_sizei < 0) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_WRITEV_BYTES,
+                     ERR_R_INTERNAL_ERROR);
+            return -1;
+        }
+        mac_size = (size_t)mac_sizei;
+    }
+    if (SSL_USE_EXPLICIT_IV(s) && !SSL_TREAT_AS_TLS13(s)) {
+        int mode = EVP_CIPHER_CTX_mode(s->enc_write_ctx);
+
+        if (mode == EVP_CIPH_CBC_MODE) {
+            eivlen = EVP_CIPHER_CTX_iv_length(s->enc_write_ctx);
+            if (eivlen <= 1)
+                eivlen = 0;
+        } else if (mode == EVP_CIPH_GCM_MODE) {
+            eivlen = EVP_GCM_TLS_EXPLICIT_IV_LEN;
+        } else if (mode == EVP_CIPH_CCM_MODE) {
+            eivlen = EVP_CCM_TLS_EXPLICIT_IV_LEN;
+        }
+    }
+
+    /* Room for the largest records we may pack, whatever the cipher */
+    packlen = SSL3_WRITEV_MAX_RECORDS
+              * (SSL3_RT_HEADER_LENGTH + max_send_fragment
+                 + 2 * SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD);
+#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD != 0
+    packlen += SSL3_ALIGN_PAYLOAD - 1;
+#endif
+    if (s->rlayer.numwpipes != 1 || wb->buf == NULL || wb->len < packlen) {
+        ssl3_release_write_buffer(s);
+        if (!ssl3_setup_write_buffer(s, 1, packlen)) {
+            /* SSLfatal() already called */
+            return -1;
+        }
+    }
+
+    /* Find where we got to in the gather list */
+    off = tot;
+    for (idx = 0; off >= iov[idx].len && off > 0; idx++)
+        off -= iov[idx].len;
+
+    n = len - tot;
+    for (;;) {
+        if (s->s3.alert_dispatch) {
+            ret = s->method->ssl_dispatch_alert(s);
+            if (ret <= 0) {
+                /* SSLfatal() already called if appropriate */
+                s->rlayer.wnum = tot;
+                return ret;
+            }
+        }
+
+#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD != 0
+        align = (size_t)SSL3_BUFFER_get_buf(wb) + SSL3_RT_HEADER_LENGTH;
+        align = SSL3_ALIGN_PAYLOAD - 1 - ((align - 1) % SSL3_ALIGN_PAYLOAD);
+#endif
+        SSL3_BUFFER_set_offset(wb, align);
+        if (!WPACKET_init_static_len(&pkt, SSL3_BUFFER_get_buf(wb),
+                                     SSL3_BUFFER_get_len(wb), 0)
+                || !WPACKET_allocate_bytes(&pkt, align, NULL)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_WRITEV_BYTES,
+                     ERR_R_INTERNAL_ERROR);
+            return -1;
+        }
+
+        for (i = 0, nw = 0; i < SSL3_WRITEV_MAX_RECORDS && nw < n; i++) {
+            reclen = n - nw;
+            if (reclen > max_send_fragment)
+                reclen = max_send_fragment;
+            if (!ssl3_seal_gather_record(s, type, &pkt, mac_size, eivlen,
+                                         iov, &idx, &off, reclen)) {
+                /* SSLfatal() already called */
+                WPACKET_cleanup(&pkt);
+                return -1;
+            }
+            nw += reclen;
+        }
+
+        if (!WPACKET_get_total_written(&pkt, &packlen)
+                || !WPACKET_finish(&pkt)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_WRITEV_BYTES,
+                     ERR_R_INTERNAL_ERROR);
+            WPACKET_cleanup(&pkt);
+            return -1;
+        }
+        SSL3_BUFFER_set_left(wb, packlen - align);
+
+        s->rlayer.wpend_tot = nw;
+        s->rlayer.wpend_buf = wid;
+        s->rlayer.wpend_type = type;
+        s->rlayer.wpend_ret = nw;
+
+        ret = ssl3_write_pending(s, type, wid, nw, &tmpwrit);
+        if (ret <= 0) {
+            /* SSLfatal() already called if appropriate */
+            s->rlayer.wnum = tot;
+            return ret;
+        }
+        tot += tmpwrit;
+        n -= tmpwrit;
+
+        if (n == 0 || (s->mode & SSL_MODE_ENABLE_PARTIAL_WRITE)) {
+            if (n == 0 && (s->mode & SSL_MODE_RELEASE_BUFFERS) != 0)
+                ssl3_release_write_buffer(s);
+            *written = tot;
+            return 1;
+        }
+    }
+}
+
 /*-
  * Return up to 'len' payload bytes received in 'type' records.
  * 'type' is one of the following:
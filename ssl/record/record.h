@@ -29,6 +29,14 @@ typedef struct ssl3_buffer_st {
 
 #define SEQ_NUM_SIZE                            8
 
+/* Maximum number of records ssl3_writev_bytes() hands to the BIO at once */
+#define SSL3_WRITEV_MAX_RECORDS                 4
+/*
+ * Maximum number of caller's buffers a TLSv1.3 record can be sealed from
+ * directly, beyond that the plaintext is gathered into the write buffer first
+ */
+#define SSL3_WRITEV_MAX_SEGMENTS                16
+
 typedef struct ssl3_record_st {
     /* Record layer version */
     /* r */
@@ -204,6 +212,8 @@ size_t RECORD_LAYER_get_rrec_length(RECORD_LAYER *rl);
 __owur size_t ssl3_pending(const SSL *s);
 __owur int ssl3_write_bytes(SSL *s, int type, const void *buf, size_t len,
                             size_t *written);
+__owur int ssl3_writev_bytes(SSL *s, int type, const SSL_IOVEC *iov,
+                             size_t iovcnt, size_t *written);
 int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                   size_t *pipelens, size_t numpipes,
                   int create_empty_fragment, size_t *written);
@@ -218,6 +228,8 @@ __owur int ssl3_write_pending(SSL *s, int type, const unsigned char *buf, size_t
 __owur int tls1_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int send);
 __owur int tls1_mac(SSL *ssl, SSL3_RECORD *rec, unsigned char *md, int send);
 __owur int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int send);
+__owur int tls13_enc_gather(SSL *s, SSL3_RECORD *rec, const SSL_IOVEC *in,
+                            size_t nin);
 int DTLS_RECORD_LAYER_new(RECORD_LAYER *rl);
 void DTLS_RECORD_LAYER_free(RECORD_LAYER *rl);
 void DTLS_RECORD_LAYER_clear(RECORD_LAYER *rl);
@@ -187,11 +187,16 @@ int ssl3_get_record(SSL *s)
     size_t num_recs = 0, max_recs, j;
     PACKET pkt, sslv2pkt;
     size_t first_rec_len;
-    int is_ktls_left;
+    int is_ktls_left, using_ktls;
 
     rr = RECORD_LAYER_get_rrec(&s->rlayer);
     rbuf = RECORD_LAYER_get_rbuf(&s->rlayer);
     is_ktls_left = (rbuf->left > 0);
+    /*
+     * KTLS reads full records. If there is any data left,
+     * then it is from before enabling ktls
+     */
+    using_ktls = BIO_get_ktls_recv(s->rbio) && !is_ktls_left;
     max_recs = s->max_pipelines;
     if (max_recs == 0)
         max_recs = 1;
@@ -366,7 +371,12 @@ int ssl3_get_record(SSL *s)
                     }
                 }
 
-                if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL) {
+                /*
+                 * With ktls the kernel has already removed the TLSv1.3 record
+                 * protection and reports the inner content type
+                 */
+                if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL
+                        && !using_ktls) {
                     if (thisrr->type != SSL3_RT_APPLICATION_DATA
                             && (thisrr->type != SSL3_RT_CHANGE_CIPHER_SPEC
                                 || !SSL_IS_FIRST_HANDSHAKE(s))
@@ -487,6 +497,7 @@ int ssl3_get_record(SSL *s)
              && s->enc_read_ctx != NULL
              && (EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(s->enc_read_ctx))
                  & EVP_CIPH_FLAG_PIPELINE)
+             && !using_ktls
              && ssl3_record_app_data_waiting(s));
 
     if (num_recs == 1
@@ -519,11 +530,7 @@ int ssl3_get_record(SSL *s)
         return 1;
     }
 
-    /*
-     * KTLS reads full records. If there is any data left,
-     * then it is from before enabling ktls
-     */
-    if (BIO_get_ktls_recv(s->rbio) && !is_ktls_left)
+    if (using_ktls)
         goto skip_decryption;
 
     /*
@@ -729,6 +736,7 @@ int ssl3_get_record(SSL *s)
 
         if (SSL_IS_TLS13(s)
                 && s->enc_read_ctx != NULL
+                && !using_ktls
                 && thisrr->type != SSL3_RT_ALERT) {
             size_t end;
 
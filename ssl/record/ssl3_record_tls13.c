@@ -11,37 +11,23 @@
 #include "record_locl.h"
 #include "internal/cryptlib.h"
 
-/*-
- * tls13_enc encrypts/decrypts |n_recs| in |recs|. Will call SSLfatal() for
- * internal errors, but not otherwise.
- *
- * Returns:
- *    0: (in non-constant time) if the record is publically invalid (i.e. too
- *        short etc).
- *    1: if the record encryption was successful.
- *   -1: if the record's AEAD-authenticator is invalid or, if sending,
- *       an internal error occurred.
+/*
+ * Encrypt or decrypt |rec|. If |in| isn't NULL the plaintext is taken from the
+ * |nin| buffers there instead of rec->input, in order, and their lengths must
+ * add up to rec->length. Return values are as per tls13_enc().
  */
-int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
+static int tls13_cipher(SSL *s, SSL3_RECORD *rec, const SSL_IOVEC *in,
+                        size_t nin, int sending)
 {
     EVP_CIPHER_CTX *ctx;
     unsigned char iv[EVP_MAX_IV_LENGTH], recheader[SSL3_RT_HEADER_LENGTH];
-    size_t ivlen, taglen, offset, loop, hdrlen;
+    size_t ivlen, taglen, offset, loop, hdrlen, total;
     unsigned char *staticiv;
     unsigned char *seq;
     int lenu, lenf;
-    SSL3_RECORD *rec = &recs[0];
     uint32_t alg_enc;
     WPACKET wpkt;
 
-    if (n_recs != 1) {
-        /* Should not happen */
-        /* TODO(TLS1.3): Support pipelining */
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_ENC,
-                 ERR_R_INTERNAL_ERROR);
-        return -1;
-    }
-
     if (sending) {
         ctx = s->enc_write_ctx;
         staticiv = s->write_iv;
@@ -59,6 +45,12 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
      * far then we have already validated that a plaintext alert is ok here.
      */
     if (ctx == NULL || rec->type == SSL3_RT_ALERT) {
+        if (in != NULL) {
+            /* Should not happen */
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_ENC,
+                     ERR_R_INTERNAL_ERROR);
+            return -1;
+        }
         memmove(rec->data, rec->input, rec->length);
         rec->input = rec->data;
         return 1;
@@ -174,11 +166,24 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
                  && EVP_CipherUpdate(ctx, NULL, &lenu, NULL,
                                      (unsigned int)rec->length) <= 0)
             || EVP_CipherUpdate(ctx, NULL, &lenu, recheader,
-                                sizeof(recheader)) <= 0
-            || EVP_CipherUpdate(ctx, rec->data, &lenu, rec->input,
-                                (unsigned int)rec->length) <= 0
-            || EVP_CipherFinal_ex(ctx, rec->data + lenu, &lenf) <= 0
-            || (size_t)(lenu + lenf) != rec->length) {
+                                sizeof(recheader)) <= 0) {
+        return -1;
+    }
+    if (in == NULL) {
+        if (EVP_CipherUpdate(ctx, rec->data, &lenu, rec->input,
+                             (unsigned int)rec->length) <= 0)
+            return -1;
+        total = lenu;
+    } else {
+        for (loop = 0, total = 0; loop < nin; loop++) {
+            if (EVP_CipherUpdate(ctx, rec->data + total, &lenu, in[loop].buf,
+                                 (unsigned int)in[loop].len) <= 0)
+                return -1;
+            total += lenu;
+        }
+    }
+    if (EVP_CipherFinal_ex(ctx, rec->data + total, &lenf) <= 0
+            || total + lenf != rec->length) {
         return -1;
     }
     if (sending) {
@@ -194,3 +199,39 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
 
     return 1;
 }
+
+/*-
+ * tls13_enc encrypts/decrypts |n_recs| in |recs|. Will call SSLfatal() for
+ * internal errors, but not otherwise.
+ *
+ * Returns:
+ *    0: (in non-constant time) if the record is publically invalid (i.e. too
+ *        short etc).
+ *    1: if the record encryption was successful.
+ *   -1: if the record's AEAD-authenticator is invalid or, if sending,
+ *       an internal error occurred.
+ */
+int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
+{
+    if (n_recs != 1) {
+        /* Should not happen */
+        /* TODO(TLS1.3): Support pipelining */
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_ENC,
+                 ERR_R_INTERNAL_ERROR);
+        return -1;
+    }
+    return tls13_cipher(s, recs, NULL, 0, sending);
+}
+
+/*
+ * Encrypt the record |rec| straight from the |nin| plaintext buffers in |in|,
+ * into rec->data. The buffers may include part of rec->data itself, as long as
+ * they are at the place where their ciphertext goes. CCM needs the whole
+ * plaintext in one go and can't be used this way. Return values are as per
+ * tls13_enc().
+ */
+int tls13_enc_gather(SSL *s, SSL3_RECORD *rec, const SSL_IOVEC *in,
+                     size_t nin)
+{
+    return tls13_cipher(s, rec, in, nin, 1);
+}
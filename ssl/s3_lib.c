@@ -4447,6 +4447,16 @@ int ssl3_write(SSL *s, const void *buf, size_t len, size_t *written)
                                       written);
 }
 
+int ssl3_writev(SSL *s, const SSL_IOVEC *iov, size_t iovcnt, size_t *written)
+{
+    clear_sys_error();
+    if (s->s3.renegotiate)
+        ssl3_renegotiate_check(s, 0);
+
+    return ssl3_writev_bytes(s, SSL3_RT_APPLICATION_DATA, iov, iovcnt,
+                             written);
+}
+
 static int ssl3_read_internal(SSL *s, void *buf, size_t len, int peek,
                               size_t *readbytes)
 {
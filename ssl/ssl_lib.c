@@ -107,10 +107,11 @@ struct ssl_async_args {
     SSL *s;
     void *buf;
     size_t num;
-    enum { READFUNC, WRITEFUNC, OTHERFUNC } type;
+    enum { READFUNC, WRITEFUNC, WRITEVFUNC, OTHERFUNC } type;
     union {
         int (*func_read) (SSL *, void *, size_t, size_t *);
         int (*func_write) (SSL *, const void *, size_t, size_t *);
+        int (*func_writev) (SSL *, const SSL_IOVEC *, size_t, size_t *);
         int (*func_other) (SSL *);
     } f;
 };
@@ -928,7 +929,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
      * any new session built out of this id/id_len and the ssl_version in use
      * by this SSL.
      */
-    SSL_SESSION r, *p;
+    SSL_SESSION r;
 
     if (id_len > sizeof(r.session_id))
         return 0;
@@ -937,10 +938,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
     r.session_id_length = id_len;
     memcpy(r.session_id, id, id_len);
 
-    CRYPTO_THREAD_read_lock(ssl->session_ctx->lock);
-    p = lh_SSL_SESSION_retrieve(ssl->session_ctx->sessions, &r);
-    CRYPTO_THREAD_unlock(ssl->session_ctx->lock);
-    return (p != NULL);
+    return ssl_session_cache_has(ssl->session_ctx, &r);
 }
 
 int SSL_CTX_set_purpose(SSL_CTX *s, int purpose)
@@ -1781,6 +1779,8 @@ static int ssl_io_intern(void *vargs)
         return args->f.func_read(s, buf, num, &s->asyncrw);
     case WRITEFUNC:
         return args->f.func_write(s, buf, num, &s->asyncrw);
+    case WRITEVFUNC:
+        return args->f.func_writev(s, buf, num, &s->asyncrw);
     case OTHERFUNC:
         return args->f.func_other(s);
     }
@@ -2117,6 +2117,65 @@ int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written)
     return ret;
 }
 
+int SSL_writev(SSL *s, const SSL_IOVEC *iov, size_t iovcnt, size_t *written)
+{
+    size_t len = 0, i;
+    int ret;
+
+    for (i = 0; i < iovcnt; i++) {
+        if ((iov[i].buf == NULL && iov[i].len != 0)
+                || iov[i].len > SIZE_MAX - len) {
+            SSLerr(SSL_F_SSL_WRITEV, SSL_R_BAD_LENGTH);
+            return 0;
+        }
+        len += iov[i].len;
+    }
+
+    if (SSL_IS_DTLS(s)) {
+        SSLerr(SSL_F_SSL_WRITEV, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return 0;
+    }
+
+    if (s->handshake_func == NULL) {
+        SSLerr(SSL_F_SSL_WRITEV, SSL_R_UNINITIALIZED);
+        return 0;
+    }
+
+    if (s->shutdown & SSL_SENT_SHUTDOWN) {
+        s->rwstate = SSL_NOTHING;
+        SSLerr(SSL_F_SSL_WRITEV, SSL_R_PROTOCOL_IS_SHUTDOWN);
+        return 0;
+    }
+
+    if (s->early_data_state == SSL_EARLY_DATA_CONNECT_RETRY
+                || s->early_data_state == SSL_EARLY_DATA_ACCEPT_RETRY
+                || s->early_data_state == SSL_EARLY_DATA_READ_RETRY) {
+        SSLerr(SSL_F_SSL_WRITEV, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return 0;
+    }
+    /* If we are a client and haven't sent the Finished we better do that */
+    ossl_statem_check_finish_init(s, 1);
+
+    if ((s->mode & SSL_MODE_ASYNC) && ASYNC_get_current_job() == NULL) {
+        struct ssl_async_args args;
+
+        args.s = s;
+        args.buf = (void *)iov;
+        args.num = iovcnt;
+        args.type = WRITEVFUNC;
+        args.f.func_writev = ssl3_writev;
+
+        ret = ssl_start_async_job(s, &args, ssl_io_intern);
+        *written = s->asyncrw;
+    } else {
+        ret = ssl3_writev(s, iov, iovcnt, written);
+    }
+
+    if (ret < 0)
+        ret = 0;
+    return ret;
+}
+
 int SSL_write_early_data(SSL *s, const void *buf, size_t num, size_t *written)
 {
     int ret, early_data_state;
@@ -2459,13 +2518,16 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         return (long)ctx->session_cache_size;
     case SSL_CTRL_SET_SESS_CACHE_MODE:
         l = ctx->session_cache_mode;
+        if (!ssl_session_cache_set_sharded(ctx,
+                                           (larg & SSL_SESS_CACHE_SHARDED) != 0))
+            larg &= ~SSL_SESS_CACHE_SHARDED;
         ctx->session_cache_mode = larg;
         return l;
     case SSL_CTRL_GET_SESS_CACHE_MODE:
         return ctx->session_cache_mode;
 
     case SSL_CTRL_SESS_NUMBER:
-        return lh_SSL_SESSION_num_items(ctx->sessions);
+        return (long)ssl_session_cache_num_items(ctx);
     case SSL_CTRL_SESS_CONNECT:
         return tsan_load(&ctx->stats.sess_connect);
     case SSL_CTRL_SESS_CONNECT_GOOD:
@@ -2993,7 +3055,7 @@ int SSL_export_keying_material_early(SSL *s, unsigned char *out, size_t olen,
                                               context, contextlen);
 }
 
-static unsigned long ssl_session_hash(const SSL_SESSION *a)
+unsigned long ssl_session_hash(const SSL_SESSION *a)
 {
     const unsigned char *session_id = a->session_id;
     unsigned long l;
@@ -3020,7 +3082,7 @@ static unsigned long ssl_session_hash(const SSL_SESSION *a)
  * being able to construct an SSL_SESSION that will collide with any existing
  * session with a matching session ID.
  */
-static int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
+int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
 {
     if (a->ssl_version != b->ssl_version)
         return 1;
@@ -3266,7 +3328,9 @@ void SSL_CTX_free(SSL_CTX *a)
         SSL_CTX_flush_sessions(a, 0);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_SSL_CTX, a, &a->ex_data);
-    lh_SSL_SESSION_free(a->sessions);
+    ssl_session_cache_free(a);
+    ssl_shared_sess_cache_free(a->shared_sess_cache);
+    ssl_ticket_ring_free(a->ext.tick_ring);
     X509_STORE_free(a->cert_store);
 #ifndef OPENSSL_NO_CT
     CTLOG_STORE_free(a->ctlog_store);
@@ -3552,15 +3616,21 @@ void ssl_update_cache(SSL *s, int mode)
          * - the application has set a remove_session_cb so needs to know about
          *   session timeout events
          * - SSL_OP_NO_TICKET is set in which case it is a stateful ticket
+         *
+         * The shared cache is a store of its own, so it doesn't depend on
+         * SSL_SESS_CACHE_NO_INTERNAL_STORE.
          */
-        if ((i & SSL_SESS_CACHE_NO_INTERNAL_STORE) == 0
-                && (!SSL_IS_TLS13(s)
-                    || !s->server
-                    || (s->max_early_data > 0
-                        && (s->options & SSL_OP_NO_ANTI_REPLAY) == 0)
-                    || s->session_ctx->remove_session_cb != NULL
-                    || (s->options & SSL_OP_NO_TICKET) != 0))
-            SSL_CTX_add_session(s->session_ctx, s->session);
+        if (!SSL_IS_TLS13(s)
+                || !s->server
+                || (s->max_early_data > 0
+                    && (s->options & SSL_OP_NO_ANTI_REPLAY) == 0)
+                || s->session_ctx->remove_session_cb != NULL
+                || (s->options & SSL_OP_NO_TICKET) != 0) {
+            if ((i & SSL_SESS_CACHE_NO_INTERNAL_STORE) == 0)
+                SSL_CTX_add_session(s->session_ctx, s->session);
+            if (s->server)
+                ssl_shared_sess_add(s->session_ctx, s->session);
+        }
 
         /*
          * Add the session to the external cache. We do this even in server side
@@ -737,6 +737,23 @@ typedef struct ssl_ctx_ext_secure_st {
     unsigned char tick_aes_key[TLSEXT_TICK_KEY_LENGTH];
 } SSL_CTX_EXT_SECURE;
 
+/*
+ * Number of independently locked segments the internal session cache is
+ * split into when SSL_SESS_CACHE_SHARDED is set.
+ */
+# define SSL_SESS_CACHE_NUM_SHARDS 16
+
+typedef struct ssl_shared_sess_cache_st SSL_SHARED_SESS_CACHE;
+typedef struct ssl_ticket_ring_st SSL_TICKET_RING;
+
+/* One segment of a sharded session cache */
+typedef struct ssl_sess_shard_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(SSL_SESSION) *sessions;
+    struct ssl_session_st *session_cache_head;
+    struct ssl_session_st *session_cache_tail;
+} SSL_SESS_SHARD;
+
 struct ssl_ctx_st {
     const SSL_METHOD *method;
     STACK_OF(SSL_CIPHER) *cipher_list;
@@ -753,6 +770,14 @@ struct ssl_ctx_st {
     size_t session_cache_size;
     struct ssl_session_st *session_cache_head;
     struct ssl_session_st *session_cache_tail;
+    /*
+     * With SSL_SESS_CACHE_SHARDED the sessions are held in these
+     * SSL_SESS_CACHE_NUM_SHARDS segments instead of |sessions| above, each
+     * guarded by its own lock rather than by |lock|.
+     */
+    SSL_SESS_SHARD *sess_shards;
+    /* Session cache shared with other processes, or NULL */
+    SSL_SHARED_SESS_CACHE *shared_sess_cache;
     /*
      * This can have one of 2 values, ored together, SSL_SESS_CACHE_CLIENT,
      * SSL_SESS_CACHE_SERVER, Default is SSL_SESSION_CACHE_SERVER, which
@@ -934,6 +959,11 @@ struct ssl_ctx_st {
         /* RFC 4507 session ticket keys */
         unsigned char tick_key_name[TLSEXT_KEYNAME_LENGTH];
         SSL_CTX_EXT_SECURE *secure;
+        /*
+         * Automatically rotated ticket keys. If set these are used instead
+         * of the ones above.
+         */
+        SSL_TICKET_RING *tick_ring;
         /* Callback to support customisation of ticket key setting */
         int (*ticket_key_cb) (SSL *ssl,
                               unsigned char *name, unsigned char *iv,
@@ -2281,6 +2311,25 @@ __owur SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
                                          size_t sess_id_len);
 __owur int ssl_get_prev_session(SSL *s, CLIENTHELLO_MSG *hello);
 __owur SSL_SESSION *ssl_session_dup(const SSL_SESSION *src, int ticket);
+unsigned long ssl_session_hash(const SSL_SESSION *a);
+int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b);
+__owur int ssl_session_cache_set_sharded(SSL_CTX *ctx, int sharded);
+size_t ssl_session_cache_num_items(SSL_CTX *ctx);
+int ssl_session_cache_has(SSL_CTX *ctx, const SSL_SESSION *key);
+void ssl_session_cache_free(SSL_CTX *ctx);
+void ssl_shared_sess_cache_free(SSL_SHARED_SESS_CACHE *c);
+int ssl_shared_sess_add(SSL_CTX *ctx, SSL_SESSION *sess);
+SSL_SESSION *ssl_shared_sess_lookup(SSL_CTX *ctx, int version,
+                                    const unsigned char *id, size_t id_len);
+void ssl_shared_sess_remove(SSL_CTX *ctx, const SSL_SESSION *sess);
+void ssl_ticket_ring_free(SSL_TICKET_RING *ring);
+__owur int ssl_ticket_ring_encrypt_init(SSL_CTX *tctx, unsigned char *key_name,
+                                        unsigned char *iv, int *iv_len,
+                                        EVP_CIPHER_CTX *ctx, HMAC_CTX *hctx);
+__owur int ssl_ticket_ring_decrypt_init(SSL_CTX *tctx,
+                                        const unsigned char *etick,
+                                        EVP_CIPHER_CTX *ctx, HMAC_CTX *hctx,
+                                        int *renew);
 __owur int ssl_cipher_id_cmp(const SSL_CIPHER *a, const SSL_CIPHER *b);
 DECLARE_OBJ_BSEARCH_GLOBAL_CMP_FN(SSL_CIPHER, SSL_CIPHER, ssl_cipher_id);
 __owur int ssl_cipher_ptr_id_cmp(const SSL_CIPHER *const *ap,
@@ -2389,6 +2438,8 @@ void ssl3_free(SSL *s);
 __owur int ssl3_read(SSL *s, void *buf, size_t len, size_t *readbytes);
 __owur int ssl3_peek(SSL *s, void *buf, size_t len, size_t *readbytes);
 __owur int ssl3_write(SSL *s, const void *buf, size_t len, size_t *written);
+__owur int ssl3_writev(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                       size_t *written);
 __owur int ssl3_shutdown(SSL *s);
 int ssl3_clear(SSL *s);
 __owur long ssl3_ctrl(SSL *s, int cmd, long larg, void *parg);
@@ -2481,6 +2532,15 @@ __owur size_t tls13_final_finish_mac(SSL *s, const char *str, size_t slen,
                                      unsigned char *p);
 __owur int tls13_change_cipher_state(SSL *s, int which);
 __owur int tls13_update_key(SSL *s, int send);
+#  ifndef OPENSSL_NO_KTLS
+union tls_crypto_info_all;
+__owur int ktls_check_supported_cipher(const SSL *s, const EVP_CIPHER *c);
+__owur int ktls_configure_crypto(SSL *s, const EVP_CIPHER *c,
+                                 EVP_CIPHER_CTX *dd, int which,
+                                 const unsigned char *iv,
+                                 const unsigned char *key,
+                                 union tls_crypto_info_all *crypto_info);
+#  endif
 __owur int tls13_hkdf_expand(SSL *s, const EVP_MD *md,
                              const unsigned char *secret,
                              const unsigned char *label, size_t labellen,
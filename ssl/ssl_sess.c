@@ -16,10 +16,76 @@
 #include "ssl_locl.h"
 #include "statem/statem_locl.h"
 
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s);
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s);
+/*
+ * The part of the internal session cache that a session is kept in: either
+ * the SSL_CTX itself, or one of its shards if SSL_SESS_CACHE_SHARDED is set.
+ */
+typedef struct {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(SSL_SESSION) *sessions;
+    SSL_SESSION **head;
+    SSL_SESSION **tail;
+} SESS_CACHE;
+
+static void SSL_SESSION_list_remove(SESS_CACHE *cache, SSL_SESSION *s);
+static void SSL_SESSION_list_add(SESS_CACHE *cache, SSL_SESSION *s);
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck);
 
+static size_t sess_cache_num(const SSL_CTX *ctx)
+{
+    return ctx->sess_shards == NULL ? 1 : SSL_SESS_CACHE_NUM_SHARDS;
+}
+
+static void sess_cache_get(SSL_CTX *ctx, size_t idx, SESS_CACHE *cache)
+{
+    if (ctx->sess_shards == NULL) {
+        cache->lock = ctx->lock;
+        cache->sessions = ctx->sessions;
+        cache->head = &ctx->session_cache_head;
+        cache->tail = &ctx->session_cache_tail;
+    } else {
+        SSL_SESS_SHARD *shard = &ctx->sess_shards[idx];
+
+        cache->lock = shard->lock;
+        cache->sessions = shard->sessions;
+        cache->head = &shard->session_cache_head;
+        cache->tail = &shard->session_cache_tail;
+    }
+}
+
+/*
+ * Pick the shard for |s|. This hashes the whole session ID (FNV-1a) rather
+ * than reusing ssl_session_hash(), which only looks at the first four bytes
+ * and is what each shard's hash table buckets on.
+ */
+static size_t sess_cache_index(const SSL_CTX *ctx, const SSL_SESSION *s)
+{
+    uint32_t h = 0x811c9dc5;
+    size_t i;
+
+    if (ctx->sess_shards == NULL)
+        return 0;
+    for (i = 0; i < s->session_id_length; i++) {
+        h ^= s->session_id[i];
+        h *= 0x01000193;
+    }
+    return h % SSL_SESS_CACHE_NUM_SHARDS;
+}
+
+static void sess_cache_find(SSL_CTX *ctx, const SSL_SESSION *s,
+                            SESS_CACHE *cache)
+{
+    sess_cache_get(ctx, sess_cache_index(ctx, s), cache);
+}
+
+/* The most sessions each part of the cache may hold, 0 is unlimited */
+static size_t sess_cache_limit(const SSL_CTX *ctx)
+{
+    size_t n = sess_cache_num(ctx);
+
+    return (ctx->session_cache_size + n - 1) / n;
+}
+
 /*
  * SSL_get_session() and SSL_get1_session() are problematic in TLS1.3 because,
  * unlike in earlier protocol versions, the session ticket may not have been
@@ -424,6 +490,7 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
     if ((s->session_ctx->session_cache_mode
          & SSL_SESS_CACHE_NO_INTERNAL_LOOKUP) == 0) {
         SSL_SESSION data;
+        SESS_CACHE cache;
 
         data.ssl_version = s->version;
         if (!ossl_assert(sess_id_len <= SSL_MAX_SSL_SESSION_ID_LENGTH))
@@ -432,17 +499,29 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
         memcpy(data.session_id, sess_id, sess_id_len);
         data.session_id_length = sess_id_len;
 
-        CRYPTO_THREAD_read_lock(s->session_ctx->lock);
-        ret = lh_SSL_SESSION_retrieve(s->session_ctx->sessions, &data);
+        sess_cache_find(s->session_ctx, &data, &cache);
+        CRYPTO_THREAD_read_lock(cache.lock);
+        ret = lh_SSL_SESSION_retrieve(cache.sessions, &data);
         if (ret != NULL) {
             /* don't allow other threads to steal it: */
             SSL_SESSION_up_ref(ret);
         }
-        CRYPTO_THREAD_unlock(s->session_ctx->lock);
+        CRYPTO_THREAD_unlock(cache.lock);
         if (ret == NULL)
             tsan_counter(&s->session_ctx->stats.sess_miss);
     }
 
+    /* The shared cache doesn't depend on SSL_SESS_CACHE_NO_INTERNAL_LOOKUP */
+    if (ret == NULL) {
+        ret = ssl_shared_sess_lookup(s->session_ctx, s->version, sess_id,
+                                     sess_id_len);
+        /* Keep it in the internal cache too, unless told not to */
+        if (ret != NULL
+                && (s->session_ctx->session_cache_mode
+                    & SSL_SESS_CACHE_NO_INTERNAL_STORE) == 0)
+            (void)SSL_CTX_add_session(s->session_ctx, ret);
+    }
+
     if (ret == NULL && s->session_ctx->get_session_cb != NULL) {
         int copy = 1;
 
@@ -638,6 +717,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
     int ret = 0;
     SSL_SESSION *s;
+    SESS_CACHE cache;
 
     /*
      * add just 1 reference count for the SSL_CTX's session cache even though
@@ -649,17 +729,18 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
      * if session c is in already in cache, we take back the increment later
      */
 
-    CRYPTO_THREAD_write_lock(ctx->lock);
-    s = lh_SSL_SESSION_insert(ctx->sessions, c);
+    sess_cache_find(ctx, c, &cache);
+    CRYPTO_THREAD_write_lock(cache.lock);
+    s = lh_SSL_SESSION_insert(cache.sessions, c);
 
     /*
      * s != NULL iff we already had a session with the given PID. In this
      * case, s == c should hold (then we did not really modify
-     * ctx->sessions), or we're in trouble.
+     * cache.sessions), or we're in trouble.
      */
     if (s != NULL && s != c) {
         /* We *are* in trouble ... */
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(&cache, s);
         SSL_SESSION_free(s);
         /*
          * ... so pretend the other session did not exist in cache (we cannot
@@ -669,7 +750,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
          */
         s = NULL;
     } else if (s == NULL &&
-               lh_SSL_SESSION_retrieve(ctx->sessions, c) == NULL) {
+               lh_SSL_SESSION_retrieve(cache.sessions, c) == NULL) {
         /* s == NULL can also mean OOM error in lh_SSL_SESSION_insert ... */
 
         /*
@@ -681,7 +762,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 
     /* Put at the head of the queue unless it is already in the cache */
     if (s == NULL)
-        SSL_SESSION_list_add(ctx, c);
+        SSL_SESSION_list_add(&cache, c);
 
     if (s != NULL) {
         /*
@@ -699,40 +780,45 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
         ret = 1;
 
         if (SSL_CTX_sess_get_cache_size(ctx) > 0) {
-            while (SSL_CTX_sess_number(ctx) > SSL_CTX_sess_get_cache_size(ctx)) {
-                if (!remove_session_lock(ctx, ctx->session_cache_tail, 0))
+            while (lh_SSL_SESSION_num_items(cache.sessions)
+                   > sess_cache_limit(ctx)) {
+                if (!remove_session_lock(ctx, *cache.tail, 0))
                     break;
                 else
                     tsan_counter(&ctx->stats.sess_cache_full);
             }
         }
     }
-    CRYPTO_THREAD_unlock(ctx->lock);
+    CRYPTO_THREAD_unlock(cache.lock);
     return ret;
 }
 
 int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
+    if (c != NULL)
+        ssl_shared_sess_remove(ctx, c);
     return remove_session_lock(ctx, c, 1);
 }
 
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck)
 {
     SSL_SESSION *r;
+    SESS_CACHE cache;
     int ret = 0;
 
     if ((c != NULL) && (c->session_id_length != 0)) {
+        sess_cache_find(ctx, c, &cache);
         if (lck)
-            CRYPTO_THREAD_write_lock(ctx->lock);
-        if ((r = lh_SSL_SESSION_retrieve(ctx->sessions, c)) != NULL) {
+            CRYPTO_THREAD_write_lock(cache.lock);
+        if ((r = lh_SSL_SESSION_retrieve(cache.sessions, c)) != NULL) {
             ret = 1;
-            r = lh_SSL_SESSION_delete(ctx->sessions, r);
-            SSL_SESSION_list_remove(ctx, r);
+            r = lh_SSL_SESSION_delete(cache.sessions, r);
+            SSL_SESSION_list_remove(&cache, r);
         }
         c->not_resumable = 1;
 
         if (lck)
-            CRYPTO_THREAD_unlock(ctx->lock);
+            CRYPTO_THREAD_unlock(cache.lock);
 
         if (ctx->remove_session_cb != NULL)
             ctx->remove_session_cb(ctx, c);
@@ -1045,7 +1131,7 @@ int SSL_set_session_ticket_ext(SSL *s, void *ext_data, int ext_len)
 typedef struct timeout_param_st {
     SSL_CTX *ctx;
     long time;
-    LHASH_OF(SSL_SESSION) *cache;
+    SESS_CACHE cache;
 } TIMEOUT_PARAM;
 
 static void timeout_cb(SSL_SESSION *s, TIMEOUT_PARAM *p)
@@ -1055,8 +1141,8 @@ static void timeout_cb(SSL_SESSION *s, TIMEOUT_PARAM *p)
          * The reason we don't call SSL_CTX_remove_session() is to save on
          * locking overhead
          */
-        (void)lh_SSL_SESSION_delete(p->cache, s);
-        SSL_SESSION_list_remove(p->ctx, s);
+        (void)lh_SSL_SESSION_delete(p->cache.sessions, s);
+        SSL_SESSION_list_remove(&p->cache, s);
         s->not_resumable = 1;
         if (p->ctx->remove_session_cb != NULL)
             p->ctx->remove_session_cb(p->ctx, s);
@@ -1069,19 +1155,149 @@ IMPLEMENT_LHASH_DOALL_ARG(SSL_SESSION, TIMEOUT_PARAM);
 void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
 {
     unsigned long i;
+    size_t idx;
     TIMEOUT_PARAM tp;
 
-    tp.ctx = s;
-    tp.cache = s->sessions;
-    if (tp.cache == NULL)
+    if (s->sessions == NULL)
         return;
+    tp.ctx = s;
     tp.time = t;
-    CRYPTO_THREAD_write_lock(s->lock);
-    i = lh_SSL_SESSION_get_down_load(s->sessions);
-    lh_SSL_SESSION_set_down_load(s->sessions, 0);
-    lh_SSL_SESSION_doall_TIMEOUT_PARAM(tp.cache, timeout_cb, &tp);
-    lh_SSL_SESSION_set_down_load(s->sessions, i);
-    CRYPTO_THREAD_unlock(s->lock);
+    /* Each shard is expired under its own lock, one at a time */
+    for (idx = 0; idx < sess_cache_num(s); idx++) {
+        sess_cache_get(s, idx, &tp.cache);
+        CRYPTO_THREAD_write_lock(tp.cache.lock);
+        i = lh_SSL_SESSION_get_down_load(tp.cache.sessions);
+        lh_SSL_SESSION_set_down_load(tp.cache.sessions, 0);
+        lh_SSL_SESSION_doall_TIMEOUT_PARAM(tp.cache.sessions, timeout_cb, &tp);
+        lh_SSL_SESSION_set_down_load(tp.cache.sessions, i);
+        CRYPTO_THREAD_unlock(tp.cache.lock);
+    }
+}
+
+size_t ssl_session_cache_num_items(SSL_CTX *ctx)
+{
+    SESS_CACHE cache;
+    size_t idx, n = 0;
+
+    for (idx = 0; idx < sess_cache_num(ctx); idx++) {
+        sess_cache_get(ctx, idx, &cache);
+        n += lh_SSL_SESSION_num_items(cache.sessions);
+    }
+    return n;
+}
+
+int ssl_session_cache_has(SSL_CTX *ctx, const SSL_SESSION *key)
+{
+    SESS_CACHE cache;
+    SSL_SESSION *p;
+
+    sess_cache_find(ctx, key, &cache);
+    CRYPTO_THREAD_read_lock(cache.lock);
+    p = lh_SSL_SESSION_retrieve(cache.sessions, key);
+    CRYPTO_THREAD_unlock(cache.lock);
+    return p != NULL;
+}
+
+static void sess_shards_free(SSL_SESS_SHARD *shards)
+{
+    size_t i;
+
+    if (shards == NULL)
+        return;
+    for (i = 0; i < SSL_SESS_CACHE_NUM_SHARDS; i++) {
+        lh_SSL_SESSION_free(shards[i].sessions);
+        CRYPTO_THREAD_lock_free(shards[i].lock);
+    }
+    OPENSSL_free(shards);
+}
+
+void ssl_session_cache_free(SSL_CTX *ctx)
+{
+    lh_SSL_SESSION_free(ctx->sessions);
+    ctx->sessions = NULL;
+    sess_shards_free(ctx->sess_shards);
+    ctx->sess_shards = NULL;
+}
+
+/*
+ * Move every session in |from| to wherever it belongs in |ctx|'s cache now,
+ * oldest first so that the LRU order is kept.
+ */
+static void sess_cache_move(SSL_CTX *ctx, SESS_CACHE *from)
+{
+    SSL_SESSION *s;
+    SESS_CACHE to;
+
+    while ((s = *from->tail) != NULL) {
+        (void)lh_SSL_SESSION_delete(from->sessions, s);
+        SSL_SESSION_list_remove(from, s);
+        sess_cache_find(ctx, s, &to);
+        if (lh_SSL_SESSION_insert(to.sessions, s) == NULL
+                && lh_SSL_SESSION_retrieve(to.sessions, s) == NULL) {
+            /* Out of memory: drop it from the cache */
+            s->not_resumable = 1;
+            if (ctx->remove_session_cb != NULL)
+                ctx->remove_session_cb(ctx, s);
+            SSL_SESSION_free(s);
+            continue;
+        }
+        SSL_SESSION_list_add(&to, s);
+    }
+}
+
+/*
+ * Switch |ctx|'s internal session cache between a single table guarded by
+ * ctx->lock and SSL_SESS_CACHE_NUM_SHARDS separately locked ones, carrying
+ * any cached sessions over. This is not safe against other threads using the
+ * cache at the same time.
+ */
+int ssl_session_cache_set_sharded(SSL_CTX *ctx, int sharded)
+{
+    SSL_SESS_SHARD *shards;
+    SESS_CACHE from;
+    size_t i;
+
+    if (ctx->sessions == NULL || sharded == (ctx->sess_shards != NULL))
+        return 1;
+
+    if (!sharded) {
+        CRYPTO_THREAD_write_lock(ctx->lock);
+        shards = ctx->sess_shards;
+        ctx->sess_shards = NULL;
+        for (i = 0; i < SSL_SESS_CACHE_NUM_SHARDS; i++) {
+            from.lock = shards[i].lock;
+            from.sessions = shards[i].sessions;
+            from.head = &shards[i].session_cache_head;
+            from.tail = &shards[i].session_cache_tail;
+            sess_cache_move(ctx, &from);
+        }
+        CRYPTO_THREAD_unlock(ctx->lock);
+        sess_shards_free(shards);
+        return 1;
+    }
+
+    shards = OPENSSL_zalloc(sizeof(*shards) * SSL_SESS_CACHE_NUM_SHARDS);
+    if (shards == NULL) {
+        SSLerr(SSL_F_SSL_SESSION_CACHE_SET_SHARDED, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    for (i = 0; i < SSL_SESS_CACHE_NUM_SHARDS; i++) {
+        shards[i].lock = CRYPTO_THREAD_lock_new();
+        shards[i].sessions = lh_SSL_SESSION_new(ssl_session_hash,
+                                                ssl_session_cmp);
+        if (shards[i].lock == NULL || shards[i].sessions == NULL) {
+            SSLerr(SSL_F_SSL_SESSION_CACHE_SET_SHARDED, ERR_R_MALLOC_FAILURE);
+            sess_shards_free(shards);
+            return 0;
+        }
+    }
+
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    sess_cache_get(ctx, 0, &from);
+    ctx->sess_shards = shards;
+    sess_cache_move(ctx, &from);
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return 1;
 }
 
 int ssl_clear_bad_session(SSL *s)
@@ -1095,27 +1311,27 @@ int ssl_clear_bad_session(SSL *s)
         return 0;
 }
 
-/* locked by SSL_CTX in the calling function */
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
+/* locked by the cache's lock in the calling function */
+static void SSL_SESSION_list_remove(SESS_CACHE *cache, SSL_SESSION *s)
 {
     if ((s->next == NULL) || (s->prev == NULL))
         return;
 
-    if (s->next == (SSL_SESSION *)&(ctx->session_cache_tail)) {
+    if (s->next == (SSL_SESSION *)cache->tail) {
         /* last element in list */
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)cache->head) {
             /* only one element in list */
-            ctx->session_cache_head = NULL;
-            ctx->session_cache_tail = NULL;
+            *cache->head = NULL;
+            *cache->tail = NULL;
         } else {
-            ctx->session_cache_tail = s->prev;
-            s->prev->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+            *cache->tail = s->prev;
+            s->prev->next = (SSL_SESSION *)cache->tail;
         }
     } else {
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)cache->head) {
             /* first element in list */
-            ctx->session_cache_head = s->next;
-            s->next->prev = (SSL_SESSION *)&(ctx->session_cache_head);
+            *cache->head = s->next;
+            s->next->prev = (SSL_SESSION *)cache->head;
         } else {
             /* middle of list */
             s->next->prev = s->prev;
@@ -1125,21 +1341,21 @@ static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
     s->prev = s->next = NULL;
 }
 
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s)
+static void SSL_SESSION_list_add(SESS_CACHE *cache, SSL_SESSION *s)
 {
     if ((s->next != NULL) && (s->prev != NULL))
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(cache, s);
 
-    if (ctx->session_cache_head == NULL) {
-        ctx->session_cache_head = s;
-        ctx->session_cache_tail = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        s->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+    if (*cache->head == NULL) {
+        *cache->head = s;
+        *cache->tail = s;
+        s->prev = (SSL_SESSION *)cache->head;
+        s->next = (SSL_SESSION *)cache->tail;
     } else {
-        s->next = ctx->session_cache_head;
+        s->next = *cache->head;
         s->next->prev = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        ctx->session_cache_head = s;
+        s->prev = (SSL_SESSION *)cache->head;
+        *cache->head = s;
     }
 }
 
@@ -0,0 +1,416 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A server session cache that lives in shared memory so that all processes
+ * of a pre-forked server can resume each other's sessions.
+ *
+ * The mapping starts with a header describing its geometry, followed by a
+ * fixed number of equally sized slots. Each slot holds at most one DER
+ * encoded session and is chosen by a hash of the session id, so a new
+ * session simply replaces whatever was in its slot before. Slots are guarded
+ * by a sequence lock: a writer makes the sequence number odd, updates the
+ * slot and makes it even again, while readers copy the slot without taking
+ * any lock and retry or give up if the sequence number was odd or changed
+ * under them. Writers never wait for each other; if a slot is busy the
+ * update is dropped, which is always safe for a cache.
+ *
+ * The pid of the writer is kept in the same word as the sequence number, so
+ * that a slot left odd by a process that died while writing to it can be
+ * taken over by the next writer instead of staying busy for good. A slot
+ * that stays busy for longer than SHM_WRITE_TIMEOUT is taken over too, in
+ * case the pid has been reused in the meantime.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "ssl_locl.h"
+
+#if defined(OPENSSL_SYS_UNIX) && defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+# define SHARED_SESS_CACHE
+# include <sys/types.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <signal.h>
+# include <unistd.h>
+# if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#  define MAP_ANON MAP_ANONYMOUS
+# endif
+#endif
+
+#ifdef SHARED_SESS_CACHE
+
+# define SHM_MAGIC              0x4f53534cU /* "OSSL" */
+# define SHM_VERSION            1
+# define SHM_ALIGN              64
+/* How often a reader retries a slot that is being written to */
+# define SHM_READ_RETRIES       4
+/* Seconds after which a busy slot is assumed to be abandoned */
+# define SHM_WRITE_TIMEOUT      10
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_slots;
+    uint64_t slot_size;
+} SHM_HEADER;
+
+typedef struct {
+    /*
+     * Sequence number in the low 32 bits, odd while a writer is updating the
+     * slot, and the pid of the last writer in the high 32 bits.
+     */
+    uint64_t seq;
+    /* |seq| of the current writer and when it started writing */
+    uint64_t busy_seq;
+    int64_t busy_since;
+    /* Length of the encoded session that follows, 0 if the slot is empty */
+    uint32_t len;
+    int32_t ssl_version;
+    uint32_t id_len;
+    int64_t expires;
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+} SHM_SLOT;
+
+# define SHM_SEQ_BUSY(s)        (((s) & 1) != 0)
+# define SHM_SEQ_PID(s)         ((pid_t)((s) >> 32))
+# define SHM_SEQ_NEXT(s, n)     \
+    (((uint64_t)(uint32_t)getpid() << 32) | (uint32_t)((s) + (n)))
+
+# define SHM_HEADER_SIZE \
+    ((sizeof(SHM_HEADER) + SHM_ALIGN - 1) & ~(size_t)(SHM_ALIGN - 1))
+
+struct ssl_shared_sess_cache_st {
+    unsigned char *map;
+    size_t map_len;
+    size_t num_slots;
+    /* Distance between slots, and the most DER bytes each can hold */
+    size_t slot_size;
+    size_t sess_size;
+};
+
+static SHM_SLOT *shm_slot(SSL_SHARED_SESS_CACHE *c, const unsigned char *id,
+                          size_t id_len)
+{
+    uint32_t h = 0x811c9dc5;
+    size_t i;
+
+    for (i = 0; i < id_len; i++) {
+        h ^= id[i];
+        h *= 0x01000193;
+    }
+    return (SHM_SLOT *)(c->map + SHM_HEADER_SIZE
+                        + (h % c->num_slots) * c->slot_size);
+}
+
+/*
+ * Whether the writer that made |slot| busy with sequence number |s| is gone:
+ * either its process no longer exists, or it has held the slot for longer
+ * than any write takes.
+ */
+static int shm_writer_gone(SHM_SLOT *slot, uint64_t s)
+{
+    pid_t pid = SHM_SEQ_PID(s);
+
+    if (pid != getpid() && kill(pid, 0) != 0 && errno == ESRCH)
+        return 1;
+    /* busy_since only belongs to this writer if it has set busy_seq */
+    return __atomic_load_n(&slot->busy_seq, __ATOMIC_ACQUIRE) == s
+        && (int64_t)time(NULL) - slot->busy_since > SHM_WRITE_TIMEOUT;
+}
+
+static int shm_write_begin(SHM_SLOT *slot, uint64_t *seq)
+{
+    uint64_t s = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    uint64_t next;
+
+    /*
+     * Somebody else is writing: let them, unless they are gone. A busy slot
+     * is taken over by moving on to the next odd sequence number, so that
+     * readers that saw the old one still retry.
+     */
+    if (SHM_SEQ_BUSY(s) && !shm_writer_gone(slot, s))
+        return 0;
+    next = SHM_SEQ_NEXT(s, SHM_SEQ_BUSY(s) ? 2 : 1);
+    if (!__atomic_compare_exchange_n(&slot->seq, &s, next, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 0;
+    slot->busy_since = (int64_t)time(NULL);
+    __atomic_store_n(&slot->busy_seq, next, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    *seq = next;
+    return 1;
+}
+
+static void shm_write_end(SHM_SLOT *slot, uint64_t seq)
+{
+    /* Fails if the slot was taken over, which then finishes the write */
+    __atomic_compare_exchange_n(&slot->seq, &seq, SHM_SEQ_NEXT(seq, 1), 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+static int shm_matches(const SHM_SLOT *hdr, int version,
+                       const unsigned char *id, size_t id_len)
+{
+    return hdr->len != 0
+        && hdr->ssl_version == version
+        && hdr->id_len == id_len
+        && memcmp(hdr->id, id, id_len) == 0;
+}
+
+void ssl_shared_sess_cache_free(SSL_SHARED_SESS_CACHE *c)
+{
+    if (c == NULL)
+        return;
+    if (c->map != NULL)
+        munmap(c->map, c->map_len);
+    OPENSSL_free(c);
+}
+
+int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, const char *path,
+                                     size_t num_slots, size_t sess_size)
+{
+    SSL_SHARED_SESS_CACHE *c;
+    SHM_HEADER *hdr;
+    struct stat st;
+    void *map;
+    int fd = -1;
+
+    if (num_slots == 0) {
+        ssl_shared_sess_cache_free(ctx->shared_sess_cache);
+        ctx->shared_sess_cache = NULL;
+        return 1;
+    }
+    if (sess_size == 0)
+        sess_size = SSL_SHARED_SESS_CACHE_SESS_SIZE_DEFAULT;
+    if (sess_size > UINT32_MAX
+            || sess_size > SIZE_MAX / 2 - sizeof(SHM_SLOT) - SHM_ALIGN) {
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+               ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+
+    if ((c = OPENSSL_zalloc(sizeof(*c))) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    c->num_slots = num_slots;
+    c->sess_size = sess_size;
+    c->slot_size = (sizeof(SHM_SLOT) + sess_size + SHM_ALIGN - 1)
+                   & ~(size_t)(SHM_ALIGN - 1);
+    if (num_slots > (SIZE_MAX - SHM_HEADER_SIZE) / c->slot_size) {
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+               ERR_R_PASSED_INVALID_ARGUMENT);
+        goto err;
+    }
+    c->map_len = SHM_HEADER_SIZE + num_slots * c->slot_size;
+
+    if (path == NULL) {
+        map = mmap(NULL, c->map_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANON, -1, 0);
+    } else {
+        if ((fd = open(path, O_RDWR | O_CREAT, 0600)) < 0) {
+            ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(),
+                           "calling open(%s)", path);
+            SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_SYS_LIB);
+            goto err;
+        }
+        if (fstat(fd, &st) != 0
+                || (st.st_size == 0 && ftruncate(fd, c->map_len) != 0)) {
+            ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(),
+                           "calling fstat/ftruncate(%s)", path);
+            SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_SYS_LIB);
+            goto err;
+        }
+        if (st.st_size != 0 && (size_t)st.st_size != c->map_len) {
+            SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+                   SSL_R_SHARED_SESSION_CACHE_MISMATCH);
+            goto err;
+        }
+        map = mmap(NULL, c->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(), "calling mmap()");
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_SYS_LIB);
+        goto err;
+    }
+    c->map = map;
+
+    /*
+     * A fresh mapping is all zeroes. Processes racing to set up the same
+     * file all write the same geometry, so the header needs no lock.
+     */
+    hdr = (SHM_HEADER *)c->map;
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == 0) {
+        hdr->version = SHM_VERSION;
+        hdr->num_slots = num_slots;
+        hdr->slot_size = c->slot_size;
+        __atomic_store_n(&hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    } else if (hdr->magic != SHM_MAGIC
+               || hdr->version != SHM_VERSION
+               || hdr->num_slots != num_slots
+               || hdr->slot_size != c->slot_size) {
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+               SSL_R_SHARED_SESSION_CACHE_MISMATCH);
+        goto err;
+    }
+
+    if (fd >= 0)
+        close(fd);
+    ssl_shared_sess_cache_free(ctx->shared_sess_cache);
+    ctx->shared_sess_cache = c;
+    return 1;
+
+ err:
+    if (fd >= 0)
+        close(fd);
+    ssl_shared_sess_cache_free(c);
+    return 0;
+}
+
+int ssl_shared_sess_add(SSL_CTX *ctx, SSL_SESSION *sess)
+{
+    SSL_SHARED_SESS_CACHE *c = ctx->shared_sess_cache;
+    SHM_SLOT *slot;
+    unsigned char *der = NULL, *p;
+    uint64_t seq;
+    int len, ret = 0;
+
+    if (c == NULL || sess->session_id_length == 0)
+        return 0;
+
+    len = i2d_SSL_SESSION(sess, NULL);
+    if (len <= 0 || (size_t)len > c->sess_size)
+        return 0;
+    if ((der = p = OPENSSL_malloc(len)) == NULL)
+        return 0;
+    if (i2d_SSL_SESSION(sess, &p) != len)
+        goto end;
+
+    slot = shm_slot(c, sess->session_id, sess->session_id_length);
+    if (!shm_write_begin(slot, &seq))
+        goto end;
+    slot->len = (uint32_t)len;
+    slot->ssl_version = sess->ssl_version;
+    slot->id_len = (uint32_t)sess->session_id_length;
+    slot->expires = (int64_t)sess->time + sess->timeout;
+    memcpy(slot->id, sess->session_id, sess->session_id_length);
+    memcpy(slot + 1, der, len);
+    shm_write_end(slot, seq);
+    ret = 1;
+
+ end:
+    OPENSSL_free(der);
+    return ret;
+}
+
+SSL_SESSION *ssl_shared_sess_lookup(SSL_CTX *ctx, int version,
+                                    const unsigned char *id, size_t id_len)
+{
+    SSL_SHARED_SESS_CACHE *c = ctx->shared_sess_cache;
+    SSL_SESSION *ret = NULL;
+    SHM_SLOT *slot, hdr;
+    unsigned char *der;
+    const unsigned char *p;
+    uint64_t seq;
+    int i;
+
+    if (c == NULL || id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+        return NULL;
+    if ((der = OPENSSL_malloc(c->sess_size)) == NULL)
+        return NULL;
+
+    hdr.len = 0;
+    slot = shm_slot(c, id, id_len);
+    for (i = 0; i < SHM_READ_RETRIES; i++) {
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (SHM_SEQ_BUSY(seq))
+            continue;
+        /* The copy may be torn, so check everything before using it */
+        memcpy(&hdr, slot, sizeof(hdr));
+        if (!shm_matches(&hdr, version, id, id_len)
+                || hdr.len > c->sess_size)
+            hdr.len = 0;
+        else
+            memcpy(der, slot + 1, hdr.len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+
+    if (i < SHM_READ_RETRIES && hdr.len != 0
+            && hdr.expires > (int64_t)time(NULL)) {
+        p = der;
+        ret = d2i_SSL_SESSION(NULL, &p, hdr.len);
+        if (ret != NULL
+                && (ret->ssl_version != version
+                    || ret->session_id_length != id_len
+                    || memcmp(ret->session_id, id, id_len) != 0)) {
+            SSL_SESSION_free(ret);
+            ret = NULL;
+        }
+    }
+
+    OPENSSL_free(der);
+    return ret;
+}
+
+void ssl_shared_sess_remove(SSL_CTX *ctx, const SSL_SESSION *sess)
+{
+    SSL_SHARED_SESS_CACHE *c = ctx->shared_sess_cache;
+    SHM_SLOT *slot;
+    uint64_t seq;
+
+    if (c == NULL || sess->session_id_length == 0)
+        return;
+
+    slot = shm_slot(c, sess->session_id, sess->session_id_length);
+    if (!shm_write_begin(slot, &seq))
+        return;
+    if (shm_matches(slot, sess->ssl_version, sess->session_id,
+                    sess->session_id_length))
+        slot->len = 0;
+    shm_write_end(slot, seq);
+}
+
+#else
+
+void ssl_shared_sess_cache_free(SSL_SHARED_SESS_CACHE *c)
+{
+}
+
+int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, const char *path,
+                                     size_t num_slots, size_t sess_size)
+{
+    if (num_slots == 0)
+        return 1;
+    SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+           SSL_R_SHARED_SESSION_CACHE_NOT_SUPPORTED);
+    return 0;
+}
+
+int ssl_shared_sess_add(SSL_CTX *ctx, SSL_SESSION *sess)
+{
+    return 0;
+}
+
+SSL_SESSION *ssl_shared_sess_lookup(SSL_CTX *ctx, int version,
+                                    const unsigned char *id, size_t id_len)
+{
+    return NULL;
+}
+
+void ssl_shared_sess_remove(SSL_CTX *ctx, const SSL_SESSION *sess)
+{
+}
+
+#endif
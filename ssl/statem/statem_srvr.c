@@ -3937,6 +3937,13 @@ static int construct_stateless_ticket(SSL *s, WPACKET *pkt, uint32_t age_add,
             goto err;
         }
         iv_len = EVP_CIPHER_CTX_iv_length(ctx);
+    } else if (tctx->ext.tick_ring != NULL) {
+        if (!ssl_ticket_ring_encrypt_init(tctx, key_name, iv, &iv_len, ctx,
+                                          hctx)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_CONSTRUCT_STATELESS_TICKET,
+                     ERR_R_INTERNAL_ERROR);
+            goto err;
+        }
     } else {
         const EVP_CIPHER *cipher = EVP_aes_256_cbc();
 
@@ -1464,6 +1464,25 @@ SSL_TICKET_STATUS tls_decrypt_ticket(SSL *s, const unsigned char *etick,
         }
         if (rv == 2)
             renew_ticket = 1;
+    } else if (tctx->ext.tick_ring != NULL) {
+        int rv = ssl_ticket_ring_decrypt_init(tctx, etick, ctx, hctx,
+                                              &renew_ticket);
+
+        if (rv < 0) {
+            ret = SSL_TICKET_FATAL_ERR_OTHER;
+            goto end;
+        }
+        if (rv == 0) {
+            ret = SSL_TICKET_NO_DECRYPT;
+            goto end;
+        }
+        /*
+         * As with the built-in key below. TLSv1.3 tickets are single use and
+         * a new one is sent on every resumption, so the decrypt ticket
+         * callback sees SSL_TICKET_SUCCESS_RENEW whichever keys are in use.
+         */
+        if (SSL_IS_TLS13(s))
+            renew_ticket = 1;
     } else {
         /* Check key name matches */
         if (memcmp(etick, tctx->ext.tick_key_name,
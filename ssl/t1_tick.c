@@ -0,0 +1,256 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A ring of automatically rotated session ticket keys. The newest key
+ * encrypts new tickets until its issuing period is over, after which it is
+ * still accepted for decryption during a grace period. Each key keeps cipher
+ * and HMAC contexts that are set up once when the key is created; tickets
+ * are processed with copies of those, which avoids fetching the algorithms
+ * and running the key schedules again for every ticket.
+ */
+
+#include <time.h>
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
+#include "ssl_locl.h"
+
+/* The most keys a ring holds, older ones are dropped even in their grace */
+#define TICKET_RING_MAX_KEYS    8
+
+typedef struct ssl_ticket_key_st {
+    unsigned char name[TLSEXT_KEYNAME_LENGTH];
+    EVP_CIPHER_CTX *enc;
+    EVP_CIPHER_CTX *dec;
+    HMAC_CTX *hmac;
+    /* Used for new tickets until, and accepted until */
+    time_t issue_until;
+    time_t accept_until;
+} SSL_TICKET_KEY;
+
+struct ssl_ticket_ring_st {
+    CRYPTO_RWLOCK *lock;
+    long interval;
+    long grace;
+    /* Newest first, only keys[0] is used for new tickets */
+    SSL_TICKET_KEY *keys[TICKET_RING_MAX_KEYS];
+    size_t num_keys;
+};
+
+static void ticket_key_free(SSL_TICKET_KEY *key)
+{
+    if (key == NULL)
+        return;
+    EVP_CIPHER_CTX_free(key->enc);
+    EVP_CIPHER_CTX_free(key->dec);
+    HMAC_CTX_free(key->hmac);
+    OPENSSL_free(key);
+}
+
+static SSL_TICKET_KEY *ticket_key_new(time_t now, long interval, long grace)
+{
+    SSL_TICKET_KEY *key;
+    unsigned char hmac_key[TLSEXT_TICK_KEY_LENGTH];
+    unsigned char aes_key[TLSEXT_TICK_KEY_LENGTH];
+    int ok;
+
+    if ((key = OPENSSL_zalloc(sizeof(*key))) == NULL)
+        return NULL;
+    ok = (key->enc = EVP_CIPHER_CTX_new()) != NULL
+         && (key->dec = EVP_CIPHER_CTX_new()) != NULL
+         && (key->hmac = HMAC_CTX_new()) != NULL
+         && RAND_bytes(key->name, sizeof(key->name)) > 0
+         && RAND_priv_bytes(hmac_key, sizeof(hmac_key)) > 0
+         && RAND_priv_bytes(aes_key, sizeof(aes_key)) > 0
+         && EVP_EncryptInit_ex(key->enc, EVP_aes_256_cbc(), NULL, aes_key,
+                               NULL)
+         && EVP_DecryptInit_ex(key->dec, EVP_aes_256_cbc(), NULL, aes_key,
+                               NULL)
+         && HMAC_Init_ex(key->hmac, hmac_key, sizeof(hmac_key), EVP_sha256(),
+                         NULL);
+    OPENSSL_cleanse(hmac_key, sizeof(hmac_key));
+    OPENSSL_cleanse(aes_key, sizeof(aes_key));
+    if (!ok) {
+        ticket_key_free(key);
+        return NULL;
+    }
+    key->issue_until = now + interval;
+    key->accept_until = key->issue_until + grace;
+    return key;
+}
+
+/* Must be called with the ring's write lock held */
+static int ticket_ring_rotate(SSL_TICKET_RING *ring, time_t now)
+{
+    SSL_TICKET_KEY *key;
+    size_t i, j;
+
+    if ((key = ticket_key_new(now, ring->interval, ring->grace)) == NULL)
+        return 0;
+
+    /* A key retired early gets its grace period from now on */
+    if (ring->num_keys > 0 && ring->keys[0]->issue_until > now) {
+        ring->keys[0]->issue_until = now;
+        ring->keys[0]->accept_until = now + ring->grace;
+    }
+
+    for (i = j = 0; i < ring->num_keys; i++) {
+        if (ring->keys[i]->accept_until <= now || j == TICKET_RING_MAX_KEYS - 1)
+            ticket_key_free(ring->keys[i]);
+        else
+            ring->keys[j++] = ring->keys[i];
+    }
+    memmove(ring->keys + 1, ring->keys, j * sizeof(ring->keys[0]));
+    ring->keys[0] = key;
+    ring->num_keys = j + 1;
+    return 1;
+}
+
+void ssl_ticket_ring_free(SSL_TICKET_RING *ring)
+{
+    size_t i;
+
+    if (ring == NULL)
+        return;
+    for (i = 0; i < ring->num_keys; i++)
+        ticket_key_free(ring->keys[i]);
+    CRYPTO_THREAD_lock_free(ring->lock);
+    OPENSSL_free(ring);
+}
+
+/*
+ * Set up |ctx| and |hctx| to protect a new ticket with the current key of
+ * |tctx|'s ticket key ring, rotating it first if it is due. A random IV is
+ * written to |iv| and its length to |iv_len|.
+ */
+int ssl_ticket_ring_encrypt_init(SSL_CTX *tctx, unsigned char *key_name,
+                                 unsigned char *iv, int *iv_len,
+                                 EVP_CIPHER_CTX *ctx, HMAC_CTX *hctx)
+{
+    SSL_TICKET_RING *ring = tctx->ext.tick_ring;
+    SSL_TICKET_KEY *key;
+    time_t now = time(NULL);
+    int ret = 0;
+
+    CRYPTO_THREAD_read_lock(ring->lock);
+    if (ring->num_keys == 0 || ring->keys[0]->issue_until <= now) {
+        CRYPTO_THREAD_unlock(ring->lock);
+        CRYPTO_THREAD_write_lock(ring->lock);
+        /* Somebody else may have got here first */
+        if ((ring->num_keys == 0 || ring->keys[0]->issue_until <= now)
+                && !ticket_ring_rotate(ring, now))
+            goto end;
+    }
+
+    key = ring->keys[0];
+    *iv_len = EVP_CIPHER_CTX_iv_length(key->enc);
+    if (*iv_len < 0 || *iv_len > EVP_MAX_IV_LENGTH
+            || RAND_bytes(iv, *iv_len) <= 0
+            || !EVP_CIPHER_CTX_copy(ctx, key->enc)
+            || !EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv)
+            || !HMAC_CTX_copy(hctx, key->hmac))
+        goto end;
+    memcpy(key_name, key->name, sizeof(key->name));
+    ret = 1;
+
+ end:
+    CRYPTO_THREAD_unlock(ring->lock);
+    return ret;
+}
+
+/*
+ * Set up |ctx| and |hctx| to check and decrypt the ticket |etick|, which
+ * starts with the key name and IV. |*renew| is set if the ticket should be
+ * replaced because it was not made with the current key.
+ * Returns 1 on success, 0 if the ticket's key is unknown or no longer
+ * accepted, or -1 on error.
+ */
+int ssl_ticket_ring_decrypt_init(SSL_CTX *tctx, const unsigned char *etick,
+                                 EVP_CIPHER_CTX *ctx, HMAC_CTX *hctx,
+                                 int *renew)
+{
+    SSL_TICKET_RING *ring = tctx->ext.tick_ring;
+    SSL_TICKET_KEY *key;
+    time_t now = time(NULL);
+    size_t i;
+    int ret = 0;
+
+    CRYPTO_THREAD_read_lock(ring->lock);
+    for (i = 0; i < ring->num_keys; i++) {
+        key = ring->keys[i];
+        if (memcmp(etick, key->name, sizeof(key->name)) != 0)
+            continue;
+        if (key->accept_until <= now)
+            break;
+        if (!EVP_CIPHER_CTX_copy(ctx, key->dec)
+                || !EVP_DecryptInit_ex(ctx, NULL, NULL, NULL,
+                                       etick + TLSEXT_KEYNAME_LENGTH)
+                || !HMAC_CTX_copy(hctx, key->hmac)) {
+            ret = -1;
+            break;
+        }
+        *renew = i != 0 || key->issue_until <= now;
+        ret = 1;
+        break;
+    }
+    CRYPTO_THREAD_unlock(ring->lock);
+    return ret;
+}
+
+int SSL_CTX_set_ticket_key_rotation(SSL_CTX *ctx, long interval, long grace)
+{
+    SSL_TICKET_RING *ring = ctx->ext.tick_ring;
+
+    if (interval <= 0) {
+        ssl_ticket_ring_free(ring);
+        ctx->ext.tick_ring = NULL;
+        return 1;
+    }
+    if (grace < 0) {
+        SSLerr(SSL_F_SSL_CTX_SET_TICKET_KEY_ROTATION,
+               ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+
+    if (ring == NULL) {
+        if ((ring = OPENSSL_zalloc(sizeof(*ring))) == NULL
+                || (ring->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            OPENSSL_free(ring);
+            SSLerr(SSL_F_SSL_CTX_SET_TICKET_KEY_ROTATION,
+                   ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        ctx->ext.tick_ring = ring;
+    }
+
+    CRYPTO_THREAD_write_lock(ring->lock);
+    ring->interval = interval;
+    ring->grace = grace;
+    CRYPTO_THREAD_unlock(ring->lock);
+    return 1;
+}
+
+int SSL_CTX_rotate_ticket_keys(SSL_CTX *ctx)
+{
+    SSL_TICKET_RING *ring = ctx->ext.tick_ring;
+    int ret;
+
+    if (ring == NULL) {
+        SSLerr(SSL_F_SSL_CTX_ROTATE_TICKET_KEYS,
+               SSL_R_TICKET_KEY_ROTATION_NOT_ENABLED);
+        return 0;
+    }
+
+    CRYPTO_THREAD_write_lock(ring->lock);
+    ret = ticket_ring_rotate(ring, time(NULL));
+    CRYPTO_THREAD_unlock(ring->lock);
+    if (!ret)
+        SSLerr(SSL_F_SSL_CTX_ROTATE_TICKET_KEYS, ERR_R_INTERNAL_ERROR);
+    return ret;
+}
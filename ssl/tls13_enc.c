@@ -9,6 +9,8 @@
 
 #include <stdlib.h>
 #include "ssl_locl.h"
+#include "internal/ktls.h"
+#include "record/record_locl.h"
 #include "internal/cryptlib.h"
 #include <openssl/evp.h>
 #include <openssl/kdf.h>
@@ -386,9 +388,9 @@ static int derive_secret_key_and_iv(SSL *s, int sending, const EVP_MD *md,
                                     const unsigned char *hash,
                                     const unsigned char *label,
                                     size_t labellen, unsigned char *secret,
-                                    unsigned char *iv, EVP_CIPHER_CTX *ciph_ctx)
+                                    unsigned char *key, unsigned char *iv,
+                                    EVP_CIPHER_CTX *ciph_ctx)
 {
-    unsigned char key[EVP_MAX_KEY_LENGTH];
     size_t ivlen, keylen, taglen;
     int hashleni = EVP_MD_size(md);
     size_t hashlen;
@@ -446,10 +448,71 @@ static int derive_secret_key_and_iv(SSL *s, int sending, const EVP_MD *md,
 
     return 1;
  err:
-    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(key, EVP_MAX_KEY_LENGTH);
     return 0;
 }
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+/*
+ * Hand the application traffic key |key| and static IV |iv| for the direction
+ * given in |which| over to the kernel. If the kernel is already processing
+ * records in that direction then this is a KeyUpdate: the kernel must be
+ * rekeyed because we can no longer fall back to protecting records in user
+ * space. Returns 1 on success or if ktls is not used, 0 on fatal error.
+ */
+static int tls13_ktls_start(SSL *s, int which, const EVP_CIPHER *c,
+                            const unsigned char *key, const unsigned char *iv)
+{
+    union tls_crypto_info_all crypto_info;
+    int sending = (which & SSL3_CC_WRITE) != 0;
+    BIO *bio = sending ? s->wbio : s->rbio;
+    int rekey;
+    int ret;
+
+    if (!ossl_assert(bio != NULL))
+        return 0;
+
+    rekey = sending ? BIO_get_ktls_send(bio) : BIO_get_ktls_recv(bio);
+    if (!rekey) {
+        if ((sending && (s->mode & SSL_MODE_NO_KTLS_TX))
+                || (!sending && (s->mode & SSL_MODE_NO_KTLS_RX)))
+            return 1;
+
+        /* ktls supports only the maximum fragment size */
+        if (ssl_get_max_send_fragment(s) != SSL3_RT_MAX_PLAIN_LENGTH)
+            return 1;
+
+        /* ktls does not add record padding */
+        if (sending && (s->record_padding_cb != NULL || s->block_padding > 0))
+            return 1;
+
+        if (!ktls_check_supported_cipher(s, c))
+            return 1;
+
+        /*
+         * All future data will get encrypted by ktls. Flush the BIO or skip
+         * ktls
+         */
+        if (sending && BIO_flush(bio) <= 0)
+            return 1;
+    }
+
+    if (!ktls_configure_crypto(s, c, NULL, which, iv, key, &crypto_info))
+        return !rekey;
+
+    ret = BIO_set_ktls(bio, &crypto_info, sending);
+    OPENSSL_cleanse(&crypto_info, sizeof(crypto_info));
+    if (!ret)
+        return !rekey;
+
+    /* ktls works with user provided buffers directly */
+    if (sending && !rekey)
+        ssl3_release_write_buffer(s);
+
+    return 1;
+}
+#endif
+
 int tls13_change_cipher_state(SSL *s, int which)
 {
 #ifdef CHARSET_EBCDIC
@@ -472,6 +535,7 @@ int tls13_change_cipher_state(SSL *s, int which)
     static const unsigned char early_exporter_master_secret[] = "e exp master";
 #endif
     unsigned char *iv;
+    unsigned char key[EVP_MAX_KEY_LENGTH];
     unsigned char secret[EVP_MAX_MD_SIZE];
     unsigned char hashval[EVP_MAX_MD_SIZE];
     unsigned char *hash = hashval;
@@ -688,8 +752,8 @@ int tls13_change_cipher_state(SSL *s, int which)
     }
 
     if (!derive_secret_key_and_iv(s, which & SSL3_CC_WRITE, md, cipher,
-                                  insecret, hash, label, labellen, secret, iv,
-                                  ciph_ctx)) {
+                                  insecret, hash, label, labellen, secret, key,
+                                  iv, ciph_ctx)) {
         /* SSLfatal() already called */
         goto err;
     }
@@ -726,12 +790,23 @@ int tls13_change_cipher_state(SSL *s, int which)
         goto err;
     }
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+    /* Only the application traffic keys are offloaded to the kernel */
+    if ((which & SSL3_CC_APPLICATION) != 0
+            && !tls13_ktls_start(s, which, cipher, key, iv)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_CHANGE_CIPHER_STATE,
+                 ERR_R_INTERNAL_ERROR);
+        goto err;
+    }
+#endif
+
     if (!s->server && label == client_early_traffic)
         s->statem.enc_write_state = ENC_WRITE_STATE_WRITE_PLAIN_ALERTS;
     else
         s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
     ret = 1;
  err:
+    OPENSSL_cleanse(key, sizeof(key));
     OPENSSL_cleanse(secret, sizeof(secret));
     return ret;
 }
@@ -746,6 +821,7 @@ int tls13_update_key(SSL *s, int sending)
     const EVP_MD *md = ssl_handshake_md(s);
     size_t hashlen = EVP_MD_size(md);
     unsigned char *insecret, *iv;
+    unsigned char key[EVP_MAX_KEY_LENGTH];
     unsigned char secret[EVP_MAX_MD_SIZE];
     EVP_CIPHER_CTX *ciph_ctx;
     int ret = 0;
@@ -769,17 +845,27 @@ int tls13_update_key(SSL *s, int sending)
     if (!derive_secret_key_and_iv(s, sending, ssl_handshake_md(s),
                                   s->s3.tmp.new_sym_enc, insecret, NULL,
                                   application_traffic,
-                                  sizeof(application_traffic) - 1, secret, iv,
-                                  ciph_ctx)) {
+                                  sizeof(application_traffic) - 1, secret, key,
+                                  iv, ciph_ctx)) {
         /* SSLfatal() already called */
         goto err;
     }
 
     memcpy(insecret, secret, hashlen);
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+    if (!tls13_ktls_start(s, sending ? SSL3_CC_WRITE : SSL3_CC_READ,
+                          s->s3.tmp.new_sym_enc, key, iv)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_UPDATE_KEY,
+                 SSL_R_KTLS_REKEY_FAILED);
+        goto err;
+    }
+#endif
+
     s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
     ret = 1;
  err:
+    OPENSSL_cleanse(key, sizeof(key));
     OPENSSL_cleanse(secret, sizeof(secret));
     return ret;
 }
@@ -1231,6 +1231,92 @@ static int test_EVP_MD_fetch(int tst)
     return ret;
 }
 
+/*
+ * Test that legacy EVP_MD pointers, whose provider methods are cached, keep
+ * working across changes of the default properties.
+ */
+static int test_EVP_MD_legacy_cache(void)
+{
+    const char testmsg[] = "Hello world";
+    const unsigned char exptd[] = {
+      0x27, 0x51, 0x8b, 0xa9, 0x68, 0x30, 0x11, 0xf6, 0xb3, 0x96, 0x07, 0x2c,
+      0x05, 0xf6, 0x65, 0x6d, 0x04, 0xf5, 0xfb, 0xc3, 0x78, 0x7c, 0xf9, 0x24,
+      0x90, 0xec, 0x60, 0x6e, 0x50, 0x92, 0xe3, 0x26
+    };
+    int ret = 0;
+
+    if (!TEST_true(calculate_digest(EVP_sha256(), testmsg, sizeof(testmsg),
+                                    exptd))
+            || !TEST_true(calculate_digest(EVP_sha256(), testmsg,
+                                           sizeof(testmsg), exptd))
+            || !TEST_true(EVP_set_default_properties(NULL, "default=yes"))
+            || !TEST_true(calculate_digest(EVP_sha256(), testmsg,
+                                           sizeof(testmsg), exptd)))
+        goto err;
+
+    ret = 1;
+ err:
+    EVP_set_default_properties(NULL, NULL);
+    return ret;
+}
+
+/*
+ * Test the per thread fetch cache
+ * Test 0: Test with the default OPENSSL_CTX
+ * Test 1: Test with an explicit OPENSSL_CTX
+ */
+static int test_EVP_thread_fetch_cache(int tst)
+{
+    OPENSSL_CTX *ctx = NULL;
+    EVP_MD *md1 = NULL, *md2 = NULL;
+    const char testmsg[] = "Hello world";
+    const unsigned char exptd[] = {
+      0x27, 0x51, 0x8b, 0xa9, 0x68, 0x30, 0x11, 0xf6, 0xb3, 0x96, 0x07, 0x2c,
+      0x05, 0xf6, 0x65, 0x6d, 0x04, 0xf5, 0xfb, 0xc3, 0x78, 0x7c, 0xf9, 0x24,
+      0x90, 0xec, 0x60, 0x6e, 0x50, 0x92, 0xe3, 0x26
+    };
+    int ret = 0;
+
+    if (tst == 1 && !TEST_ptr(ctx = OPENSSL_CTX_new()))
+        goto err;
+
+    if (!TEST_true(EVP_set_thread_fetch_cache(ctx, 1)))
+        goto err;
+
+    /* Repeating a fetch must give us the same method */
+    if (!TEST_ptr(md1 = EVP_MD_fetch(ctx, "SHA256", NULL))
+            || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "SHA256", NULL))
+            || !TEST_ptr_eq(md1, md2)
+            || !TEST_true(calculate_digest(md2, testmsg, sizeof(testmsg),
+                                           exptd)))
+        goto err;
+    EVP_MD_free(md2);
+
+    /* Different properties must not be mixed up */
+    if (!TEST_ptr_null(md2 = EVP_MD_fetch(ctx, "SHA256", "fips=yes"))
+            || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "SHA256", "default=yes"))
+            || !TEST_int_eq(EVP_MD_nid(md2), NID_sha256))
+        goto err;
+    EVP_MD_free(md2);
+
+    /* The cache must still hand out working methods after being flushed */
+    if (!TEST_true(EVP_set_default_properties(ctx, NULL))
+            || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "SHA256", NULL))
+            || !TEST_true(calculate_digest(md2, testmsg, sizeof(testmsg),
+                                           exptd)))
+        goto err;
+
+    ret = 1;
+ err:
+    EVP_set_thread_fetch_cache(ctx, 0);
+    EVP_MD_free(md1);
+    EVP_MD_free(md2);
+    if (ctx != NULL)
+        OPENSSL_thread_stop_ex(ctx);
+    OPENSSL_CTX_free(ctx);
+    return ret;
+}
+
 static int encrypt_decrypt(const EVP_CIPHER *cipher, const unsigned char *msg,
                            size_t len)
 {
@@ -1506,6 +1592,563 @@ static int test_EVP_PKEY_CTX_get_set_params(void)
     return ret;
 }
 
+static const char *batch_digests[] = {
+    "SHA224", "SHA256", "SHA384", "SHA512", "SHA512-256", "SHA1"
+};
+
+/*
+ * Message lengths around the block and padding boundaries of both SHA-256
+ * and SHA-512, more messages than there are lanes in multi-block code.
+ */
+static const size_t batch_lens[] = {
+    0, 1, 55, 56, 63, 64, 65, 111, 112, 119, 120, 127, 128, 129, 200, 256,
+    1000, 4097, 3, 10000
+};
+
+static int test_EVP_DigestBatch(int idx)
+{
+    const unsigned char *in[OSSL_NELEM(batch_lens)];
+    unsigned char *data = NULL, *out = NULL;
+    unsigned char md[EVP_MAX_MD_SIZE];
+    EVP_MD *fetched = NULL;
+    const EVP_MD *type;
+    size_t i, total = 0, n = OSSL_NELEM(batch_lens);
+    int legacy, mdlen, ret = 0;
+
+    for (i = 0; i < n; i++)
+        total += batch_lens[i];
+    if (!TEST_ptr(data = OPENSSL_malloc(total)))
+        goto err;
+    for (i = 0; i < total; i++)
+        data[i] = (unsigned char)(i * 7 + (i >> 8));
+    for (i = 0, total = 0; i < n; i++) {
+        in[i] = data + total;
+        total += batch_lens[i];
+    }
+
+    if (!TEST_ptr(fetched = EVP_MD_fetch(NULL, batch_digests[idx], NULL))
+            || !TEST_int_gt(mdlen = EVP_MD_size(fetched), 0)
+            || !TEST_ptr(out = OPENSSL_malloc(n * mdlen)))
+        goto err;
+
+    /* Both the fetched and the legacy digest take the provider route */
+    for (legacy = 0; legacy < 2; legacy++) {
+        type = legacy ? EVP_get_digestbyname(batch_digests[idx]) : fetched;
+        memset(out, 0, n * mdlen);
+        if (!TEST_ptr(type)
+                || !TEST_true(EVP_DigestBatch(in, batch_lens, n, out, type))
+                || !TEST_true(EVP_DigestBatch(in, batch_lens, 1, out, type)))
+            goto err;
+        for (i = 0; i < n; i++) {
+            if (!TEST_true(EVP_Digest(in[i], batch_lens[i], md, NULL, type,
+                                      NULL))
+                    || !TEST_mem_eq(out + i * mdlen, mdlen, md, mdlen)) {
+                TEST_info("%s, message %zu", batch_digests[idx], i);
+                goto err;
+            }
+        }
+    }
+    ret = 1;
+
+ err:
+    EVP_MD_free(fetched);
+    OPENSSL_free(data);
+    OPENSSL_free(out);
+    return ret;
+}
+
+static const char *threads_ciphers[] = {
+    "AES-128-CTR", "AES-256-CTR", "id-aes128-GCM", "id-aes256-GCM"
+};
+
+static int threads_encrypt(const EVP_CIPHER *cipher, int threads,
+                           const unsigned char *in, size_t len,
+                           unsigned char *out, unsigned char *tag)
+{
+    static const unsigned char key[32] = { 1, 2, 3 };
+    unsigned char iv[16];
+    EVP_CIPHER_CTX *ctx = NULL;
+    int gcm = EVP_CIPHER_mode(cipher) == EVP_CIPH_GCM_MODE;
+    int outl, outl2, ret = 0;
+
+    /* Start close to the point where the counter wraps */
+    memset(iv, 0xff, sizeof(iv));
+    if (!TEST_ptr(ctx = EVP_CIPHER_CTX_new())
+            || !TEST_true(EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv))
+            || (threads > 1
+                && !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_SET_THREADS,
+                                                    threads, NULL), 0))
+            || (gcm && !TEST_true(EVP_EncryptUpdate(ctx, NULL, &outl, in, 13)))
+            /* An odd first update leaves a partial block behind */
+            || !TEST_true(EVP_EncryptUpdate(ctx, out, &outl, in, 7))
+            || !TEST_true(EVP_EncryptUpdate(ctx, out + outl, &outl2, in + 7,
+                                            len - 7))
+            || !TEST_true(EVP_EncryptFinal_ex(ctx, out + outl + outl2, &outl))
+            || (gcm && !TEST_true(EVP_CIPHER_CTX_ctrl(ctx,
+                                                      EVP_CTRL_AEAD_GET_TAG,
+                                                      16, tag))))
+        goto err;
+    ret = 1;
+ err:
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+/*
+ * Splitting an operation over the library's thread pool must not change
+ * its result.
+ */
+static int test_EVP_CIPHER_threads(int idx)
+{
+    const size_t len = 1024 * 1024 + 35;
+    OPENSSL_INIT_SETTINGS *settings = NULL;
+    EVP_CIPHER *cipher = NULL;
+    unsigned char *in = NULL, *out1 = NULL, *out2 = NULL;
+    unsigned char tag1[16] = { 0 }, tag2[16] = { 0 };
+    size_t i;
+    int threads, ret = 0;
+
+    if (!TEST_ptr(settings = OPENSSL_INIT_new()))
+        goto err;
+    OPENSSL_INIT_set_thread_pool_size(settings, 3);
+    if (!TEST_true(OPENSSL_init_crypto(OPENSSL_INIT_THREAD_POOL, settings))
+            || !TEST_ptr(cipher = EVP_CIPHER_fetch(NULL, threads_ciphers[idx],
+                                                   NULL))
+            || !TEST_ptr(in = OPENSSL_malloc(len))
+            || !TEST_ptr(out1 = OPENSSL_malloc(len))
+            || !TEST_ptr(out2 = OPENSSL_malloc(len)))
+        goto err;
+    for (i = 0; i < len; i++)
+        in[i] = (unsigned char)(i * 31 + (i >> 9));
+
+    if (!threads_encrypt(cipher, 1, in, len, out1, tag1))
+        goto err;
+    for (threads = 2; threads <= 8; threads += 3) {
+        if (!threads_encrypt(cipher, threads, in, len, out2, tag2)
+                || !TEST_mem_eq(out1, len, out2, len)
+                || !TEST_mem_eq(tag1, sizeof(tag1), tag2, sizeof(tag2))) {
+            TEST_info("%s, %d threads", threads_ciphers[idx], threads);
+            goto err;
+        }
+    }
+    ret = 1;
+ err:
+    OPENSSL_INIT_free(settings);
+    EVP_CIPHER_free(cipher);
+    OPENSSL_free(in);
+    OPENSSL_free(out1);
+    OPENSSL_free(out2);
+    return ret;
+}
+
+static const char *xts_ciphers[] = { "AES-128-XTS", "AES-256-XTS" };
+
+static int xts_set_sectors(EVP_CIPHER_CTX *ctx, size_t size, uint64_t sector)
+{
+    OSSL_PARAM params[3];
+
+    params[0] = OSSL_PARAM_construct_size_t(OSSL_CIPHER_PARAM_XTS_SECTOR_SIZE,
+                                            &size);
+    params[1] = OSSL_PARAM_construct_uint64(OSSL_CIPHER_PARAM_XTS_SECTOR,
+                                            &sector);
+    params[2] = OSSL_PARAM_construct_end();
+    return EVP_CIPHER_CTX_set_params(ctx, params);
+}
+
+/*
+ * A batch of sectors must give the same result as encrypting every sector
+ * on its own with its number as the tweak, however it is split up.
+ */
+static int test_EVP_CIPHER_xts_sectors(int idx)
+{
+    const size_t size = 4096, nsect = 64, len = size * nsect;
+    /* The sector number crosses a 32-bit boundary within the batch */
+    const uint64_t start = 0xffffffe0;
+    OSSL_PARAM params[2];
+    OPENSSL_INIT_SETTINGS *settings = NULL;
+    EVP_CIPHER *cipher = NULL;
+    EVP_CIPHER_CTX *ctx = NULL;
+    unsigned char key[64], iv[16];
+    unsigned char *in = NULL, *ref = NULL, *out = NULL;
+    uint64_t sector;
+    size_t i, j;
+    int outl, outl2, ret = 0;
+
+    for (i = 0; i < sizeof(key); i++)
+        key[i] = (unsigned char)(i * 13 + 1);
+    if (!TEST_ptr(settings = OPENSSL_INIT_new()))
+        goto err;
+    OPENSSL_INIT_set_thread_pool_size(settings, 3);
+    if (!TEST_true(OPENSSL_init_crypto(OPENSSL_INIT_THREAD_POOL, settings))
+            || !TEST_ptr(cipher = EVP_CIPHER_fetch(NULL, xts_ciphers[idx],
+                                                   NULL))
+            || !TEST_ptr(ctx = EVP_CIPHER_CTX_new())
+            || !TEST_ptr(in = OPENSSL_malloc(len))
+            || !TEST_ptr(ref = OPENSSL_malloc(len))
+            || !TEST_ptr(out = OPENSSL_malloc(len)))
+        goto err;
+    for (i = 0; i < len; i++)
+        in[i] = (unsigned char)(i * 31 + (i >> 9));
+
+    /* One data unit at a time, as without the batch interface */
+    if (!TEST_true(EVP_EncryptInit_ex(ctx, cipher, NULL, key, NULL)))
+        goto err;
+    for (i = 0; i < nsect; i++) {
+        memset(iv, 0, sizeof(iv));
+        for (j = 0; j < 8; j++)
+            iv[j] = (unsigned char)((start + i) >> (8 * j));
+        if (!TEST_true(EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv))
+                || !TEST_true(EVP_EncryptUpdate(ctx, ref + i * size, &outl,
+                                                in + i * size, size)))
+            goto err;
+    }
+
+    /* A single sector, then the rest, spread over several threads */
+    if (!TEST_true(EVP_EncryptInit_ex(ctx, cipher, NULL, key, NULL))
+            || !TEST_true(xts_set_sectors(ctx, size, start))
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_SET_THREADS, 4,
+                                                NULL), 0)
+            || !TEST_true(EVP_EncryptUpdate(ctx, out, &outl, in, size))
+            || !TEST_true(EVP_EncryptUpdate(ctx, out + outl, &outl2,
+                                            in + outl, len - size))
+            || !TEST_size_t_eq(outl + outl2, len)
+            || !TEST_mem_eq(out, len, ref, len))
+        goto err;
+
+    /* The sector number has moved past the batch */
+    params[0] = OSSL_PARAM_construct_uint64(OSSL_CIPHER_PARAM_XTS_SECTOR,
+                                            &sector);
+    params[1] = OSSL_PARAM_construct_end();
+    if (!TEST_true(EVP_CIPHER_CTX_get_params(ctx, params))
+            || !TEST_true(sector == start + nsect))
+        goto err;
+
+    /* Partial sectors are rejected */
+    if (!TEST_false(EVP_EncryptUpdate(ctx, out, &outl, in, size + 16)))
+        goto err;
+
+    if (!TEST_true(EVP_DecryptInit_ex(ctx, cipher, NULL, key, NULL))
+            || !TEST_true(xts_set_sectors(ctx, size, start))
+            || !TEST_true(EVP_DecryptUpdate(ctx, out, &outl, ref, len))
+            || !TEST_mem_eq(out, len, in, len))
+        goto err;
+    ret = 1;
+ err:
+    OPENSSL_INIT_free(settings);
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_CIPHER_free(cipher);
+    OPENSSL_free(in);
+    OPENSSL_free(ref);
+    OPENSSL_free(out);
+    return ret;
+}
+
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+/*
+ * Record lengths around the ChaCha20 block size and the 512 byte chunks of
+ * the stitched x86_64 code, up to a full TLS record.
+ */
+static const size_t chacha_tls_lens[] = {
+    0, 1, 15, 16, 17, 63, 64, 65, 255, 256, 511, 512, 513, 1023, 1024, 1025,
+    1536 + 15, 4096, 16384
+};
+
+/*
+ * Seal and open a TLS record with EVP_chacha20_poly1305() in TLS mode, and
+ * check it against the plain AEAD interface.
+ */
+static int test_chacha20_poly1305_tls(int idx)
+{
+    static const unsigned char key[32] = { 1, 2, 3, 4 };
+    static const unsigned char fixed_iv[12] = {
+        0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43,
+        0x44, 0x45, 0x46, 0x47
+    };
+    unsigned char aad[EVP_AEAD_TLS1_AAD_LEN] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,     /* sequence */
+        0x17, 0x03, 0x03                            /* application data */
+    };
+    unsigned char nonce[12], tag[16];
+    unsigned char *in = NULL, *rec = NULL, *ref = NULL;
+    size_t len = chacha_tls_lens[idx], i;
+    EVP_CIPHER_CTX *ctx = NULL;
+    int outl, tmpl, ret = 0;
+
+    if (!TEST_ptr(in = OPENSSL_malloc(len + 1))
+            || !TEST_ptr(rec = OPENSSL_malloc(len + 16))
+            || !TEST_ptr(ref = OPENSSL_malloc(len + 1))
+            || !TEST_ptr(ctx = EVP_CIPHER_CTX_new()))
+        goto err;
+    for (i = 0; i < len; i++)
+        in[i] = (unsigned char)(i * 11 + (i >> 8));
+
+    /* The reference: the record sequence number is mixed into the nonce */
+    memcpy(nonce, fixed_iv, sizeof(nonce));
+    for (i = 0; i < 8; i++)
+        nonce[4 + i] ^= aad[i];
+    aad[EVP_AEAD_TLS1_AAD_LEN - 2] = (unsigned char)(len >> 8);
+    aad[EVP_AEAD_TLS1_AAD_LEN - 1] = (unsigned char)len;
+    if (!TEST_true(EVP_EncryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, key,
+                                      nonce))
+            || !TEST_true(EVP_EncryptUpdate(ctx, NULL, &outl, aad,
+                                            sizeof(aad)))
+            || !TEST_true(EVP_EncryptUpdate(ctx, ref, &outl, in, len))
+            || !TEST_true(EVP_EncryptFinal_ex(ctx, ref + outl, &tmpl))
+            || !TEST_true(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG,
+                                              sizeof(tag), tag)))
+        goto err;
+
+    /* Seal in place, the tag goes after the payload */
+    memcpy(rec, in, len);
+    if (!TEST_true(EVP_EncryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, key,
+                                      fixed_iv))
+            || !TEST_int_eq(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD,
+                                                sizeof(aad), aad), 16)
+            || !TEST_int_eq(EVP_Cipher(ctx, rec, rec, len + 16),
+                            (int)(len + 16))
+            || !TEST_mem_eq(rec, len, ref, len)
+            || !TEST_mem_eq(rec + len, 16, tag, sizeof(tag)))
+        goto err;
+
+    /* Open it again, the length in the AAD now includes the tag */
+    aad[EVP_AEAD_TLS1_AAD_LEN - 2] = (unsigned char)((len + 16) >> 8);
+    aad[EVP_AEAD_TLS1_AAD_LEN - 1] = (unsigned char)(len + 16);
+    if (!TEST_true(EVP_DecryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, key,
+                                      fixed_iv))
+            || !TEST_int_eq(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD,
+                                                sizeof(aad), aad), 16)
+            || !TEST_int_eq(EVP_Cipher(ctx, rec, rec, len + 16),
+                            (int)(len + 16))
+            || !TEST_mem_eq(rec, len, in, len))
+        goto err;
+
+    /* A record that has been tampered with is rejected */
+    memcpy(rec, ref, len);
+    memcpy(rec + len, tag, sizeof(tag));
+    rec[len / 2] ^= 0x80;
+    if (!TEST_int_eq(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD,
+                                         sizeof(aad), aad), 16)
+            || !TEST_int_lt(EVP_Cipher(ctx, rec, rec, len + 16), 0))
+        goto err;
+    ret = 1;
+
+ err:
+    EVP_CIPHER_CTX_free(ctx);
+    OPENSSL_free(in);
+    OPENSSL_free(rec);
+    OPENSSL_free(ref);
+    return ret;
+}
+#endif
+
+#ifndef OPENSSL_NO_EC
+# define VERIFY_BATCH_KEYS 3
+# define VERIFY_BATCH_SIGS 21
+
+static const int verify_batch_types[] = { EVP_PKEY_EC, EVP_PKEY_ED25519 };
+
+static EVP_PKEY *batch_keygen(int type, int curve)
+{
+    EVP_PKEY_CTX *ctx;
+    EVP_PKEY *pkey = NULL;
+
+    if (!TEST_ptr(ctx = EVP_PKEY_CTX_new_id(type, NULL))
+            || !TEST_int_gt(EVP_PKEY_keygen_init(ctx), 0)
+            || (type == EVP_PKEY_EC
+                && !TEST_int_gt(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx,
+                                                                       curve),
+                                0))
+            || !TEST_int_gt(EVP_PKEY_keygen(ctx, &pkey), 0))
+        pkey = NULL;
+    EVP_PKEY_CTX_free(ctx);
+    return pkey;
+}
+
+static int test_EVP_PKEY_verify_batch(int idx)
+{
+    int type = verify_batch_types[idx];
+    EVP_PKEY *signers[VERIFY_BATCH_KEYS] = { NULL };
+    EVP_PKEY *pkey[VERIFY_BATCH_SIGS];
+    unsigned char msgs[VERIFY_BATCH_SIGS][32];
+    unsigned char sigs[VERIFY_BATCH_SIGS][80];
+    const unsigned char *sig[VERIFY_BATCH_SIGS], *tbs[VERIFY_BATCH_SIGS];
+    size_t siglen[VERIFY_BATCH_SIGS], tbslen[VERIFY_BATCH_SIGS];
+    int status[VERIFY_BATCH_SIGS];
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_MD_CTX *mctx = NULL;
+    size_t i, n = VERIFY_BATCH_SIGS;
+    int ret = 0;
+
+    for (i = 0; i < VERIFY_BATCH_KEYS; i++)
+        if (!TEST_ptr(signers[i] = batch_keygen(type, NID_X9_62_prime256v1)))
+            goto err;
+
+    for (i = 0; i < n; i++) {
+        /* The first key signs every other message, so keys repeat */
+        pkey[i] = signers[i % 2 == 0 ? 0 : i % VERIFY_BATCH_KEYS];
+        memset(msgs[i], (int)i, sizeof(msgs[i]));
+        sig[i] = sigs[i];
+        tbs[i] = msgs[i];
+        tbslen[i] = sizeof(msgs[i]);
+        siglen[i] = sizeof(sigs[i]);
+        if (type == EVP_PKEY_EC) {
+            if (!TEST_ptr(pctx = EVP_PKEY_CTX_new(pkey[i], NULL))
+                    || !TEST_int_gt(EVP_PKEY_sign_init(pctx), 0)
+                    || !TEST_int_gt(EVP_PKEY_sign(pctx, sigs[i], &siglen[i],
+                                                  tbs[i], tbslen[i]), 0))
+                goto err;
+            EVP_PKEY_CTX_free(pctx);
+            pctx = NULL;
+        } else {
+            if (!TEST_ptr(mctx = EVP_MD_CTX_new())
+                    || !TEST_true(EVP_DigestSignInit(mctx, NULL, NULL, NULL,
+                                                     pkey[i]))
+                    || !TEST_true(EVP_DigestSign(mctx, sigs[i], &siglen[i],
+                                                 tbs[i], tbslen[i])))
+                goto err;
+            EVP_MD_CTX_free(mctx);
+            mctx = NULL;
+        }
+    }
+
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(pkey, sig, siglen, tbs, tbslen, n,
+                                           status), 1)
+            || !TEST_int_eq(EVP_PKEY_verify_batch(pkey, sig, siglen, tbs,
+                                                  tbslen, n, NULL), 1)
+            || !TEST_int_eq(EVP_PKEY_verify_batch(pkey, sig, siglen, tbs,
+                                                  tbslen, 1, NULL), 1))
+        goto err;
+    for (i = 0; i < n; i++)
+        if (!TEST_int_eq(status[i], 1))
+            goto err;
+
+    /* One bad signature fails the batch and is the only one reported */
+    msgs[7][0] ^= 1;
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(pkey, sig, siglen, tbs, tbslen, n,
+                                           NULL), 0)
+            || !TEST_int_eq(EVP_PKEY_verify_batch(pkey, sig, siglen, tbs,
+                                                  tbslen, n, status), 0))
+        goto err;
+    for (i = 0; i < n; i++)
+        if (!TEST_int_eq(status[i], i == 7 ? 0 : 1))
+            goto err;
+    msgs[7][0] ^= 1;
+
+    /* A signature made with a different key, but a valid one otherwise */
+    pkey[4] = signers[2];
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(pkey, sig, siglen, tbs, tbslen, n,
+                                           status), 0)
+            || !TEST_int_eq(status[4], 0)
+            || !TEST_int_eq(status[3], 1))
+        goto err;
+    ret = 1;
+
+ err:
+    EVP_PKEY_CTX_free(pctx);
+    EVP_MD_CTX_free(mctx);
+    for (i = 0; i < VERIFY_BATCH_KEYS; i++)
+        EVP_PKEY_free(signers[i]);
+    return ret;
+}
+
+# define DERIVE_BATCH_KEYS 4
+# define DERIVE_BATCH_PAIRS 21
+
+static const int derive_batch_types[] = { EVP_PKEY_X25519, EVP_PKEY_EC };
+
+static int test_EVP_PKEY_derive_batch(int idx)
+{
+    static const unsigned char zeros[32] = { 0 };
+    int type = derive_batch_types[idx];
+    EVP_PKEY *privs[DERIVE_BATCH_KEYS] = { NULL };
+    EVP_PKEY *peers[DERIVE_BATCH_KEYS] = { NULL }, *bad = NULL;
+    EVP_PKEY *pkey[DERIVE_BATCH_PAIRS], *peer[DERIVE_BATCH_PAIRS];
+    unsigned char secrets[DERIVE_BATCH_PAIRS][66], expected[66];
+    unsigned char saved[DERIVE_BATCH_PAIRS][66];
+    unsigned char *key[DERIVE_BATCH_PAIRS];
+    size_t keylen[DERIVE_BATCH_PAIRS], savedlen[DERIVE_BATCH_PAIRS], explen;
+    EVP_PKEY_CTX *ctx = NULL;
+    size_t i, n = DERIVE_BATCH_PAIRS;
+    int ret = 0;
+
+    for (i = 0; i < DERIVE_BATCH_KEYS; i++)
+        if (!TEST_ptr(privs[i] = batch_keygen(type, NID_X9_62_prime256v1))
+                || !TEST_ptr(peers[i] = batch_keygen(type,
+                                                     NID_X9_62_prime256v1)))
+            goto err;
+
+    for (i = 0; i < n; i++) {
+        pkey[i] = privs[i % DERIVE_BATCH_KEYS];
+        peer[i] = peers[(i * 3) % DERIVE_BATCH_KEYS];
+        key[i] = secrets[i];
+        keylen[i] = sizeof(secrets[i]);
+    }
+    if (!TEST_int_eq(EVP_PKEY_derive_batch(pkey, peer, key, keylen, n), 1))
+        goto err;
+    for (i = 0; i < n; i++) {
+        explen = sizeof(expected);
+        if (!TEST_ptr(ctx = EVP_PKEY_CTX_new(pkey[i], NULL))
+                || !TEST_int_gt(EVP_PKEY_derive_init(ctx), 0)
+                || !TEST_int_gt(EVP_PKEY_derive_set_peer(ctx, peer[i]), 0)
+                || !TEST_int_gt(EVP_PKEY_derive(ctx, expected, &explen), 0)
+                || !TEST_mem_eq(secrets[i], keylen[i], expected, explen))
+            goto err;
+        EVP_PKEY_CTX_free(ctx);
+        ctx = NULL;
+        memcpy(saved[i], secrets[i], keylen[i]);
+        savedlen[i] = keylen[i];
+    }
+
+    /* An empty buffer for one EC pair doesn't displace the other secrets */
+    if (type == EVP_PKEY_EC) {
+        for (i = 0; i < n; i++)
+            keylen[i] = sizeof(secrets[i]);
+        keylen[2] = 0;
+        memset(secrets, 0, sizeof(secrets));
+        if (!TEST_int_eq(EVP_PKEY_derive_batch(pkey, peer, key, keylen, n), 1)
+                || !TEST_size_t_eq(keylen[2], 0))
+            goto err;
+        for (i = 0; i < n; i++)
+            if (i != 2
+                    && !TEST_mem_eq(secrets[i], keylen[i], saved[i],
+                                    savedlen[i]))
+                goto err;
+    }
+
+    /*
+     * A peer that must fail: a point of small order for X25519, which takes
+     * the batch path, and a key on another curve for EC, which doesn't
+     */
+    if (type == EVP_PKEY_X25519)
+        bad = EVP_PKEY_new_raw_public_key(type, NULL, zeros, sizeof(zeros));
+    else
+        bad = batch_keygen(type, NID_secp384r1);
+    if (!TEST_ptr(bad))
+        goto err;
+    peer[5] = bad;
+    for (i = 0; i < n; i++)
+        keylen[i] = sizeof(secrets[i]);
+    memset(secrets, 0, sizeof(secrets));
+    if (!TEST_int_eq(EVP_PKEY_derive_batch(pkey, peer, key, keylen, n), 0)
+            || !TEST_size_t_eq(keylen[5], 0))
+        goto err;
+    for (i = 0; i < n; i++)
+        if (i != 5
+                && !TEST_mem_eq(secrets[i], keylen[i], saved[i], savedlen[i]))
+            goto err;
+    ret = 1;
+
+ err:
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(bad);
+    for (i = 0; i < DERIVE_BATCH_KEYS; i++) {
+        EVP_PKEY_free(privs[i]);
+        EVP_PKEY_free(peers[i]);
+    }
+    return ret;
+}
+#endif
+
 int setup_tests(void)
 {
     ADD_TEST(test_EVP_DigestSignInit);
@@ -1542,6 +2185,18 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_EVP_MD_fetch, 5);
     ADD_ALL_TESTS(test_EVP_CIPHER_fetch, 5);
 #endif
+    ADD_TEST(test_EVP_MD_legacy_cache);
+    ADD_ALL_TESTS(test_EVP_thread_fetch_cache, 2);
     ADD_TEST(test_EVP_PKEY_CTX_get_set_params);
+    ADD_ALL_TESTS(test_EVP_DigestBatch, OSSL_NELEM(batch_digests));
+    ADD_ALL_TESTS(test_EVP_CIPHER_threads, OSSL_NELEM(threads_ciphers));
+    ADD_ALL_TESTS(test_EVP_CIPHER_xts_sectors, OSSL_NELEM(xts_ciphers));
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+    ADD_ALL_TESTS(test_chacha20_poly1305_tls, OSSL_NELEM(chacha_tls_lens));
+#endif
+#ifndef OPENSSL_NO_EC
+    ADD_ALL_TESTS(test_EVP_PKEY_verify_batch, OSSL_NELEM(verify_batch_types));
+    ADD_ALL_TESTS(test_EVP_PKEY_derive_batch, OSSL_NELEM(derive_batch_types));
+#endif
     return 1;
 }
@@ -198,9 +198,152 @@ static int test_mod_exp(int round)
     return ret;
 }
 
+/*
+ * Moduli of these sizes take dedicated code paths on some platforms, check
+ * them with full-size exponents and some extreme bases.
+ */
+static int test_mod_exp_consttime_sizes(int idx)
+{
+    static const int sizes[] = { 1024, 1536, 2048 };
+    BN_CTX *ctx = NULL;
+    BIGNUM *a = NULL, *p = NULL, *m = NULL;
+    BIGNUM *r_simple = NULL, *r_mont_const = NULL;
+    int i, ret = 0;
+
+    if (!TEST_ptr(ctx = BN_CTX_new())
+        || !TEST_ptr(a = BN_new())
+        || !TEST_ptr(p = BN_new())
+        || !TEST_ptr(m = BN_new())
+        || !TEST_ptr(r_simple = BN_new())
+        || !TEST_ptr(r_mont_const = BN_new()))
+        goto err;
+
+    if (!TEST_true(BN_rand(m, sizes[idx], BN_RAND_TOP_ONE,
+                           BN_RAND_BOTTOM_ODD)))
+        goto err;
+
+    for (i = 0; i < 8; i++) {
+        switch (i) {
+        case 0:
+            BN_zero(a);
+            break;
+        case 1:
+            if (!TEST_true(BN_one(a)))
+                goto err;
+            break;
+        case 2:
+            if (!TEST_true(BN_sub(a, m, BN_value_one())))
+                goto err;
+            break;
+        default:
+            if (!TEST_true(BN_rand_range(a, m)))
+                goto err;
+        }
+        /* Also try exponents shorter than the modulus */
+        if (!TEST_true(BN_rand(p, sizes[idx] - (i % 3) * 100,
+                               BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ANY))
+            || !TEST_true(BN_mod_exp_simple(r_simple, a, p, m, ctx))
+            || !TEST_true(BN_mod_exp_mont_consttime(r_mont_const, a, p, m,
+                                                    ctx, NULL)))
+            goto err;
+
+        if (!TEST_BN_eq(r_simple, r_mont_const)) {
+            BN_print_var(a);
+            BN_print_var(p);
+            BN_print_var(m);
+            goto err;
+        }
+    }
+
+    ret = 1;
+ err:
+    BN_free(r_simple);
+    BN_free(r_mont_const);
+    BN_free(a);
+    BN_free(p);
+    BN_free(m);
+    BN_CTX_free(ctx);
+    return ret;
+}
+
+/*
+ * Check BN_mod_exp_mont_consttime_x2() against BN_mod_exp_simple() for
+ * moduli of the sizes that have a dedicated code path and one that has not.
+ */
+static int test_mod_exp_x2(int idx)
+{
+    static const int sizes[] = { 1024, 1536, 2048 };
+    BN_CTX *ctx = NULL;
+    BIGNUM *a1 = NULL, *p1 = NULL, *m1 = NULL, *r1 = NULL, *r1_simple = NULL;
+    BIGNUM *a2 = NULL, *p2 = NULL, *m2 = NULL, *r2 = NULL, *r2_simple = NULL;
+    int i, ret = 0;
+
+    if (!TEST_ptr(ctx = BN_CTX_new())
+        || !TEST_ptr(a1 = BN_new())
+        || !TEST_ptr(p1 = BN_new())
+        || !TEST_ptr(m1 = BN_new())
+        || !TEST_ptr(r1 = BN_new())
+        || !TEST_ptr(r1_simple = BN_new())
+        || !TEST_ptr(a2 = BN_new())
+        || !TEST_ptr(p2 = BN_new())
+        || !TEST_ptr(m2 = BN_new())
+        || !TEST_ptr(r2 = BN_new())
+        || !TEST_ptr(r2_simple = BN_new()))
+        goto err;
+
+    for (i = 0; i < 8; i++) {
+        if (!TEST_true(BN_rand(m1, sizes[idx], BN_RAND_TOP_ONE,
+                               BN_RAND_BOTTOM_ODD))
+            || !TEST_true(BN_rand(m2, sizes[idx], BN_RAND_TOP_ONE,
+                                  BN_RAND_BOTTOM_ODD))
+            || !TEST_true(BN_rand_range(a1, m1))
+            || !TEST_true(BN_rand_range(a2, m2))
+            || !TEST_true(BN_rand(p1, sizes[idx], BN_RAND_TOP_ANY,
+                                  BN_RAND_BOTTOM_ANY))
+            || !TEST_true(BN_rand(p2, sizes[idx] - i * 8, BN_RAND_TOP_ONE,
+                                  BN_RAND_BOTTOM_ANY))
+            || !TEST_true(BN_mod_exp_simple(r1_simple, a1, p1, m1, ctx))
+            || !TEST_true(BN_mod_exp_simple(r2_simple, a2, p2, m2, ctx))
+            || !TEST_true(BN_mod_exp_mont_consttime_x2(r1, a1, p1, m1, NULL,
+                                                       r2, a2, p2, m2, NULL,
+                                                       ctx)))
+            goto err;
+
+        if (!TEST_BN_eq(r1_simple, r1)) {
+            BN_print_var(a1);
+            BN_print_var(p1);
+            BN_print_var(m1);
+            goto err;
+        }
+        if (!TEST_BN_eq(r2_simple, r2)) {
+            BN_print_var(a2);
+            BN_print_var(p2);
+            BN_print_var(m2);
+            goto err;
+        }
+    }
+
+    ret = 1;
+ err:
+    BN_free(a1);
+    BN_free(p1);
+    BN_free(m1);
+    BN_free(r1);
+    BN_free(r1_simple);
+    BN_free(a2);
+    BN_free(p2);
+    BN_free(m2);
+    BN_free(r2);
+    BN_free(r2_simple);
+    BN_CTX_free(ctx);
+    return ret;
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_mod_exp_zero);
     ADD_ALL_TESTS(test_mod_exp, 200);
+    ADD_ALL_TESTS(test_mod_exp_consttime_sizes, 3);
+    ADD_ALL_TESTS(test_mod_exp_x2, 3);
     return 1;
 }
@@ -372,6 +372,51 @@ err:
     return res;
 }
 
+/*
+ * Test that cached queries follow replacements, deletions and the flushing
+ * that adding methods does, however often they have been looked up before.
+ */
+static int test_query_cache_update(void)
+{
+    OSSL_METHOD_STORE *store;
+    int i, ret = 0;
+    void *result;
+
+    if (!TEST_ptr(store = ossl_method_store_new(NULL))
+        || !add_property_names("n", NULL)
+        || !TEST_true(ossl_method_store_add(store, NULL, 1, "n=1", "a",
+                                            NULL, NULL))
+        || !TEST_true(ossl_method_store_add(store, NULL, 2, "n=2", "b",
+                                            NULL, NULL))
+        || !TEST_true(ossl_method_store_cache_set(store, 1, "n=1", "one"))
+        || !TEST_true(ossl_method_store_cache_set(store, 2, "n=2", "two")))
+        goto err;
+
+    for (i = 0; i < 2; i++)
+        if (!TEST_true(ossl_method_store_cache_get(store, 1, "n=1", &result))
+            || !TEST_str_eq((char *)result, "one")
+            || !TEST_false(ossl_method_store_cache_get(store, 2, "n=1",
+                                                       &result)))
+            goto err;
+
+    if (!TEST_true(ossl_method_store_cache_set(store, 1, "n=1", "uno"))
+        || !TEST_true(ossl_method_store_cache_get(store, 1, "n=1", &result))
+        || !TEST_str_eq((char *)result, "uno")
+        || !TEST_true(ossl_method_store_cache_set(store, 1, "n=1", NULL))
+        || !TEST_false(ossl_method_store_cache_get(store, 1, "n=1", &result))
+        || !TEST_true(ossl_method_store_cache_get(store, 2, "n=2", &result))
+        || !TEST_str_eq((char *)result, "two")
+        || !TEST_true(ossl_method_store_add(store, NULL, 2, "n=3", "c",
+                                            NULL, NULL))
+        || !TEST_false(ossl_method_store_cache_get(store, 2, "n=2", &result)))
+        goto err;
+
+    ret = 1;
+err:
+    ossl_method_store_free(store);
+    return ret;
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_property_string);
@@ -382,5 +427,6 @@ int setup_tests(void)
     ADD_TEST(test_register_deregister);
     ADD_TEST(test_property);
     ADD_TEST(test_query_cache_stochastic);
+    ADD_TEST(test_query_cache_update);
     return 1;
 }
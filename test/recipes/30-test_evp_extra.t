@@ -11,9 +11,29 @@ use strict;
 use warnings;
 
 use OpenSSL::Test qw/:DEFAULT bldtop_dir/;
+use OpenSSL::Test::Utils;
 
 setup("test_evp_extra");
 
-plan tests => 1;
+plan tests => 3;
 
 ok(run(test(["evp_extra_test"])), "running evp_extra_test");
+
+# The stitched ChaCha20-Poly1305 TLS code is only used on x86_64 processors
+# with AVX2 but without AVX512F/VL, so mask those out to have it tested there
+SKIP: {
+    skip "ChaCha20-Poly1305 is not supported by this OpenSSL build", 1
+        if disabled("chacha") || disabled("poly1305");
+
+    local $ENV{OPENSSL_ia32cap} = ":~0x80010000";
+    ok(run(test(["evp_extra_test", "-test", "test_chacha20_poly1305_tls"])),
+       "running the ChaCha20-Poly1305 TLS tests without AVX512");
+}
+
+# The multi-buffer SHA-2 code prefers AVX512F and SHA extensions where
+# available, mask those out to have the AVX2 paths tested there too
+{
+    local $ENV{OPENSSL_ia32cap} = ":~0x20010000";
+    ok(run(test(["evp_extra_test", "-test", "test_EVP_DigestBatch"])),
+       "running the EVP_DigestBatch tests without AVX512 and SHA extensions");
+}
@@ -23,7 +23,7 @@ setup("test_rehash");
 plan skip_all => "test_rehash is not available on this platform"
     unless run(app(["openssl", "rehash", "-help"]));
 
-plan tests => 4;
+plan tests => 7;
 
 indir "rehash.$$" => sub {
     prepare();
@@ -56,6 +56,36 @@ indir "rehash.$$" => sub {
     chmod 0700, curdir();       # make it writable again, so cleanup works
 }, create => 1, cleanup => 1;
 
+indir "rehash.$$" => sub {
+    prepare();
+    ok(run(app(["openssl", "rehash", "-compile", "trust.store", curdir()]))
+       && -s "trust.store",
+       'Testing rehash compiling a trust store');
+}, create => 1, cleanup => 1;
+
+indir "rehash.$$" => sub {
+    prepare();
+    my @once = run(app(["openssl", "rehash", "-v", "-compile", "trust.store",
+                        curdir()]), capture => 1);
+    my @twice = run(app(["openssl", "rehash", "-v", "-compile", "trust.store",
+                         curdir(), curdir()]), capture => 1);
+    @once = grep { /^wrote / } @once;
+    @twice = grep { /^wrote / } @twice;
+    ok(scalar @once == 1 && scalar @twice == 1 && $once[0] eq $twice[0],
+       'Testing rehash compiling drops duplicate certificates');
+}, create => 1, cleanup => 1;
+
+indir "rehash.$$" => sub {
+    open OUT, '>', "bad.pem" or die "Can't write bad.pem\n";
+    print OUT "-----BEGIN CERTIFICATE-----\n",
+              "not a certificate\n",
+              "-----END CERTIFICATE-----\n";
+    close OUT;
+    isnt(run(app(["openssl", "rehash", "-compile", "trust.store",
+                  curdir()])), 1,
+         'Testing rehash compiling an unreadable certificate file');
+}, create => 1, cleanup => 1;
+
 sub prepare {
     my @pemsourcefiles = sort glob(srctop_file('test', "*.pem"));
     my @destfiles = ();
@@ -7,14 +7,20 @@
 # https://www.openssl.org/source/license.html
 
 
+use File::Temp qw(tempfile);
 use OpenSSL::Test qw/:DEFAULT srctop_file/;
 
 setup("test_verify_extra");
 
 plan tests => 1;
 
+(undef, my $tmpfilename) = tempfile();
+
 ok(run(test(["verify_extra_test",
              srctop_file("test", "certs", "roots.pem"),
              srctop_file("test", "certs", "untrusted.pem"),
              srctop_file("test", "certs", "bad.pem"),
-             srctop_file("test", "certs", "sm2-csr.pem")])));
+             srctop_file("test", "certs", "sm2-csr.pem"),
+             $tmpfilename])));
+
+unlink $tmpfilename;
@@ -18,6 +18,7 @@
 #include <openssl/srp.h>
 #include <openssl/txt_db.h>
 #include <openssl/aes.h>
+#include <openssl/engine.h>
 #include <openssl/rand.h>
 
 #include "ssltestlib.h"
@@ -820,8 +821,16 @@ end:
     return 0;
 }
 
+static int ktls_set_cipher(SSL_CTX *cctx, int tlsver, const char *cipher)
+{
+    if (tlsver == TLS1_3_VERSION)
+        return SSL_CTX_set_ciphersuites(cctx, cipher);
+    return SSL_CTX_set_cipher_list(cctx, cipher);
+}
+
 static int execute_test_ktls(int cis_ktls_tx, int cis_ktls_rx,
-                             int sis_ktls_tx, int sis_ktls_rx)
+                             int sis_ktls_tx, int sis_ktls_rx,
+                             int tlsver, const char *cipher)
 {
     SSL_CTX *cctx = NULL, *sctx = NULL;
     SSL *clientssl = NULL, *serverssl = NULL;
@@ -838,10 +847,9 @@ static int execute_test_ktls(int cis_ktls_tx, int cis_ktls_rx,
     /* Create a session based on SHA-256 */
     if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
                                        TLS_client_method(),
-                                       TLS1_2_VERSION, TLS1_2_VERSION,
+                                       tlsver, tlsver,
                                        &sctx, &cctx, cert, privkey))
-            || !TEST_true(SSL_CTX_set_cipher_list(cctx,
-                                                  "AES128-GCM-SHA256"))
+            || !TEST_true(ktls_set_cipher(cctx, tlsver, cipher))
             || !TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
                                           &clientssl, sfd, cfd)))
         goto end;
@@ -925,7 +933,7 @@ end:
 #define SENDFILE_CHUNK                  (4 * 4096)
 #define min(a,b)                        ((a) > (b) ? (b) : (a))
 
-static int test_ktls_sendfile(void)
+static int execute_test_ktls_sendfile(int tlsver, const char *cipher)
 {
     SSL_CTX *cctx = NULL, *sctx = NULL;
     SSL *clientssl = NULL, *serverssl = NULL;
@@ -952,10 +960,9 @@ static int test_ktls_sendfile(void)
     /* Create a session based on SHA-256 */
     if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
                                        TLS_client_method(),
-                                       TLS1_2_VERSION, TLS1_2_VERSION,
+                                       tlsver, tlsver,
                                        &sctx, &cctx, cert, privkey))
-        || !TEST_true(SSL_CTX_set_cipher_list(cctx,
-                                              "AES128-GCM-SHA256"))
+        || !TEST_true(ktls_set_cipher(cctx, tlsver, cipher))
         || !TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
                                           &clientssl, sfd, cfd)))
         goto end;
@@ -1028,82 +1035,601 @@ end:
 
 static int test_ktls_no_txrx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(0, 0, 0, 0);
+    return execute_test_ktls(0, 0, 0, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_rx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(1, 0, 0, 0);
+    return execute_test_ktls(1, 0, 0, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_tx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(0, 1, 0, 0);
+    return execute_test_ktls(0, 1, 0, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_client_no_txrx_server(void)
 {
-    return execute_test_ktls(1, 1, 0, 0);
+    return execute_test_ktls(1, 1, 0, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_txrx_client_no_rx_server(void)
 {
-    return execute_test_ktls(0, 0, 1, 0);
+    return execute_test_ktls(0, 0, 1, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_rx_client_no_rx_server(void)
 {
-    return execute_test_ktls(1, 0, 1, 0);
+    return execute_test_ktls(1, 0, 1, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_tx_client_no_rx_server(void)
 {
-    return execute_test_ktls(0, 1, 1, 0);
+    return execute_test_ktls(0, 1, 1, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_client_no_rx_server(void)
 {
-    return execute_test_ktls(1, 1, 1, 0);
+    return execute_test_ktls(1, 1, 1, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_txrx_client_no_tx_server(void)
 {
-    return execute_test_ktls(0, 0, 0, 1);
+    return execute_test_ktls(0, 0, 0, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_rx_client_no_tx_server(void)
 {
-    return execute_test_ktls(1, 0, 0, 1);
+    return execute_test_ktls(1, 0, 0, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_tx_client_no_tx_server(void)
 {
-    return execute_test_ktls(0, 1, 0, 1);
+    return execute_test_ktls(0, 1, 0, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_client_no_tx_server(void)
 {
-    return execute_test_ktls(1, 1, 0, 1);
+    return execute_test_ktls(1, 1, 0, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_txrx_client_server(void)
 {
-    return execute_test_ktls(0, 0, 1, 1);
+    return execute_test_ktls(0, 0, 1, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_rx_client_server(void)
 {
-    return execute_test_ktls(1, 0, 1, 1);
+    return execute_test_ktls(1, 0, 1, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_tx_client_server(void)
 {
-    return execute_test_ktls(0, 1, 1, 1);
+    return execute_test_ktls(0, 1, 1, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_client_server(void)
 {
-    return execute_test_ktls(1, 1, 1, 1);
+    return execute_test_ktls(1, 1, 1, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
+}
+
+static int test_ktls_sendfile(void)
+{
+    return execute_test_ktls_sendfile(TLS1_2_VERSION, "AES128-GCM-SHA256");
+}
+
+# if defined(OPENSSL_KTLS_TLS13) && !defined(OPENSSL_NO_TLS1_3)
+/*
+ * Test TLSv1.3 ktls. The four low bits of |tst| select whether ktls is
+ * disabled for client tx, client rx, server tx and server rx respectively.
+ */
+static int test_ktls_tls13(int tst)
+{
+    return execute_test_ktls((tst & 1) == 0, (tst & 2) == 0,
+                             (tst & 4) == 0, (tst & 8) == 0,
+                             TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256");
+}
+
+static int test_ktls_sendfile_tls13(void)
+{
+    return execute_test_ktls_sendfile(TLS1_3_VERSION,
+                                      "TLS_AES_128_GCM_SHA256");
+}
+
+/*
+ * Test that both ends rekey the kernel when a KeyUpdate is exchanged while
+ * ktls is in use in both directions.
+ */
+static int test_ktls_tls13_key_update(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char cbuf[1024], sbuf[1024];
+    int testresult = 0;
+    int cfd, sfd, i;
+    int err;
+
+    if (!TEST_true(create_test_sockets(&cfd, &sfd)))
+        goto end;
+
+    /* Skip this test if the platform does not support ktls */
+    if (!ktls_chk_platform(cfd)) {
+        testresult = 1;
+        goto end;
+    }
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_3_VERSION, TLS1_3_VERSION,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_ciphersuites(cctx,
+                                                   "TLS_AES_128_GCM_SHA256"))
+            || !TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
+                                              &clientssl, sfd, cfd))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    /* The kernel may not support TLSv1.3 for the cipher. Nothing to test */
+    if (!BIO_get_ktls_send(clientssl->wbio)
+            || !BIO_get_ktls_recv(serverssl->rbio)) {
+        testresult = 1;
+        goto end;
+    }
+
+    for (i = 0; i < 3; i++) {
+        memset(cbuf, 'a' + i, sizeof(cbuf));
+
+        /* The peer is asked to update too, so both directions are rekeyed */
+        if (i == 1
+                && !TEST_true(SSL_key_update(clientssl,
+                                             SSL_KEY_UPDATE_REQUESTED)))
+            goto end;
+
+        if (!TEST_int_eq(SSL_write(clientssl, cbuf, sizeof(cbuf)),
+                         sizeof(cbuf)))
+            goto end;
+        while ((err = SSL_read(serverssl, sbuf, sizeof(sbuf)))
+               != sizeof(sbuf)) {
+            if (!TEST_int_eq(SSL_get_error(serverssl, err),
+                             SSL_ERROR_WANT_READ))
+                goto end;
+        }
+        if (!TEST_mem_eq(cbuf, sizeof(cbuf), sbuf, sizeof(sbuf))
+                || !TEST_int_eq(SSL_write(serverssl, sbuf, sizeof(sbuf)),
+                                sizeof(sbuf)))
+            goto end;
+        while ((err = SSL_read(clientssl, cbuf, sizeof(cbuf)))
+               != sizeof(cbuf)) {
+            if (!TEST_int_eq(SSL_get_error(clientssl, err),
+                             SSL_ERROR_WANT_READ))
+                goto end;
+        }
+        if (!TEST_mem_eq(cbuf, sizeof(cbuf), sbuf, sizeof(sbuf)))
+            goto end;
+    }
+
+    testresult = 1;
+end:
+    if (clientssl) {
+        SSL_shutdown(clientssl);
+        SSL_free(clientssl);
+    }
+    if (serverssl) {
+        SSL_shutdown(serverssl);
+        SSL_free(serverssl);
+    }
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+# endif
+
+static const struct {
+    int tlsver;
+    const char *cipher;
+} ktls_ciphers[] = {
+    { TLS1_2_VERSION, "AES128-GCM-SHA256" },
+# ifdef OPENSSL_KTLS_AES_GCM_256
+    { TLS1_2_VERSION, "AES256-GCM-SHA384" },
+# endif
+# ifdef OPENSSL_KTLS_AES_CCM_128
+    { TLS1_2_VERSION, "AES128-CCM" },
+# endif
+# if defined(OPENSSL_KTLS_CHACHA20_POLY1305) && !defined(OPENSSL_NO_CHACHA) \
+     && !defined(OPENSSL_NO_POLY1305) && !defined(OPENSSL_NO_EC)
+    { TLS1_2_VERSION, "ECDHE-RSA-CHACHA20-POLY1305" },
+# endif
+# if defined(OPENSSL_KTLS_TLS13) && !defined(OPENSSL_NO_TLS1_3)
+    { TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256" },
+#  ifdef OPENSSL_KTLS_AES_GCM_256
+    { TLS1_3_VERSION, "TLS_AES_256_GCM_SHA384" },
+#  endif
+#  ifdef OPENSSL_KTLS_AES_CCM_128
+    { TLS1_3_VERSION, "TLS_AES_128_CCM_SHA256" },
+#  endif
+#  if defined(OPENSSL_KTLS_CHACHA20_POLY1305) && !defined(OPENSSL_NO_CHACHA) \
+      && !defined(OPENSSL_NO_POLY1305)
+    { TLS1_3_VERSION, "TLS_CHACHA20_POLY1305_SHA256" },
+#  endif
+# endif
+};
+
+/*
+ * Test that data gets through for every cipher that can be handed to the
+ * kernel. Whether the running kernel implements a particular cipher is not
+ * known in advance, so ktls not being enabled is not treated as a failure.
+ */
+static int test_ktls_cipher(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int tlsver = ktls_ciphers[tst].tlsver;
+    const char *cipher = ktls_ciphers[tst].cipher;
+    unsigned char cbuf[16000], sbuf[16000];
+    int testresult = 0;
+    int cfd, sfd, i;
+    int err;
+
+    if (!TEST_true(create_test_sockets(&cfd, &sfd)))
+        goto end;
+
+    /* Skip this test if the platform does not support ktls */
+    if (!ktls_chk_platform(cfd)) {
+        testresult = 1;
+        goto end;
+    }
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), tlsver, tlsver,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(ktls_set_cipher(cctx, tlsver, cipher))
+            || !TEST_true(ktls_set_cipher(sctx, tlsver, cipher))
+            || !TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
+                                              &clientssl, sfd, cfd))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    for (i = 0; i < 3; i++) {
+        memset(cbuf, 'a' + i, sizeof(cbuf));
+
+        if (!TEST_int_eq(SSL_write(clientssl, cbuf, sizeof(cbuf)),
+                         sizeof(cbuf)))
+            goto end;
+        while ((err = SSL_read(serverssl, sbuf, sizeof(sbuf)))
+               != sizeof(sbuf)) {
+            if (!TEST_int_eq(SSL_get_error(serverssl, err),
+                             SSL_ERROR_WANT_READ))
+                goto end;
+        }
+        if (!TEST_mem_eq(cbuf, sizeof(cbuf), sbuf, sizeof(sbuf))
+                || !TEST_int_eq(SSL_write(serverssl, sbuf, sizeof(sbuf)),
+                                sizeof(sbuf)))
+            goto end;
+        while ((err = SSL_read(clientssl, cbuf, sizeof(cbuf)))
+               != sizeof(cbuf)) {
+            if (!TEST_int_eq(SSL_get_error(clientssl, err),
+                             SSL_ERROR_WANT_READ))
+                goto end;
+        }
+        if (!TEST_mem_eq(cbuf, sizeof(cbuf), sbuf, sizeof(sbuf)))
+            goto end;
+    }
+
+    testresult = 1;
+end:
+    if (clientssl) {
+        SSL_shutdown(clientssl);
+        SSL_free(clientssl);
+    }
+    if (serverssl) {
+        SSL_shutdown(serverssl);
+        SSL_free(serverssl);
+    }
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+#endif
+
+static int writev_records = 0;
+
+static void writev_msg_cb(int write_p, int version, int content_type,
+                          const void *buf, size_t len, SSL *ssl, void *arg)
+{
+    if (write_p && content_type == SSL3_RT_HEADER)
+        writev_records++;
+}
+
+/*
+ * Test SSL_writev() with a header, a body and an empty buffer.
+ * Test 0: TLSv1.2, small body
+ * Test 1: TLSv1.3, small body
+ * Test 2: TLSv1.2, body needing more than one packed write
+ * Test 3: TLSv1.3, body needing more than one packed write
+ * Test 4: TLSv1.2, non-blocking writes through a small BIO pair
+ * Test 5: TLSv1.3, non-blocking writes through a small BIO pair
+ * Test 6: TLSv1.2, CBC ciphersuite with encrypt-then-MAC
+ * Test 7: TLSv1.2, CBC ciphersuite with MAC-then-encrypt
+ * Test 8: TLSv1.3, body in more pieces than a record is sealed from directly
+ * Test 9: TLSv1.3, CCM ciphersuite, whose plaintext is gathered first
+ * Test 10: TLSv1.3, ChaCha20-Poly1305 ciphersuite
+ */
+static int test_writev(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *cbio = NULL, *sbio = NULL;
+    int tlsver = (tst % 2 == 0 || tst == 7) && tst < 8 ? TLS1_2_VERSION
+                                                       : TLS1_3_VERSION;
+    static const char hdr[] = "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n";
+    size_t bodylen = tst < 2 ? 100 : 5 * SSL3_RT_MAX_PLAIN_LENGTH + 7;
+    size_t total = sizeof(hdr) - 1 + bodylen;
+    /* The pieces of test 8 end up about 32 to a record */
+    size_t npieces = tst == 8 ? 160 : 1;
+    unsigned char *body = NULL, *expected = NULL, *rbuf = NULL;
+    SSL_IOVEC iov[160 + 2];
+    size_t iovcnt = npieces + 2, written = 0, readbytes, got = 0, i;
+    int testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (tlsver == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (tlsver == TLS1_3_VERSION)
+        return 1;
+#endif
+
+    if (!TEST_ptr(body = OPENSSL_malloc(bodylen))
+            || !TEST_ptr(expected = OPENSSL_malloc(total))
+            || !TEST_ptr(rbuf = OPENSSL_malloc(total)))
+        goto end;
+    for (i = 0; i < bodylen; i++)
+        body[i] = (unsigned char)(i * 7);
+    memcpy(expected, hdr, sizeof(hdr) - 1);
+    memcpy(expected + sizeof(hdr) - 1, body, bodylen);
+
+    iov[0].buf = hdr;
+    iov[0].len = sizeof(hdr) - 1;
+    for (i = 0; i < npieces; i++) {
+        iov[i + 1].buf = body + i * (bodylen / npieces);
+        iov[i + 1].len = bodylen / npieces;
+    }
+    iov[npieces].len += bodylen % npieces;
+    iov[npieces + 1].buf = NULL;
+    iov[npieces + 1].len = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), tlsver, tlsver,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+
+    if (tst == 6 || tst == 7) {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-SHA")))
+            goto end;
+        if (tst == 7)
+            SSL_CTX_set_options(cctx, SSL_OP_NO_ENCRYPT_THEN_MAC);
+    } else if (tst == 9) {
+        if (!TEST_true(SSL_CTX_set_ciphersuites(sctx,
+                                                "TLS_AES_128_CCM_SHA256"))
+                || !TEST_true(SSL_CTX_set_ciphersuites(cctx,
+                                                "TLS_AES_128_CCM_SHA256")))
+            goto end;
+    } else if (tst == 10) {
+#if defined(OPENSSL_NO_CHACHA) || defined(OPENSSL_NO_POLY1305)
+        testresult = 1;
+        goto end;
+#else
+        if (!TEST_true(SSL_CTX_set_ciphersuites(cctx,
+                                                "TLS_CHACHA20_POLY1305_SHA256")))
+            goto end;
+#endif
+    }
+
+    if (tst < 4 || tst >= 6) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL)))
+            goto end;
+    } else {
+        if (!TEST_ptr(serverssl = SSL_new(sctx))
+                || !TEST_ptr(clientssl = SSL_new(cctx))
+                || !TEST_true(BIO_new_bio_pair(&cbio, 4096, &sbio, 4096)))
+            goto end;
+        SSL_set_bio(clientssl, cbio, cbio);
+        SSL_set_bio(serverssl, sbio, sbio);
+    }
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE)))
+        goto end;
+
+    writev_records = 0;
+    SSL_set_msg_callback(clientssl, writev_msg_cb);
+
+    while (!SSL_writev(clientssl, iov, iovcnt, &written)) {
+        /* Only the BIO pair may fill up */
+        if (!TEST_true(tst == 4 || tst == 5)
+                || !TEST_int_eq(SSL_get_error(clientssl, 0),
+                                SSL_ERROR_WANT_WRITE))
+            goto end;
+        while (got < total
+               && SSL_read_ex(serverssl, rbuf + got, total - got, &readbytes))
+            got += readbytes;
+    }
+    if (!TEST_size_t_eq(written, total))
+        goto end;
+
+    while (got < total) {
+        if (!TEST_true(SSL_read_ex(serverssl, rbuf + got, total - got,
+                                   &readbytes)))
+            goto end;
+        got += readbytes;
+    }
+    if (!TEST_mem_eq(rbuf, got, expected, total))
+        goto end;
+
+    /* All the buffers share full sized records */
+    if ((tst < 4 || tst >= 6)
+            && !TEST_int_eq(writev_records,
+                            (total + SSL3_RT_MAX_PLAIN_LENGTH - 1)
+                            / SSL3_RT_MAX_PLAIN_LENGTH))
+        goto end;
+
+    testresult = 1;
+ end:
+    OPENSSL_free(body);
+    OPENSSL_free(expected);
+    OPENSSL_free(rbuf);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+#if !defined(OPENSSL_NO_TLS1_2) && !defined(OPENSSL_NO_ENGINE) \
+    && !defined(OPENSSL_NO_DYNAMIC_ENGINE)
+/*
+ * Write |len| bytes from |msg| on |clientssl| through a BIO pair that fills
+ * up, reading them on |serverssl| as they come, and check they arrive intact.
+ */
+static int pipeline_transfer(SSL *clientssl, SSL *serverssl,
+                             const unsigned char *msg, unsigned char *rbuf,
+                             size_t len)
+{
+    size_t written, readbytes, got = 0;
+
+    while (!SSL_write_ex(clientssl, msg, len, &written)) {
+        /* The buffers hold a record that isn't written out yet */
+        if (!TEST_int_eq(SSL_get_error(clientssl, 0), SSL_ERROR_WANT_WRITE)
+                || !TEST_false(SSL_free_buffers(clientssl)))
+            return 0;
+        while (got < len
+               && SSL_read_ex(serverssl, rbuf + got, len - got, &readbytes))
+            got += readbytes;
+    }
+    if (!TEST_size_t_eq(written, len))
+        return 0;
+    while (got < len) {
+        if (!TEST_true(SSL_read_ex(serverssl, rbuf + got, len - got,
+                                   &readbytes)))
+            return 0;
+        got += readbytes;
+    }
+    return TEST_mem_eq(rbuf, got, msg, len);
+}
+
+/*
+ * Test that reads of several buffered records at once work, and that writes
+ * using fewer pipelines than an earlier one do, also when the write can't be
+ * completed at once.  The pipeline capable AES-128-CBC-HMAC-SHA1 cipher of
+ * the dasync engine is used for that.
+ */
+static int test_pipelining(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *cbio = NULL, *sbio = NULL;
+    ENGINE *e = NULL;
+    unsigned char *msg = NULL, *rbuf = NULL;
+    static const struct {
+        size_t split, len;
+    } writes[] = {
+        /* Four small records, all read in one go after they're written */
+        { 512, 2000 },
+        /* Four full pipelines, then one pipeline that doesn't fit the pair */
+        { SSL3_RT_MAX_PLAIN_LENGTH, 4 * SSL3_RT_MAX_PLAIN_LENGTH },
+        { SSL3_RT_MAX_PLAIN_LENGTH, 5000 },
+        { SSL3_RT_MAX_PLAIN_LENGTH, 100 },
+    };
+    size_t msglen = 4 * SSL3_RT_MAX_PLAIN_LENGTH, i;
+    int testresult = 0;
+
+    if (!TEST_ptr(e = ENGINE_by_id("dasync")))
+        goto end;
+    if (!TEST_true(ENGINE_init(e))) {
+        ENGINE_free(e);
+        e = NULL;
+        goto end;
+    }
+    if (!TEST_true(ENGINE_register_ciphers(e)))
+        goto end;
+
+    if (!TEST_ptr(msg = OPENSSL_malloc(msglen))
+            || !TEST_ptr(rbuf = OPENSSL_malloc(msglen)))
+        goto end;
+    for (i = 0; i < msglen; i++)
+        msg[i] = (unsigned char)(i * 13);
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), TLS1_2_VERSION,
+                                       TLS1_2_VERSION, &sctx, &cctx, cert,
+                                       privkey))
+            || !TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-SHA"))
+            || !TEST_true(SSL_CTX_set_max_pipelines(cctx, 4))
+            || !TEST_true(SSL_CTX_set_max_pipelines(sctx, 4)))
+        goto end;
+    /* The stitched cipher is only used with MAC-then-encrypt */
+    SSL_CTX_set_options(cctx, SSL_OP_NO_ENCRYPT_THEN_MAC);
+
+    if (!TEST_ptr(serverssl = SSL_new(sctx))
+            || !TEST_ptr(clientssl = SSL_new(cctx))
+            || !TEST_true(BIO_new_bio_pair(&cbio, 4096, &sbio, 4096)))
+        goto end;
+    SSL_set_bio(clientssl, cbio, cbio);
+    SSL_set_bio(serverssl, sbio, sbio);
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE)))
+        goto end;
+
+    /* The engine only provides the stitched cipher where AES-NI is there */
+    if ((EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(clientssl->enc_write_ctx))
+         & EVP_CIPH_FLAG_PIPELINE) == 0) {
+        TEST_skip("No pipeline capable cipher available");
+        testresult = 1;
+        goto end;
+    }
+
+    for (i = 0; i < OSSL_NELEM(writes); i++) {
+        if (!TEST_true(SSL_set_split_send_fragment(clientssl, writes[i].split))
+                || !TEST_true(pipeline_transfer(clientssl, serverssl, msg,
+                                                rbuf, writes[i].len)))
+            goto end;
+    }
+
+    testresult = 1;
+ end:
+    OPENSSL_free(msg);
+    OPENSSL_free(rbuf);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    if (e != NULL) {
+        ENGINE_unregister_ciphers(e);
+        ENGINE_finish(e);
+        ENGINE_free(e);
+    }
+
+    return testresult;
 }
 #endif
 
@@ -1665,6 +2191,192 @@ static int test_session_with_both_cache(void)
 #endif
 }
 
+#ifndef OPENSSL_NO_TLS1_2
+# define SHARDED_SESS_NUM 10
+
+/*
+ * Test the internal session cache with SSL_SESS_CACHE_SHARDED
+ * Test 0: Sharding is enabled before any sessions are cached
+ * Test 1: Sharding is enabled once sessions are cached, then disabled again
+ */
+static int test_session_cache_sharded(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    SSL_SESSION *sess[SHARDED_SESS_NUM];
+    long mode = SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_SHARDED;
+    int testresult = 0, i;
+
+    memset(sess, 0, sizeof(sess));
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(), TLS_client_method(),
+                                       TLS1_VERSION, TLS1_2_VERSION,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+
+    /* Resume using session IDs only */
+    SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    if (tst == 0)
+        SSL_CTX_set_session_cache_mode(sctx, mode);
+
+    for (i = 0; i < SHARDED_SESS_NUM; i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_ptr(sess[i] = SSL_get1_session(clientssl)))
+            goto end;
+        shutdown_ssl_connection(serverssl, clientssl);
+        serverssl = clientssl = NULL;
+    }
+    if (!TEST_long_eq(SSL_CTX_sess_number(sctx), SHARDED_SESS_NUM))
+        goto end;
+
+    if (tst == 1) {
+        SSL_CTX_set_session_cache_mode(sctx, mode);
+        if (!TEST_long_eq(SSL_CTX_get_session_cache_mode(sctx), mode)
+                || !TEST_long_eq(SSL_CTX_sess_number(sctx), SHARDED_SESS_NUM))
+            goto end;
+    }
+
+    for (i = 0; i < SHARDED_SESS_NUM; i++) {
+        if (tst == 1 && i == SHARDED_SESS_NUM / 2) {
+            SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_SERVER);
+            if (!TEST_long_eq(SSL_CTX_sess_number(sctx), SHARDED_SESS_NUM))
+                goto end;
+        }
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(SSL_set_session(clientssl, sess[i]))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_true(SSL_session_reused(clientssl)))
+            goto end;
+        shutdown_ssl_connection(serverssl, clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    if (!TEST_true(SSL_CTX_remove_session(sctx, sess[0]))
+            || !TEST_long_eq(SSL_CTX_sess_number(sctx), SHARDED_SESS_NUM - 1))
+        goto end;
+    SSL_CTX_flush_sessions(sctx, 0);
+    if (!TEST_long_eq(SSL_CTX_sess_number(sctx), 0))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    for (i = 0; i < SHARDED_SESS_NUM; i++)
+        SSL_SESSION_free(sess[i]);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Test resuming a session through the shared session cache. Two server
+ * SSL_CTXs mapping the same file stand in for two server processes.
+ */
+static int test_session_cache_shared(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL, *sctx2 = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    SSL_SESSION *sess = NULL;
+    int testresult = 0;
+
+    /* The cache must not pick up whatever other tests left in the file */
+    remove(tmpfilename);
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(), TLS_client_method(),
+                                       TLS1_VERSION, TLS1_2_VERSION,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(create_ssl_ctx_pair(TLS_server_method(), NULL,
+                                              TLS1_VERSION, TLS1_2_VERSION,
+                                              &sctx2, NULL, cert, privkey)))
+        goto end;
+
+    if (!SSL_CTX_set_shared_session_cache(sctx, tmpfilename, 64, 0)) {
+        if (ERR_GET_REASON(ERR_peek_last_error())
+                == SSL_R_SHARED_SESSION_CACHE_NOT_SUPPORTED) {
+            TEST_info("Shared session cache not supported, skipping");
+            testresult = 1;
+        }
+        goto end;
+    }
+    if (!TEST_false(SSL_CTX_set_shared_session_cache(sctx2, tmpfilename,
+                                                     32, 0))
+            || !TEST_true(SSL_CTX_set_shared_session_cache(sctx2, tmpfilename,
+                                                           64, 0)))
+        goto end;
+
+    /* Resume using session IDs, and only via the shared cache in sctx2 */
+    SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    SSL_CTX_set_options(sctx2, SSL_OP_NO_TICKET);
+    SSL_CTX_set_session_cache_mode(sctx2, SSL_SESS_CACHE_SERVER
+                                          | SSL_SESS_CACHE_NO_INTERNAL);
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_ptr(sess = SSL_get1_session(clientssl)))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+
+    if (!TEST_true(create_ssl_objects(sctx2, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(SSL_set_session(clientssl, sess))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_session_reused(clientssl)))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+
+    /* Removing it in one "process" stops the other one resuming it */
+    if (!TEST_true(SSL_CTX_remove_session(sctx, sess))
+            || !TEST_true(create_ssl_objects(sctx2, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_true(SSL_set_session(clientssl, sess))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_false(SSL_session_reused(clientssl)))
+        goto end;
+
+    /*
+     * The new session goes to the shared cache although sctx2 has no
+     * internal store, and can be resumed in the other "process"
+     */
+    SSL_SESSION_free(sess);
+    if (!TEST_ptr(sess = SSL_get1_session(clientssl)))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(SSL_set_session(clientssl, sess))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_session_reused(clientssl)))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_SESSION_free(sess);
+    SSL_CTX_free(sctx2);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    remove(tmpfilename);
+
+    return testresult;
+}
+#endif
+
 #ifndef OPENSSL_NO_TLS1_3
 static SSL_SESSION *sesscache[6];
 static int do_cache;
@@ -1953,6 +2665,145 @@ static int test_psk_tickets(void)
 }
 #endif
 
+/*
+ * Connect, resuming |*sess| if it is set, check whether the session was
+ * reused and replace |*sess| with the session from the new connection.
+ */
+static int ticket_key_connect(SSL_CTX *sctx, SSL_CTX *cctx,
+                              SSL_SESSION **sess, int reused)
+{
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || (*sess != NULL
+                && !TEST_true(SSL_set_session(clientssl, *sess)))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_int_eq(SSL_session_reused(clientssl), reused))
+        goto end;
+    SSL_SESSION_free(*sess);
+    if (!TEST_ptr(*sess = SSL_get1_session(clientssl)))
+        goto end;
+    SSL_shutdown(clientssl);
+    SSL_shutdown(serverssl);
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    return testresult;
+}
+
+static SSL_TICKET_STATUS ring_tick_status;
+
+/* Record the status and do what would be done without a callback */
+static SSL_TICKET_RETURN ring_dec_tick_cb(SSL *s, SSL_SESSION *ss,
+                                          const unsigned char *keyname,
+                                          size_t keyname_length,
+                                          SSL_TICKET_STATUS status,
+                                          void *arg)
+{
+    ring_tick_status = status;
+    switch (status) {
+    case SSL_TICKET_SUCCESS:
+        return SSL_TICKET_RETURN_USE;
+    case SSL_TICKET_SUCCESS_RENEW:
+        return SSL_TICKET_RETURN_USE_RENEW;
+    default:
+        return SSL_TICKET_RETURN_IGNORE_RENEW;
+    }
+}
+
+/*
+ * Test the automatically rotated ticket key ring
+ * Test 0: TLSv1.2
+ * Test 1: TLSv1.3
+ */
+static int test_ticket_key_rotation(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL_SESSION *sess = NULL;
+    const unsigned char *tick;
+    unsigned char oldtick[TLSEXT_KEYNAME_LENGTH];
+    size_t ticklen;
+    int version = tst == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    /* TLSv1.3 tickets are always renewed */
+    SSL_TICKET_STATUS current = tst == 0 ? SSL_TICKET_SUCCESS
+                                         : SSL_TICKET_SUCCESS_RENEW;
+    int testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 0)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst == 1)
+        return 1;
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(), TLS_client_method(),
+                                       version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_session_ticket_cb(sctx, NULL,
+                                                        ring_dec_tick_cb,
+                                                        NULL)))
+        goto end;
+
+    /* The built-in key, which the key ring should behave the same as */
+    ring_tick_status = SSL_TICKET_EMPTY;
+    if (!ticket_key_connect(sctx, cctx, &sess, 0)
+            || !ticket_key_connect(sctx, cctx, &sess, 1)
+            || !TEST_int_eq(ring_tick_status, current))
+        goto end;
+    SSL_SESSION_free(sess);
+    sess = NULL;
+
+    ring_tick_status = SSL_TICKET_EMPTY;
+    if (!TEST_false(SSL_CTX_rotate_ticket_keys(sctx))
+            || !TEST_true(SSL_CTX_set_ticket_key_rotation(sctx, 3600, 3600))
+            || !ticket_key_connect(sctx, cctx, &sess, 0)
+            || !ticket_key_connect(sctx, cctx, &sess, 1)
+            || !TEST_int_eq(ring_tick_status, current))
+        goto end;
+
+    SSL_SESSION_get0_ticket(sess, &tick, &ticklen);
+    if (!TEST_size_t_gt(ticklen, sizeof(oldtick)))
+        goto end;
+    memcpy(oldtick, tick, sizeof(oldtick));
+
+    /*
+     * A ticket made with the previous key is still accepted during the grace
+     * period, and replaced with one made with the new key
+     */
+    ring_tick_status = SSL_TICKET_EMPTY;
+    if (!TEST_true(SSL_CTX_rotate_ticket_keys(sctx))
+            || !ticket_key_connect(sctx, cctx, &sess, 1)
+            || !TEST_int_eq(ring_tick_status, SSL_TICKET_SUCCESS_RENEW))
+        goto end;
+    SSL_SESSION_get0_ticket(sess, &tick, &ticklen);
+    if (!TEST_size_t_gt(ticklen, sizeof(oldtick))
+            || !TEST_mem_ne(tick, sizeof(oldtick), oldtick, sizeof(oldtick))
+            || !ticket_key_connect(sctx, cctx, &sess, 1))
+        goto end;
+
+    /* Without a grace period a retired key is not accepted any more */
+    if (!TEST_true(SSL_CTX_set_ticket_key_rotation(sctx, 3600, 0))
+            || !TEST_true(SSL_CTX_rotate_ticket_keys(sctx))
+            || !ticket_key_connect(sctx, cctx, &sess, 0))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_SESSION_free(sess);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
 #define USE_NULL            0
 #define USE_BIO_1           1
 #define USE_BIO_2           2
@@ -6877,6 +7728,17 @@ int setup_tests(void)
     ADD_TEST(test_ktls_no_tx_client_server);
     ADD_TEST(test_ktls_client_server);
     ADD_TEST(test_ktls_sendfile);
+# if defined(OPENSSL_KTLS_TLS13) && !defined(OPENSSL_NO_TLS1_3)
+    ADD_ALL_TESTS(test_ktls_tls13, 16);
+    ADD_TEST(test_ktls_sendfile_tls13);
+    ADD_TEST(test_ktls_tls13_key_update);
+# endif
+    ADD_ALL_TESTS(test_ktls_cipher, OSSL_NELEM(ktls_ciphers));
+#endif
+    ADD_ALL_TESTS(test_writev, 11);
+#if !defined(OPENSSL_NO_TLS1_2) && !defined(OPENSSL_NO_ENGINE) \
+    && !defined(OPENSSL_NO_DYNAMIC_ENGINE)
+    ADD_TEST(test_pipelining);
 #endif
     ADD_TEST(test_large_message_tls);
     ADD_TEST(test_large_message_tls_read_ahead);
@@ -6889,11 +7751,16 @@ int setup_tests(void)
     ADD_TEST(test_session_with_only_int_cache);
     ADD_TEST(test_session_with_only_ext_cache);
     ADD_TEST(test_session_with_both_cache);
+#ifndef OPENSSL_NO_TLS1_2
+    ADD_ALL_TESTS(test_session_cache_sharded, 2);
+    ADD_TEST(test_session_cache_shared);
+#endif
 #ifndef OPENSSL_NO_TLS1_3
     ADD_ALL_TESTS(test_stateful_tickets, 3);
     ADD_ALL_TESTS(test_stateless_tickets, 3);
     ADD_TEST(test_psk_tickets);
 #endif
+    ADD_ALL_TESTS(test_ticket_key_rotation, 2);
     ADD_ALL_TESTS(test_ssl_set_bio, TOTAL_SSL_SET_BIO_TESTS);
     ADD_TEST(test_ssl_bio_pop_next_bio);
     ADD_TEST(test_ssl_bio_pop_ssl_bio);
@@ -12,6 +12,7 @@
 #endif
 
 #include <openssl/crypto.h>
+#include <openssl/evp.h>
 #include "testutil.h"
 
 #if !defined(OPENSSL_THREADS) || defined(CRYPTO_TDEBUG)
@@ -184,10 +185,100 @@ static int test_thread_local(void)
     return 1;
 }
 
+#if defined(OPENSSL_THREADS) && !defined(CRYPTO_TDEBUG) \
+    && defined(OPENSSL_SYS_UNIX)
+# include <signal.h>
+# include <unistd.h>
+# include <sys/types.h>
+# include <sys/wait.h>
+
+# define POOL_FORK_LEN  (1024 * 1024)
+
+static unsigned char pool_fork_in[POOL_FORK_LEN], pool_fork_out[POOL_FORK_LEN];
+static volatile int pool_fork_stop = 0;
+
+/* An AES-CTR encryption big enough to be spread over the thread pool */
+static int pool_fork_encrypt(unsigned char *out)
+{
+    static const unsigned char key[16] = { 1, 2, 3 }, iv[16] = { 4, 5, 6 };
+    EVP_CIPHER *cipher = EVP_CIPHER_fetch(NULL, "AES-128-CTR", NULL);
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int outl, ret = 0;
+
+    if (cipher != NULL && ctx != NULL
+            && EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv)
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_SET_THREADS, 4, NULL) > 0
+            && EVP_EncryptUpdate(ctx, out, &outl, pool_fork_in, POOL_FORK_LEN))
+        ret = 1;
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_CIPHER_free(cipher);
+    return ret;
+}
+
+static void pool_fork_thread_cb(void)
+{
+    while (!pool_fork_stop)
+        if (!pool_fork_encrypt(pool_fork_out))
+            break;
+}
+
+/*
+ * Fork while another thread keeps the thread pool busy.  The child must be
+ * able to use the pool, without any workers, and to clean up without
+ * waiting for the parent's.  Only the thread pool itself is asked for, so
+ * it has to look after fork() by itself.
+ */
+static int test_thread_pool_fork(void)
+{
+    OPENSSL_INIT_SETTINGS *settings = NULL;
+    unsigned char out[POOL_FORK_LEN];
+    thread_t thread;
+    pid_t pid;
+    int i, status, running = 0, ret = 0;
+
+    if (!TEST_ptr(settings = OPENSSL_INIT_new()))
+        return 0;
+    OPENSSL_INIT_set_thread_pool_size(settings, 3);
+    if (!TEST_true(OPENSSL_init_crypto(OPENSSL_INIT_THREAD_POOL, settings))
+            || !TEST_true(pool_fork_encrypt(out))
+            || !TEST_true(running = run_thread(&thread, pool_fork_thread_cb)))
+        goto err;
+
+    for (i = 0; i < 50; i++) {
+        if (!TEST_int_ge(pid = fork(), 0))
+            goto err;
+        if (pid == 0) {
+            /* A hang is turned into a failure */
+            alarm(20);
+            status = pool_fork_encrypt(out);
+            OPENSSL_cleanup();
+            _exit(status ? 0 : 1);
+        }
+        if (!TEST_int_eq(waitpid(pid, &status, 0), pid)
+                || !TEST_true(WIFEXITED(status))
+                || !TEST_int_eq(WEXITSTATUS(status), 0)) {
+            TEST_info("child %d", i);
+            goto err;
+        }
+    }
+    ret = 1;
+ err:
+    pool_fork_stop = 1;
+    if (running)
+        wait_for_thread(thread);
+    OPENSSL_INIT_free(settings);
+    return ret;
+}
+#endif
+
 int setup_tests(void)
 {
     ADD_TEST(test_lock);
     ADD_TEST(test_once);
     ADD_TEST(test_thread_local);
+#if defined(OPENSSL_THREADS) && !defined(CRYPTO_TDEBUG) \
+    && defined(OPENSSL_SYS_UNIX)
+    ADD_TEST(test_thread_pool_fork);
+#endif
     return 1;
 }
@@ -11,6 +11,7 @@
 #include <openssl/evp.h>
 
 #include "../ssl/ssl_locl.h"
+#include "../ssl/record/record_locl.h"
 #include "testutil.h"
 
 #define IVLEN   12
@@ -206,6 +207,31 @@ int ossl_statem_export_early_allowed(SSL *s)
     return 1;
 }
 
+#ifndef OPENSSL_NO_KTLS
+int ktls_check_supported_cipher(const SSL *s, const EVP_CIPHER *c)
+{
+    return 0;
+}
+
+int ktls_configure_crypto(SSL *s, const EVP_CIPHER *c, EVP_CIPHER_CTX *dd,
+                          int which, const unsigned char *iv,
+                          const unsigned char *key,
+                          union tls_crypto_info_all *crypto_info)
+{
+    return 0;
+}
+
+unsigned int ssl_get_max_send_fragment(const SSL *ssl)
+{
+    return SSL3_RT_MAX_PLAIN_LENGTH;
+}
+
+int ssl3_release_write_buffer(SSL *s)
+{
+    return 1;
+}
+#endif
+
 /* End of mocked out code */
 
 static int test_secret(SSL *s, unsigned char *prk,
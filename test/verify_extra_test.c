@@ -20,6 +20,7 @@ static const char *roots_f;
 static const char *untrusted_f;
 static const char *bad_f;
 static const char *req_f;
+static const char *ts_f;
 
 static STACK_OF(X509) *load_certs_from_file(const char *filename)
 {
@@ -177,7 +178,314 @@ static int test_store_ctx(void)
     return testresult;
 }
 
-OPT_TEST_DECLARE_USAGE("roots.pem untrusted.pem bad.pem\n")
+static int verify_cache_cb(int ok, X509_STORE_CTX *ctx)
+{
+    return ok;
+}
+
+static int verify_cache_revoke_all(X509_STORE_CTX *ctx)
+{
+    X509_STORE_CTX_set_error(ctx, X509_V_ERR_CERT_REVOKED);
+    return 0;
+}
+
+/*
+ * Verify |x| against |store| and check the verified chain cache counters
+ * afterwards.
+ */
+static int verify_cached(X509_STORE *store, X509 *x, STACK_OF(X509) *untrusted,
+                         int expected, unsigned long flags,
+                         X509_STORE_CTX_verify_cb cb,
+                         uint64_t hits, uint64_t misses)
+{
+    X509_STORE_CTX *sctx = NULL;
+    uint64_t h, m;
+    int ret = 0;
+
+    if (!TEST_ptr(sctx = X509_STORE_CTX_new())
+            || !TEST_true(X509_STORE_CTX_init(sctx, store, x, untrusted)))
+        goto err;
+    if (flags != 0)
+        X509_STORE_CTX_set_flags(sctx, flags);
+    if (cb != NULL)
+        X509_STORE_CTX_set_verify_cb(sctx, cb);
+    if (!TEST_int_eq(X509_verify_cert(sctx), expected)
+            || !TEST_true(X509_STORE_get_verify_cache_stats(store, &h, &m))
+            || !TEST_true(h == hits)
+            || !TEST_true(m == misses))
+        goto err;
+    if (expected == 1
+            && (!TEST_int_eq(sk_X509_num(X509_STORE_CTX_get0_chain(sctx)), 2)
+                || !TEST_ptr_eq(sk_X509_value(X509_STORE_CTX_get0_chain(sctx),
+                                              0), x)))
+        goto err;
+    ret = 1;
+ err:
+    X509_STORE_CTX_free(sctx);
+    return ret;
+}
+
+static int test_store_verify_cache(void)
+{
+    X509_STORE *store = NULL;
+    X509_LOOKUP *lookup = NULL;
+    STACK_OF(X509) *untrusted = NULL;
+    X509 *leaf, *bad = NULL;
+    BIO *bio = NULL;
+    uint64_t h, m;
+    int ret = 0;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(lookup = X509_STORE_add_lookup(store,
+                                                        X509_LOOKUP_file()))
+            || !TEST_true(X509_LOOKUP_load_file(lookup, roots_f,
+                                                X509_FILETYPE_PEM))
+            || !TEST_true(X509_STORE_set_flags(store,
+                                               X509_V_FLAG_PARTIAL_CHAIN))
+            || !TEST_ptr(untrusted = load_certs_from_file(untrusted_f))
+            || !TEST_int_eq(sk_X509_num(untrusted), 2)
+            || !TEST_ptr(bio = BIO_new_file(bad_f, "r"))
+            || !TEST_ptr(bad = PEM_read_bio_X509(bio, NULL, 0, NULL)))
+        goto err;
+    leaf = sk_X509_value(untrusted, 1);
+
+    if (!TEST_false(X509_STORE_get_verify_cache_stats(store, &h, &m))
+            || !TEST_true(X509_STORE_set_verify_cache_size(store, 4)))
+        goto err;
+
+    /* The second verification of the same chain is a hit */
+    if (!verify_cached(store, leaf, untrusted, 1, 0, NULL, 0, 1)
+            || !verify_cached(store, leaf, untrusted, 1, 0, NULL, 1, 1))
+        goto err;
+
+    /* Different parameters or untrusted certificates don't match */
+    if (!verify_cached(store, leaf, untrusted, 1, X509_V_FLAG_X509_STRICT,
+                       NULL, 1, 2)
+            || !verify_cached(store, leaf, NULL, 1, 0, NULL, 1, 3))
+        goto err;
+
+    /* Failures aren't cached */
+    if (!verify_cached(store, bad, untrusted, 0, 0, NULL, 1, 4)
+            || !verify_cached(store, bad, untrusted, 0, 0, NULL, 1, 5))
+        goto err;
+
+    /* Verification callbacks bypass the cache */
+    if (!verify_cached(store, leaf, untrusted, 1, 0, verify_cache_cb, 1, 5))
+        goto err;
+
+    /* Adding to the store invalidates existing results */
+    if (!TEST_true(X509_STORE_add_cert(store, sk_X509_value(untrusted, 0)))
+            || !verify_cached(store, leaf, untrusted, 1, 0, NULL, 1, 6)
+            || !verify_cached(store, leaf, untrusted, 1, 0, NULL, 2, 6))
+        goto err;
+
+    /* So does flushing */
+    X509_STORE_flush_verify_cache(store);
+    if (!verify_cached(store, leaf, untrusted, 1, 0, NULL, 2, 7))
+        goto err;
+
+    /* A replaced revocation check bypasses the cache, and is applied */
+    X509_STORE_set_check_revocation(store, verify_cache_revoke_all);
+    if (!verify_cached(store, leaf, untrusted, 0, 0, NULL, 2, 7))
+        goto err;
+
+    ret = 1;
+ err:
+    X509_free(bad);
+    BIO_free(bio);
+    sk_X509_pop_free(untrusted, X509_free);
+    X509_STORE_free(store);
+    return ret;
+}
+
+static int test_store_signature_memo(void)
+{
+    X509_STORE *store = NULL;
+    X509_STORE_CTX *sctx = NULL;
+    X509_LOOKUP *lookup = NULL;
+    STACK_OF(X509) *untrusted = NULL;
+    uint64_t h, m;
+    int i, ret = 0;
+
+    /*
+     * With a partial chain of the leaf and the self-signed subinterCA, the
+     * only issuer signature checked is that of subinterCA on itself.
+     */
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(lookup = X509_STORE_add_lookup(store,
+                                                        X509_LOOKUP_file()))
+            || !TEST_true(X509_LOOKUP_load_file(lookup, roots_f,
+                                                X509_FILETYPE_PEM))
+            || !TEST_true(X509_STORE_set_flags(store,
+                                               X509_V_FLAG_PARTIAL_CHAIN
+                                               | X509_V_FLAG_CHECK_SS_SIGNATURE))
+            || !TEST_true(X509_STORE_set_signature_memo_size(store, 16))
+            || !TEST_ptr(untrusted = load_certs_from_file(untrusted_f)))
+        goto err;
+
+    for (i = 0; i < 3; i++) {
+        if (!TEST_ptr(sctx = X509_STORE_CTX_new())
+                || !TEST_true(X509_STORE_CTX_init(sctx, store,
+                                                  sk_X509_value(untrusted, 1),
+                                                  untrusted))
+                || !TEST_int_eq(X509_verify_cert(sctx), 1)
+                || !TEST_int_eq(sk_X509_num(X509_STORE_CTX_get0_chain(sctx)),
+                                2)
+                || !TEST_true(X509_STORE_get_signature_memo_stats(store, &h,
+                                                                  &m))
+                || !TEST_true(h == (uint64_t)i)
+                || !TEST_true(m == 1))
+            goto err;
+        X509_STORE_CTX_free(sctx);
+        sctx = NULL;
+    }
+
+    ret = 1;
+ err:
+    X509_STORE_CTX_free(sctx);
+    sk_X509_pop_free(untrusted, X509_free);
+    X509_STORE_free(store);
+    return ret;
+}
+
+/*
+ * Fill a store with enough certificates to make its indexes grow a few
+ * times, several sharing each subject, and look them up again.
+ */
+static int test_store_index(void)
+{
+    X509_STORE *store = NULL;
+    X509_STORE_CTX *sctx = NULL;
+    STACK_OF(X509) *certs = NULL, *found = NULL;
+    X509_NAME *name = NULL;
+    X509 *x = NULL, *leaf = NULL;
+    BIO *bio = NULL;
+    char cn[16];
+    int i, j, ret = 0;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(certs = sk_X509_new_null())
+            || !TEST_ptr(bio = BIO_new_file(bad_f, "r"))
+            || !TEST_ptr(leaf = PEM_read_bio_X509(bio, NULL, 0, NULL)))
+        goto err;
+
+    for (i = 0; i < 100; i++) {
+        BIO_snprintf(cn, sizeof(cn), "index %d", i % 25);
+        if (!TEST_ptr(x = X509_dup(leaf))
+                || !TEST_ptr(name = X509_NAME_new())
+                || !TEST_true(X509_NAME_add_entry_by_txt(name, "CN",
+                                                         MBSTRING_ASC,
+                                                         (unsigned char *)cn,
+                                                         -1, -1, 0))
+                || !TEST_true(X509_set_subject_name(x, name))
+                || !TEST_true(ASN1_INTEGER_set(X509_get_serialNumber(x), i))
+                || !TEST_true(X509_STORE_add_cert(store, x))
+                || !TEST_true(sk_X509_push(certs, x)))
+            goto err;
+        x = NULL;
+        X509_NAME_free(name);
+        name = NULL;
+    }
+
+    /* Adding a certificate again doesn't add another object */
+    for (i = 0; i < 100; i += 7)
+        if (!TEST_true(X509_STORE_add_cert(store, sk_X509_value(certs, i))))
+            goto err;
+    if (!TEST_int_eq(sk_X509_OBJECT_num(X509_STORE_get0_objects(store)), 100))
+        goto err;
+
+    /* All certificates with a subject come back in the order added */
+    if (!TEST_ptr(sctx = X509_STORE_CTX_new())
+            || !TEST_true(X509_STORE_CTX_init(sctx, store, leaf, NULL)))
+        goto err;
+    for (i = 0; i < 25; i++) {
+        found = X509_STORE_CTX_get1_certs(sctx,
+                    X509_get_subject_name(sk_X509_value(certs, i)));
+        if (!TEST_ptr(found) || !TEST_int_eq(sk_X509_num(found), 4))
+            goto err;
+        for (j = 0; j < 4; j++)
+            if (!TEST_int_eq(X509_cmp(sk_X509_value(found, j),
+                                      sk_X509_value(certs, i + 25 * j)), 0))
+                goto err;
+        sk_X509_pop_free(found, X509_free);
+        found = NULL;
+    }
+    if (!TEST_ptr_null(X509_STORE_CTX_get1_certs(sctx,
+                                                 X509_get_subject_name(leaf))))
+        goto err;
+
+    ret = 1;
+ err:
+    X509_STORE_CTX_free(sctx);
+    sk_X509_pop_free(found, X509_free);
+    sk_X509_pop_free(certs, X509_free);
+    X509_NAME_free(name);
+    X509_free(x);
+    X509_free(leaf);
+    BIO_free(bio);
+    X509_STORE_free(store);
+    return ret;
+}
+
+/*
+ * Compile the roots into a trust store, and check that only what a
+ * verification needs is decoded from it.
+ */
+static int test_store_mmap(void)
+{
+    X509_STORE *store = NULL;
+    X509_STORE_CTX *sctx = NULL;
+    X509_LOOKUP *lookup = NULL;
+    STACK_OF(X509) *roots = NULL, *untrusted = NULL;
+    BIO *bio = NULL;
+    int ret = 0;
+
+    if (!TEST_ptr(roots = load_certs_from_file(roots_f))
+            || !TEST_ptr(bio = BIO_new_file(ts_f, "wb"))
+            || !TEST_true(X509_LOOKUP_mmap_write(bio, roots)))
+        goto err;
+    BIO_free(bio);
+    bio = NULL;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(lookup = X509_STORE_add_lookup(store,
+                                                        X509_LOOKUP_mmap()))
+            || !TEST_false(X509_LOOKUP_load_mmap(lookup, roots_f))
+            || !TEST_true(X509_LOOKUP_load_mmap(lookup, ts_f))
+            || !TEST_true(X509_STORE_set_flags(store,
+                                               X509_V_FLAG_PARTIAL_CHAIN))
+            || !TEST_ptr(untrusted = load_certs_from_file(untrusted_f))
+            || !TEST_int_eq(sk_X509_OBJECT_num(X509_STORE_get0_objects(store)),
+                            0))
+        goto err;
+    ERR_clear_error();
+
+    /* The lookup must leave errors that were already queued alone */
+    ERR_raise(ERR_LIB_X509, ERR_R_PASSED_INVALID_ARGUMENT);
+    if (!TEST_ptr(sctx = X509_STORE_CTX_new())
+            || !TEST_true(X509_STORE_CTX_init(sctx, store,
+                                              sk_X509_value(untrusted, 1),
+                                              untrusted))
+            || !TEST_int_eq(X509_verify_cert(sctx), 1)
+            || !TEST_int_eq(sk_X509_num(X509_STORE_CTX_get0_chain(sctx)), 2)
+            || !TEST_int_eq(sk_X509_OBJECT_num(X509_STORE_get0_objects(store)),
+                            1)
+            || !TEST_int_eq(ERR_GET_REASON(ERR_peek_error()),
+                            ERR_R_PASSED_INVALID_ARGUMENT))
+        goto err;
+    ERR_clear_error();
+
+    ret = 1;
+ err:
+    X509_STORE_CTX_free(sctx);
+    sk_X509_pop_free(untrusted, X509_free);
+    sk_X509_pop_free(roots, X509_free);
+    BIO_free(bio);
+    X509_STORE_free(store);
+    return ret;
+}
+
+OPT_TEST_DECLARE_USAGE("roots.pem untrusted.pem bad.pem sm2-csr.pem tmpfile\n")
 
 #ifndef OPENSSL_NO_SM2
 static int test_sm2_id(void)
@@ -266,11 +574,16 @@ int setup_tests(void)
     if (!TEST_ptr(roots_f = test_get_argument(0))
             || !TEST_ptr(untrusted_f = test_get_argument(1))
             || !TEST_ptr(bad_f = test_get_argument(2))
-            || !TEST_ptr(req_f = test_get_argument(3)))
+            || !TEST_ptr(req_f = test_get_argument(3))
+            || !TEST_ptr(ts_f = test_get_argument(4)))
         return 0;
 
     ADD_TEST(test_alt_chains_cert_forgery);
     ADD_TEST(test_store_ctx);
+    ADD_TEST(test_store_verify_cache);
+    ADD_TEST(test_store_signature_memo);
+    ADD_TEST(test_store_index);
+    ADD_TEST(test_store_mmap);
 #ifndef OPENSSL_NO_SM2
     ADD_TEST(test_sm2_id);
     ADD_TEST(test_req_sm2_id);